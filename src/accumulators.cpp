@@ -12,10 +12,16 @@
 #include "accumulatorcheckpoints.h"
 #include "zvitchain.h"
 
+#include <boost/thread.hpp>
+
 using namespace libzerocoin;
 
 std::map<uint32_t, CBigNum> mapAccumulatorValues;
 std::list<uint256> listAccCheckpointsNoDB;
+// Guards mapAccumulatorValues and listAccCheckpointsNoDB against the background load
+CCriticalSection cs_accumulatorValues;
+static boost::thread threadLoadAccumulatorValues;
+CMintCounts mintCounts;
 
 uint32_t ParseChecksum(uint256 nChecksum, CoinDenomination denomination)
 {
@@ -62,9 +68,12 @@ int GetChecksumHeight(uint32_t nChecksum, CoinDenomination denomination)
 
 bool GetAccumulatorValueFromChecksum(uint32_t nChecksum, bool fMemoryOnly, CBigNum& bnAccValue)
 {
-    if (mapAccumulatorValues.count(nChecksum)) {
-        bnAccValue = mapAccumulatorValues.at(nChecksum);
-        return true;
+    {
+        LOCK(cs_accumulatorValues);
+        if (mapAccumulatorValues.count(nChecksum)) {
+            bnAccValue = mapAccumulatorValues.at(nChecksum);
+            return true;
+        }
     }
 
     if (fMemoryOnly)
@@ -87,6 +96,7 @@ void AddAccumulatorChecksum(const uint32_t nChecksum, const CBigNum &bnValue)
 {
     //Since accumulators are switching at v2, stop databasing v1 because its useless. Only focus on v2.
     if (chainActive.Height() >= Params().Zerocoin_Block_V2_Start()) {
+        LOCK(cs_accumulatorValues);
         zerocoinDB->WriteAccumulatorValue(nChecksum, bnValue);
         mapAccumulatorValues.insert(make_pair(nChecksum, bnValue));
     }
@@ -106,6 +116,7 @@ void DatabaseChecksums(AccumulatorMap& mapAccumulators)
 bool EraseChecksum(uint32_t nChecksum)
 {
     //erase from both memory and database
+    LOCK(cs_accumulatorValues);
     mapAccumulatorValues.erase(nChecksum);
     return zerocoinDB->EraseAccumulatorValue(nChecksum);
 }
@@ -129,6 +140,8 @@ bool EraseAccumulatorValues(const uint256& nCheckpointErase, const uint256& nChe
 
 bool LoadAccumulatorValuesFromDB(const uint256 nCheckpoint)
 {
+    // Held across the reads, so that a value erased meanwhile is not put back into memory
+    LOCK(cs_accumulatorValues);
     for (auto& denomination : zerocoinDenomList) {
         uint32_t nChecksum = ParseChecksum(nCheckpoint, denomination);
 
@@ -145,6 +158,37 @@ bool LoadAccumulatorValuesFromDB(const uint256 nCheckpoint)
     return true;
 }
 
+static void ThreadLoadAccumulatorValues(const std::vector<uint256> vCheckpoints)
+{
+    RenameThread("Divitae-accload");
+    int64_t nStart = GetTimeMillis();
+    try {
+        for (const uint256& nCheckpoint : vCheckpoints) {
+            boost::this_thread::interruption_point();
+            LoadAccumulatorValuesFromDB(nCheckpoint);
+        }
+    } catch (const boost::thread_interrupted&) {
+        LogPrintf("%s : interrupted\n", __func__);
+        return;
+    }
+    LogPrintf("%s : loaded %u accumulator checkpoints in %dms\n", __func__, vCheckpoints.size(), GetTimeMillis() - nStart);
+}
+
+void LoadAccumulatorValuesInBackground(const std::vector<uint256>& vCheckpoints)
+{
+    WaitForAccumulatorValues(true);
+    threadLoadAccumulatorValues = boost::thread(&ThreadLoadAccumulatorValues, vCheckpoints);
+}
+
+void WaitForAccumulatorValues(bool fInterrupt)
+{
+    if (!threadLoadAccumulatorValues.joinable())
+        return;
+    if (fInterrupt)
+        threadLoadAccumulatorValues.interrupt();
+    threadLoadAccumulatorValues.join();
+}
+
 //Erase accumulator checkpoints for a certain block range
 bool EraseCheckpoints(int nStartHeight, int nEndHeight)
 {
@@ -267,12 +311,12 @@ bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint, Accumulat
         }
 
         //grab mints from this block
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex))
+        std::shared_ptr<const CBlock> pblock;
+        if(!ReadBlockFromDisk(pblock, pindex))
             return error("%s: failed to read block from disk", __func__);
 
         std::list<PublicCoin> listPubcoins;
-        if (!BlockToPubcoinList(block, listPubcoins, fFilterInvalid))
+        if (!BlockToPubcoinList(*pblock, listPubcoins, fFilterInvalid))
             return error("%s: failed to get zerocoin mintlist from block %d", __func__, pindex->nHeight);
 
         nTotalMintsFound += listPubcoins.size();
@@ -343,48 +387,107 @@ void RandomizeSecurityLevel(int& nSecurityLevel)
     }
 }
 
-//Compute how many coins were added to an accumulator up to the end height
-int ComputeAccumulatedCoins(int nHeightEnd, libzerocoin::CoinDenomination denom)
+void CMintCounts::Sync(const CChain& chain)
 {
-    CBlockIndex* pindex = chainActive[GetZerocoinStartHeight()];
-    int n = 0;
-    while (pindex->nHeight < nHeightEnd) {
-        n += count(pindex->vMintDenominationsInBlock.begin(), pindex->vMintDenominationsInBlock.end(), denom);
-        pindex = chainActive.Next(pindex);
+    if (vSamples.empty())
+        vSamples.push_back(Counts());
+
+    //drop the samples of blocks that are no longer in the chain
+    if (pindexCounted && !chain.Contains(pindexCounted)) {
+        const CBlockIndex* pindexFork = chain.FindFork(pindexCounted);
+        int nHeightFork = pindexFork ? pindexFork->nHeight : -1;
+        vSamples.resize((nHeightFork + 1) / SAMPLE_INTERVAL + 1);
+        pindexCounted = vSamples.size() > 1 ? chain[(vSamples.size() - 1) * SAMPLE_INTERVAL - 1] : NULL;
     }
 
+    //count the blocks connected since
+    while ((int)vSamples.size() * SAMPLE_INTERVAL <= chain.Height() + 1) {
+        Counts counts = vSamples.back();
+        int nHeightEnd = vSamples.size() * SAMPLE_INTERVAL;
+        for (int nHeight = nHeightEnd - SAMPLE_INTERVAL; nHeight < nHeightEnd; nHeight++) {
+            const CBlockIndex* pindex = chain[nHeight];
+            for (unsigned int i = 0; i < zerocoinDenomCount; i++)
+                counts[i] += pindex->GetMintDenominationCount(zerocoinDenomList[i]);
+        }
+        vSamples.push_back(counts);
+        pindexCounted = chain[nHeightEnd - 1];
+    }
+}
+
+unsigned int CMintCounts::GetCount(const CChain& chain, int nHeightEnd, libzerocoin::CoinDenomination denom)
+{
+    int nIndex = ZerocoinDenominationToIndex(denom);
+    if (nIndex < 0)
+        return 0;
+
+    LOCK(cs);
+    Sync(chain);
+    nHeightEnd = std::min(nHeightEnd, chain.Height() + 1);
+    if (nHeightEnd <= 0)
+        return 0;
+
+    int nSample = std::min(nHeightEnd / SAMPLE_INTERVAL, (int)vSamples.size() - 1);
+    unsigned int n = vSamples[nSample][nIndex];
+    for (int nHeight = nSample * SAMPLE_INTERVAL; nHeight < nHeightEnd; nHeight++)
+        n += chain[nHeight]->GetMintDenominationCount(denom);
     return n;
 }
 
-int AddBlockMintsToAccumulator(const libzerocoin::PublicCoin& coin, const int nHeightMintAdded, const CBlockIndex* pindex,
-                           libzerocoin::Accumulator* accumulator, bool isWitness)
+void CMintCounts::Clear()
 {
-    // if this block contains mints of the denomination that is being spent, then add them to the witness
-    int nMintsAdded = 0;
-    if (pindex->MintedDenomination(coin.getDenomination())) {
-        //grab mints from this block
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex))
-            return error("%s: failed to read block from disk while adding pubcoins to witness", __func__);
+    LOCK(cs);
+    vSamples.clear();
+    pindexCounted = NULL;
+}
 
-        list<PublicCoin> listPubcoins;
-        if(!BlockToPubcoinList(block, listPubcoins, true))
-            return error("%s: failed to get zerocoin mintlist from block %n\n", __func__, pindex->nHeight);
+//Compute how many coins were added to an accumulator up to the end height
+int ComputeAccumulatedCoins(int nHeightEnd, libzerocoin::CoinDenomination denom)
+{
+    int nHeightStart = GetZerocoinStartHeight();
+    if (nHeightEnd <= nHeightStart)
+        return 0;
+    return mintCounts.GetCount(chainActive, nHeightEnd, denom) - mintCounts.GetCount(chainActive, nHeightStart, denom);
+}
 
-        //add the mints to the witness
-        for (const PublicCoin& pubcoin : listPubcoins) {
-            if (pubcoin.getDenomination() != coin.getDenomination())
-                continue;
+//Read the pubcoins of a block from the cursor, which only seeks when the height goes back or it ran out
+static bool ReadBlockPubcoins(CPubcoinCursor& cursor, const CBlockIndex* pindex, vector<CBigNum>& vPubcoins)
+{
+    if (!cursor.Valid() || cursor.GetHeight() > pindex->nHeight)
+        cursor.Seek(pindex->nHeight);
+    while (cursor.Valid() && cursor.GetHeight() < pindex->nHeight)
+        cursor.Next();
+    return cursor.Valid() && cursor.GetHeight() == pindex->nHeight && cursor.GetPubcoins(vPubcoins);
+}
+
+static bool AddBlockMintsToAccumulator(libzerocoin::CoinDenomination denom, const uint256& hashPubcoin, const int nHeightMintAdded, const CBlockIndex* pindex,
+                           libzerocoin::Accumulator* accumulator, bool isWitness, CPubcoinCursor& cursor, int& nMintsAdded)
+{
+    // if this block contains mints of the denomination that is being spent, then add them to the witness
+    if (pindex->MintedDenomination(denom)) {
+        //grab mints from the block pubcoins, or from the block itself if they are not recorded
+        vector<CBigNum> vPubcoins;
+        if (!ReadBlockPubcoins(cursor, pindex, vPubcoins)) {
+            std::shared_ptr<const CBlock> pblock;
+            if(!ReadBlockFromDisk(pblock, pindex))
+                return error("%s: failed to read block from disk while adding pubcoins to witness", __func__);
+
+            std::map<CoinDenomination, vector<CBigNum> > mapPubcoins;
+            if(!BlockToAccumulatedPubcoins(*pblock, pindex, mapPubcoins))
+                return error("%s: failed to get zerocoin mintlist from block %d\n", __func__, pindex->nHeight);
+            vPubcoins = mapPubcoins[denom];
+        }
 
-            if (isWitness && pindex->nHeight == nHeightMintAdded && pubcoin.getValue() == coin.getValue())
+        //add the mints to the witness
+        for (const CBigNum& bnPubcoin : vPubcoins) {
+            if (isWitness && pindex->nHeight == nHeightMintAdded && GetPubCoinHash(bnPubcoin) == hashPubcoin)
                 continue;
 
-            accumulator->increment(pubcoin.getValue());
+            accumulator->increment(bnPubcoin);
             ++nMintsAdded;
         }
     }
 
-    return nMintsAdded;
+    return true;
 }
 
 bool GetAccumulatorValue(int& nHeight, const libzerocoin::CoinDenomination denom, CBigNum& bnAccValue)
@@ -413,7 +516,58 @@ bool GetAccumulatorValue(int& nHeight, const libzerocoin::CoinDenomination denom
     return true;
 }
 
-bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator, AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, string& strError, CBlockIndex* pindexCheckpoint)
+bool InitMintWitness(libzerocoin::CoinDenomination denom, int nHeightMint, CMintWitness& witness)
+{
+    witness.SetNull();
+    witness.denom = denom;
+    witness.nHeightMint = nHeightMint;
+
+    //get the checkpoint added at the next multiple of 10
+    int nHeightCheckpoint = nHeightMint + (10 - (nHeightMint % 10));
+    CBigNum bnAccValue = 0;
+    bool fFound = GetAccumulatorValue(nHeightCheckpoint, denom, bnAccValue);
+    witness.nHeight = nHeightCheckpoint - 10;
+    if (!fFound)
+        return false;
+
+    witness.bnValue = bnAccValue;
+    if (witness.nHeight > 0)
+        witness.hashBlock = chainActive[witness.nHeight - 1]->GetBlockHash();
+    return true;
+}
+
+bool AdvanceMintWitness(const uint256& hashPubcoin, const std::vector<const CBlockIndex*>& vBlocks, int nHeightFirst, int nHeightEnd, CMintWitness& witness)
+{
+    if (witness.nHeight < nHeightFirst || nHeightEnd > nHeightFirst + (int)vBlocks.size())
+        return error("%s: blocks %d to %d are not given", __func__, witness.nHeight, nHeightEnd);
+
+    libzerocoin::Accumulator accumulator(Params().Zerocoin_Params(false), witness.denom, witness.bnValue);
+    boost::scoped_ptr<CPubcoinCursor> pcursor(zerocoinDB->PubcoinCursor(witness.denom, witness.nHeight));
+    bool fDoubleCounted = false;
+    int nHeight = witness.nHeight;
+    while (nHeight < nHeightEnd) {
+        const CBlockIndex* pindex = vBlocks[nHeight - nHeightFirst];
+        if (!AddBlockMintsToAccumulator(witness.denom, hashPubcoin, witness.nHeightMint, pindex, &accumulator, true, *pcursor, witness.nMintsAdded))
+            return false;
+
+        // 10 blocks were accumulated twice when zDIVIT v2 was activated, like GenerateAccumulatorWitness does
+        if (nHeight == 1050010 && !fDoubleCounted) {
+            if (nHeightFirst > 1050000)
+                return error("%s: blocks from 1050000 are not given", __func__);
+            nHeight = 1050000;
+            fDoubleCounted = true;
+            continue;
+        }
+        nHeight++;
+    }
+
+    witness.bnValue = accumulator.getValue();
+    witness.nHeight = nHeightEnd;
+    witness.hashBlock = vBlocks[nHeightEnd - 1 - nHeightFirst]->GetBlockHash();
+    return true;
+}
+
+bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator, AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, string& strError, CBlockIndex* pindexCheckpoint, int nHeightMint, const CMintWitness* pwitnessCached)
 {
     LogPrint("zero", "%s: generating\n", __func__);
     int nLockAttempts = 0;
@@ -433,32 +587,39 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
     if (!zerocoinDB->ReadCoinMint(coin.getValue(), txid))
         return error("%s failed to read mint from db", __func__);
 
-    CTransaction txMinted;
-    uint256 hashBlock;
-    if (!GetTransaction(txid, txMinted, hashBlock))
-        return error("%s failed to read tx", __func__);
-
-    int nHeightTest;
-    if (!IsTransactionInChain(txid, nHeightTest))
-        return error("%s: mint tx %s is not in chain", __func__, txid.GetHex());
-
-    int nHeightMintAdded = mapBlockIndex[hashBlock]->nHeight;
-
-    //get the checkpoint added at the next multiple of 10
-    int nHeightCheckpoint = nHeightMintAdded + (10 - (nHeightMintAdded % 10));
+    // Check the height the wallet recorded against the block pubcoins first, which saves reading the mint's
+    // block and works when that block is pruned
+    int nHeightMintAdded = 0;
+    vector<CBigNum> vPubcoins;
+    if (nHeightMint > 0 && nHeightMint <= chainActive.Height() &&
+        zerocoinDB->ReadBlockPubcoins(coin.getDenomination(), nHeightMint, vPubcoins) &&
+        std::find(vPubcoins.begin(), vPubcoins.end(), coin.getValue()) != vPubcoins.end()) {
+        nHeightMintAdded = nHeightMint;
+    } else {
+        CTransaction txMinted;
+        uint256 hashBlock;
+        if (!GetTransaction(txid, txMinted, hashBlock))
+            return error("%s failed to read tx", __func__);
+
+        int nHeightTest;
+        if (!IsTransactionInChain(txid, nHeightTest))
+            return error("%s: mint tx %s is not in chain", __func__, txid.GetHex());
+
+        nHeightMintAdded = mapBlockIndex[hashBlock]->nHeight;
+    }
 
     //the height to start accumulating coins to add to witness
     int nAccStartHeight = nHeightMintAdded - (nHeightMintAdded % 10);
 
     //Get the accumulator that is right before the cluster of blocks containing our mint was added to the accumulator
-    CBigNum bnAccValue = 0;
-    if (GetAccumulatorValue(nHeightCheckpoint, coin.getDenomination(), bnAccValue)) {
-            accumulator.setValue(bnAccValue);
+    CMintWitness start;
+    if (InitMintWitness(coin.getDenomination(), nHeightMintAdded, start)) {
+            accumulator.setValue(start.bnValue);
             witness.resetValue(accumulator, coin);
     }
 
     //add the pubcoins from the blockchain up to the next checksum starting from the block
-    CBlockIndex* pindex = chainActive[nHeightCheckpoint - 10];
+    CBlockIndex* pindex = chainActive[start.nHeight];
     int nChainHeight = chainActive.Height();
     int nHeightStop = nChainHeight % 10;
     nHeightStop = nChainHeight - nHeightStop - 20; // at least two checkpoints deep
@@ -472,8 +633,27 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
     nMintsAdded = 0;
     RandomizeSecurityLevel(nSecurityLevel); //make security level not always the same and predictable
     libzerocoin::Accumulator witnessAccumulator = accumulator;
+    const uint256 hashPubcoin = GetPubCoinHash(coin.getValue());
+
+    //Continue from the witness the wallet keeps, when it is on the active chain and not past 1050000 without the blocks
+    //that were accumulated twice
+    int nHeightCached = 0;
+    if (pwitnessCached && !pwitnessCached->IsNull() && pwitnessCached->denom == coin.getDenomination() &&
+        pwitnessCached->nHeightMint == nHeightMintAdded && pwitnessCached->nHeight > start.nHeight &&
+        pwitnessCached->nHeight <= chainActive.Height() + 1 &&
+        chainActive[pwitnessCached->nHeight - 1]->GetBlockHash() == pwitnessCached->hashBlock &&
+        (pwitnessCached->nHeight <= 1050000 || pwitnessCached->nHeight > 1050010)) {
+        nHeightCached = pwitnessCached->nHeight;
+        witnessAccumulator.setValue(pwitnessCached->bnValue);
+        nMintsAdded = pwitnessCached->nMintsAdded;
+        LogPrint("zero", "%s: continuing from the witness at height %d\n", __func__, nHeightCached);
+    }
 
-    bool fDoubleCounted = false;
+    //Stream the pubcoins of the denomination from the database as the blocks are walked
+    boost::scoped_ptr<CPubcoinCursor> pcursor(zerocoinDB->PubcoinCursor(coin.getDenomination(), std::max(start.nHeight, nHeightCached)));
+
+    //a kept witness past the blocks accumulated twice holds them twice already
+    bool fDoubleCounted = nHeightCached > 1050010;
     while (pindex) {
         if (pindex->nHeight != nAccStartHeight && pindex->pprev->nAccumulatorCheckpoint != pindex->nAccumulatorCheckpoint)
             ++nCheckpointsAdded;
@@ -485,7 +665,11 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
             if(InvalidCheckpointRange(pindex->nHeight))
                 continue;
 
-            bnAccValue = 0;
+            //The kept witness has blocks past this checkpoint, start over without it
+            if (nHeightCached && pindex->nHeight < nHeightCached)
+                return GenerateAccumulatorWitness(coin, accumulator, witness, nSecurityLevel, nMintsAdded, strError, pindexCheckpoint, nHeightMint);
+
+            CBigNum bnAccValue = 0;
             uint256 nCheckpointSpend = chainActive[pindex->nHeight + 10]->nAccumulatorCheckpoint;
             if (!GetAccumulatorValueFromDB(nCheckpointSpend, coin.getDenomination(), bnAccValue) || bnAccValue == 0)
                 return error("%s : failed to find checksum in database for accumulator", __func__);
@@ -494,12 +678,16 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
             break;
         }
 
-        nMintsAdded += AddBlockMintsToAccumulator(coin, nHeightMintAdded, pindex, &witnessAccumulator, true);
+        //blocks below the kept witness are in it already
+        if (pindex->nHeight >= nHeightCached &&
+            !AddBlockMintsToAccumulator(coin.getDenomination(), hashPubcoin, nHeightMintAdded, pindex, &witnessAccumulator, true, *pcursor, nMintsAdded))
+            return error("%s: failed to add the mints of block %d", __func__, pindex->nHeight);
 
         // 10 blocks were accumulated twice when zDIVIT v2 was activated
         if (pindex->nHeight == 1050010 && !fDoubleCounted) {
             pindex = chainActive[1050000];
             fDoubleCounted = true;
+            nHeightCached = 0;
             continue;
         }
 
@@ -507,8 +695,11 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
     }
 
     witness.resetValue(witnessAccumulator, coin);
-    if (!witness.VerifyWitness(accumulator, coin))
+    if (!witness.VerifyWitness(accumulator, coin)) {
+        if (pwitnessCached)
+            return GenerateAccumulatorWitness(coin, accumulator, witness, nSecurityLevel, nMintsAdded, strError, pindexCheckpoint, nHeightMint);
         return error("%s: failed to verify witness", __func__);
+    }
 
     // A certain amount of accumulated coins are required
     if (nMintsAdded < Params().Zerocoin_RequiredAccumulation()) {
@@ -525,42 +716,33 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
 
 map<CoinDenomination, int> GetMintMaturityHeight()
 {
-    map<CoinDenomination, pair<int, int > > mapDenomMaturity;
-    for (auto denom : libzerocoin::zerocoinDenomList)
-        mapDenomMaturity.insert(make_pair(denom, make_pair(0, 0)));
-
     int nConfirmedHeight = chainActive.Height() - Params().Zerocoin_MintRequiredConfirmations();
 
     // A mint need to get to at least the min maturity height before it will spend.
     int nMinimumMaturityHeight = nConfirmedHeight - (nConfirmedHeight % 10);
-    CBlockIndex* pindex = chainActive[nConfirmedHeight];
-
-    while (pindex && pindex->nHeight > Params().Zerocoin_StartHeight()) {
-        bool isFinished = true;
-        for (auto denom : libzerocoin::zerocoinDenomList) {
-            //If the denom has not already had a mint added to it, then see if it has a mint added on this block
-            if (mapDenomMaturity.at(denom).first < Params().Zerocoin_RequiredAccumulation()) {
-                mapDenomMaturity.at(denom).first += count(pindex->vMintDenominationsInBlock.begin(),
-                                                          pindex->vMintDenominationsInBlock.end(), denom);
-
-                //if mint was found then record this block as the first block that maturity occurs.
-                if (mapDenomMaturity.at(denom).first >= Params().Zerocoin_RequiredAccumulation())
-                    mapDenomMaturity.at(denom).second = std::min(pindex->nHeight, nMinimumMaturityHeight);
-
-                //Signal that we are finished
-                isFinished = false;
+    int nHeightStart = Params().Zerocoin_StartHeight() + 1;
+    int nRequired = Params().Zerocoin_RequiredAccumulation();
+
+    map<CoinDenomination, int> mapRet;
+    for (auto denom : libzerocoin::zerocoinDenomList) {
+        //find the highest block from which on the confirmed blocks hold enough mints, 0 if there is none
+        int nHeightMature = 0;
+        if (nConfirmedHeight >= nHeightStart) {
+            int nTotal = mintCounts.GetCount(chainActive, nConfirmedHeight + 1, denom);
+            if (nTotal - (int)mintCounts.GetCount(chainActive, nHeightStart, denom) >= nRequired) {
+                int nLow = nHeightStart, nHigh = nConfirmedHeight;
+                while (nLow < nHigh) {
+                    int nMid = nLow + (nHigh - nLow + 1) / 2;
+                    if (nTotal - (int)mintCounts.GetCount(chainActive, nMid, denom) >= nRequired)
+                        nLow = nMid;
+                    else
+                        nHigh = nMid - 1;
+                }
+                nHeightMature = std::min(nLow, nMinimumMaturityHeight);
             }
         }
-
-        if (isFinished)
-            break;
-        pindex = chainActive[pindex->nHeight - 1];
+        mapRet.insert(make_pair(denom, nHeightMature));
     }
 
-    //Generate final map
-    map<CoinDenomination, int> mapRet;
-    for (auto denom : libzerocoin::zerocoinDenomList)
-        mapRet.insert(make_pair(denom, mapDenomMaturity.at(denom).second));
-
     return mapRet;
 }
@@ -11,18 +11,67 @@
 #include "primitives/zerocoin.h"
 #include "accumulatormap.h"
 #include "chain.h"
+#include "sync.h"
 #include "uint256.h"
 
+#include <array>
+#include <vector>
+
 class CBlockIndex;
 
+/**
+ * Cumulative mint counts of every denomination along a chain, so the mints below a height are
+ * counted without walking the chain. A sample is kept every SAMPLE_INTERVAL blocks, and the blocks
+ * between the last sample and the height are added from their index entries. The samples follow
+ * the chain lazily: before a lookup the samples of blocks that left it are dropped and the blocks
+ * connected since are counted. The caller must keep the chain from changing during a lookup.
+ */
+class CMintCounts
+{
+public:
+    static const int SAMPLE_INTERVAL = 10;
+
+    CMintCounts() : pindexCounted(NULL) {}
+
+    //! Number of mints of a denomination in the blocks of the chain below nHeightEnd
+    unsigned int GetCount(const CChain& chain, int nHeightEnd, libzerocoin::CoinDenomination denom);
+    //! Forget the samples, for when the block index entries they refer to go away or their mints are rewritten
+    void Clear();
+
+private:
+    typedef std::array<unsigned int, libzerocoin::zerocoinDenomCount> Counts;
+
+    CCriticalSection cs;
+    //! vSamples[i] holds the mints in the blocks below height i * SAMPLE_INTERVAL
+    std::vector<Counts> vSamples;
+    //! Last block the samples cover, null when they cover none
+    const CBlockIndex* pindexCounted;
+
+    void Sync(const CChain& chain);
+};
+
+//! The mint counts of chainActive
+extern CMintCounts mintCounts;
+
 std::map<libzerocoin::CoinDenomination, int> GetMintMaturityHeight();
-bool GenerateAccumulatorWitness(const libzerocoin::PublicCoin &coin, libzerocoin::Accumulator& accumulator, libzerocoin::AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, std::string& strError, CBlockIndex* pindexCheckpoint = nullptr);
+/** Start the witness of a mint added at nHeightMint from the accumulator checkpoint before it */
+bool InitMintWitness(libzerocoin::CoinDenomination denom, int nHeightMint, CMintWitness& witness);
+/**
+ * Add the mints of the blocks from witness.nHeight up to nHeightEnd to the witness of the mint hashPubcoin.
+ * vBlocks holds the blocks of the active chain from nHeightFirst on, so it can be walked without cs_main.
+ */
+bool AdvanceMintWitness(const uint256& hashPubcoin, const std::vector<const CBlockIndex*>& vBlocks, int nHeightFirst, int nHeightEnd, CMintWitness& witness);
+bool GenerateAccumulatorWitness(const libzerocoin::PublicCoin &coin, libzerocoin::Accumulator& accumulator, libzerocoin::AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, std::string& strError, CBlockIndex* pindexCheckpoint = nullptr, int nHeightMint = 0, const CMintWitness* pwitnessCached = nullptr);
 bool GetAccumulatorValueFromDB(uint256 nCheckpoint, libzerocoin::CoinDenomination denom, CBigNum& bnAccValue);
 bool GetAccumulatorValueFromChecksum(uint32_t nChecksum, bool fMemoryOnly, CBigNum& bnAccValue);
 void AddAccumulatorChecksum(const uint32_t nChecksum, const CBigNum &bnValue, bool fMemoryOnly);
 bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint, AccumulatorMap& mapAccumulators);
 void DatabaseChecksums(AccumulatorMap& mapAccumulators);
 bool LoadAccumulatorValuesFromDB(const uint256 nCheckpoint);
+/** Loads the accumulator values of the checkpoints into memory on a background thread */
+void LoadAccumulatorValuesInBackground(const std::vector<uint256>& vCheckpoints);
+/** Waits for LoadAccumulatorValuesInBackground() to finish, stopping it early if fInterrupt is set */
+void WaitForAccumulatorValues(bool fInterrupt = false);
 bool EraseAccumulatorValues(const uint256& nCheckpointErase, const uint256& nCheckpointPrevious);
 uint32_t ParseChecksum(uint256 nChecksum, libzerocoin::CoinDenomination denomination);
 uint32_t GetChecksum(const CBigNum &bnValue);
@@ -0,0 +1,78 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addressindex.h"
+
+#include "coins.h"
+#include "primitives/transaction.h"
+#include "script/standard.h"
+
+bool GetScriptAddress(const CScript& script, int& nAddressType, uint160& hashAddress)
+{
+    CTxDestination dest;
+    if (!ExtractDestination(script, dest))
+        return false;
+    if (const CKeyID* keyID = boost::get<CKeyID>(&dest)) {
+        nAddressType = ADDRESS_PUBKEYHASH;
+        hashAddress = *keyID;
+        return true;
+    }
+    if (const CScriptID* scriptID = boost::get<CScriptID>(&dest)) {
+        nAddressType = ADDRESS_SCRIPTHASH;
+        hashAddress = *scriptID;
+        return true;
+    }
+    return false;
+}
+
+void CAddressIndexUpdate::AddTransaction(const CTransaction& tx, unsigned int nTxIndex, int nHeight, const std::vector<Coin>* pvSpent, bool fConnect)
+{
+    const uint256& txhash = tx.GetHash();
+    int nAddressType;
+    uint160 hashAddress;
+
+    for (unsigned int k = 0; k < tx.vout.size(); k++) {
+        const CTxOut& out = tx.vout[k];
+        if (!fAddressIndex || !GetScriptAddress(out.scriptPubKey, nAddressType, hashAddress))
+            continue;
+        CAddressIndexKey key(nAddressType, hashAddress, nHeight, nTxIndex, txhash, k, false);
+        CAddressUnspentKey keyUnspent(nAddressType, hashAddress, txhash, k);
+        if (fConnect) {
+            vAddressWrite.push_back(std::make_pair(key, out.nValue));
+            vUnspent.push_back(std::make_pair(keyUnspent, CAddressUnspentValue(out.nValue, out.scriptPubKey, nHeight)));
+        } else {
+            vAddressErase.push_back(key);
+            vUnspent.push_back(std::make_pair(keyUnspent, CAddressUnspentValue()));
+        }
+    }
+
+    if (!pvSpent)
+        return;
+    for (unsigned int j = 0; j < tx.vin.size() && j < pvSpent->size(); j++) {
+        const COutPoint& prevout = tx.vin[j].prevout;
+        const Coin& coin = (*pvSpent)[j];
+        if (!GetScriptAddress(coin.out.scriptPubKey, nAddressType, hashAddress)) {
+            nAddressType = ADDRESS_NONE;
+            hashAddress = uint160(0);
+        }
+        if (fAddressIndex && nAddressType != ADDRESS_NONE) {
+            CAddressIndexKey key(nAddressType, hashAddress, nHeight, nTxIndex, txhash, j, true);
+            CAddressUnspentKey keyUnspent(nAddressType, hashAddress, prevout.hash, prevout.n);
+            if (fConnect) {
+                vAddressWrite.push_back(std::make_pair(key, -coin.out.nValue));
+                vUnspent.push_back(std::make_pair(keyUnspent, CAddressUnspentValue()));
+            } else {
+                vAddressErase.push_back(key);
+                vUnspent.push_back(std::make_pair(keyUnspent, CAddressUnspentValue(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight)));
+            }
+        }
+        if (fSpentIndex) {
+            CSpentIndexKey key(prevout.hash, prevout.n);
+            if (fConnect)
+                vSpent.push_back(std::make_pair(key, CSpentIndexValue(txhash, j, nHeight, coin.out.nValue, nAddressType, hashAddress)));
+            else
+                vSpent.push_back(std::make_pair(key, CSpentIndexValue()));
+        }
+    }
+}
@@ -0,0 +1,237 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DIVIT_ADDRESSINDEX_H
+#define DIVIT_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "script/script.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <utility>
+#include <vector>
+
+class Coin;
+class CTransaction;
+
+//! Default for -addressindex
+static const bool DEFAULT_ADDRESSINDEX = false;
+//! Default for -spentindex
+static const bool DEFAULT_SPENTINDEX = false;
+
+//! Kinds of address in the indexes, 0 for outputs without one
+enum AddressType {
+    ADDRESS_NONE = 0,
+    ADDRESS_PUBKEYHASH = 1,
+    ADDRESS_SCRIPTHASH = 2,
+};
+
+/**
+ * Find the address an output script pays to. Pay-to-pubkey outputs, like coinstakes,
+ * are indexed under the address of their key.
+ */
+bool GetScriptAddress(const CScript& script, int& nAddressType, uint160& hashAddress);
+
+/** Height or position, serialized big endian so keys sort by it */
+template <typename Stream, typename Operation>
+inline void ReadWriteBigEndian32(Stream& s, Operation ser_action, int nType, int nVersion, uint32_t& n)
+{
+    unsigned char pch[4];
+    if (!ser_action.ForRead()) {
+        for (int i = 0; i < 4; i++)
+            pch[i] = (n >> (24 - 8 * i)) & 0xff;
+    }
+    READWRITE(FLATDATA(pch));
+    if (ser_action.ForRead())
+        n = ((uint32_t)pch[0] << 24) | ((uint32_t)pch[1] << 16) | ((uint32_t)pch[2] << 8) | pch[3];
+}
+
+/**
+ * Key of one change to the balance of an address: an output paying to it, or an input
+ * spending such an output. The records of an address are ordered by height and by
+ * position in the block.
+ */
+class CAddressIndexKey
+{
+public:
+    char chType;
+    unsigned char nAddressType;
+    uint160 hashAddress;
+    int nHeight;
+    unsigned int nTxIndex;
+    uint256 txhash;
+    unsigned int nIndex;
+    bool fSpending;
+
+    CAddressIndexKey() : chType('a'), nAddressType(0), nHeight(0), nTxIndex(0), nIndex(0), fSpending(false) {}
+    CAddressIndexKey(int nAddressTypeIn, const uint160& hashAddressIn, int nHeightIn, unsigned int nTxIndexIn, const uint256& txhashIn, unsigned int nIndexIn, bool fSpendingIn) :
+        chType('a'), nAddressType(nAddressTypeIn), hashAddress(hashAddressIn), nHeight(nHeightIn), nTxIndex(nTxIndexIn), txhash(txhashIn), nIndex(nIndexIn), fSpending(fSpendingIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(chType);
+        READWRITE(nAddressType);
+        READWRITE(hashAddress);
+        uint32_t nHeightBE = nHeight, nTxIndexBE = nTxIndex;
+        ReadWriteBigEndian32(s, ser_action, nType, nVersion, nHeightBE);
+        ReadWriteBigEndian32(s, ser_action, nType, nVersion, nTxIndexBE);
+        nHeight = nHeightBE;
+        nTxIndex = nTxIndexBE;
+        READWRITE(txhash);
+        READWRITE(nIndex);
+        READWRITE(fSpending);
+    }
+};
+
+/** Key of an unspent output paying to an address */
+class CAddressUnspentKey
+{
+public:
+    char chType;
+    unsigned char nAddressType;
+    uint160 hashAddress;
+    uint256 txhash;
+    unsigned int nIndex;
+
+    CAddressUnspentKey() : chType('u'), nAddressType(0), nIndex(0) {}
+    CAddressUnspentKey(int nAddressTypeIn, const uint160& hashAddressIn, const uint256& txhashIn, unsigned int nIndexIn) :
+        chType('u'), nAddressType(nAddressTypeIn), hashAddress(hashAddressIn), txhash(txhashIn), nIndex(nIndexIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(chType);
+        READWRITE(nAddressType);
+        READWRITE(hashAddress);
+        READWRITE(txhash);
+        READWRITE(nIndex);
+    }
+};
+
+/** An unspent output paying to an address; null when the output is spent */
+class CAddressUnspentValue
+{
+public:
+    CAmount nValue;
+    CScript script;
+    int nHeight;
+
+    CAddressUnspentValue() { SetNull(); }
+    CAddressUnspentValue(CAmount nValueIn, const CScript& scriptIn, int nHeightIn) : nValue(nValueIn), script(scriptIn), nHeight(nHeightIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nValue);
+        READWRITE(script);
+        READWRITE(nHeight);
+    }
+
+    void SetNull()
+    {
+        nValue = -1;
+        script.clear();
+        nHeight = 0;
+    }
+
+    bool IsNull() const { return nValue == -1; }
+};
+
+/** Key of a spent output */
+class CSpentIndexKey
+{
+public:
+    char chType;
+    uint256 txid;
+    unsigned int nIndex;
+
+    CSpentIndexKey() : chType('s'), nIndex(0) {}
+    CSpentIndexKey(const uint256& txidIn, unsigned int nIndexIn) : chType('s'), txid(txidIn), nIndex(nIndexIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(chType);
+        READWRITE(txid);
+        READWRITE(nIndex);
+    }
+};
+
+/** The input that spent an output; null when the output is unspent */
+class CSpentIndexValue
+{
+public:
+    uint256 txid;
+    unsigned int nInputIndex;
+    int nHeight;
+    CAmount nValue;
+    int nAddressType;
+    uint160 hashAddress;
+
+    CSpentIndexValue() { SetNull(); }
+    CSpentIndexValue(const uint256& txidIn, unsigned int nInputIndexIn, int nHeightIn, CAmount nValueIn, int nAddressTypeIn, const uint160& hashAddressIn) :
+        txid(txidIn), nInputIndex(nInputIndexIn), nHeight(nHeightIn), nValue(nValueIn), nAddressType(nAddressTypeIn), hashAddress(hashAddressIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(txid);
+        READWRITE(nInputIndex);
+        READWRITE(nHeight);
+        READWRITE(nValue);
+        READWRITE(nAddressType);
+        READWRITE(hashAddress);
+    }
+
+    void SetNull()
+    {
+        txid = uint256(0);
+        nInputIndex = 0;
+        nHeight = 0;
+        nValue = 0;
+        nAddressType = ADDRESS_NONE;
+        hashAddress = uint160(0);
+    }
+
+    bool IsNull() const { return txid == uint256(0); }
+};
+
+/** Changes that transactions make to the address and spent indexes, written as one batch */
+class CAddressIndexUpdate
+{
+public:
+    bool fAddressIndex;
+    bool fSpentIndex;
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vAddressWrite;
+    std::vector<CAddressIndexKey> vAddressErase;
+    //! Unspent outputs to write, or to erase when the value is null
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspent;
+    //! Spent outputs to write, or to erase when the value is null
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > vSpent;
+
+    CAddressIndexUpdate(bool fAddressIndexIn, bool fSpentIndexIn) : fAddressIndex(fAddressIndexIn), fSpentIndex(fSpentIndexIn) {}
+
+    /**
+     * Record a transaction at position nTxIndex of a block at nHeight being connected, or
+     * disconnected again. pvSpent holds the coins its inputs spend, null for transactions
+     * without regular inputs.
+     */
+    void AddTransaction(const CTransaction& tx, unsigned int nTxIndex, int nHeight, const std::vector<Coin>* pvSpent, bool fConnect);
+
+    bool IsEmpty() const { return vAddressWrite.empty() && vAddressErase.empty() && vUnspent.empty() && vSpent.empty(); }
+};
+
+#endif // DIVIT_ADDRESSINDEX_H
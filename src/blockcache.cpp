@@ -0,0 +1,152 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "core_memusage.h"
+
+CBlockCache::CBlockCache(size_t nMaxUsageIn) : nUsage(0), nMaxUsage(nMaxUsageIn), nHits(0), nMisses(0)
+{
+}
+
+CBlockCache::CEntry* CBlockCache::Lookup(const uint256& hash)
+{
+    std::map<uint256, CEntry>::iterator it = mapEntries.find(hash);
+    if (it == mapEntries.end())
+        return NULL;
+    listLRU.splice(listLRU.begin(), listLRU, it->second.itLRU);
+    return &it->second;
+}
+
+CBlockCache::CEntry& CBlockCache::Insert(const uint256& hash)
+{
+    CEntry* pentry = Lookup(hash);
+    if (pentry)
+        return *pentry;
+    CEntry& entry = mapEntries[hash];
+    listLRU.push_front(hash);
+    entry.itLRU = listLRU.begin();
+    return entry;
+}
+
+void CBlockCache::Update(CEntry& entry)
+{
+    // The map and list nodes, and the objects behind the shared pointers
+    size_t nEntryUsage = memusage::MallocUsage(sizeof(memusage::stl_tree_node<std::pair<const uint256, CEntry> >)) +
+                         memusage::MallocUsage(sizeof(uint256) + 2 * sizeof(void*));
+    if (entry.pblock)
+        nEntryUsage += memusage::MallocUsage(sizeof(CBlock)) + RecursiveDynamicUsage(*entry.pblock);
+    if (entry.pdata)
+        nEntryUsage += memusage::MallocUsage(sizeof(CDataStream)) + memusage::MallocUsage(entry.pdata->size());
+    nUsage -= entry.nUsage;
+    entry.nUsage = nEntryUsage;
+    nUsage += entry.nUsage;
+}
+
+void CBlockCache::Erase(std::map<uint256, CEntry>::iterator it)
+{
+    nUsage -= it->second.nUsage;
+    listLRU.erase(it->second.itLRU);
+    mapEntries.erase(it);
+}
+
+void CBlockCache::Trim()
+{
+    while (nUsage > nMaxUsage && !listLRU.empty())
+        Erase(mapEntries.find(listLRU.back()));
+}
+
+std::shared_ptr<const CBlock> CBlockCache::Get(const uint256& hash)
+{
+    LOCK(cs);
+    CEntry* pentry = Lookup(hash);
+    if (pentry && pentry->pblock) {
+        nHits++;
+        return pentry->pblock;
+    }
+    nMisses++;
+    return std::shared_ptr<const CBlock>();
+}
+
+void CBlockCache::Put(const uint256& hash, const std::shared_ptr<const CBlock>& pblock)
+{
+    if (!pblock)
+        return;
+    LOCK(cs);
+    CEntry& entry = Insert(hash);
+    entry.pblock = pblock;
+    Update(entry);
+    Trim();
+}
+
+std::shared_ptr<const CDataStream> CBlockCache::GetRaw(const uint256& hash)
+{
+    LOCK(cs);
+    CEntry* pentry = Lookup(hash);
+    if (pentry && pentry->pdata) {
+        nHits++;
+        return pentry->pdata;
+    }
+    nMisses++;
+    return std::shared_ptr<const CDataStream>();
+}
+
+void CBlockCache::PutRaw(const uint256& hash, const std::shared_ptr<const CDataStream>& pdata)
+{
+    if (!pdata)
+        return;
+    LOCK(cs);
+    CEntry& entry = Insert(hash);
+    entry.pdata = pdata;
+    Update(entry);
+    Trim();
+}
+
+void CBlockCache::Erase(const uint256& hash)
+{
+    LOCK(cs);
+    std::map<uint256, CEntry>::iterator it = mapEntries.find(hash);
+    if (it != mapEntries.end())
+        Erase(it);
+}
+
+void CBlockCache::Clear()
+{
+    LOCK(cs);
+    mapEntries.clear();
+    listLRU.clear();
+    nUsage = 0;
+}
+
+void CBlockCache::SetMaxUsage(size_t nMaxUsageIn)
+{
+    LOCK(cs);
+    nMaxUsage = nMaxUsageIn;
+    Trim();
+}
+
+size_t CBlockCache::Size() const
+{
+    LOCK(cs);
+    return mapEntries.size();
+}
+
+size_t CBlockCache::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    return nUsage;
+}
+
+size_t CBlockCache::GetMaxUsage() const
+{
+    LOCK(cs);
+    return nMaxUsage;
+}
+
+void CBlockCache::GetStats(uint64_t& nHitsOut, uint64_t& nMissesOut) const
+{
+    LOCK(cs);
+    nHitsOut = nHits;
+    nMissesOut = nMisses;
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DIVIT_BLOCKCACHE_H
+#define DIVIT_BLOCKCACHE_H
+
+#include "primitives/block.h"
+#include "streams.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <list>
+#include <map>
+#include <memory>
+
+//! Default for -blockcachesize, in MiB
+static const unsigned int DEFAULT_BLOCK_CACHE_SIZE = 16;
+
+/**
+ * Size-bounded LRU cache of blocks recently read from disk, keyed by block hash.
+ *
+ * A block can be cached deserialized, for callers that look at its transactions,
+ * and as its serialized bytes, for peers that only need the block sent on. The blocks
+ * are shared and immutable, so an entry can be handed out without copying and stays
+ * valid after it is evicted.
+ */
+class CBlockCache
+{
+private:
+    struct CEntry {
+        std::shared_ptr<const CBlock> pblock;
+        std::shared_ptr<const CDataStream> pdata;
+        size_t nUsage;
+        std::list<uint256>::iterator itLRU;
+
+        CEntry() : nUsage(0) {}
+    };
+
+    mutable CCriticalSection cs;
+    std::map<uint256, CEntry> mapEntries;
+    //! Hashes from the most to the least recently used
+    std::list<uint256> listLRU;
+    size_t nUsage;
+    size_t nMaxUsage;
+    uint64_t nHits;
+    uint64_t nMisses;
+
+    CEntry* Lookup(const uint256& hash);
+    CEntry& Insert(const uint256& hash);
+    void Update(CEntry& entry);
+    void Erase(std::map<uint256, CEntry>::iterator it);
+    void Trim();
+
+public:
+    explicit CBlockCache(size_t nMaxUsageIn);
+
+    //! Return the cached block, or null
+    std::shared_ptr<const CBlock> Get(const uint256& hash);
+    void Put(const uint256& hash, const std::shared_ptr<const CBlock>& pblock);
+
+    //! Return the cached serialized block, or null
+    std::shared_ptr<const CDataStream> GetRaw(const uint256& hash);
+    void PutRaw(const uint256& hash, const std::shared_ptr<const CDataStream>& pdata);
+
+    void Erase(const uint256& hash);
+    void Clear();
+
+    //! Change the memory bound, evicting entries if needed
+    void SetMaxUsage(size_t nMaxUsageIn);
+
+    size_t Size() const;
+    size_t DynamicMemoryUsage() const;
+    size_t GetMaxUsage() const;
+    void GetStats(uint64_t& nHitsOut, uint64_t& nMissesOut) const;
+};
+
+#endif // DIVIT_BLOCKCACHE_H
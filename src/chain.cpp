@@ -4,6 +4,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chain.h"
+#include "main.h"
+#include "txdb.h"
 
 using namespace std;
 
@@ -76,4 +78,20 @@ uint256 CBlockIndex::GetBlockTrust() const
         uint256 bnPoWTrust = ((~uint256(0) >> 20) / (bnTarget + 1));
         return bnPoWTrust > 1 ? bnPoWTrust : 1;
     }
-}
\ No newline at end of file
+}
+
+CBlockIndexStake CBlockIndex::GetStake() const
+{
+    if (pstake)
+        return *pstake;
+
+    CBlockIndexStake stake;
+    if (IsProofOfStake() && phashBlock) {
+        CDiskBlockIndex diskindex;
+        if (!pblocktree || !pblocktree->ReadBlockIndex(GetBlockHash(), diskindex))
+            throw std::runtime_error(strprintf("CBlockIndex::GetStake() : cannot read block index entry %s", GetBlockHash().ToString()));
+        stake.prevoutStake = diskindex.prevoutStake;
+        stake.nStakeTime = diskindex.nStakeTime;
+    }
+    return stake;
+}
@@ -14,6 +14,10 @@
 #include "util.h"
 #include "libzerocoin/Denominations.h"
 
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
 #include <boost/foreach.hpp>
@@ -100,6 +104,19 @@ enum BlockStatus {
     BLOCK_FAILED_MASK = BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 };
 
+/**
+ * Proof-of-stake fields of a block index entry. They are only needed to track
+ * seen stakes and to write the entry, so entries loaded from the block tree
+ * database leave them there and read them back when asked for.
+ */
+struct CBlockIndexStake {
+    COutPoint prevoutStake;
+    unsigned int nStakeTime;
+    uint256 hashProofOfStake; // memory only
+
+    CBlockIndexStake() : nStakeTime(0) {}
+};
+
 /** The block chain is a tree shaped structure starting with the
  * genesis block at the root, with each block potentially having multiple
  * candidates to be the next block. A blockindex may have multiple pprev pointing
@@ -161,9 +178,7 @@ public:
     uint256 GetBlockTrust() const;
     uint64_t nStakeModifier;             // hash modifier for proof-of-stake
     unsigned int nStakeModifierChecksum; // checksum of index; in-memeory only
-    COutPoint prevoutStake;
-    unsigned int nStakeTime;
-    uint256 hashProofOfStake;
+    std::shared_ptr<CBlockIndexStake> pstake; // only set for new proof-of-stake entries, see GetStake()
     int64_t nMint;
     int64_t nMoneySupply;
 
@@ -178,9 +193,10 @@ public:
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
     uint32_t nSequenceId;
 
-    //! zerocoin specific fields
-    std::map<libzerocoin::CoinDenomination, int64_t> mapZerocoinSupply;
-    std::vector<libzerocoin::CoinDenomination> vMintDenominationsInBlock;
+    //! zerocoin specific fields, indexed by libzerocoin::ZerocoinDenominationToIndex()
+    int64_t nZerocoinSupply[libzerocoin::zerocoinDenomCount];
+    //! number of mints of each denomination in this block, a block can't hold more than 65535
+    uint16_t nMintDenominationsInBlock[libzerocoin::zerocoinDenomCount];
 
     void SetNull()
     {
@@ -202,8 +218,7 @@ public:
         nFlags = 0;
         nStakeModifier = 0;
         nStakeModifierChecksum = 0;
-        prevoutStake.SetNull();
-        nStakeTime = 0;
+        pstake.reset();
 
         nVersion = 0;
         hashMerkleRoot = uint256();
@@ -212,10 +227,10 @@ public:
         nNonce = 0;
         nAccumulatorCheckpoint = 0;
         // Start supply of each denomination with 0s
-        for (auto& denom : libzerocoin::zerocoinDenomList) {
-            mapZerocoinSupply.insert(make_pair(denom, 0));
+        for (unsigned int i = 0; i < libzerocoin::zerocoinDenomCount; i++) {
+            nZerocoinSupply[i] = 0;
         }
-        vMintDenominationsInBlock.clear();
+        ClearMintDenominations();
     }
 
     CBlockIndex()
@@ -242,15 +257,12 @@ public:
         nFlags = 0;
         nStakeModifier = 0;
         nStakeModifierChecksum = 0;
-        hashProofOfStake = uint256();
 
         if (block.IsProofOfStake()) {
             SetProofOfStake();
-            prevoutStake = block.vtx[1].vin[0].prevout;
-            nStakeTime = block.nTime;
-        } else {
-            prevoutStake.SetNull();
-            nStakeTime = 0;
+            pstake = std::make_shared<CBlockIndexStake>();
+            pstake->prevoutStake = block.vtx[1].vin[0].prevout;
+            pstake->nStakeTime = block.nTime;
         }
     }
 
@@ -293,16 +305,61 @@ public:
     {
         int64_t nTotal = 0;
         for (auto& denom : libzerocoin::zerocoinDenomList) {
-            nTotal += libzerocoin::ZerocoinDenominationToAmount(denom) * mapZerocoinSupply.at(denom);
+            nTotal += libzerocoin::ZerocoinDenominationToAmount(denom) * GetZerocoinSupply(denom);
         }
         return nTotal;
     }
 
+    //! Number of coins of a denomination in circulation. Throws std::out_of_range for an invalid denomination.
+    int64_t GetZerocoinSupply(libzerocoin::CoinDenomination denom) const
+    {
+        return nZerocoinSupply[DenominationIndex(denom)];
+    }
+
+    void SetZerocoinSupply(libzerocoin::CoinDenomination denom, int64_t nSupply)
+    {
+        nZerocoinSupply[DenominationIndex(denom)] = nSupply;
+    }
+
+    //! Number of mints of a denomination in this block
+    unsigned int GetMintDenominationCount(libzerocoin::CoinDenomination denom) const
+    {
+        return nMintDenominationsInBlock[DenominationIndex(denom)];
+    }
+
+    void AddMintDenomination(libzerocoin::CoinDenomination denom)
+    {
+        uint16_t& nCount = nMintDenominationsInBlock[DenominationIndex(denom)];
+        if (nCount == std::numeric_limits<uint16_t>::max())
+            throw std::overflow_error("CBlockIndex::AddMintDenomination() : too many mints in block");
+        nCount++;
+    }
+
+    void ClearMintDenominations()
+    {
+        for (unsigned int i = 0; i < libzerocoin::zerocoinDenomCount; i++) {
+            nMintDenominationsInBlock[i] = 0;
+        }
+    }
+
+    //! The denominations minted in this block, one entry per mint
+    std::vector<libzerocoin::CoinDenomination> GetMintDenominations() const
+    {
+        std::vector<libzerocoin::CoinDenomination> vDenoms;
+        for (unsigned int i = 0; i < libzerocoin::zerocoinDenomCount; i++) {
+            vDenoms.insert(vDenoms.end(), nMintDenominationsInBlock[i], libzerocoin::zerocoinDenomList[i]);
+        }
+        return vDenoms;
+    }
+
     bool MintedDenomination(libzerocoin::CoinDenomination denom) const
     {
-        return std::find(vMintDenominationsInBlock.begin(), vMintDenominationsInBlock.end(), denom) != vMintDenominationsInBlock.end();
+        return GetMintDenominationCount(denom) > 0;
     }
 
+    //! The proof-of-stake fields of this entry, read from the block tree database if they are not in memory
+    CBlockIndexStake GetStake() const;
+
     uint256 GetBlockHash() const
     {
         return *phashBlock;
@@ -417,6 +474,15 @@ public:
     //! Efficiently find an ancestor of this block.
     CBlockIndex* GetAncestor(int height);
     const CBlockIndex* GetAncestor(int height) const;
+
+private:
+    static unsigned int DenominationIndex(libzerocoin::CoinDenomination denom)
+    {
+        int nIndex = libzerocoin::ZerocoinDenominationToIndex(denom);
+        if (nIndex < 0)
+            throw std::out_of_range("CBlockIndex : invalid zerocoin denomination");
+        return nIndex;
+    }
 };
 
 /** Used to marshal pointers into hashes for db storage. */
@@ -425,16 +491,22 @@ class CDiskBlockIndex : public CBlockIndex
 public:
     uint256 hashPrev;
     uint256 hashNext;
+    COutPoint prevoutStake;
+    unsigned int nStakeTime;
 
     CDiskBlockIndex()
     {
         hashPrev = uint256();
         hashNext = uint256();
+        nStakeTime = 0;
     }
 
     explicit CDiskBlockIndex(CBlockIndex* pindex) : CBlockIndex(*pindex)
     {
         hashPrev = (pprev ? pprev->GetBlockHash() : uint256());
+        CBlockIndexStake stake = pindex->GetStake();
+        prevoutStake = stake.prevoutStake;
+        nStakeTime = stake.nStakeTime;
     }
 
     ADD_SERIALIZE_METHODS;
@@ -466,7 +538,6 @@ public:
         } else {
             const_cast<CDiskBlockIndex*>(this)->prevoutStake.SetNull();
             const_cast<CDiskBlockIndex*>(this)->nStakeTime = 0;
-            const_cast<CDiskBlockIndex*>(this)->hashProofOfStake = uint256();
         }
 
         // block header
@@ -479,8 +550,28 @@ public:
         READWRITE(nNonce);
         if(this->nVersion > 3) {
             READWRITE(nAccumulatorCheckpoint);
+
+            // Kept in the format of the former std::map and std::vector members
+            std::map<libzerocoin::CoinDenomination, int64_t> mapZerocoinSupply;
+            std::vector<libzerocoin::CoinDenomination> vMintDenominationsInBlock;
+            if (!ser_action.ForRead()) {
+                for (auto& denom : libzerocoin::zerocoinDenomList)
+                    mapZerocoinSupply.insert(std::make_pair(denom, GetZerocoinSupply(denom)));
+                vMintDenominationsInBlock = GetMintDenominations();
+            }
             READWRITE(mapZerocoinSupply);
             READWRITE(vMintDenominationsInBlock);
+            if (ser_action.ForRead()) {
+                for (auto& supply : mapZerocoinSupply) {
+                    if (libzerocoin::ZerocoinDenominationToIndex(supply.first) >= 0)
+                        SetZerocoinSupply(supply.first, supply.second);
+                }
+                ClearMintDenominations();
+                for (auto& denom : vMintDenominationsInBlock) {
+                    if (libzerocoin::ZerocoinDenominationToIndex(denom) >= 0)
+                        AddMintDenomination(denom);
+                }
+            }
         }
 
     }
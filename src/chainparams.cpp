@@ -167,6 +167,15 @@ public:
         assert(hashGenesisBlock == uint256("0x00002506d96e02f3a5d9d03a8d5e54411d8a6754167156ca24204400a3ef2adc"));
         assert(genesis.hashMerkleRoot == uint256("0x1b2ef6e2f28be914103a277377ae7729dcd125dfeb8bf97bd5964ba72b6dc39b"));
 
+        //! Blocks at and below this hash skip script and zerocoin proof checks
+        //! during sync, see -assumevalid. Only set it to a block that has been
+        //! reviewed as part of a release and is also in mapCheckpoints, as blocks
+        //! are fetched without headers first; 0 verifies everything.
+        hashAssumeValid = 0;
+        //! Snapshots written by dumptxoutset that loadtxoutset accepts, added
+        //! together with the published snapshot file of a release:
+        //! mapSnapshotHashes[<base block hash>] = <contents hash>;
+
 
         vFixedSeeds.clear();
         vSeeds.clear();
@@ -330,6 +339,7 @@ public:
 
         hashGenesisBlock = genesis.GetHash();
         assert(hashGenesisBlock == checkHash);
+        hashAssumeValid = 0;
 
         vFixedSeeds.clear();
         vSeeds.clear();
@@ -406,6 +416,7 @@ public:
         hashGenesisBlock = genesis.GetHash();
         nDefaultPort = 51476;
         //assert(hashGenesisBlock == uint256("0x4f023a2120d9127b21bbad01724fdb79b519f593f2a85b60d3d79160ec5f29df"));
+        hashAssumeValid = 0;
 
         vFixedSeeds.clear(); //! Testnet mode doesn't have any fixed seeds.
         vSeeds.clear();      //! Testnet mode doesn't have any DNS seeds.
@@ -458,6 +469,8 @@ public:
     virtual void setDefaultConsistencyChecks(bool afDefaultConsistencyChecks) { fDefaultConsistencyChecks = afDefaultConsistencyChecks; }
     virtual void setAllowMinDifficultyBlocks(bool afAllowMinDifficultyBlocks) { fAllowMinDifficultyBlocks = afAllowMinDifficultyBlocks; }
     virtual void setSkipProofOfWorkCheck(bool afSkipProofOfWorkCheck) { fSkipProofOfWorkCheck = afSkipProofOfWorkCheck; }
+    virtual void setSnapshotHash(const uint256& hashBlock, const uint256& hashContents) { mapSnapshotHashes[hashBlock] = hashContents; }
+    virtual void setZerocoinStartHeight(int anZerocoinStartHeight) { nZerocoinStartHeight = anZerocoinStartHeight; }
 };
 static CUnitTestParams unitTestParams;
 
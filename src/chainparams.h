@@ -66,6 +66,10 @@ public:
     bool HeadersFirstSyncingActive() const { return fHeadersFirstSyncingActive; };
     /** Default value for -checkmempool and -checkblockindex argument */
     bool DefaultConsistencyChecks() const { return fDefaultConsistencyChecks; }
+    /** Default value for -assumevalid, 0 when every block is verified */
+    const uint256& DefaultAssumeValid() const { return hashAssumeValid; }
+    /** UTXO snapshots accepted by loadtxoutset, from the hash of their base block to the hash of their contents */
+    const std::map<uint256, uint256>& SnapshotHashes() const { return mapSnapshotHashes; }
     /** Allow mining of a min-difficulty block */
     bool AllowMinDifficultyBlocks() const { return fAllowMinDifficultyBlocks; }
     /** Skip proof-of-work check: allow mining of any difficulty block */
@@ -132,6 +136,8 @@ protected:
     CChainParams() {}
 
     uint256 hashGenesisBlock;
+    uint256 hashAssumeValid;
+    std::map<uint256, uint256> mapSnapshotHashes;
     MessageStartChars pchMessageStart;
     //! Raw pub key bytes for the broadcast alert signing key.
     std::vector<unsigned char> vAlertPubKey;
@@ -210,6 +216,8 @@ public:
     virtual void setDefaultConsistencyChecks(bool aDefaultConsistencyChecks) = 0;
     virtual void setAllowMinDifficultyBlocks(bool aAllowMinDifficultyBlocks) = 0;
     virtual void setSkipProofOfWorkCheck(bool aSkipProofOfWorkCheck) = 0;
+    virtual void setSnapshotHash(const uint256& hashBlock, const uint256& hashContents) = 0;
+    virtual void setZerocoinStartHeight(int anZerocoinStartHeight) = 0;
 };
 
 
@@ -83,6 +83,20 @@ int GetTotalBlocksEstimate()
     return checkpoints.rbegin()->first;
 }
 
+int GetCheckpointHeight(const uint256& hash)
+{
+    if (!fEnabled)
+        return -1;
+
+    const MapCheckpoints& checkpoints = *Params().Checkpoints().mapCheckpoints;
+
+    BOOST_FOREACH (const MapCheckpoints::value_type& i, checkpoints) {
+        if (i.second == hash)
+            return i.first;
+    }
+    return -1;
+}
+
 CBlockIndex* GetLastCheckpoint()
 {
     if (!fEnabled)
@@ -33,6 +33,9 @@ bool CheckBlock(int nHeight, const uint256& hash, bool fMatchesCheckpoint = fals
 //! Return conservative estimate of total number of blocks, 0 if unknown
 int GetTotalBlocksEstimate();
 
+//! Returns the height of the checkpoint with the given hash, -1 if there is none
+int GetCheckpointHeight(const uint256& hash);
+
 //! Returns last CBlockIndex* in mapBlockIndex that is a checkpoint
 CBlockIndex* GetLastCheckpoint();
 
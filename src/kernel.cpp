@@ -371,27 +371,27 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::uniqu
         // First try finding the previous transaction in database
         uint256 hashBlock;
         CTransaction txPrev;
-        if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock, true))
-            return error("CheckProofOfStake() : INFO: read txPrev failed");
+        CVitStake* zitInput = new CVitStake();
+        stake = std::unique_ptr<CStakeInput>(zitInput);
+        if (GetTransaction(txin.prevout.hash, txPrev, hashBlock, true)) {
+            if (!zitInput->SetInput(txPrev, txin.prevout.n))
+                return error("CheckProofOfStake() : invalid prevout on coinstake %s", tx.GetHash().ToString().c_str());
+        } else {
+            // Blocks below a loaded UTXO snapshot are not on disk, fall back to the unspent output itself
+            Coin coin;
+            if (!fHavePruned || !pcoinsTip->GetCoin(txin.prevout, coin) || !zitInput->SetInput(txin.prevout, coin))
+                return error("CheckProofOfStake() : INFO: read txPrev failed");
+        }
 
         //verify signature and script
-        if (!VerifyScript(txin.scriptSig, txPrev.vout[txin.prevout.n].scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0)))
+        if (!VerifyScript(txin.scriptSig, zitInput->GetTxOutFrom().scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0)))
             return error("CheckProofOfStake() : VerifySignature failed on coinstake %s", tx.GetHash().ToString().c_str());
-
-        CVitStake* zitInput = new CVitStake();
-        zitInput->SetInput(txPrev, txin.prevout.n);
-        stake = std::unique_ptr<CStakeInput>(zitInput);
     }
 
     CBlockIndex* pindex = stake->GetIndexFrom();
     if (!pindex)
         return error("%s: Failed to find the block index", __func__);
 
-    // Read block header
-    CBlock blockprev;
-    if (!ReadBlockFromDisk(blockprev, pindex->GetBlockPos()))
-        return error("CheckProofOfStake(): INFO: failed to find block");
-
     uint256 bnTargetPerCoinDay;
     bnTargetPerCoinDay.SetCompact(block.nBits);
 
@@ -399,7 +399,8 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::uniqu
     if (!stake->GetModifier(nStakeModifier))
         return error("%s failed to get modifier for stake input\n", __func__);
 
-    unsigned int nBlockFromTime = blockprev.nTime;
+    // The header time is all that is needed from the block the input was included in
+    unsigned int nBlockFromTime = pindex->nTime;
     unsigned int nTxTime = block.nTime;
     if (!CheckStake(stake->GetUniqueness(), stake->GetValue(), nStakeModifier, bnTargetPerCoinDay, nBlockFromTime,
                     nTxTime, hashProofOfStake)) {
@@ -425,7 +426,7 @@ unsigned int GetStakeModifierChecksum(const CBlockIndex* pindex)
     CDataStream ss(SER_GETHASH, 0);
     if (pindex->pprev)
         ss << pindex->pprev->nStakeModifierChecksum;
-    ss << pindex->nFlags << pindex->hashProofOfStake << pindex->nStakeModifier;
+    ss << pindex->nFlags << (pindex->pstake ? pindex->pstake->hashProofOfStake : uint256()) << pindex->nStakeModifier;
     uint256 hashChecksum = Hash(ss.begin(), ss.end());
     hashChecksum >>= (256 - 32);
     return hashChecksum.Get64();
@@ -63,6 +63,7 @@ public:
     void increment(const CBigNum& bnValue);
 
 	CoinDenomination getDenomination() const;
+	const AccumulatorAndProofParams* getParams() const { return params; }
 	/** Get the accumulator result
 	 *
 	 * @return a CBigNum containing the result.
@@ -13,6 +13,7 @@
 // Copyright (c) 2017 The PIVX developers
 #include "AccumulatorProofOfKnowledge.h"
 #include "hash.h"
+#include "Threading.h"
 
 namespace libzerocoin {
 
@@ -37,9 +38,9 @@ AccumulatorProofOfKnowledge::AccumulatorProofOfKnowledge(const AccumulatorAndPro
 	CBigNum r_2 = CBigNum::randBignum(params->accumulatorModulus/4);
 	CBigNum r_3 = CBigNum::randBignum(params->accumulatorModulus/4);
 
-	this->C_e = g_n.pow_mod(e, params->accumulatorModulus) * h_n.pow_mod(r_1, params->accumulatorModulus);
-	this->C_u = witness.getValue() * h_n.pow_mod(r_2, params->accumulatorModulus);
-	this->C_r = g_n.pow_mod(r_2, params->accumulatorModulus) * h_n.pow_mod(r_3, params->accumulatorModulus);
+	this->C_e = params->pow_g_n(e) * params->pow_h_n(r_1);
+	this->C_u = witness.getValue() * params->pow_h_n(r_2);
+	this->C_r = params->pow_g_n(r_2) * params->pow_h_n(r_3);
 
 	CBigNum r_alpha = CBigNum::randBignum(params->maxCoinValue * CBigNum(2).pow(params->k_prime + params->k_dprime));
 	if(!(CBigNum::randBignum(CBigNum(3)) % 2)) {
@@ -74,14 +75,18 @@ AccumulatorProofOfKnowledge::AccumulatorProofOfKnowledge(const AccumulatorAndPro
 		r_delta = 0-r_delta;
 	}
 
-	this->st_1 = (sg.pow_mod(r_alpha, params->accumulatorPoKCommitmentGroup.modulus) * sh.pow_mod(r_phi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
-	this->st_2 = (((commitmentToCoin.getCommitmentValue() * sg.inverse(params->accumulatorPoKCommitmentGroup.modulus)).pow_mod(r_gamma, params->accumulatorPoKCommitmentGroup.modulus)) * sh.pow_mod(r_psi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
-	this->st_3 = ((sg * commitmentToCoin.getCommitmentValue()).pow_mod(r_sigma, params->accumulatorPoKCommitmentGroup.modulus) * sh.pow_mod(r_xi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
-
-	this->t_1 = (h_n.pow_mod(r_zeta, params->accumulatorModulus) * g_n.pow_mod(r_epsilon, params->accumulatorModulus)) % params->accumulatorModulus;
-	this->t_2 = (h_n.pow_mod(r_eta, params->accumulatorModulus) * g_n.pow_mod(r_alpha, params->accumulatorModulus)) % params->accumulatorModulus;
-	this->t_3 = (C_u.pow_mod(r_alpha, params->accumulatorModulus) * ((h_n.inverse(params->accumulatorModulus)).pow_mod(r_beta, params->accumulatorModulus))) % params->accumulatorModulus;
-	this->t_4 = (C_r.pow_mod(r_alpha, params->accumulatorModulus) * ((h_n.inverse(params->accumulatorModulus)).pow_mod(r_delta, params->accumulatorModulus)) * ((g_n.inverse(params->accumulatorModulus)).pow_mod(r_beta, params->accumulatorModulus))) % params->accumulatorModulus;
+	// The commitments are independent of each other, compute them in parallel
+	ParallelFor(7, [&](uint32_t i) {
+		switch (i) {
+		case 0: this->st_1 = (params->accumulatorPoKCommitmentGroup.pow_g(r_alpha) * params->accumulatorPoKCommitmentGroup.pow_h(r_phi)) % params->accumulatorPoKCommitmentGroup.modulus; break;
+		case 1: this->st_2 = (((commitmentToCoin.getCommitmentValue() * sg.inverse(params->accumulatorPoKCommitmentGroup.modulus)).pow_mod(r_gamma, params->accumulatorPoKCommitmentGroup.modulus)) * params->accumulatorPoKCommitmentGroup.pow_h(r_psi)) % params->accumulatorPoKCommitmentGroup.modulus; break;
+		case 2: this->st_3 = ((sg * commitmentToCoin.getCommitmentValue()).pow_mod(r_sigma, params->accumulatorPoKCommitmentGroup.modulus) * params->accumulatorPoKCommitmentGroup.pow_h(r_xi)) % params->accumulatorPoKCommitmentGroup.modulus; break;
+		case 3: this->t_1 = (params->pow_h_n(r_zeta) * params->pow_g_n(r_epsilon)) % params->accumulatorModulus; break;
+		case 4: this->t_2 = (params->pow_h_n(r_eta) * params->pow_g_n(r_alpha)) % params->accumulatorModulus; break;
+		case 5: this->t_3 = (C_u.pow_mod(r_alpha, params->accumulatorModulus) * params->pow_h_n(-r_beta)) % params->accumulatorModulus; break;
+		case 6: this->t_4 = (C_r.pow_mod(r_alpha, params->accumulatorModulus) * params->pow_h_n(-r_delta) * params->pow_g_n(-r_beta)) % params->accumulatorModulus; break;
+		}
+	});
 
 	CHashWriter hasher(0,0);
 	hasher << *params << sg << sh << g_n << h_n << commitmentToCoin.getCommitmentValue() << C_e << C_u << C_r << st_1 << st_2 << st_3 << t_1 << t_2 << t_3 << t_4;
@@ -104,7 +109,7 @@ AccumulatorProofOfKnowledge::AccumulatorProofOfKnowledge(const AccumulatorAndPro
 
 /** Verifies that a commitment c is accumulated in accumulator a
  */
-bool AccumulatorProofOfKnowledge:: Verify(const Accumulator& a, const CBigNum& valueOfCommitmentToCoin) const {
+bool AccumulatorProofOfKnowledge:: Verify(const Accumulator& a, const CBigNum& valueOfCommitmentToCoin, FixedBaseTable* pAccumulatorTable) const {
 	CBigNum sg = params->accumulatorPoKCommitmentGroup.g;
 	CBigNum sh = params->accumulatorPoKCommitmentGroup.h;
 
@@ -117,14 +122,22 @@ bool AccumulatorProofOfKnowledge:: Verify(const Accumulator& a, const CBigNum& v
 
 	CBigNum c = CBigNum(hasher.GetHash()); //this hash should be of length k_prime bits
 
-	CBigNum st_1_prime = (valueOfCommitmentToCoin.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) * sg.pow_mod(s_alpha, params->accumulatorPoKCommitmentGroup.modulus) * sh.pow_mod(s_phi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
-	CBigNum st_2_prime = (sg.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) * ((valueOfCommitmentToCoin * sg.inverse(params->accumulatorPoKCommitmentGroup.modulus)).pow_mod(s_gamma, params->accumulatorPoKCommitmentGroup.modulus)) * sh.pow_mod(s_psi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
-	CBigNum st_3_prime = (sg.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) * (sg * valueOfCommitmentToCoin).pow_mod(s_sigma, params->accumulatorPoKCommitmentGroup.modulus) * sh.pow_mod(s_xi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
-
-	CBigNum t_1_prime = (C_r.pow_mod(c, params->accumulatorModulus) * h_n.pow_mod(s_zeta, params->accumulatorModulus) * g_n.pow_mod(s_epsilon, params->accumulatorModulus)) % params->accumulatorModulus;
-	CBigNum t_2_prime = (C_e.pow_mod(c, params->accumulatorModulus) * h_n.pow_mod(s_eta, params->accumulatorModulus) * g_n.pow_mod(s_alpha, params->accumulatorModulus)) % params->accumulatorModulus;
-	CBigNum t_3_prime = ((a.getValue()).pow_mod(c, params->accumulatorModulus) * C_u.pow_mod(s_alpha, params->accumulatorModulus) * ((h_n.inverse(params->accumulatorModulus)).pow_mod(s_beta, params->accumulatorModulus))) % params->accumulatorModulus;
-	CBigNum t_4_prime = (C_r.pow_mod(s_alpha, params->accumulatorModulus) * ((h_n.inverse(params->accumulatorModulus)).pow_mod(s_delta, params->accumulatorModulus)) * ((g_n.inverse(params->accumulatorModulus)).pow_mod(s_beta, params->accumulatorModulus))) % params->accumulatorModulus;
+	if (pAccumulatorTable && !pAccumulatorTable->Matches(a.getValue(), params->accumulatorModulus))
+		pAccumulatorTable = NULL;
+
+	// Each term only depends on the proof and the accumulator, compute them in parallel
+	CBigNum st_1_prime, st_2_prime, st_3_prime, t_1_prime, t_2_prime, t_3_prime, t_4_prime;
+	ParallelFor(7, [&](uint32_t i) {
+		switch (i) {
+		case 0: st_1_prime = (valueOfCommitmentToCoin.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) * params->accumulatorPoKCommitmentGroup.pow_g(s_alpha) * params->accumulatorPoKCommitmentGroup.pow_h(s_phi)) % params->accumulatorPoKCommitmentGroup.modulus; break;
+		case 1: st_2_prime = (params->accumulatorPoKCommitmentGroup.pow_g(c) * ((valueOfCommitmentToCoin * sg.inverse(params->accumulatorPoKCommitmentGroup.modulus)).pow_mod(s_gamma, params->accumulatorPoKCommitmentGroup.modulus)) * params->accumulatorPoKCommitmentGroup.pow_h(s_psi)) % params->accumulatorPoKCommitmentGroup.modulus; break;
+		case 2: st_3_prime = (params->accumulatorPoKCommitmentGroup.pow_g(c) * (sg * valueOfCommitmentToCoin).pow_mod(s_sigma, params->accumulatorPoKCommitmentGroup.modulus) * params->accumulatorPoKCommitmentGroup.pow_h(s_xi)) % params->accumulatorPoKCommitmentGroup.modulus; break;
+		case 3: t_1_prime = (C_r.pow_mod(c, params->accumulatorModulus) * params->pow_h_n(s_zeta) * params->pow_g_n(s_epsilon)) % params->accumulatorModulus; break;
+		case 4: t_2_prime = (C_e.pow_mod(c, params->accumulatorModulus) * params->pow_h_n(s_eta) * params->pow_g_n(s_alpha)) % params->accumulatorModulus; break;
+		case 5: t_3_prime = ((pAccumulatorTable ? pAccumulatorTable->pow_mod(c) : a.getValue().pow_mod(c, params->accumulatorModulus)) * C_u.pow_mod(s_alpha, params->accumulatorModulus) * params->pow_h_n(-s_beta)) % params->accumulatorModulus; break;
+		case 6: t_4_prime = (C_r.pow_mod(s_alpha, params->accumulatorModulus) * params->pow_h_n(-s_delta) * params->pow_g_n(-s_beta)) % params->accumulatorModulus; break;
+		}
+	});
 
 	bool result = false;
 
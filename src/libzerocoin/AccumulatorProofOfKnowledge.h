@@ -35,8 +35,10 @@ public:
 	 */
 	AccumulatorProofOfKnowledge(const AccumulatorAndProofParams* p, const Commitment& commitmentToCoin, const AccumulatorWitness& witness, Accumulator& a);
 	/** Verifies that  a commitment c is accumulated in accumulated a
+	 * @param pAccumulatorTable optional table of powers of the accumulator value,
+	 *        shared by proofs that are checked against the same accumulator
 	 */
-	bool Verify(const Accumulator& a,const CBigNum& valueOfCommitmentToCoin) const;
+	bool Verify(const Accumulator& a,const CBigNum& valueOfCommitmentToCoin, FixedBaseTable* pAccumulatorTable = NULL) const;
 	
 	ADD_SERIALIZE_METHODS;
   template <typename Stream, typename Operation>  inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
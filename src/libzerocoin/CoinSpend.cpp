@@ -11,6 +11,7 @@
  **/
 // Copyright (c) 2017 The DIVIT developers
 #include "CoinSpend.h"
+#include "Threading.h"
 #include <iostream>
 #include <sstream>
 
@@ -71,7 +72,7 @@ namespace libzerocoin
     }
 }
 
-bool CoinSpend::Verify(const Accumulator& a) const
+bool CoinSpend::Verify(const Accumulator& a, FixedBaseTable* pAccumulatorTable) const
 {
     // Double check that the version is the same as marked in the serial
     if (ExtractVersionFromSerial(coinSerialNumber) != version) {
@@ -90,7 +91,7 @@ bool CoinSpend::Verify(const Accumulator& a) const
         return false;
     }
 
-    if (!accumulatorPoK.Verify(a, accCommitmentToCoinValue)) {
+    if (!accumulatorPoK.Verify(a, accCommitmentToCoinValue, pAccumulatorTable)) {
         //std::cout << "CoinsSpend::Verify: accumulatorPoK failed\n";
         return false;
     }
@@ -103,6 +104,33 @@ bool CoinSpend::Verify(const Accumulator& a) const
     return true;
 }
 
+bool CoinSpend::BatchVerify(const std::vector<const CoinSpend*>& vSpends, const Accumulator& a, std::vector<bool>& vValid)
+{
+    vValid.assign(vSpends.size(), false);
+    if (vSpends.empty())
+        return true;
+
+    // Every accumulator proof raises the accumulator value to its challenge,
+    // with enough spends a table of its powers pays for itself.
+    const AccumulatorAndProofParams* params = a.getParams();
+    boost::shared_ptr<FixedBaseTable> table;
+    if (FIXED_BASE_TABLES && vSpends.size() >= ZEROCOIN_BATCH_TABLE_MIN_SPENDS)
+        table = MakeFixedBaseTable(a.getValue(), params->accumulatorModulus, params->accumulatorModulus);
+
+    // std::vector<bool> packs its elements, so collect the results separately
+    std::vector<char> vResults(vSpends.size(), 0);
+    ParallelFor(vSpends.size(), [&](uint32_t i) {
+        vResults[i] = vSpends[i]->Verify(a, table.get());
+    });
+
+    bool fAllValid = true;
+    for (unsigned int i = 0; i < vSpends.size(); i++) {
+        vValid[i] = vResults[i];
+        fAllValid &= vValid[i];
+    }
+    return fAllValid;
+}
+
 const uint256 CoinSpend::signatureHash() const
 {
     CHashWriter h(0, 0);
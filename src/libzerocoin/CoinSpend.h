@@ -115,7 +115,19 @@ public:
     SpendType getSpendType() const { return spendType; }
     std::vector<unsigned char> getSignature() const { return vchSig; }
 
-    bool Verify(const Accumulator& a) const;
+    bool Verify(const Accumulator& a, FixedBaseTable* pAccumulatorTable = NULL) const;
+
+    /**
+     * Verifies spends that were all made against the accumulator a.
+     * Each spend is checked in full, with the work that only depends on the
+     * accumulator done once for the whole batch and the spends spread over
+     * the proof threads.
+     * @param vSpends the spends to verify
+     * @param a the accumulator the spends were made against
+     * @param vValid set to the result of each spend, to find the bad ones
+     * @return true if every spend verifies
+     */
+    static bool BatchVerify(const std::vector<const CoinSpend*>& vSpends, const Accumulator& a, std::vector<bool>& vValid);
     bool HasValidSerial(ZerocoinParams* params) const;
     bool HasValidSignature() const;
     CBigNum CalculateValidSerial(ZerocoinParams* params);
@@ -100,6 +100,27 @@ CAmount ZerocoinDenominationToAmount(const CoinDenomination& denomination)
     return nValue;
 }
 
+// Position in zerocoinDenomList, -1 if not a valid denomination
+int ZerocoinDenominationToIndex(const CoinDenomination& denomination)
+{
+    int nIndex = -1;
+    switch (denomination) {
+    case CoinDenomination::ZQ_ONE: nIndex = 0; break;
+    case CoinDenomination::ZQ_FIVE: nIndex = 1; break;
+    case CoinDenomination::ZQ_TEN: nIndex = 2; break;
+    case CoinDenomination::ZQ_FIFTY: nIndex = 3; break;
+    case CoinDenomination::ZQ_ONE_HUNDRED: nIndex = 4; break;
+    case CoinDenomination::ZQ_FIVE_HUNDRED: nIndex = 5; break;
+    case CoinDenomination::ZQ_ONE_THOUSAND: nIndex = 6; break;
+    case CoinDenomination::ZQ_FIVE_THOUSAND: nIndex = 7; break;
+    default:
+        //not a valid denomination
+        nIndex = -1; break;
+    }
+
+    return nIndex;
+}
+
 
 CoinDenomination get_denomination(std::string denomAmount) {
     int64_t val = std::stoi(denomAmount);
@@ -0,0 +1,83 @@
+/**
+ * @file       FixedBaseTable.cpp
+ *
+ * @brief      Precomputed powers of the fixed group generators for the Zerocoin library.
+ *
+ * @copyright  Copyright 2018 The DIVIT developers
+ * @license    This project is released under the MIT license.
+ **/
+
+#include "FixedBaseTable.h"
+
+#include <boost/thread/locks.hpp>
+
+namespace libzerocoin {
+
+static const unsigned int FIXED_BASE_DIGITS = 1 << FIXED_BASE_WINDOW;
+static_assert(FIXED_BASE_WINDOW == 4, "pow_mod reads two digits from each byte of the exponent");
+
+FixedBaseTable::FixedBaseTable(const CBigNum& base, const CBigNum& modulus, unsigned int nMaxBits): base(base), modulus(modulus), nMaxBits(nMaxBits) {}
+
+bool FixedBaseTable::Matches(const CBigNum& base, const CBigNum& modulus) const {
+	return this->base == base && this->modulus == modulus;
+}
+
+void FixedBaseTable::Extend(unsigned int nRows) {
+	rows.reserve(nRows);
+	while (rows.size() < nRows) {
+		// The base of the new row is the base of the previous one raised to 2^FIXED_BASE_WINDOW
+		CBigNum rowBase = rows.empty() ? base % modulus : rows.back()[FIXED_BASE_DIGITS - 1].mul_mod(rows.back()[1], modulus);
+		std::vector<CBigNum> row(FIXED_BASE_DIGITS);
+		row[0] = 1;
+		row[1] = rowBase;
+		for (unsigned int d = 2; d < FIXED_BASE_DIGITS; d++)
+			row[d] = row[d - 1].mul_mod(rowBase, modulus);
+		rows.push_back(row);
+	}
+}
+
+CBigNum FixedBaseTable::pow_mod(const CBigNum& e) {
+	if (e < 0) {
+		// g^-x = (g^x)^-1
+		return pow_mod(-e).inverse(modulus);
+	}
+
+	const unsigned int nBits = e.bitSize();
+	if (nBits > nMaxBits)
+		return base.pow_mod(e, modulus);
+
+	const unsigned int nRows = (nBits + FIXED_BASE_WINDOW - 1) / FIXED_BASE_WINDOW;
+	boost::shared_lock<boost::shared_mutex> lock(cs);
+	while (rows.size() < nRows) {
+		lock.unlock();
+		{
+			boost::unique_lock<boost::shared_mutex> lockExtend(cs);
+			Extend(nRows);
+		}
+		lock.lock();
+	}
+
+	// Little endian magnitude, two digits per byte
+	const std::vector<unsigned char> vch = e.getvch();
+	CBigNum ret = 1;
+	for (unsigned int i = 0; i < nRows; i++) {
+		unsigned int d = (vch[i / 2] >> (FIXED_BASE_WINDOW * (i % 2))) & (FIXED_BASE_DIGITS - 1);
+		if (d)
+			ret = ret.mul_mod(rows[i][d], modulus);
+	}
+	return ret % modulus;
+}
+
+boost::shared_ptr<FixedBaseTable> MakeFixedBaseTable(const CBigNum& base, const CBigNum& modulus, const CBigNum& order) {
+	if (!FIXED_BASE_TABLES || modulus == 0)
+		return boost::shared_ptr<FixedBaseTable>();
+	return boost::shared_ptr<FixedBaseTable>(new FixedBaseTable(base, modulus, order.bitSize()));
+}
+
+CBigNum FixedBasePow(const boost::shared_ptr<FixedBaseTable>& ptable, const CBigNum& base, const CBigNum& e, const CBigNum& modulus) {
+	if (!ptable)
+		return base.pow_mod(e, modulus);
+	return ptable->pow_mod(e);
+}
+
+} /* namespace libzerocoin */
@@ -0,0 +1,81 @@
+/**
+ * @file       FixedBaseTable.h
+ *
+ * @brief      Precomputed powers of the fixed group generators for the Zerocoin library.
+ *
+ * @copyright  Copyright 2018 The DIVIT developers
+ * @license    This project is released under the MIT license.
+ **/
+
+#ifndef FIXEDBASETABLE_H_
+#define FIXEDBASETABLE_H_
+
+#include "bignum.h"
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+namespace libzerocoin {
+
+/** Width in bits of the exponent digits looked up in a FixedBaseTable */
+static const unsigned int FIXED_BASE_WINDOW = 4;
+
+/**
+ * Whether the tables beat pow_mod with the selected bignum backend. OpenSSL's
+ * Montgomery exponentiation outruns a table walk done with BN_mod_mul.
+ */
+#if defined(USE_NUM_GMP)
+static const bool FIXED_BASE_TABLES = true;
+#else
+static const bool FIXED_BASE_TABLES = false;
+#endif
+
+/**
+ * Windowed table of powers of a fixed base.
+ *
+ * Row i holds base^(d * 2^(FIXED_BASE_WINDOW * i)) mod modulus for every
+ * digit d, so base^e costs one modular multiplication per nonzero digit of e
+ * and no squarings. Rows are added on demand as longer exponents show up,
+ * up to the bit length of the group order. Longer exponents, which only come
+ * from proofs received from peers, are computed with a plain pow_mod so they
+ * can not grow the table. The tables are only used when FIXED_BASE_TABLES is set.
+ */
+class FixedBaseTable {
+public:
+	FixedBaseTable(const CBigNum& base, const CBigNum& modulus, unsigned int nMaxBits);
+
+	/** Returns true if the table holds powers of base modulo modulus */
+	bool Matches(const CBigNum& base, const CBigNum& modulus) const;
+
+	/** Computes base^e mod modulus. Safe to call from several threads. */
+	CBigNum pow_mod(const CBigNum& e);
+
+private:
+	const CBigNum base;
+	const CBigNum modulus;
+	//! Longest exponent the table is extended for
+	const unsigned int nMaxBits;
+
+	boost::shared_mutex cs;
+	std::vector<std::vector<CBigNum> > rows;
+
+	void Extend(unsigned int nRows);
+};
+
+/**
+ * Returns a table of powers of base modulo modulus for exponents up to the bit
+ * length of order, or none if FIXED_BASE_TABLES is not set.
+ */
+boost::shared_ptr<FixedBaseTable> MakeFixedBaseTable(const CBigNum& base, const CBigNum& modulus, const CBigNum& order);
+
+/**
+ * Computes base^e mod modulus through ptable, which must hold powers of base
+ * modulo modulus. Falls back to pow_mod if ptable is null.
+ */
+CBigNum FixedBasePow(const boost::shared_ptr<FixedBaseTable>& ptable, const CBigNum& base, const CBigNum& e, const CBigNum& modulus);
+
+} /* namespace libzerocoin */
+
+#endif /* FIXEDBASETABLE_H_ */
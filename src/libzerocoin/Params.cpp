@@ -34,6 +34,20 @@ AccumulatorAndProofParams::AccumulatorAndProofParams() {
 	this->initialized = false;
 }
 
+CBigNum AccumulatorAndProofParams::pow_g_n(const CBigNum& e) const {
+	return FixedBasePow(gnTable, this->accumulatorQRNCommitmentGroup.g, e, this->accumulatorModulus);
+}
+
+CBigNum AccumulatorAndProofParams::pow_h_n(const CBigNum& e) const {
+	return FixedBasePow(hnTable, this->accumulatorQRNCommitmentGroup.h, e, this->accumulatorModulus);
+}
+
+void AccumulatorAndProofParams::InitTables() {
+	// The order of the QRN group is not known, it is below the modulus
+	gnTable = MakeFixedBaseTable(this->accumulatorQRNCommitmentGroup.g, this->accumulatorModulus, this->accumulatorModulus);
+	hnTable = MakeFixedBaseTable(this->accumulatorQRNCommitmentGroup.h, this->accumulatorModulus, this->accumulatorModulus);
+}
+
 IntegerGroupParams::IntegerGroupParams() {
 	this->initialized = false;
 }
@@ -42,7 +56,20 @@ CBigNum IntegerGroupParams::randomElement() const {
 	// The generator of the group raised
 	// to a random number less than the order of the group
 	// provides us with a uniformly distributed random number.
-	return this->g.pow_mod(CBigNum::randBignum(this->groupOrder),this->modulus);
+	return this->pow_g(CBigNum::randBignum(this->groupOrder));
+}
+
+CBigNum IntegerGroupParams::pow_g(const CBigNum& e) const {
+	return FixedBasePow(gTable, this->g, e, this->modulus);
+}
+
+CBigNum IntegerGroupParams::pow_h(const CBigNum& e) const {
+	return FixedBasePow(hTable, this->h, e, this->modulus);
+}
+
+void IntegerGroupParams::InitTables() {
+	gTable = MakeFixedBaseTable(this->g, this->modulus, this->groupOrder);
+	hTable = MakeFixedBaseTable(this->h, this->modulus, this->groupOrder);
 }
 
 } /* namespace libzerocoin */
@@ -15,6 +15,7 @@
 #define PARAMS_H_
 
 #include "bignum.h"
+#include "FixedBaseTable.h"
 #include "ZerocoinDefines.h"
 
 namespace libzerocoin {
@@ -32,6 +33,28 @@ public:
 	 * @return a random element in the group.
 	 */
 	CBigNum randomElement() const;
+
+	/**
+	 * Computes g^e mod modulus from a precomputed table of powers of g.
+	 * @param e the exponent, may be negative
+	 * @return g^e mod modulus
+	 */
+	CBigNum pow_g(const CBigNum& e) const;
+
+	/**
+	 * Computes h^e mod modulus from a precomputed table of powers of h.
+	 * @param e the exponent, may be negative
+	 * @return h^e mod modulus
+	 */
+	CBigNum pow_h(const CBigNum& e) const;
+
+	/**
+	 * Sets up the tables used by pow_g and pow_h for the current g, h and
+	 * modulus. Called once the group is derived or read, as the tables are
+	 * not checked against the values they were built for.
+	 */
+	void InitTables();
+
 	bool initialized;
 
 	/**
@@ -63,7 +86,13 @@ public:
 		    READWRITE(h);
 		    READWRITE(modulus);
 		    READWRITE(groupOrder);
+		    if (ser_action.ForRead())
+		        InitTables();
 	}	
+
+private:
+	boost::shared_ptr<FixedBaseTable> gTable;
+	boost::shared_ptr<FixedBaseTable> hTable;
 };
 
 class AccumulatorAndProofParams {
@@ -88,6 +117,27 @@ public:
 
 	//AccumulatorAndProofParams(CBigNum accumulatorModulus);
 
+	/**
+	 * Computes g^e mod accumulatorModulus for the generator g of the
+	 * quadratic residue group, from a precomputed table of its powers.
+	 * @param e the exponent, may be negative
+	 */
+	CBigNum pow_g_n(const CBigNum& e) const;
+
+	/**
+	 * Computes h^e mod accumulatorModulus for the generator h of the
+	 * quadratic residue group, from a precomputed table of its powers.
+	 * @param e the exponent, may be negative
+	 */
+	CBigNum pow_h_n(const CBigNum& e) const;
+
+	/**
+	 * Sets up the tables used by pow_g_n and pow_h_n for the current
+	 * generators and accumulatorModulus. The commitment groups set up
+	 * their own tables.
+	 */
+	void InitTables();
+
 	bool initialized;
 
 	/**
@@ -150,7 +200,13 @@ public:
 	    READWRITE(maxCoinValue);
 	    READWRITE(k_prime);
 	    READWRITE(k_dprime);
+	    if (ser_action.ForRead())
+	        InitTables();
   }
+
+private:
+	boost::shared_ptr<FixedBaseTable> gnTable;
+	boost::shared_ptr<FixedBaseTable> hnTable;
 };
 
 class ZerocoinParams {
@@ -13,6 +13,7 @@
 // Copyright (c) 2017 The PIVX developers
 #include <streams.h>
 #include "SerialNumberSignatureOfKnowledge.h"
+#include "Threading.h"
 
 namespace libzerocoin {
 
@@ -48,11 +49,6 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const
 		throw std::runtime_error("Groups are not structured correctly.");
 	}
 
-	CBigNum a = params->coinCommitmentGroup.g;
-	CBigNum b = params->coinCommitmentGroup.h;
-	CBigNum g = params->serialNumberSoKCommitmentGroup.g;
-	CBigNum h = params->serialNumberSoKCommitmentGroup.h;
-
 	CHashWriter hasher(0,0);
 	hasher << *params << commitmentToCoin.getCommitmentValue() << coin.getSerialNumber() << msghash;
 
@@ -78,10 +74,12 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const
         }
 	}
 
-	for(uint32_t i=0; i < params->zkp_iterations; i++) {
-		// compute g^{ {a^x b^r} h^v} mod p2
-		c[i] = challengeCalculation(coin.getSerialNumber(), r[i], v_expanded[i]);
-	}
+	// compute g^{ {a^x b^r} h^v} mod p2, the iterations are independent
+	// and a^x is the same for all of them
+	const CBigNum a_pow = params->coinCommitmentGroup.pow_g(coin.getSerialNumber());
+	ParallelFor(params->zkp_iterations, [&](uint32_t i) {
+		c[i] = challengeCalculation(a_pow, r[i], v_expanded[i]);
+	});
 
 	// We can't hash data in parallel either
 	// because OPENMP cannot not guarantee loops
@@ -92,7 +90,7 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const
 	this->hash = hasher.GetHash();
 	unsigned char *hashbytes =  (unsigned char*) &hash;
 
-	for(uint32_t i = 0; i < params->zkp_iterations; i++) {
+	ParallelFor(params->zkp_iterations, [&](uint32_t i) {
 		int bit = i % 8;
 		int byte = i / 8;
 
@@ -103,50 +101,41 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const
 		} else {
 			s_notprime[i]       = r[i] - coin.getRandomness();
 			sprime[i]           = v_expanded[i] - (commitmentToCoin.getRandomness() *
-			                              b.pow_mod(r[i] - coin.getRandomness(), params->serialNumberSoKCommitmentGroup.groupOrder));
+			                              params->coinCommitmentGroup.pow_h(r[i] - coin.getRandomness()));
 		}
-	}
+	});
 }
 
-inline CBigNum SerialNumberSignatureOfKnowledge::challengeCalculation(const CBigNum& a_exp,const CBigNum& b_exp,
+inline CBigNum SerialNumberSignatureOfKnowledge::challengeCalculation(const CBigNum& a_pow,const CBigNum& b_exp,
         const CBigNum& h_exp) const {
 
-	CBigNum a = params->coinCommitmentGroup.g;
-	CBigNum b = params->coinCommitmentGroup.h;
-	CBigNum g = params->serialNumberSoKCommitmentGroup.g;
-	CBigNum h = params->serialNumberSoKCommitmentGroup.h;
-
-	CBigNum exponent = (a.pow_mod(a_exp, params->serialNumberSoKCommitmentGroup.groupOrder)
-	                   * b.pow_mod(b_exp, params->serialNumberSoKCommitmentGroup.groupOrder)) % params->serialNumberSoKCommitmentGroup.groupOrder;
+	CBigNum exponent = (a_pow * params->coinCommitmentGroup.pow_h(b_exp)) % params->serialNumberSoKCommitmentGroup.groupOrder;
 
-	return (g.pow_mod(exponent, params->serialNumberSoKCommitmentGroup.modulus) * h.pow_mod(h_exp, params->serialNumberSoKCommitmentGroup.modulus)) % params->serialNumberSoKCommitmentGroup.modulus;
+	return (params->serialNumberSoKCommitmentGroup.pow_g(exponent) * params->serialNumberSoKCommitmentGroup.pow_h(h_exp)) % params->serialNumberSoKCommitmentGroup.modulus;
 }
 
 bool SerialNumberSignatureOfKnowledge::Verify(const CBigNum& coinSerialNumber, const CBigNum& valueOfCommitmentToCoin,
         const uint256 msghash) const {
-	CBigNum a = params->coinCommitmentGroup.g;
-	CBigNum b = params->coinCommitmentGroup.h;
-	CBigNum g = params->serialNumberSoKCommitmentGroup.g;
-	CBigNum h = params->serialNumberSoKCommitmentGroup.h;
 	CHashWriter hasher(0,0);
 	hasher << *params << valueOfCommitmentToCoin << coinSerialNumber << msghash;
 
 	vector<CBigNum> tprime(params->zkp_iterations);
 	unsigned char *hashbytes = (unsigned char*) &this->hash;
 
-	for(uint32_t i = 0; i < params->zkp_iterations; i++) {
+	const CBigNum a_pow = params->coinCommitmentGroup.pow_g(coinSerialNumber);
+	ParallelFor(params->zkp_iterations, [&](uint32_t i) {
 		int bit = i % 8;
 		int byte = i / 8;
 		bool challenge_bit = ((hashbytes[byte] >> bit) & 0x01);
 		if(challenge_bit) {
-			tprime[i] = challengeCalculation(coinSerialNumber, s_notprime[i], SeedTo1024(sprime[i].getuint256()));
+			tprime[i] = challengeCalculation(a_pow, s_notprime[i], SeedTo1024(sprime[i].getuint256()));
 		} else {
-			CBigNum exp = b.pow_mod(s_notprime[i], params->serialNumberSoKCommitmentGroup.groupOrder);
+			CBigNum exp = params->coinCommitmentGroup.pow_h(s_notprime[i]);
 			tprime[i] = ((valueOfCommitmentToCoin.pow_mod(exp, params->serialNumberSoKCommitmentGroup.modulus) % params->serialNumberSoKCommitmentGroup.modulus) *
-			             (h.pow_mod(sprime[i], params->serialNumberSoKCommitmentGroup.modulus) % params->serialNumberSoKCommitmentGroup.modulus)) %
+			             params->serialNumberSoKCommitmentGroup.pow_h(sprime[i])) %
 			            params->serialNumberSoKCommitmentGroup.modulus;
 		}
-	}
+	});
 	for(uint32_t i = 0; i < params->zkp_iterations; i++) {
 		hasher << tprime[i];
 	}
@@ -68,7 +68,8 @@ private:
 	// define something named s and it conflicts
 	vector<CBigNum> s_notprime;
 	vector<CBigNum> sprime;
-	inline CBigNum challengeCalculation(const CBigNum& a_exp, const CBigNum& b_exp,
+	// a_pow is a^serial mod q, which all iterations share
+	inline CBigNum challengeCalculation(const CBigNum& a_pow, const CBigNum& b_exp,
 	                                   const CBigNum& h_exp) const;
 };
 
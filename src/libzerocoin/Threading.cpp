@@ -0,0 +1,197 @@
+/**
+ * @file       Threading.cpp
+ *
+ * @brief      Parallel evaluation of independent proof iterations for the Zerocoin library.
+ *
+ * @copyright  Copyright 2018 The DIVIT developers
+ * @license    This project is released under the MIT license.
+ **/
+
+#include "Threading.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+
+#include <boost/thread.hpp>
+
+namespace libzerocoin {
+
+static std::atomic<int> nProofThreads(0);
+
+// Non-null while the thread works on a ParallelFor or is in a
+// SequentialProofScope, ParallelFor calls then run inline.
+static void NoCleanup(bool*) {}
+static boost::thread_specific_ptr<bool> pfInParallelFor(NoCleanup);
+static bool fInParallelFor = true;
+
+namespace {
+
+/** The iterations of one ParallelFor call, shared by the caller and the pool threads */
+struct CParallelJob {
+    const boost::function<void (uint32_t)>* pfn;
+    uint32_t nCount;
+    std::atomic<uint32_t> nNext;
+    //! Pool threads working on the job, protected by the pool's mutex
+    int nWorkers;
+    boost::mutex cs_error;
+    std::exception_ptr error;
+
+    CParallelJob(const boost::function<void (uint32_t)>& fn, uint32_t nCountIn) : pfn(&fn), nCount(nCountIn), nNext(0), nWorkers(0) {}
+
+    void Work()
+    {
+        try {
+            for (uint32_t i = nNext++; i < nCount; i = nNext++)
+                (*pfn)(i);
+        } catch (...) {
+            boost::lock_guard<boost::mutex> lock(cs_error);
+            if (!error)
+                error = std::current_exception();
+            nNext = nCount;
+        }
+    }
+};
+
+/**
+ * Threads that stay around for the proof iterations of every ParallelFor
+ * call, so that verifying a spend does not start and join a set of
+ * threads for each of its proofs.
+ */
+class CProofThreadPool
+{
+private:
+    boost::mutex cs;
+    boost::condition_variable condJob;
+    boost::condition_variable condDone;
+    std::deque<std::shared_ptr<CParallelJob> > queue;
+    boost::thread_group threads;
+    int nThreads;
+    bool fStop;
+
+    void Thread()
+    {
+        pfInParallelFor.reset(&fInParallelFor);
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (true) {
+            while (queue.empty() && !fStop)
+                condJob.wait(lock);
+            if (fStop)
+                break;
+
+            std::shared_ptr<CParallelJob> job = queue.front();
+            job->nWorkers++;
+            lock.unlock();
+            job->Work();
+            lock.lock();
+            job->nWorkers--;
+            // Every iteration is taken once a worker leaves the job
+            if (!queue.empty() && queue.front() == job)
+                queue.pop_front();
+            condDone.notify_all();
+        }
+        pfInParallelFor.reset();
+    }
+
+public:
+    CProofThreadPool() : nThreads(0), fStop(false) {}
+
+    ~CProofThreadPool()
+    {
+        Stop();
+    }
+
+    void Stop()
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            fStop = true;
+            condJob.notify_all();
+        }
+        threads.join_all();
+    }
+
+    void Run(const boost::function<void (uint32_t)>& fn, uint32_t nCount, int nHelpers)
+    {
+        std::shared_ptr<CParallelJob> job = std::make_shared<CParallelJob>(fn, nCount);
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            if (fStop)
+                nHelpers = 0;
+            // The pool only grows, -zkpthreads is set once at startup
+            for (; nThreads < nHelpers; nThreads++)
+                threads.create_thread(boost::bind(&CProofThreadPool::Thread, this));
+            queue.push_back(job);
+            condJob.notify_all();
+        }
+
+        pfInParallelFor.reset(&fInParallelFor);
+        job->Work();
+        pfInParallelFor.reset();
+
+        // The job references fn, so no pool thread may still be working on it on return
+        boost::unique_lock<boost::mutex> lock(cs);
+        std::deque<std::shared_ptr<CParallelJob> >::iterator it = std::find(queue.begin(), queue.end(), job);
+        if (it != queue.end())
+            queue.erase(it);
+        while (job->nWorkers > 0)
+            condDone.wait(lock);
+        lock.unlock();
+
+        if (job->error)
+            std::rethrow_exception(job->error);
+    }
+};
+
+CProofThreadPool proofThreadPool;
+
+}
+
+void SetProofThreads(int nThreads)
+{
+    nProofThreads = std::max(nThreads, 0);
+}
+
+int GetProofThreads()
+{
+    int nThreads = nProofThreads;
+    if (nThreads == 0)
+        nThreads = boost::thread::hardware_concurrency();
+    return std::max(nThreads, 1);
+}
+
+void StopProofThreads()
+{
+    proofThreadPool.Stop();
+}
+
+SequentialProofScope::SequentialProofScope() : fSet(!pfInParallelFor.get())
+{
+    if (fSet)
+        pfInParallelFor.reset(&fInParallelFor);
+}
+
+SequentialProofScope::~SequentialProofScope()
+{
+    if (fSet)
+        pfInParallelFor.reset();
+}
+
+void ParallelFor(uint32_t nCount, const boost::function<void (uint32_t)>& fn)
+{
+    uint32_t nThreads = std::min<uint32_t>(GetProofThreads(), nCount);
+    if (nThreads <= 1 || pfInParallelFor.get()) {
+        for (uint32_t i = 0; i < nCount; i++)
+            fn(i);
+        return;
+    }
+
+    // The pool threads reference this stack frame, so waiting for them must
+    // not be cut short by an interruption of the calling thread.
+    boost::this_thread::disable_interruption di;
+    proofThreadPool.Run(fn, nCount, GetProofThreads() - 1);
+}
+
+} /* namespace libzerocoin */
@@ -0,0 +1,57 @@
+/**
+ * @file       Threading.h
+ *
+ * @brief      Parallel evaluation of independent proof iterations for the Zerocoin library.
+ *
+ * @copyright  Copyright 2018 The DIVIT developers
+ * @license    This project is released under the MIT license.
+ **/
+
+#ifndef THREADING_H_
+#define THREADING_H_
+
+#include <stdint.h>
+
+#include <boost/function.hpp>
+
+namespace libzerocoin {
+
+/**
+ * Set the number of threads used to compute proofs.
+ * @param nThreads number of threads, 0 selects the number of cores
+ */
+void SetProofThreads(int nThreads);
+
+/** Returns the number of threads used to compute proofs, at least 1. */
+int GetProofThreads();
+
+/** Stops the threads kept for ParallelFor, later calls run on the calling thread only. */
+void StopProofThreads();
+
+/**
+ * While in scope, ParallelFor calls of the constructing thread run
+ * sequentially. For threads that are already one of several verifying
+ * in parallel, such as the script check threads.
+ */
+class SequentialProofScope
+{
+private:
+    bool fSet;
+
+public:
+    SequentialProofScope();
+    ~SequentialProofScope();
+};
+
+/**
+ * Calls fn(i) for every i in [0, nCount), spread over the proof threads,
+ * which are started once and kept. The calling thread takes part in the
+ * work. Returns once all calls have finished; the first exception thrown
+ * by fn is rethrown to the caller.
+ * Calls made from within fn run sequentially on the calling thread.
+ */
+void ParallelFor(uint32_t nCount, const boost::function<void (uint32_t)>& fn);
+
+} /* namespace libzerocoin */
+
+#endif /* THREADING_H_ */
@@ -32,6 +32,9 @@
 #define ZEROCOIN_ACCUMULATOR_PROOF          "ACCUMULATOR_PROOF"
 #define ZEROCOIN_SERIALNUMBER_PROOF         "SERIALNUMBER_PROOF"
 
+// Spends verified together against one accumulator share a table of its
+// powers once there are at least this many of them
+#define ZEROCOIN_BATCH_TABLE_MIN_SPENDS     4
 // Activate multithreaded mode for proof verification
 #define ZEROCOIN_THREADING 1
 
@@ -6,9 +6,12 @@
 #ifndef BITCOIN_BIGNUM_H
 #define BITCOIN_BIGNUM_H
 
+#if defined(HAVE_CONFIG_H)
+#include "config/Divitae-config.h"
+#endif
+
 #include <stdexcept>
 #include <vector>
-#include <openssl/bn.h>
 #include "serialize.h"
 #include "uint256.h"
 #include "version.h"
@@ -20,6 +23,11 @@ public:
     explicit bignum_error(const std::string& str) : std::runtime_error(str) {}
 };
 
+#if defined(USE_NUM_GMP)
+#include "bignum_gmp.h"
+#else
+#include <openssl/bn.h>
+
 
 /** RAII encapsulated BN_CTX (OpenSSL bignum context) */
 class CAutoBN_CTX
@@ -769,6 +777,8 @@ inline bool operator<=(const CBigNum& a, const CBigNum& b) { return (BN_cmp(a.bn
 inline bool operator>=(const CBigNum& a, const CBigNum& b) { return (BN_cmp(a.bn, b.bn) >= 0); }
 inline bool operator<(const CBigNum& a, const CBigNum& b)  { return (BN_cmp(a.bn, b.bn) < 0); }
 inline bool operator>(const CBigNum& a, const CBigNum& b)  { return (BN_cmp(a.bn, b.bn) > 0); }
+#endif // USE_NUM_GMP
+
 inline std::ostream& operator<<(std::ostream &strm, const CBigNum &b) { return strm << b.ToString(10); }
 
 typedef CBigNum Bignum;
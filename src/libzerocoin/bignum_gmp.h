@@ -0,0 +1,630 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2012 The Bitcoin developers
+// Copyright (c) 2017 The DIVIT developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_BIGNUM_GMP_H
+#define BITCOIN_BIGNUM_GMP_H
+
+// GMP implementation of CBigNum, selected with --with-zerocoin-bignum=gmp.
+// Only to be included from bignum.h, which defines bignum_error.
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+#include <gmp.h>
+#include <openssl/crypto.h> // for OPENSSL_cleanse()
+#include "random.h"
+
+/** Number of Miller-Rabin rounds used by isPrime() when none is given */
+static const int BIGNUM_PRIME_CHECKS = 40;
+
+/** C++ wrapper for mpz_t (GMP bignum) */
+class CBigNum
+{
+    mpz_t bn;
+public:
+    CBigNum()
+    {
+        mpz_init(bn);
+    }
+
+    CBigNum(const CBigNum& b)
+    {
+        mpz_init_set(bn, b.bn);
+    }
+
+    CBigNum& operator=(const CBigNum& b)
+    {
+        mpz_set(bn, b.bn);
+        return (*this);
+    }
+
+    ~CBigNum()
+    {
+        OPENSSL_cleanse(bn->_mp_d, bn->_mp_alloc * sizeof(mp_limb_t));
+        mpz_clear(bn);
+    }
+
+    //CBigNum(char n) is not portable.  Use 'signed char' or 'unsigned char'.
+    CBigNum(signed char n)      { mpz_init(bn); if (n >= 0) setulong(n); else setint64(n); }
+    CBigNum(short n)            { mpz_init(bn); if (n >= 0) setulong(n); else setint64(n); }
+    CBigNum(int n)              { mpz_init(bn); if (n >= 0) setulong(n); else setint64(n); }
+    CBigNum(long n)             { mpz_init(bn); if (n >= 0) setulong(n); else setint64(n); }
+#ifdef __APPLE__
+    CBigNum(int64_t n)            { mpz_init(bn); setint64(n); }
+#endif
+    CBigNum(unsigned char n)    { mpz_init(bn); setulong(n); }
+    CBigNum(unsigned short n)   { mpz_init(bn); setulong(n); }
+    CBigNum(unsigned int n)     { mpz_init(bn); setulong(n); }
+    CBigNum(unsigned long n)    { mpz_init(bn); setulong(n); }
+    explicit CBigNum(uint256 n) { mpz_init(bn); setuint256(n); }
+
+    explicit CBigNum(const std::vector<unsigned char>& vch)
+    {
+        mpz_init(bn);
+        setvch(vch);
+    }
+
+    /** Generates a cryptographically secure random number between zero and range exclusive
+    * i.e. 0 < returned number < range
+    * @param range The upper bound on the number.
+    * @return
+    */
+    static CBigNum  randBignum(const CBigNum& range) {
+        if (range <= 0)
+            throw bignum_error("CBigNum:rand element : range must be positive");
+        // Rejection sampling keeps the result uniform over [0, range)
+        const int nBits = range.bitSize();
+        CBigNum ret;
+        do {
+            ret = RandKBitBigum(nBits);
+        } while (ret >= range);
+        return ret;
+    }
+
+    /** Generates a cryptographically secure random k-bit number
+    * @param k The bit length of the number.
+    * @return
+    */
+    static CBigNum RandKBitBigum(const uint32_t k){
+        CBigNum ret;
+        if (k == 0)
+            return ret;
+        std::vector<unsigned char> vch((k + 7) / 8);
+        GetRandBytes(&vch[0], vch.size());
+        if (k % 8)
+            vch[0] &= (1 << (k % 8)) - 1;
+        mpz_import(ret.bn, vch.size(), 1, 1, 0, 0, &vch[0]);
+        OPENSSL_cleanse(&vch[0], vch.size());
+        return ret;
+    }
+
+    /**Returns the size in bits of the underlying bignum.
+     *
+     * @return the size
+     */
+    int bitSize() const{
+        if (mpz_sgn(bn) == 0)
+            return 0;
+        return mpz_sizeinbase(bn, 2);
+    }
+
+    void setulong(unsigned long n)
+    {
+        mpz_set_ui(bn, n);
+    }
+
+    unsigned long getulong() const
+    {
+        // Mirror BN_get_word: the magnitude, or all ones if it does not fit
+        if (bitSize() > std::numeric_limits<unsigned long>::digits)
+            return std::numeric_limits<unsigned long>::max();
+        return mpz_get_ui(bn);
+    }
+
+    unsigned int getuint() const
+    {
+        return getulong();
+    }
+
+    int getint() const
+    {
+        unsigned long n = getulong();
+        if (mpz_sgn(bn) >= 0)
+            return (n > (unsigned long)std::numeric_limits<int>::max() ? std::numeric_limits<int>::max() : n);
+        else
+            return (n > (unsigned long)std::numeric_limits<int>::max() ? std::numeric_limits<int>::min() : -(int)n);
+    }
+
+    void setint64(int64_t sn)
+    {
+        if (sn < (int64_t)0)
+        {
+            // See the OpenSSL implementation for why the increment dance is needed
+            uint64_t n = -(sn + 1);
+            ++n;
+            setuint64(n);
+            mpz_neg(bn, bn);
+        } else {
+            setuint64(sn);
+        }
+    }
+
+    void setuint64(uint64_t n)
+    {
+        mpz_import(bn, 1, 1, sizeof(n), 0, 0, &n);
+    }
+
+    void setuint256(uint256 n)
+    {
+        mpz_import(bn, sizeof(n), -1, 1, 0, 0, n.begin());
+    }
+
+    uint256 getuint256() const
+    {
+        uint256 n = 0;
+        if (mpz_sgn(bn) == 0)
+            return n;
+        std::vector<unsigned char> vch((mpz_sizeinbase(bn, 2) + 7) / 8);
+        size_t nCount = 0;
+        mpz_export(&vch[0], &nCount, -1, 1, 0, 0, bn);
+        memcpy(n.begin(), &vch[0], std::min(nCount, sizeof(n)));
+        return n;
+    }
+
+    void setvch(const std::vector<unsigned char>& vch)
+    {
+        if (vch.empty()) {
+            mpz_set_ui(bn, 0);
+            return;
+        }
+        // Little endian magnitude with the sign in the top bit of the last byte
+        std::vector<unsigned char> vch2(vch);
+        bool fNegative = (vch2.back() & 0x80) != 0;
+        vch2.back() &= 0x7f;
+        mpz_import(bn, vch2.size(), -1, 1, 0, 0, &vch2[0]);
+        if (fNegative)
+            mpz_neg(bn, bn);
+    }
+
+    std::vector<unsigned char> getvch() const
+    {
+        if (mpz_sgn(bn) == 0)
+            return std::vector<unsigned char>();
+        std::vector<unsigned char> vch((mpz_sizeinbase(bn, 2) + 7) / 8);
+        size_t nCount = 0;
+        mpz_export(&vch[0], &nCount, -1, 1, 0, 0, bn);
+        vch.resize(nCount);
+        bool fNegative = mpz_sgn(bn) < 0;
+        if (vch.back() & 0x80)
+            vch.push_back(fNegative ? 0x80 : 0);
+        else if (fNegative)
+            vch.back() |= 0x80;
+        return vch;
+    }
+
+    // The "compact" format is a representation of a whole
+    // number N using an unsigned 32bit number similar to a
+    // floating point format. See the OpenSSL implementation
+    // for a full description.
+    CBigNum& SetCompact(unsigned int nCompact)
+    {
+        unsigned int nSize = nCompact >> 24;
+        bool fNegative     =(nCompact & 0x00800000) != 0;
+        unsigned int nWord = nCompact & 0x007fffff;
+        if (nSize <= 3)
+        {
+            nWord >>= 8*(3-nSize);
+            mpz_set_ui(bn, nWord);
+        }
+        else
+        {
+            mpz_set_ui(bn, nWord);
+            mpz_mul_2exp(bn, bn, 8*(nSize-3));
+        }
+        if (fNegative)
+            mpz_neg(bn, bn);
+        return *this;
+    }
+
+    unsigned int GetCompact() const
+    {
+        unsigned int nSize = (bitSize() + 7) / 8;
+        unsigned int nCompact = 0;
+        if (nSize <= 3)
+            nCompact = getulong() << 8*(3-nSize);
+        else
+        {
+            CBigNum cbn;
+            mpz_tdiv_q_2exp(cbn.bn, bn, 8*(nSize-3));
+            nCompact = cbn.getulong();
+        }
+        // The 0x00800000 bit denotes the sign.
+        // Thus, if it is already set, divide the mantissa by 256 and increase the exponent.
+        if (nCompact & 0x00800000)
+        {
+            nCompact >>= 8;
+            nSize++;
+        }
+        nCompact |= nSize << 24;
+        nCompact |= (mpz_sgn(bn) < 0 ? 0x00800000 : 0);
+        return nCompact;
+    }
+
+    void SetDec(const std::string& str)
+    {
+        if (mpz_set_str(bn, str.c_str(), 10) != 0)
+            mpz_set_ui(bn, 0);
+    }
+
+    void SetHex(const std::string& str)
+    {
+        SetHexBool(str);
+    }
+
+    bool SetHexBool(const std::string& str)
+    {
+        // skip 0x
+        const char* psz = str.c_str();
+        while (isspace(*psz))
+            psz++;
+        bool fNegative = false;
+        if (*psz == '-')
+        {
+            fNegative = true;
+            psz++;
+        }
+        if (psz[0] == '0' && tolower(psz[1]) == 'x')
+            psz += 2;
+        while (isspace(*psz))
+            psz++;
+
+        // hex string to bignum
+        std::string strHex;
+        while (isxdigit(*psz))
+            strHex += *psz++;
+        if (strHex.empty() || mpz_set_str(bn, strHex.c_str(), 16) != 0)
+            mpz_set_ui(bn, 0);
+        if (fNegative)
+            mpz_neg(bn, bn);
+
+        return true;
+    }
+
+
+    std::string ToString(int nBase=10) const
+    {
+        std::vector<char> str(mpz_sizeinbase(bn, nBase) + 2);
+        mpz_get_str(&str[0], nBase, bn);
+        return std::string(&str[0]);
+    }
+
+    std::string GetHex() const
+    {
+        return ToString(16);
+    }
+
+    std::string GetDec() const
+    {
+        return ToString(10);
+    }
+
+    unsigned int GetSerializeSize(int nType=0, int nVersion=PROTOCOL_VERSION) const
+    {
+        return ::GetSerializeSize(getvch(), nType, nVersion);
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType=0, int nVersion=PROTOCOL_VERSION) const
+    {
+        ::Serialize(s, getvch(), nType, nVersion);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType=0, int nVersion=PROTOCOL_VERSION)
+    {
+        std::vector<unsigned char> vch;
+        ::Unserialize(s, vch, nType, nVersion);
+        setvch(vch);
+    }
+
+    /**
+        * exponentiation with an int. this^e
+        * @param e the exponent as an int
+        * @return
+        */
+    CBigNum pow(const int e) const {
+        return this->pow(CBigNum(e));
+    }
+
+    /**
+     * exponentiation this^e
+     * @param e the exponent
+     * @return
+     */
+    CBigNum pow(const CBigNum& e) const {
+        if (e < 0 || e.bitSize() > std::numeric_limits<unsigned long>::digits)
+            throw bignum_error("CBigNum::pow : exponent out of range");
+        CBigNum ret;
+        mpz_pow_ui(ret.bn, bn, e.getulong());
+        return ret;
+    }
+
+    /**
+     * modular multiplication: (this * b) mod m
+     * @param b operand
+     * @param m modulus
+     */
+    CBigNum mul_mod(const CBigNum& b, const CBigNum& m) const {
+        if (!m)
+            throw bignum_error("CBigNum::mul_mod : division by zero");
+        CBigNum ret;
+        mpz_mul(ret.bn, bn, b.bn);
+        mpz_mod(ret.bn, ret.bn, m.bn);
+        return ret;
+    }
+
+    /**
+     * modular exponentiation: this^e mod n
+     * @param e exponent
+     * @param m modulus
+     */
+    CBigNum pow_mod(const CBigNum& e, const CBigNum& m) const {
+        if (!m)
+            throw bignum_error("CBigNum::pow_mod : division by zero");
+        CBigNum ret;
+        if( e < 0){
+            // g^-x = (g^-1)^x
+            CBigNum inv = this->inverse(m);
+            CBigNum posE = e * -1;
+            mpz_powm(ret.bn, inv.bn, posE.bn, m.bn);
+        }else
+            mpz_powm(ret.bn, bn, e.bn, m.bn);
+
+        return ret;
+    }
+
+   /**
+    * Calculates the inverse of this element mod m.
+    * i.e. i such this*i = 1 mod m
+    * @param m the modu
+    * @return the inverse
+    */
+    CBigNum inverse(const CBigNum& m) const {
+        CBigNum ret;
+        if (!m || !mpz_invert(ret.bn, bn, m.bn))
+            throw bignum_error("CBigNum::inverse*= :mpz_invert");
+        return ret;
+    }
+
+    /**
+     * Generates a random (safe) prime of numBits bits
+     * @param numBits the number of bits
+     * @param safe true for a safe prime
+     * @return the prime
+     */
+    static CBigNum generatePrime(const unsigned int numBits, bool safe = false) {
+        if (numBits < 3)
+            throw bignum_error("CBigNum::generatePrime*= :numBits too small");
+        CBigNum ret;
+        while (true) {
+            // Fix the top two bits, like BN_generate_prime_ex does
+            const unsigned int nBits = safe ? numBits - 1 : numBits;
+            CBigNum candidate = RandKBitBigum(nBits);
+            mpz_setbit(candidate.bn, nBits - 1);
+            mpz_setbit(candidate.bn, nBits - 2);
+            mpz_nextprime(ret.bn, candidate.bn);
+            if (safe) {
+                ret = ret * 2 + 1;
+                if (!ret.isPrime())
+                    continue;
+            }
+            if (ret.bitSize() == (int)numBits)
+                return ret;
+        }
+    }
+
+    /**
+     * Calculates the greatest common divisor (GCD) of two numbers.
+     * @param m the second element
+     * @return the GCD
+     */
+    CBigNum gcd( const CBigNum& b) const{
+        CBigNum ret;
+        mpz_gcd(ret.bn, bn, b.bn);
+        return ret;
+    }
+
+   /**
+    * Miller-Rabin primality test on this element
+    * @param checks: optional, the number of Miller-Rabin tests to run
+    * 			 	default causes error rate of 2^-80.
+    * @return true if prime
+    */
+    bool isPrime(const int checks=BIGNUM_PRIME_CHECKS) const {
+        if (mpz_cmp_ui(bn, 1) <= 0)
+            return false;
+        return mpz_probab_prime_p(bn, checks) > 0;
+    }
+
+    bool isOne() const {
+        return mpz_cmp_ui(bn, 1) == 0;
+    }
+
+
+
+    bool operator!() const
+    {
+        return mpz_sgn(bn) == 0;
+    }
+
+    CBigNum& operator+=(const CBigNum& b)
+    {
+        mpz_add(bn, bn, b.bn);
+        return *this;
+    }
+
+    CBigNum& operator-=(const CBigNum& b)
+    {
+        mpz_sub(bn, bn, b.bn);
+        return *this;
+    }
+
+    CBigNum& operator*=(const CBigNum& b)
+    {
+        mpz_mul(bn, bn, b.bn);
+        return *this;
+    }
+
+    CBigNum& operator/=(const CBigNum& b)
+    {
+        *this = *this / b;
+        return *this;
+    }
+
+    CBigNum& operator%=(const CBigNum& b)
+    {
+        *this = *this % b;
+        return *this;
+    }
+
+    CBigNum& operator<<=(unsigned int shift)
+    {
+        mpz_mul_2exp(bn, bn, shift);
+        return *this;
+    }
+
+    CBigNum& operator>>=(unsigned int shift)
+    {
+        // Same semantics as the OpenSSL implementation: anything below 2^shift,
+        // including every negative number, becomes zero.
+        CBigNum a = 1;
+        a <<= shift;
+        if (mpz_cmp(a.bn, bn) > 0)
+        {
+            mpz_set_ui(bn, 0);
+            return *this;
+        }
+
+        mpz_tdiv_q_2exp(bn, bn, shift);
+        return *this;
+    }
+
+
+    CBigNum& operator++()
+    {
+        // prefix operator
+        mpz_add_ui(bn, bn, 1);
+        return *this;
+    }
+
+    const CBigNum operator++(int)
+    {
+        // postfix operator
+        const CBigNum ret = *this;
+        ++(*this);
+        return ret;
+    }
+
+    CBigNum& operator--()
+    {
+        // prefix operator
+        mpz_sub_ui(bn, bn, 1);
+        return *this;
+    }
+
+    const CBigNum operator--(int)
+    {
+        // postfix operator
+        const CBigNum ret = *this;
+        --(*this);
+        return ret;
+    }
+
+    friend inline const CBigNum operator+(const CBigNum& a, const CBigNum& b);
+    friend inline const CBigNum operator-(const CBigNum& a, const CBigNum& b);
+    friend inline const CBigNum operator/(const CBigNum& a, const CBigNum& b);
+    friend inline const CBigNum operator%(const CBigNum& a, const CBigNum& b);
+    friend inline const CBigNum operator*(const CBigNum& a, const CBigNum& b);
+    friend inline const CBigNum operator<<(const CBigNum& a, unsigned int shift);
+    friend inline const CBigNum operator-(const CBigNum& a);
+    friend inline bool operator==(const CBigNum& a, const CBigNum& b);
+    friend inline bool operator!=(const CBigNum& a, const CBigNum& b);
+    friend inline bool operator<=(const CBigNum& a, const CBigNum& b);
+    friend inline bool operator>=(const CBigNum& a, const CBigNum& b);
+    friend inline bool operator<(const CBigNum& a, const CBigNum& b);
+    friend inline bool operator>(const CBigNum& a, const CBigNum& b);
+};
+
+
+
+inline const CBigNum operator+(const CBigNum& a, const CBigNum& b)
+{
+    CBigNum r;
+    mpz_add(r.bn, a.bn, b.bn);
+    return r;
+}
+
+inline const CBigNum operator-(const CBigNum& a, const CBigNum& b)
+{
+    CBigNum r;
+    mpz_sub(r.bn, a.bn, b.bn);
+    return r;
+}
+
+inline const CBigNum operator-(const CBigNum& a)
+{
+    CBigNum r;
+    mpz_neg(r.bn, a.bn);
+    return r;
+}
+
+inline const CBigNum operator*(const CBigNum& a, const CBigNum& b)
+{
+    CBigNum r;
+    mpz_mul(r.bn, a.bn, b.bn);
+    return r;
+}
+
+inline const CBigNum operator/(const CBigNum& a, const CBigNum& b)
+{
+    if (!b)
+        throw bignum_error("CBigNum::operator/ : division by zero");
+    CBigNum r;
+    mpz_tdiv_q(r.bn, a.bn, b.bn);
+    return r;
+}
+
+inline const CBigNum operator%(const CBigNum& a, const CBigNum& b)
+{
+    if (!b)
+        throw bignum_error("CBigNum::operator% : division by zero");
+    CBigNum r;
+    mpz_mod(r.bn, a.bn, b.bn);
+    return r;
+}
+
+inline const CBigNum operator<<(const CBigNum& a, unsigned int shift)
+{
+    CBigNum r;
+    mpz_mul_2exp(r.bn, a.bn, shift);
+    return r;
+}
+
+inline const CBigNum operator>>(const CBigNum& a, unsigned int shift)
+{
+    CBigNum r = a;
+    r >>= shift;
+    return r;
+}
+
+inline bool operator==(const CBigNum& a, const CBigNum& b) { return (mpz_cmp(a.bn, b.bn) == 0); }
+inline bool operator!=(const CBigNum& a, const CBigNum& b) { return (mpz_cmp(a.bn, b.bn) != 0); }
+inline bool operator<=(const CBigNum& a, const CBigNum& b) { return (mpz_cmp(a.bn, b.bn) <= 0); }
+inline bool operator>=(const CBigNum& a, const CBigNum& b) { return (mpz_cmp(a.bn, b.bn) >= 0); }
+inline bool operator<(const CBigNum& a, const CBigNum& b)  { return (mpz_cmp(a.bn, b.bn) < 0); }
+inline bool operator>(const CBigNum& a, const CBigNum& b)  { return (mpz_cmp(a.bn, b.bn) > 0); }
+
+#endif // BITCOIN_BIGNUM_GMP_H
@@ -18,6 +18,7 @@
 #include "checkqueue.h"
 #include "init.h"
 #include "kernel.h"
+#include "mappedfile.h"
 #include "prosperitynode-budget.h"
 #include "prosperitynode-payments.h"
 #include "prosperitynodeman.h"
@@ -29,12 +30,14 @@
 #include "sporkdb.h"
 #include "swifttx.h"
 #include "txdb.h"
+#include "txindex.h"
 #include "txmempool.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utilmoneystr.h"
 #include "validationinterface.h"
 #include "zvitchain.h"
+#include "zvitspendcache.h"
 
 #include "masternode-pos.h"
 #include "masternode.h"
@@ -43,8 +46,10 @@
 
 #include "primitives/zerocoin.h"
 #include "libzerocoin/Denominations.h"
+#include "libzerocoin/Threading.h"
 #include "invalid.h"
 
+#include <atomic>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -90,10 +95,16 @@ int nScriptCheckThreads = 0;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
+bool fAddressIndex = DEFAULT_ADDRESSINDEX;
+bool fSpentIndex = DEFAULT_SPENTINDEX;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
-unsigned int nCoinCacheSize = 5000;
+uint256 hashAssumeValid;
+bool fHavePruned = false;
+bool fPruneMode = false;
+uint64_t nPruneTarget = 0;
+size_t nCoinCacheUsage = 5000 * 300;
 bool fAlerts = DEFAULT_ALERTS;
 
 unsigned int nStakeMinAge = 1 * 60 * 60;
@@ -106,6 +117,7 @@ int64_t nReserveBalance = 0;
 CFeeRate minRelayTxFee = CFeeRate(10000);
 
 CTxMemPool mempool(::minRelayTxFee);
+CBlockCache blockCache(DEFAULT_BLOCK_CACHE_SIZE << 20);
 
 struct COrphanTx {
     CTransaction tx;
@@ -201,6 +213,9 @@ set<CBlockIndex*> setDirtyBlockIndex;
 
 /** Dirty block file entries. */
 set<int> setDirtyFileInfo;
+
+/** Set when block or undo file space was allocated in prune mode, to look for files to prune at the next flush. */
+bool fCheckForPruning = false;
 } // anon namespace
 
 //////////////////////////////////////////////////////////////////////////////
@@ -546,6 +561,9 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
     return chain.Genesis();
 }
 
+CCoinsViewDB* pcoinsdbview = NULL;
+CCoinsViewBackgroundFlush* pcoinsflusher = NULL;
+CCoinsRunningStats coinsStatsTip;
 CCoinsViewCache* pcoinsTip = NULL;
 CBlockTreeDB* pblocktree = NULL;
 CZerocoinDB* zerocoinDB = NULL;
@@ -837,11 +855,11 @@ int GetInputAge(CTxIn& vin)
         CCoinsViewMemPool viewMempool(pcoinsTip, mempool);
         view.SetBackend(viewMempool); // temporarily switch cache backend to db+mempool view
 
-        const CCoins* coins = view.AccessCoins(vin.prevout.hash);
+        const Coin& coin = view.AccessCoin(vin.prevout);
 
-        if (coins) {
-            if (coins->nHeight < 0) return 0;
-            return (chainActive.Tip()->nHeight + 1) - coins->nHeight;
+        if (!coin.IsSpent()) {
+            if (coin.nHeight < 0) return 0;
+            return (chainActive.Tip()->nHeight + 1) - coin.nHeight;
         } else
             return -1;
     }
@@ -996,7 +1014,7 @@ bool ContextualCheckZerocoinSpend(const CTransaction& tx, const CoinSpend& spend
     return true;
 }
 
-bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state)
+bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvChecks)
 {
     //max needed non-mint outputs should be 2 - one for redemption address and a possible 2nd for change
     if (tx.vout.size() > 2) {
@@ -1021,7 +1039,8 @@ bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidati
     set<CBigNum> serials;
     list<CoinSpend> vSpends;
     CAmount nTotalRedeemed = 0;
-    for (const CTxIn& txin : tx.vin) {
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        const CTxIn& txin = tx.vin[i];
 
         //only check txin that is a zcspend
         if (!txin.scriptSig.IsZerocoinSpend())
@@ -1051,12 +1070,19 @@ bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidati
                 return state.DoS(100, error("%s: Zerocoinspend could not find accumulator associated with checksum %s", __func__, HexStr(BEGIN(nChecksum), END(nChecksum))));
             }
 
-            Accumulator accumulator(Params().Zerocoin_Params(chainActive.Height() < Params().Zerocoin_Block_V2_Start()),
-                                    newSpend.getDenomination(), bnAccumulatorValue);
-
-            //Check that the coin has been accumulated
-            if(!newSpend.Verify(accumulator))
+            //Check that the coin has been accumulated, unless this spend was already
+            //verified against the same accumulator, e.g. when it entered the mempool
+            uint256 hashSpend = GetZerocoinSpendCacheHash(txin);
+            if (!IsZerocoinSpendVerified(hashSpend, newSpend.getAccumulatorChecksum())) {
+                CZerocoinSpendCheck check(tx, i, Params().Zerocoin_Params(chainActive.Height() < Params().Zerocoin_Block_V2_Start()),
+                                          bnAccumulatorValue, hashSpend);
+                if (pvChecks) {
+                    pvChecks->push_back(CZerocoinSpendCheck());
+                    check.swap(pvChecks->back());
+                } else if (!check()) {
                     return state.DoS(100, error("CheckZerocoinSpend(): zerocoin spend did not verify"));
+                }
+            }
         }
 
         if (serials.count(newSpend.getCoinSerialNumber()))
@@ -1076,7 +1102,7 @@ bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidati
     return fValidated;
 }
 
-bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state)
+bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvChecks)
 {
     // Basic checks that don't depend on any context
     if (tx.vin.empty())
@@ -1132,7 +1158,7 @@ bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fReject
 
             // Do not require signature verification if this is initial sync and a block over 24 hours old
             bool fVerifySignature = !IsInitialBlockDownload() && (GetTime() - chainActive.Tip()->GetBlockTime() < (60*60*24));
-            if (!CheckZerocoinSpend(tx, fVerifySignature, state))
+            if (!CheckZerocoinSpend(tx, fVerifySignature, state, pvChecks))
                 return state.DoS(100, error("CheckTransaction() : invalid zerocoin spend"));
         }
     }
@@ -1315,15 +1341,16 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
             CCoinsViewMemPool viewMemPool(pcoinsTip, pool);
             view.SetBackend(viewMemPool);
 
-            // do we already have it?
-            if (view.HaveCoins(hash))
-                return false;
-
             // do all inputs exist?
-            // Note that this does not check for the presence of actual outputs (see the next check for that),
-            // only helps filling in pfMissingInputs (to determine missing vs spent).
             for (const CTxIn txin : tx.vin) {
-                if (!view.HaveCoins(txin.prevout.hash)) {
+                if (!view.HaveCoin(txin.prevout)) {
+                    // Are inputs missing because we already have the tx?
+                    for (size_t out = 0; out < tx.vout.size(); out++) {
+                        // Optimistically just do efficient check of cache for outputs
+                        if (pcoinsTip->HaveCoinInCache(COutPoint(hash, out)))
+                            return false;
+                    }
+                    // Otherwise assume this might be an orphan tx for which we just haven't seen parents yet
                     if (pfMissingInputs)
                         *pfMissingInputs = true;
                     return false;
@@ -1560,15 +1587,16 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
             CCoinsViewMemPool viewMemPool(pcoinsTip, pool);
             view.SetBackend(viewMemPool);
 
-            // do we already have it?
-            if (view.HaveCoins(hash))
-                return false;
-
             // do all inputs exist?
-            // Note that this does not check for the presence of actual outputs (see the next check for that),
-            // only helps filling in pfMissingInputs (to determine missing vs spent).
             for (const CTxIn txin : tx.vin) {
-                if (!view.HaveCoins(txin.prevout.hash)) {
+                if (!view.HaveCoin(txin.prevout)) {
+                    // Are inputs missing because we already have the tx?
+                    for (size_t out = 0; out < tx.vout.size(); out++) {
+                        // Optimistically just do efficient check of cache for outputs
+                        if (pcoinsTip->HaveCoinInCache(COutPoint(hash, out)))
+                            return false;
+                    }
+                    // Otherwise assume this might be an orphan tx for which we just haven't seen parents yet
                     if (pfMissingInputs)
                         *pfMissingInputs = true;
                     return false;
@@ -1769,15 +1797,9 @@ bool AcceptableFundamentalTxn(CTxMemPool& pool, CValidationState& state, const C
             CCoinsViewMemPool viewMemPool(pcoinsTip, pool);
             view.SetBackend(viewMemPool);
 
-            // do we already have it?
-            if (view.HaveCoins(hash))
-                return false;
-
             // do all inputs exist?
-            // Note that this does not check for the presence of actual outputs (see the next check for that),
-            // only helps filling in pfMissingInputs (to determine missing vs spent).
             for (const CTxIn txin : tx.vin) {
-                if (!view.HaveCoins(txin.prevout.hash)) {
+                if (!view.HaveCoin(txin.prevout)) {
                     /*if (pfMissingInputs)
                         *pfMissingInputs = true;*/
                     return false;
@@ -1847,9 +1869,9 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
             }
         }
 
-        if (fTxIndex) {
+        if (ptxindex) {
             CDiskTxPos postx;
-            if (pblocktree->ReadTxIndex(hash, postx)) {
+            if (ptxindex->FindTx(hash, postx)) {
                 CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
                 if (file.IsNull())
                     return error("%s: OpenBlockFile failed", __func__);
@@ -1868,16 +1890,17 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
             }
 
             // transaction not found in the index, nothing more can be done
-            return false;
+            if (ptxindex->IsSynced())
+                return false;
+            // the index is still catching up, so look further as if there were none
         }
 
         if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
             int nHeight = -1;
             {
-                CCoinsViewCache& view = *pcoinsTip;
-                const CCoins* coins = view.AccessCoins(hash);
-                if (coins)
-                    nHeight = coins->nHeight;
+                const Coin& coin = AccessByTxid(*pcoinsTip, hash);
+                if (!coin.IsSpent())
+                    nHeight = coin.nHeight;
             }
             if (nHeight > 0)
                 pindexSlow = chainActive[nHeight];
@@ -1885,9 +1908,9 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
     }
 
     if (pindexSlow) {
-        CBlock block;
-        if (ReadBlockFromDisk(block, pindexSlow)) {
-            BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+        std::shared_ptr<const CBlock> pblock;
+        if (ReadBlockFromDisk(pblock, pindexSlow)) {
+            BOOST_FOREACH (const CTransaction& tx, pblock->vtx) {
                 if (tx.GetHash() == hash) {
                     txOut = tx;
                     hashBlock = pindexSlow->GetBlockHash();
@@ -1900,6 +1923,31 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
     return false;
 }
 
+bool GetAddressIndex(const uint160& hashAddress, int nAddressType, std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries, int nStart, int nEnd)
+{
+    if (!fAddressIndex)
+        return error("%s : address index not enabled", __func__);
+    if (!pblocktree->ReadAddressIndex(nAddressType, hashAddress, vEntries, nStart, nEnd))
+        return error("%s : unable to get txids for address", __func__);
+    return true;
+}
+
+bool GetAddressUnspent(const uint160& hashAddress, int nAddressType, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vEntries)
+{
+    if (!fAddressIndex)
+        return error("%s : address index not enabled", __func__);
+    if (!pblocktree->ReadAddressUnspentIndex(nAddressType, hashAddress, vEntries))
+        return error("%s : unable to get unspent outputs for address", __func__);
+    return true;
+}
+
+bool GetSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    if (!fSpentIndex)
+        return false;
+    return pblocktree->ReadSpentIndex(key, value);
+}
+
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -1927,20 +1975,128 @@ bool WriteBlockToDisk(CBlock& block, CDiskBlockPos& pos)
     return true;
 }
 
+namespace
+{
+/**
+ * Memory mappings of block and undo files that are no longer appended to, most recently
+ * used first. A file stays mapped until the last reader of an evicted mapping is done.
+ */
+class CBlockFileMappings
+{
+private:
+    typedef std::pair<std::string, int> FileKey;
+    typedef std::list<std::pair<FileKey, std::shared_ptr<const CMappedFile> > > MappingList;
+
+    CCriticalSection cs;
+    MappingList listMappings;
+
+public:
+    std::shared_ptr<const CMappedFile> Get(const CDiskBlockPos& pos, const char* prefix)
+    {
+        LOCK(cs);
+        const FileKey key(prefix, pos.nFile);
+        for (MappingList::iterator it = listMappings.begin(); it != listMappings.end(); ++it) {
+            if (it->first != key)
+                continue;
+            if (pos.nPos < it->second->size()) {
+                listMappings.splice(listMappings.begin(), listMappings, it);
+                return it->second;
+            }
+            // The file has grown since it was mapped
+            listMappings.erase(it);
+            break;
+        }
+
+        std::shared_ptr<const CMappedFile> pfile = CMappedFile::Open(GetBlockPosFilename(pos, prefix));
+        if (!pfile || pos.nPos >= pfile->size())
+            return std::shared_ptr<const CMappedFile>();
+        listMappings.push_front(std::make_pair(key, pfile));
+        while (listMappings.size() > MAX_MAPPED_BLOCK_FILES)
+            listMappings.pop_back();
+        return pfile;
+    }
+
+    void Remove(int nFile, const char* prefix)
+    {
+        LOCK(cs);
+        const FileKey key(prefix, nFile);
+        for (MappingList::iterator it = listMappings.begin(); it != listMappings.end(); ++it) {
+            if (it->first == key) {
+                listMappings.erase(it);
+                return;
+            }
+        }
+    }
+};
+
+CBlockFileMappings blockFileMappings;
+}
+
+/** Return a mapping of the block or undo file at pos if the file is finalized, or null */
+static std::shared_ptr<const CMappedFile> MapFinalizedBlockFile(const CDiskBlockPos& pos, const char* prefix)
+{
+    // Keeping files of up to 128 MiB mapped does not fit in a 32 bit address space
+    if (sizeof(void*) < 8)
+        return std::shared_ptr<const CMappedFile>();
+    {
+        LOCK(cs_LastBlockFile);
+        if (pos.nFile >= nLastBlockFile)
+            return std::shared_ptr<const CMappedFile>();
+    }
+    return blockFileMappings.Get(pos, prefix);
+}
+
+/**
+ * Find a record that was written at pos behind the message start and its size, in a
+ * mapped file. The nTrailer bytes that follow the record are included in the range.
+ */
+static bool GetMappedRecord(const CMappedFile& file, const CDiskBlockPos& pos, unsigned int nTrailer, const char*& pbegin, const char*& pend)
+{
+    const unsigned int nHeaderSize = MESSAGE_START_SIZE + sizeof(unsigned int);
+    if (pos.nPos < nHeaderSize || pos.nPos > file.size())
+        return false;
+
+    MessageStartChars pchMessageStart;
+    unsigned int nSize;
+    CSpanReader header(file.data() + pos.nPos - nHeaderSize, file.data() + pos.nPos, SER_DISK, CLIENT_VERSION);
+    header >> FLATDATA(pchMessageStart) >> nSize;
+    if (memcmp(pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE) != 0)
+        return false;
+    if ((uint64_t)nSize + nTrailer > file.size() - pos.nPos)
+        return false;
+
+    pbegin = file.data() + pos.nPos;
+    pend = pbegin + nSize + nTrailer;
+    return true;
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk : OpenBlockFile failed");
+    // Blocks in finalized files are deserialized straight from a memory mapping
+    std::shared_ptr<const CMappedFile> pfile = MapFinalizedBlockFile(pos, "blk");
+    const char* pbegin;
+    const char* pend;
+    if (pfile && GetMappedRecord(*pfile, pos, 0, pbegin, pend)) {
+        try {
+            CSpanReader reader(pbegin, pend, SER_DISK, CLIENT_VERSION);
+            reader >> block;
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize error - %s", __func__, e.what());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk : OpenBlockFile failed");
 
-    // Read block
-    try {
-        filein >> block;
-    } catch (const std::exception& e) {
-        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        // Read block
+        try {
+            filein >> block;
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
     }
 
     // Check the header
@@ -1954,12 +2110,76 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
 
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
 {
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos()))
+    std::shared_ptr<const CBlock> pblock;
+    if (!ReadBlockFromDisk(pblock, pindex)) {
+        block.SetNull();
+        return false;
+    }
+    block = *pblock;
+    return true;
+}
+
+bool ReadBlockFromDisk(std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex)
+{
+    const uint256 hash = pindex->GetBlockHash();
+    pblock = blockCache.Get(hash);
+    if (pblock)
+        return true;
+
+    std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+    if (!ReadBlockFromDisk(*pblockRead, pindex->GetBlockPos()))
         return false;
-    if (block.GetHash() != pindex->GetBlockHash()) {
-        LogPrintf("%s : block=%s index=%s\n", __func__, block.GetHash().ToString().c_str(), pindex->GetBlockHash().ToString().c_str());
+    if (pblockRead->GetHash() != hash) {
+        LogPrintf("%s : block=%s index=%s\n", __func__, pblockRead->GetHash().ToString().c_str(), hash.ToString().c_str());
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*) : GetHash() doesn't match index");
     }
+    pblock = pblockRead;
+    blockCache.Put(hash, pblock);
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::shared_ptr<const CDataStream>& pdata, const CBlockIndex* pindex)
+{
+    const uint256 hash = pindex->GetBlockHash();
+    pdata = blockCache.GetRaw(hash);
+    if (pdata)
+        return true;
+
+    std::shared_ptr<const CMappedFile> pfile = MapFinalizedBlockFile(pindex->GetBlockPos(), "blk");
+    const char* pbegin;
+    const char* pend;
+    if (pfile && GetMappedRecord(*pfile, pindex->GetBlockPos(), 0, pbegin, pend)) {
+        pdata = std::make_shared<CDataStream>(pbegin, pend, SER_NETWORK, PROTOCOL_VERSION);
+        blockCache.PutRaw(hash, pdata);
+        return true;
+    }
+
+    // Start at the message start and size that WriteBlockToDisk puts in front of the block
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    if (pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("%s : invalid position of block %s", __func__, hash.ToString());
+    pos.nPos -= MESSAGE_START_SIZE + sizeof(unsigned int);
+
+    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s : OpenBlockFile failed", __func__);
+
+    std::shared_ptr<CDataStream> pdataRead(new CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+    try {
+        MessageStartChars pchMessageStart;
+        unsigned int nSize;
+        filein >> FLATDATA(pchMessageStart) >> nSize;
+        if (memcmp(pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE) != 0)
+            return error("%s : block %s does not start with the message start", __func__, hash.ToString());
+        if (nSize > MAX_BLOCK_SIZE_CURRENT)
+            return error("%s : block %s has an invalid size %u", __func__, hash.ToString(), nSize);
+        pdataRead->resize(nSize);
+        filein.read(&(*pdataRead)[0], nSize);
+    } catch (const std::exception& e) {
+        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+    pdata = pdataRead;
+    blockCache.PutRaw(hash, pdata);
     return true;
 }
 
@@ -2308,6 +2528,28 @@ bool IsInitialBlockDownload()
     return state;
 }
 
+/**
+ * Whether the block with the given hash, on top of pindexPrev, is the -assumevalid
+ * block or one of its ancestors. Once the assumed valid block is in mapBlockIndex
+ * this is decided by its ancestry. Before that it can only be decided by height,
+ * which is possible when the assumed valid block is also a checkpoint.
+ */
+static bool IsBlockAssumedValid(const CBlockIndex* pindexPrev, const uint256& hashBlock)
+{
+    AssertLockHeld(cs_main);
+    if (hashAssumeValid == 0 || pindexPrev == NULL)
+        return false;
+    if (hashBlock == hashAssumeValid)
+        return true;
+
+    const int nHeight = pindexPrev->nHeight + 1;
+    BlockMap::const_iterator it = mapBlockIndex.find(hashAssumeValid);
+    if (it != mapBlockIndex.end() && it->second)
+        return it->second->nHeight > nHeight && it->second->GetAncestor(nHeight - 1) == pindexPrev;
+
+    return nHeight < Checkpoints::GetCheckpointHeight(hashAssumeValid);
+}
+
 bool fLargeWorkForkFound = false;
 bool fLargeWorkInvalidChainFound = false;
 CBlockIndex *pindexBestForkTip = NULL, *pindexBestForkBase = NULL;
@@ -2441,14 +2683,14 @@ void UpdateCoins(const CTransaction& tx, CValidationState& state, CCoinsViewCach
     if (!tx.IsCoinBase() && !tx.IsZerocoinSpend()) {
         txundo.vprevout.reserve(tx.vin.size());
         BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-            txundo.vprevout.push_back(CTxInUndo());
-            bool ret = inputs.ModifyCoins(txin.prevout.hash)->Spend(txin.prevout, txundo.vprevout.back());
-            assert(ret);
+            txundo.vprevout.push_back(Coin());
+            bool is_spent = inputs.SpendCoin(txin.prevout, &txundo.vprevout.back());
+            assert(is_spent);
         }
     }
 
     // add outputs
-    inputs.ModifyCoins(tx.GetHash())->FromTx(tx, nHeight);
+    AddCoins(inputs, tx, nHeight);
 }
 
 bool CScriptCheck::operator()()
@@ -2460,6 +2702,101 @@ bool CScriptCheck::operator()()
     return true;
 }
 
+bool CZerocoinSpendCheck::operator()()
+{
+    std::vector<CoinSpend> vSpends;
+    vSpends.reserve(vIn.size());
+    for (unsigned int i = 0; i < vIn.size(); i++)
+        vSpends.push_back(TxInToZerocoinSpend(vTxTo[i]->vin[vIn[i]]));
+
+    // Merged checks only hold spends of a single denomination
+    Accumulator accumulator(params, vSpends[0].getDenomination(), bnAccumulatorValue);
+    std::vector<bool> vValid;
+    if (vSpends.size() == 1) {
+        vValid.assign(1, vSpends[0].Verify(accumulator));
+    } else {
+        std::vector<const CoinSpend*> vpSpends;
+        for (const CoinSpend& spend : vSpends)
+            vpSpends.push_back(&spend);
+        CoinSpend::BatchVerify(vpSpends, accumulator, vValid);
+    }
+
+    bool fValid = true;
+    for (unsigned int i = 0; i < vSpends.size(); i++) {
+        if (!vValid[i]) {
+            fValid = ::error("CZerocoinSpendCheck(): %s:%d zerocoin spend did not verify", vTxTo[i]->GetHash().ToString(), vIn[i]);
+            continue;
+        }
+        SetZerocoinSpendVerified(vHashSpend[i], vSpends[i].getAccumulatorChecksum());
+    }
+    return fValid;
+}
+
+bool CValidationCheck::operator()()
+{
+    if (!fZerocoin)
+        return scriptCheck();
+
+    // The other -par threads are verifying checks of their own, so a single spend's proof
+    // iterations stay on this thread. Merged checks still spread over the proof threads.
+    if (zerocoinCheck.size() == 1) {
+        libzerocoin::SequentialProofScope sequential;
+        return zerocoinCheck();
+    }
+    return zerocoinCheck();
+}
+
+bool CZerocoinSpendCheck::SameAccumulator(const CZerocoinSpendCheck& check) const
+{
+    // The denomination of a spend is enforced to match its nSequence
+    return params == check.params && bnAccumulatorValue == check.bnAccumulatorValue &&
+           vTxTo[0]->vin[vIn[0]].nSequence == check.vTxTo[0]->vin[check.vIn[0]].nSequence;
+}
+
+void CZerocoinSpendCheck::Merge(CZerocoinSpendCheck& check)
+{
+    vTxTo.insert(vTxTo.end(), check.vTxTo.begin(), check.vTxTo.end());
+    vIn.insert(vIn.end(), check.vIn.begin(), check.vIn.end());
+    vHashSpend.insert(vHashSpend.end(), check.vHashSpend.begin(), check.vHashSpend.end());
+    check.vTxTo.clear();
+    check.vIn.clear();
+    check.vHashSpend.clear();
+}
+
+void BatchZerocoinSpendChecks(std::vector<CZerocoinSpendCheck>& vChecks)
+{
+    // Smaller groups are better spread over the script check threads one by one
+    if (!libzerocoin::FIXED_BASE_TABLES || vChecks.size() < ZEROCOIN_BATCH_TABLE_MIN_SPENDS)
+        return;
+
+    std::vector<std::vector<unsigned int> > vGroups;
+    for (unsigned int i = 0; i < vChecks.size(); i++) {
+        std::vector<std::vector<unsigned int> >::iterator it = vGroups.begin();
+        while (it != vGroups.end() && !vChecks[it->front()].SameAccumulator(vChecks[i]))
+            ++it;
+        if (it == vGroups.end())
+            vGroups.push_back(std::vector<unsigned int>(1, i));
+        else
+            it->push_back(i);
+    }
+
+    std::vector<CZerocoinSpendCheck> vBatched;
+    for (const std::vector<unsigned int>& group : vGroups) {
+        if (group.size() >= ZEROCOIN_BATCH_TABLE_MIN_SPENDS) {
+            for (unsigned int j = 1; j < group.size(); j++)
+                vChecks[group[0]].Merge(vChecks[group[j]]);
+            vBatched.push_back(CZerocoinSpendCheck());
+            vBatched.back().swap(vChecks[group[0]]);
+        } else {
+            for (unsigned int i : group) {
+                vBatched.push_back(CZerocoinSpendCheck());
+                vBatched.back().swap(vChecks[i]);
+            }
+        }
+    }
+    vChecks.swap(vBatched);
+}
+
 CBitcoinAddress addressExp1("DQZzqnSR6PXxagep1byLiRg9ZurCZ5KieQ");
 CBitcoinAddress addressExp2("DTQYdnNqKuEHXyNeeYhPQGGGdqHbXYwjpj");
 
@@ -2520,14 +2857,10 @@ CAmount GetInvalidUTXOValue()
 {
     CAmount nValue = 0;
     for (auto out : invalid_out::setInvalidOutPoints) {
-        bool fSpent = false;
         CCoinsViewCache cache(pcoinsTip);
-        const CCoins *coins = cache.AccessCoins(out.hash);
-        if(!coins || !coins->IsAvailable(out.n))
-            fSpent = true;
-
-        if (!fSpent)
-            nValue += coins->vout[out.n].nValue;
+        const Coin& coin = cache.AccessCoin(out);
+        if (!coin.IsSpent())
+            nValue += coin.out.nValue;
     }
 
     return nValue;
@@ -2552,20 +2885,20 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
         CAmount nFees = 0;
         for (unsigned int i = 0; i < tx.vin.size(); i++) {
             const COutPoint& prevout = tx.vin[i].prevout;
-            const CCoins* coins = inputs.AccessCoins(prevout.hash);
-            assert(coins);
+            const Coin& coin = inputs.AccessCoin(prevout);
+            assert(!coin.IsSpent());
 
             // If prev is coinbase, check that it's matured
-            if (coins->IsCoinBase() || coins->IsCoinStake()) {
-                if (nSpendHeight - coins->nHeight < Params().COINBASE_MATURITY())
+            if (coin.IsCoinBase() || coin.IsCoinStake()) {
+                if (nSpendHeight - coin.nHeight < Params().COINBASE_MATURITY())
                     return state.Invalid(
-                        error("CheckInputs() : tried to spend coinbase at depth %d, coinstake=%d", nSpendHeight - coins->nHeight, coins->IsCoinStake()),
+                        error("CheckInputs() : tried to spend coinbase at depth %d, coinstake=%d", nSpendHeight - coin.nHeight, coin.IsCoinStake()),
                         REJECT_INVALID, "bad-txns-premature-spend-of-coinbase");
             }
 
             // Check for negative or overflow input values
-            nValueIn += coins->vout[prevout.n].nValue;
-            if (!MoneyRange(coins->vout[prevout.n].nValue) || !MoneyRange(nValueIn))
+            nValueIn += coin.out.nValue;
+            if (!MoneyRange(coin.out.nValue) || !MoneyRange(nValueIn))
                 return state.DoS(100, error("CheckInputs() : txin values out of range"),
                     REJECT_INVALID, "bad-txns-inputvalues-outofrange");
         }
@@ -2599,11 +2932,11 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
         if (fScriptChecks) {
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint& prevout = tx.vin[i].prevout;
-                const CCoins* coins = inputs.AccessCoins(prevout.hash);
-                assert(coins);
+                const Coin& coin = inputs.AccessCoin(prevout);
+                assert(!coin.IsSpent());
 
                 // Verify signature
-                CScriptCheck check(*coins, tx, i, flags, cacheStore);
+                CScriptCheck check(coin.out, tx, i, flags, cacheStore);
                 if (pvChecks) {
                     pvChecks->push_back(CScriptCheck());
                     check.swap(pvChecks->back());
@@ -2615,7 +2948,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
                         // arguments; if so, don't trigger DoS protection to
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
-                        CScriptCheck check(*coins, tx, i,
+                        CScriptCheck check(coin.out, tx, i,
                             flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore);
                         if (check())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
@@ -2636,7 +2969,94 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
     return true;
 }
 
-bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
+/**
+ * Find a transaction with zerocoin mints in pindex or its ancestors without the transaction
+ * index, by reading the blocks that have mints. Fails at a block that was pruned.
+ */
+static bool FindMintTransaction(const uint256& hashTx, const CBlockIndex* pindex, CTransaction& tx, const CBlockIndex*& pindexTx)
+{
+    for (; pindex; pindex = pindex->pprev) {
+        bool fMints = false;
+        for (auto denom : libzerocoin::zerocoinDenomList)
+            fMints = fMints || pindex->MintedDenomination(denom);
+        if (!fMints)
+            continue;
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+            return error("%s : block %d is pruned", __func__, pindex->nHeight);
+
+        // Old blocks are read past the block cache, which is meant for blocks in use
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex->GetBlockPos()))
+            return error("%s : failed to read block %d", __func__, pindex->nHeight);
+        for (const CTransaction& txBlock : block.vtx) {
+            if (txBlock.GetHash() == hashTx) {
+                tx = txBlock;
+                pindexTx = pindex;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Recover the metadata of a coin spent by pindex from the transaction that created it.
+ * Undo records written before the chainstate upgrade leave it out when the creating
+ * transaction still had zerocoin mint outputs, which are no longer in the UTXO set.
+ */
+static bool RecoverTxInUndoMetadata(Coin& coin, const COutPoint& out, const CBlockIndex* pindex)
+{
+    CTransaction txPrev;
+    const CBlockIndex* pindexPrev = NULL;
+    uint256 hashBlock = 0;
+    if (GetTransaction(out.hash, txPrev, hashBlock, true) && hashBlock != 0) {
+        // The creating block must be on the chain being disconnected, not on some other branch
+        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+        if (mi != mapBlockIndex.end() && mi->second->nHeight <= pindex->nHeight &&
+            pindex->GetAncestor(mi->second->nHeight) == mi->second)
+            pindexPrev = mi->second;
+    }
+    // Without -txindex, as in prune mode, look through the blocks with mints
+    if (!pindexPrev && !FindMintTransaction(out.hash, pindex, txPrev, pindexPrev))
+        return error("%s : transaction %s not found, its blocks are needed or -txindex", __func__, out.hash.GetHex());
+    if (out.n >= txPrev.vout.size() || txPrev.vout[out.n] != coin.out)
+        return false;
+
+    coin.nHeight = pindexPrev->nHeight;
+    coin.fCoinBase = txPrev.IsCoinBase();
+    coin.fCoinStake = txPrev.IsCoinStake();
+    return true;
+}
+
+/**
+ * Restore the UTXO in a Coin at a given COutPoint, spent by the block pindex.
+ * Sets fClean to false if the restored output overwrote an existing one.
+ * Returns false if the coin's metadata could not be recovered.
+ */
+static bool ApplyTxInUndo(const Coin& undo, CCoinsViewCache& view, const COutPoint& out, const CBlockIndex* pindex, bool& fClean)
+{
+    Coin coin = undo;
+    if (view.HaveCoin(out))
+        fClean = fClean && error("DisconnectBlock() : undo data overwriting existing output");
+    if (coin.nHeight == 0) {
+        // Missing undo metadata (height, coinbase and coinstake). Older versions included this
+        // information only in undo records for the last spend of a transaction's
+        // outputs. This implies that it must be present for some other output of the same tx,
+        // unless those are zerocoin mints, which the upgraded chainstate leaves out.
+        const Coin& alternate = AccessByTxid(view, out.hash);
+        if (!alternate.IsSpent()) {
+            coin.nHeight = alternate.nHeight;
+            coin.fCoinBase = alternate.fCoinBase;
+            coin.fCoinStake = alternate.fCoinStake;
+        } else if (!RecoverTxInUndoMetadata(coin, out, pindex)) {
+            return false;
+        }
+    }
+    view.AddCoin(out, coin, true);
+    return true;
+}
+
+bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean, CCoinsRunningStats* pstats)
 {
     if (pindex->GetBlockHash() != view.GetBestBlock())
         LogPrintf("%s : pindex=%s view=%s\n", __func__, pindex->GetBlockHash().GetHex(), view.GetBestBlock().GetHex());
@@ -2657,6 +3077,16 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
     if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
         return error("DisconnectBlock() : block and undo data inconsistent");
 
+    // The running UTXO set statistics are only updated if they describe the view's state
+    bool fTrackStats = pstats && pstats->hashBlock == pindex->GetBlockHash();
+    CCoinsRunningStats statsBlock;
+    if (fTrackStats)
+        statsBlock = *pstats;
+
+    // Only a block leaving the active chain is taken out of the indexes, not one disconnected to verify it
+    const bool fUpdateIndexes = !pfClean && !fVerifyingBlocks;
+    CAddressIndexUpdate addressUpdate(fUpdateIndexes && fAddressIndex, fUpdateIndexes && fSpentIndex);
+
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction& tx = block.vtx[i];
@@ -2705,25 +3135,21 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
         uint256 hash = tx.GetHash();
 
         // Check that all outputs are available and match the outputs in the block itself
-        // exactly. Note that transactions with only provably unspendable outputs won't
-        // have outputs available even in the block itself, so we handle that case
-        // specially with outsEmpty.
-        {
-            CCoins outsEmpty;
-            CCoinsModifier outs = view.ModifyCoins(hash);
-            outs->ClearUnspendable();
-
-            CCoins outsBlock(tx, pindex->nHeight);
-            // The CCoins serialization does not serialize negative numbers.
-            // No network rules currently depend on the version here, so an inconsistency is harmless
-            // but it must be corrected before txout nversion ever influences a network rule.
-            if (outsBlock.nVersion < 0)
-                outs->nVersion = outsBlock.nVersion;
-            if (*outs != outsBlock)
+        // exactly.
+        bool fCoinBase = tx.IsCoinBase();
+        bool fCoinStake = tx.IsCoinStake();
+        for (size_t o = 0; o < tx.vout.size(); o++) {
+            const CTxOut& txout = tx.vout[o];
+            if (!IsUTXOSetOutput(txout))
+                continue;
+            COutPoint out(hash, o);
+            Coin coin;
+            bool is_spent = view.SpendCoin(out, &coin);
+            if (!is_spent || txout != coin.out || pindex->nHeight != coin.nHeight ||
+                fCoinBase != coin.fCoinBase || fCoinStake != coin.fCoinStake)
                 fClean = fClean && error("DisconnectBlock() : added transaction mismatch? database corrupted");
-
-            // remove outputs
-            outs->Clear();
+            if (is_spent && fTrackStats)
+                statsBlock.RemoveCoin(out, coin);
         }
 
         // restore inputs
@@ -2733,32 +3159,33 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
                 return error("DisconnectBlock() : transaction and undo data inconsistent - txundo.vprevout.siz=%d tx.vin.siz=%d", txundo.vprevout.size(), tx.vin.size());
             for (unsigned int j = tx.vin.size(); j-- > 0;) {
                 const COutPoint& out = tx.vin[j].prevout;
-                const CTxInUndo& undo = txundo.vprevout[j];
-                CCoinsModifier coins = view.ModifyCoins(out.hash);
-                if (undo.nHeight != 0) {
-                    // undo data contains height: this is the last output of the prevout tx being spent
-                    if (!coins->IsPruned())
-                        fClean = fClean && error("DisconnectBlock() : undo data overwriting existing transaction");
-                    coins->Clear();
-                    coins->fCoinBase = undo.fCoinBase;
-                    coins->nHeight = undo.nHeight;
-                    coins->nVersion = undo.nVersion;
-                } else {
-                    if (coins->IsPruned())
-                        fClean = fClean && error("DisconnectBlock() : undo data adding output to missing transaction");
-                }
-                if (coins->IsAvailable(out.n))
-                    fClean = fClean && error("DisconnectBlock() : undo data overwriting existing output");
-                if (coins->vout.size() < out.n + 1)
-                    coins->vout.resize(out.n + 1);
-                coins->vout[out.n] = undo.txout;
+                if (!ApplyTxInUndo(txundo.vprevout[j], view, out, pindex, fClean))
+                    return error("DisconnectBlock() : undo data for %s is missing its coin metadata", out.ToString());
+                if (fTrackStats)
+                    statsBlock.AddCoin(out, view.AccessCoin(out));
 
                 // erase the spent input
                 mapStakeSpent.erase(out);
             }
         }
+
+        if (addressUpdate.fAddressIndex || addressUpdate.fSpentIndex) {
+            // The restored coins, with the metadata that older undo records leave out
+            std::vector<Coin> vSpent;
+            if (!tx.IsCoinBase() && !tx.IsZerocoinSpend()) {
+                for (const CTxIn& txin : tx.vin)
+                    vSpent.push_back(view.AccessCoin(txin.prevout));
+            }
+            addressUpdate.AddTransaction(tx, i, pindex->nHeight, &vSpent, false);
+        }
     }
 
+    if (!addressUpdate.IsEmpty() && !pblocktree->WriteAddressIndexUpdate(addressUpdate))
+        return error("DisconnectBlock(): failed to write address index");
+
+    if (!pindex->GetMintDenominations().empty() && !zerocoinDB->EraseBlockPubcoins(pindex->nHeight))
+        return error("DisconnectBlock(): failed to erase block pubcoins");
+
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
@@ -2771,6 +3198,11 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
         }
     }
 
+    if (fTrackStats && (pfClean || fClean)) {
+        statsBlock.hashBlock = pindex->pprev->GetBlockHash();
+        *pstats = statsBlock;
+    }
+
     if (pfClean) {
         *pfClean = fClean;
         return true;
@@ -2804,7 +3236,7 @@ void static FlushBlockFile(bool fFinalize = false)
 
 bool FindUndoPos(CValidationState& state, int nFile, CDiskBlockPos& pos, unsigned int nAddSize);
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+static CCheckQueue<CValidationCheck> scriptcheckqueue(128);
 
 void ThreadScriptCheck()
 {
@@ -2812,135 +3244,169 @@ void ThreadScriptCheck()
     scriptcheckqueue.Thread();
 }
 
-void RecalculateZVITMinted()
+/** Hand a batch of script or zerocoin spend checks over to the -par worker threads. */
+template <typename C>
+static void QueueChecks(CCheckQueueControl<CValidationCheck>& control, std::vector<C>& vChecks)
 {
-    CBlockIndex *pindex = chainActive[Params().Zerocoin_StartHeight()];
-    int nHeightEnd = chainActive.Height();
-    while (true) {
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
-
-        //overwrite possibly wrong vMintsInBlock data
-        CBlock block;
-        assert(ReadBlockFromDisk(block, pindex));
-
-        std::list<CZerocoinMint> listMints;
-        BlockToZerocoinMintList(block, listMints, true);
-
-        vector<libzerocoin::CoinDenomination> vDenomsBefore = pindex->vMintDenominationsInBlock;
-        pindex->vMintDenominationsInBlock.clear();
-        for (auto mint : listMints)
-            pindex->vMintDenominationsInBlock.emplace_back(mint.GetDenomination());
-
-        if (pindex->nHeight < nHeightEnd)
-            pindex = chainActive.Next(pindex);
-        else
-            break;
-    }
+    std::vector<CValidationCheck> vQueue;
+    vQueue.reserve(vChecks.size());
+    BOOST_FOREACH (C& check, vChecks)
+        vQueue.push_back(CValidationCheck(check));
+    control.Add(vQueue);
 }
 
-void RecalculateZVITSpent()
+namespace
 {
-    CBlockIndex* pindex = chainActive[Params().Zerocoin_StartHeight()];
-    while (true) {
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
-
-        //Rewrite zDIVIT supply
-        CBlock block;
-        assert(ReadBlockFromDisk(block, pindex));
+/** What a block changes in the money and zerocoin supply, computed by the workers of RecalculateSupply() */
+struct CSupplyDelta {
+    std::string strError;
+    CAmount nValueIn;
+    CAmount nValueOut;
+    std::vector<libzerocoin::CoinDenomination> vMints;
+    std::list<libzerocoin::CoinDenomination> listSpends;
+    //! Inputs missing from the undo data, looked up afterwards since GetTransaction takes cs_main
+    std::vector<COutPoint> vMissing;
+
+    CSupplyDelta() : nValueIn(0), nValueOut(0) {}
+};
 
-        list<libzerocoin::CoinDenomination> listDenomsSpent = ZerocoinSpendListFromBlock(block, true);
+void ComputeSupplyDelta(const CBlockIndex* pindex, bool fZerocoin, CSupplyDelta& delta)
+{
+    // Old blocks are read past the block cache, which is meant for blocks in use
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex->GetBlockPos()) || block.GetHash() != pindex->GetBlockHash()) {
+        delta.strError = strprintf("failed to read block %d", pindex->nHeight);
+        return;
+    }
 
-        //Reset the supply to previous block
-        pindex->mapZerocoinSupply = pindex->pprev->mapZerocoinSupply;
+    if (fZerocoin) {
+        std::list<CZerocoinMint> listMints;
+        BlockToZerocoinMintList(block, listMints, true);
+        for (const CZerocoinMint& mint : listMints)
+            delta.vMints.push_back(mint.GetDenomination());
+        delta.listSpends = ZerocoinSpendListFromBlock(block, true);
+    }
 
-        //Add mints to zDIVIT supply
-        for (auto denom : libzerocoin::zerocoinDenomList) {
-            long nDenomAdded = count(pindex->vMintDenominationsInBlock.begin(), pindex->vMintDenominationsInBlock.end(), denom);
-            pindex->mapZerocoinSupply.at(denom) += nDenomAdded;
+    // The coins a block spends are in its undo data, which saves looking up every previous transaction
+    CBlockUndo blockUndo;
+    CDiskBlockPos pos = pindex->GetUndoPos();
+    bool fUndo = pindex->pprev && !pos.IsNull() && blockUndo.ReadFromDisk(pos, pindex->pprev->GetBlockHash()) &&
+                 blockUndo.vtxundo.size() + 1 == block.vtx.size();
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = block.vtx[i];
+        if (!tx.IsCoinBase()) {
+            const CTxUndo* ptxundo = fUndo ? &blockUndo.vtxundo[i - 1] : NULL;
+            for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                if (tx.vin[j].scriptSig.IsZerocoinSpend()) {
+                    delta.nValueIn += tx.vin[j].nSequence * COIN;
+                    continue;
+                }
+                if (ptxundo && j < ptxundo->vprevout.size())
+                    delta.nValueIn += ptxundo->vprevout[j].out.nValue;
+                else
+                    delta.vMissing.push_back(tx.vin[j].prevout);
+            }
         }
 
-        //Remove spends from zDIVIT supply
-        for (auto denom : listDenomsSpent)
-            pindex->mapZerocoinSupply.at(denom)--;
-
-        //Rewrite money supply
-        assert(pblocktree->WriteBlockIndex(CDiskBlockIndex(pindex)));
+        for (unsigned int o = 0; o < tx.vout.size(); o++) {
+            if (o == 0 && tx.IsCoinStake())
+                continue;
 
-        if (pindex->nHeight < chainActive.Height())
-            pindex = chainActive.Next(pindex);
-        else
-            break;
+            delta.nValueOut += tx.vout[o].nValue;
+        }
     }
 }
+}
 
-bool RecalculateVITSupply(int nHeightStart)
+bool RecalculateSupply(int nHeightStart, bool fZerocoin)
 {
+    LOCK(cs_main);
     if (nHeightStart > chainActive.Height())
-        return false;
-
-    CBlockIndex* pindex = chainActive[nHeightStart];
-    CAmount nSupplyPrev = pindex->pprev->nMoneySupply;
-    if (nHeightStart == Params().Zerocoin_StartHeight())
-        nSupplyPrev = CAmount(649916627717750);
-
-    while (true) {
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
-
-        CBlock block;
-        assert(ReadBlockFromDisk(block, pindex));
+        return true;
 
-        CAmount nValueIn = 0;
-        CAmount nValueOut = 0;
-        for (const CTransaction tx : block.vtx) {
-            for (unsigned int i = 0; i < tx.vin.size(); i++) {
-                if (tx.IsCoinBase())
-                    break;
+    const int nHeightZerocoin = Params().Zerocoin_StartHeight();
+    // Like at startup, the script check threads are idle while blocks are not being connected
+    const int nThreads = std::max(nScriptCheckThreads, 1);
 
-                if (tx.vin[i].scriptSig.IsZerocoinSpend()) {
-                    nValueIn += tx.vin[i].nSequence * COIN;
-                    continue;
-                }
+    CAmount nSupplyPrev = chainActive[nHeightStart]->pprev->nMoneySupply;
+    if (nHeightStart == nHeightZerocoin)
+        nSupplyPrev = CAmount(649916627717750);
 
-                COutPoint prevout = tx.vin[i].prevout;
+    const int nHeightEnd = chainActive.Height();
+    for (int nHeightRange = nHeightStart; nHeightRange <= nHeightEnd; nHeightRange += RECALCULATE_SUPPLY_BATCH) {
+        std::vector<CBlockIndex*> vRange;
+        for (int nHeight = nHeightRange; nHeight <= nHeightEnd && nHeight < nHeightRange + RECALCULATE_SUPPLY_BATCH; nHeight++)
+            vRange.push_back(chainActive[nHeight]);
+
+        // Map: what each block adds and removes, independent of the blocks before it
+        std::vector<CSupplyDelta> vDeltas(vRange.size());
+        std::atomic<size_t> nNext(0);
+        auto worker = [&]() {
+            for (size_t i = nNext++; i < vRange.size(); i = nNext++)
+                ComputeSupplyDelta(vRange[i], fZerocoin && vRange[i]->nHeight >= nHeightZerocoin, vDeltas[i]);
+        };
+        boost::thread_group threads;
+        for (int i = 1; i < nThreads; i++)
+            threads.create_thread(worker);
+        worker();
+        threads.join_all();
+
+        // Reduce: sum up the changes in height order
+        for (unsigned int i = 0; i < vRange.size(); i++) {
+            CBlockIndex* pindex = vRange[i];
+            CSupplyDelta& delta = vDeltas[i];
+            if (pindex->nHeight % 1000 == 0)
+                LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
+
+            if (!delta.strError.empty())
+                return error("%s : %s", __func__, delta.strError);
+            for (const COutPoint& prevout : delta.vMissing) {
                 CTransaction txPrev;
                 uint256 hashBlock;
-                assert(GetTransaction(prevout.hash, txPrev, hashBlock, true));
-                nValueIn += txPrev.vout[prevout.n].nValue;
+                if (!GetTransaction(prevout.hash, txPrev, hashBlock, true) || prevout.n >= txPrev.vout.size())
+                    return error("%s : failed to find the output %s spent in block %d", __func__, prevout.ToString(), pindex->nHeight);
+                delta.nValueIn += txPrev.vout[prevout.n].nValue;
             }
 
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                if (i == 0 && tx.IsCoinStake())
-                    continue;
+            if (fZerocoin && pindex->nHeight >= nHeightZerocoin) {
+                //overwrite possibly wrong vMintsInBlock data
+                pindex->ClearMintDenominations();
+                for (auto denom : delta.vMints)
+                    pindex->AddMintDenomination(denom);
+                // The mint counts may have sampled the old denominations
+                mintCounts.Clear();
+
+                //Reset the supply to previous block
+                //Add mints to zDIVIT supply
+                for (auto denom : libzerocoin::zerocoinDenomList) {
+                    long nDenomAdded = pindex->GetMintDenominationCount(denom);
+                    pindex->SetZerocoinSupply(denom, pindex->pprev->GetZerocoinSupply(denom) + nDenomAdded);
+                }
 
-                nValueOut += tx.vout[i].nValue;
+                //Remove spends from zDIVIT supply
+                for (auto denom : delta.listSpends)
+                    pindex->SetZerocoinSupply(denom, pindex->GetZerocoinSupply(denom) - 1);
             }
-        }
 
-        // Rewrite money supply
-        pindex->nMoneySupply = nSupplyPrev + nValueOut - nValueIn;
-        nSupplyPrev = pindex->nMoneySupply;
+            // Rewrite money supply
+            pindex->nMoneySupply = nSupplyPrev + delta.nValueOut - delta.nValueIn;
+            nSupplyPrev = pindex->nMoneySupply;
 
-        // Add fraudulent funds to the supply and remove any recovered funds.
-        if (pindex->nHeight == Params().Zerocoin_Block_RecalculateAccumulators()) {
-            LogPrintf("%s : Original money supply=%s\n", __func__, FormatMoney(pindex->nMoneySupply));
+            // Add fraudulent funds to the supply and remove any recovered funds.
+            if (pindex->nHeight == Params().Zerocoin_Block_RecalculateAccumulators()) {
+                LogPrintf("%s : Original money supply=%s\n", __func__, FormatMoney(pindex->nMoneySupply));
 
-            pindex->nMoneySupply += Params().InvalidAmountFiltered();
-            LogPrintf("%s : Adding filtered funds to supply + %s : supply=%s\n", __func__, FormatMoney(Params().InvalidAmountFiltered()), FormatMoney(pindex->nMoneySupply));
+                pindex->nMoneySupply += Params().InvalidAmountFiltered();
+                LogPrintf("%s : Adding filtered funds to supply + %s : supply=%s\n", __func__, FormatMoney(Params().InvalidAmountFiltered()), FormatMoney(pindex->nMoneySupply));
 
-            CAmount nLocked = GetInvalidUTXOValue();
-            pindex->nMoneySupply -= nLocked;
-            LogPrintf("%s : Removing locked from supply - %s : supply=%s\n", __func__, FormatMoney(nLocked), FormatMoney(pindex->nMoneySupply));
+                CAmount nLocked = GetInvalidUTXOValue();
+                pindex->nMoneySupply -= nLocked;
+                LogPrintf("%s : Removing locked from supply - %s : supply=%s\n", __func__, FormatMoney(nLocked), FormatMoney(pindex->nMoneySupply));
+            }
         }
 
-        assert(pblocktree->WriteBlockIndex(CDiskBlockIndex(pindex)));
-
-        if (pindex->nHeight < chainActive.Height())
-            pindex = chainActive.Next(pindex);
-        else
-            break;
+        if (!pblocktree->WriteBlockIndexBatch(vRange))
+            return error("%s : failed to write the block index", __func__);
     }
     return true;
 }
@@ -3005,19 +3471,19 @@ bool UpdateZDIVITSupply(const CBlock& block, CBlockIndex* pindex)
     // Initialize zerocoin supply to the supply from previous block
     if (pindex->pprev && pindex->pprev->GetBlockHeader().nVersion > 3) {
         for (auto& denom : zerocoinDenomList) {
-            pindex->mapZerocoinSupply.at(denom) = pindex->pprev->mapZerocoinSupply.at(denom);
+            pindex->SetZerocoinSupply(denom, pindex->pprev->GetZerocoinSupply(denom));
         }
     }
 
     // Track zerocoin money supply
     CAmount nAmountZerocoinSpent = 0;
-    pindex->vMintDenominationsInBlock.clear();
+    pindex->ClearMintDenominations();
     if (pindex->pprev) {
         std::set<uint256> setAddedToWallet;
         for (auto& m : listMints) {
             libzerocoin::CoinDenomination denom = m.GetDenomination();
-            pindex->vMintDenominationsInBlock.push_back(m.GetDenomination());
-            pindex->mapZerocoinSupply.at(denom)++;
+            pindex->AddMintDenomination(denom);
+            pindex->SetZerocoinSupply(denom, pindex->GetZerocoinSupply(denom) + 1);
 
             //Remove any of our own mints from the mintpool
             if (pwalletMain) {
@@ -3042,17 +3508,17 @@ bool UpdateZDIVITSupply(const CBlock& block, CBlockIndex* pindex)
         }
 
         for (auto& denom : listSpends) {
-            pindex->mapZerocoinSupply.at(denom)--;
+            pindex->SetZerocoinSupply(denom, pindex->GetZerocoinSupply(denom) - 1);
             nAmountZerocoinSpent += libzerocoin::ZerocoinDenominationToAmount(denom);
 
             // zerocoin failsafe
-            if (pindex->mapZerocoinSupply.at(denom) < 0)
+            if (pindex->GetZerocoinSupply(denom) < 0)
                 return error("Block contains zerocoins that spend more than are in the available supply to spend");
         }
     }
 
     for (auto& denom : zerocoinDenomList)
-        LogPrint("zero", "%s coins for denomination %d pubcoin %s\n", __func__, denom, pindex->mapZerocoinSupply.at(denom));
+        LogPrint("zero", "%s coins for denomination %d pubcoin %s\n", __func__, denom, pindex->GetZerocoinSupply(denom));
 
     return true;
 }
@@ -3063,7 +3529,7 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
-bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck, bool fAlreadyChecked)
+bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck, bool fAlreadyChecked, CCoinsRunningStats* pstats)
 {
     AssertLockHeld(cs_main);
     // Check it again in case a previous version let a bad block in
@@ -3076,10 +3542,18 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         LogPrintf("%s: hashPrev=%s view=%s\n", __func__, hashPrevBlock.ToString().c_str(), view.GetBestBlock().ToString().c_str());
     assert(hashPrevBlock == view.GetBestBlock());
 
+    // The running UTXO set statistics are only updated if they describe the view's state
+    bool fTrackStats = pstats && pstats->hashBlock == hashPrevBlock;
+    CCoinsRunningStats statsBlock;
+    if (fTrackStats)
+        statsBlock = *pstats;
+
     // Special case for the genesis block, skipping connection of its transactions
     // (its coinbase is unspendable)
     if (block.GetHash() == Params().HashGenesisBlock()) {
         view.SetBestBlock(pindex->GetBlockHash());
+        if (fTrackStats)
+            pstats->hashBlock = pindex->GetBlockHash();
         return true;
     }
 
@@ -3091,7 +3565,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         return state.DoS(100, error("ConnectBlock() : PoW period ended"),
             REJECT_INVALID, "PoW-ended");
 
-    bool fScriptChecks = pindex->nHeight >= Checkpoints::GetTotalBlocksEstimate();
+    bool fScriptChecks = pindex->nHeight >= Checkpoints::GetTotalBlocksEstimate() &&
+                         !IsBlockAssumedValid(pindex->pprev, pindex->GetBlockHash());
 
     // If scripts won't be checked anyways, don't bother seeing if CLTV is activated
     bool fCLTVHasMajority = false;
@@ -3116,24 +3591,25 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                              (pindex->nHeight == 91880 && pindex->GetBlockHash() == uint256("0x00000000000743f190a18c5577a3c2d2a1f610ae9601ac046a38084ccb7cd721")));
     if (fEnforceBIP30) {
         BOOST_FOREACH (const CTransaction& tx, block.vtx) {
-            const CCoins* coins = view.AccessCoins(tx.GetHash());
-            if (coins && !coins->IsPruned())
-                return state.DoS(100, error("ConnectBlock() : tried to overwrite transaction"),
-                    REJECT_INVALID, "bad-txns-BIP30");
+            for (size_t o = 0; o < tx.vout.size(); o++) {
+                if (view.HaveCoin(COutPoint(tx.GetHash(), o)))
+                    return state.DoS(100, error("ConnectBlock() : tried to overwrite transaction"),
+                        REJECT_INVALID, "bad-txns-BIP30");
+            }
         }
     }
 
-    CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
+    CCheckQueueControl<CValidationCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
 
     int64_t nTimeStart = GetTimeMicros();
     CAmount nFees = 0;
     int nInputs = 0;
     unsigned int nSigOps = 0;
-    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
-    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     std::vector<std::pair<CoinSpend, uint256> > vSpends;
     std::vector<std::pair<PublicCoin, uint256> > vMints;
-    vPos.reserve(block.vtx.size());
+    // Blocks only checked or verified again at startup are in the indexes already, or never will be
+    const bool fUpdateIndexes = !fJustCheck && !fVerifyingBlocks;
+    CAddressIndexUpdate addressUpdate(fUpdateIndexes && fAddressIndex, fUpdateIndexes && fSpentIndex);
     CBlockUndo blockundo;
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     CAmount nValueOut = 0;
@@ -3251,7 +3727,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
             if (!CheckInputs(tx, state, view, fScriptChecks, flags, false, nScriptCheckThreads ? &vChecks : NULL))
                 return false;
-            control.Add(vChecks);
+            QueueChecks(control, vChecks);
         }
         nValueOut += tx.GetValueOut();
 
@@ -3259,17 +3735,27 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
         }
-        UpdateCoins(tx, state, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
-
-        vPos.push_back(std::make_pair(tx.GetHash(), pos));
-        pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
+        CTxUndo& txundo = i == 0 ? undoDummy : blockundo.vtxundo.back();
+        UpdateCoins(tx, state, view, txundo, pindex->nHeight);
+        if (addressUpdate.fAddressIndex || addressUpdate.fSpentIndex)
+            addressUpdate.AddTransaction(tx, i, pindex->nHeight, &txundo.vprevout, true);
+
+        if (fTrackStats) {
+            for (unsigned int j = 0; j < txundo.vprevout.size(); j++)
+                statsBlock.RemoveCoin(tx.vin[j].prevout, txundo.vprevout[j]);
+            // Same outputs as AddCoins puts in the view
+            for (unsigned int o = 0; o < tx.vout.size(); o++) {
+                const CTxOut& txout = tx.vout[o];
+                if (IsUTXOSetOutput(txout))
+                    statsBlock.AddCoin(COutPoint(tx.GetHash(), o), Coin(txout, pindex->nHeight, tx.IsCoinBase(), tx.IsCoinStake()));
+            }
+        }
     }
 
     //A one-time event where money supply counts were off and recalculated on a certain block.
     if (pindex->nHeight == Params().Zerocoin_Block_RecalculateAccumulators() + 1) {
-        RecalculateZVITMinted();
-        RecalculateZVITSpent();
-        RecalculateVITSupply(Params().Zerocoin_StartHeight());
+        if (!RecalculateSupply(Params().Zerocoin_StartHeight(), true))
+            return state.Abort("Failed to recalculate the money supply");
     }
 
     //Track zDIVIT money supply in the block index
@@ -3367,12 +3853,18 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     if (!zerocoinDB->WriteCoinSpendBatch(vSpends)) return state.Abort(("Failed to record coin serials to database"));
     if (!zerocoinDB->WriteCoinMintBatch(vMints)) return state.Abort(("Failed to record new mints to database"));
 
+    // Keep what the block adds to the accumulators, so witnesses can be generated after it is pruned
+    if (!vMints.empty()) {
+        std::map<CoinDenomination, std::vector<CBigNum> > mapPubcoins;
+        if (!BlockToAccumulatedPubcoins(block, pindex, mapPubcoins) || !zerocoinDB->WriteBlockPubcoins(pindex->nHeight, mapPubcoins))
+            return state.Abort("Failed to record block pubcoins to database");
+    }
+
     //Record accumulator checksums
     DatabaseChecksums(mapAccumulators);
 
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
-            return state.Abort("Failed to write transaction index");
+    if (!addressUpdate.IsEmpty() && !pblocktree->WriteAddressIndexUpdate(addressUpdate))
+        return state.Abort("Failed to write address index");
 
     // add new entries
     for (const CTransaction tx: block.vtx) {
@@ -3422,9 +3914,116 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             mapZerocoinspends.erase(it);
     }
 
+    if (fTrackStats) {
+        statsBlock.hashBlock = pindex->GetBlockHash();
+        *pstats = statsBlock;
+    }
+
     return true;
 }
 
+/** Mark the blocks of a block file as pruned and forget its file info. The files are deleted by UnlinkPrunedFiles. */
+static void PruneOneBlockFile(const int nFile)
+{
+    for (BlockMap::iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end(); ++it) {
+        CBlockIndex* pindex = it->second;
+        if (pindex->nFile != nFile)
+            continue;
+
+        pindex->nStatus &= ~(BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO);
+        blockCache.Erase(pindex->GetBlockHash());
+        pindex->nFile = 0;
+        pindex->nDataPos = 0;
+        pindex->nUndoPos = 0;
+        setDirtyBlockIndex.insert(pindex);
+
+        // A pruned block has to be downloaded again before its chain can be considered
+        std::pair<multimap<CBlockIndex*, CBlockIndex*>::iterator, multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex->pprev);
+        while (range.first != range.second) {
+            multimap<CBlockIndex*, CBlockIndex*>::iterator itUnlinked = range.first++;
+            if (itUnlinked->second == pindex)
+                mapBlocksUnlinked.erase(itUnlinked);
+        }
+    }
+
+    vinfoBlockFile[nFile].SetNull();
+    setDirtyFileInfo.insert(nFile);
+}
+
+void UnlinkPrunedFiles(std::set<int>& setFilesToPrune)
+{
+    for (set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
+        CDiskBlockPos pos(*it, 0);
+        blockFileMappings.Remove(*it, "blk");
+        blockFileMappings.Remove(*it, "rev");
+        boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
+        boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
+        LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
+    }
+}
+
+uint64_t CalculateCurrentUsage()
+{
+    LOCK(cs_LastBlockFile);
+
+    uint64_t nTotal = 0;
+    for (const CBlockFileInfo& info : vinfoBlockFile)
+        nTotal += info.nSize + info.nUndoSize;
+    return nTotal;
+}
+
+/**
+ * Find the block and undo files to delete to get below nPruneTarget, and mark their blocks as pruned.
+ * Files with blocks within MIN_BLOCKS_TO_KEEP of the tip are kept, and so are the files with zerocoin
+ * blocks until the one time supply recalculation after Zerocoin_Block_RecalculateAccumulators, which
+ * reads them. Witnesses for older mints come from the block pubcoins in the zerocoin database.
+ */
+static void FindFilesToPrune(std::set<int>& setFilesToPrune)
+{
+    LOCK2(cs_main, cs_LastBlockFile);
+    if (chainActive.Tip() == NULL || nPruneTarget == 0)
+        return;
+    if (chainActive.Tip()->nHeight <= (int)MIN_BLOCKS_TO_KEEP)
+        return;
+
+    // The block pubcoins must be complete before any zerocoin block can go
+    bool fPubcoinsIndexed = false;
+    if (!zerocoinDB->ReadFlag("blockpubcoins", fPubcoinsIndexed) || !fPubcoinsIndexed)
+        return;
+
+    int nLastBlockWeCanPrune = chainActive.Tip()->nHeight - MIN_BLOCKS_TO_KEEP;
+    if (chainActive.Tip()->nHeight <= Params().Zerocoin_Block_RecalculateAccumulators() + 1)
+        nLastBlockWeCanPrune = std::min(nLastBlockWeCanPrune, Params().Zerocoin_StartHeight() - 1);
+
+    uint64_t nCurrentUsage = CalculateCurrentUsage();
+    // Files are only checked after new space was allocated, so stay a chunk below the target
+    uint64_t nBuffer = BLOCKFILE_CHUNK_SIZE + UNDOFILE_CHUNK_SIZE;
+    int nCount = 0;
+    if (nCurrentUsage + nBuffer >= nPruneTarget) {
+        for (int nFile = 0; nFile < nLastBlockFile; nFile++) {
+            if (vinfoBlockFile[nFile].nSize == 0)
+                continue;
+
+            if (nCurrentUsage + nBuffer < nPruneTarget)
+                break;
+
+            if ((int)vinfoBlockFile[nFile].nHeightLast > nLastBlockWeCanPrune)
+                continue;
+
+            uint64_t nBytesToPrune = vinfoBlockFile[nFile].nSize + vinfoBlockFile[nFile].nUndoSize;
+            PruneOneBlockFile(nFile);
+            setFilesToPrune.insert(nFile);
+            nCurrentUsage -= nBytesToPrune;
+            nCount++;
+        }
+    }
+
+    LogPrint("prune", "Prune: target=%dMiB actual=%dMiB diff=%dMiB max_prune_height=%d removed %d blk/rev pairs\n",
+        nPruneTarget / 1024 / 1024, nCurrentUsage / 1024 / 1024,
+        ((int64_t)nPruneTarget - (int64_t)nCurrentUsage) / 1024 / 1024,
+        nLastBlockWeCanPrune, nCount);
+}
+
 enum FlushStateMode {
     FLUSH_STATE_IF_NEEDED,
     FLUSH_STATE_PERIODIC,
@@ -3440,16 +4039,32 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
 {
     LOCK(cs_main);
     static int64_t nLastWrite = 0;
+    std::set<int> setFilesToPrune;
+    bool fFlushForPrune = false;
     try {
-        if ((mode == FLUSH_STATE_ALWAYS) ||
-            ((mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && pcoinsTip->GetCacheSize() > nCoinCacheSize) ||
+        if (fPruneMode && fCheckForPruning && !fReindex) {
+            FindFilesToPrune(setFilesToPrune);
+            fCheckForPruning = false;
+            if (!setFilesToPrune.empty()) {
+                fFlushForPrune = true;
+                if (!fHavePruned) {
+                    pblocktree->WriteFlag("prunedblockfiles", true);
+                    fHavePruned = true;
+                }
+            }
+        }
+        // A flushed cache stays in memory until the background write is done, so the tip
+        // cache may use half of the budget while the previous snapshot holds the other half.
+        size_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+        if ((mode == FLUSH_STATE_ALWAYS) || fFlushForPrune ||
+            ((mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && cacheSize > nCoinCacheUsage / 2) ||
             (mode == FLUSH_STATE_PERIODIC && GetTimeMicros() > nLastWrite + DATABASE_WRITE_INTERVAL * 1000000)) {
-            // Typical CCoins structures on disk are around 100 bytes in size.
+            // Typical Coin structures on disk are around 48 bytes in size.
             // Pushing a new one to the database can cause it to be written
             // twice (once in the log, and once in the tables). This is already
             // an overestimation, as most will delete an existing entry or
             // overwrite one. Still, use a conservative safety factor of 2.
-            if (!CheckDiskSpace(100 * 2 * 2 * pcoinsTip->GetCacheSize()))
+            if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
             // First make sure all block and undo data is flushed to disk.
             FlushBlockFile();
@@ -3472,9 +4087,15 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
                 setDirtyBlockIndex.erase(it++);
             }
             pblocktree->Sync();
+            // The block index no longer refers to pruned files, so they can go now
+            if (fFlushForPrune)
+                UnlinkPrunedFiles(setFilesToPrune);
             // Finally flush the chainstate (which may refer to block index entries).
+            // The coins are written in the background, unless the caller needs them in the database.
             if (!pcoinsTip->Flush())
                 return state.Abort("Failed to write to coin database");
+            if (mode == FLUSH_STATE_ALWAYS && !pcoinsflusher->WaitForWrite())
+                return state.Abort("Failed to write to coin database");
             // Update best block in wallet (so we can detect restored wallets).
             if (mode != FLUSH_STATE_IF_NEEDED) {
                 GetMainSignals().SetBestChain(chainActive.GetLocator());
@@ -3502,10 +4123,10 @@ void static UpdateTip(CBlockIndex* pindexNew)
     nTimeBestReceived = GetTime();
     mempool.AddTransactionsUpdated(1);
 
-    LogPrintf("UpdateTip: new best=%s  height=%d  log2_work=%.8g  tx=%lu  date=%s progress=%f  cache=%u\n",
+    LogPrintf("UpdateTip: new best=%s  height=%d  log2_work=%.8g  tx=%lu  date=%s progress=%f  cache=%.1fMiB(%utxo)\n",
         chainActive.Tip()->GetBlockHash().ToString(), chainActive.Height(), log(chainActive.Tip()->nChainWork.getdouble()) / log(2.0), (unsigned long)chainActive.Tip()->nChainTx,
         DateTimeStrFormat("%Y-%m-%d %H:%M:%S", chainActive.Tip()->GetBlockTime()),
-        Checkpoints::GuessVerificationProgress(chainActive.Tip()), (unsigned int)pcoinsTip->GetCacheSize());
+        Checkpoints::GuessVerificationProgress(chainActive.Tip()), pcoinsTip->DynamicMemoryUsage() * (1.0 / (1 << 20)), (unsigned int)pcoinsTip->GetCacheSize());
 
     cvBlockChange.notify_all();
 
@@ -3544,7 +4165,7 @@ bool static DisconnectTip(CValidationState& state)
     int64_t nStart = GetTimeMicros();
     {
         CCoinsViewCache view(pcoinsTip);
-        if (!DisconnectBlock(block, state, pindexDelete, view))
+        if (!DisconnectBlock(block, state, pindexDelete, view, NULL, &coinsStatsTip))
             return error("DisconnectTip() : DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         assert(view.Flush());
     }
@@ -3564,6 +4185,7 @@ bool static DisconnectTip(CValidationState& state)
     mempool.check(pcoinsTip);
     // Update chainActive and related variables.
     UpdateTip(pindexDelete->pprev);
+    GetMainSignals().BlockDisconnected(block, pindexDelete);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
     BOOST_FOREACH (const CTransaction& tx, block.vtx) {
@@ -3606,7 +4228,7 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
     {
         CInv inv(MSG_BLOCK, pindexNew->GetBlockHash());
-        bool rv = ConnectBlock(*pblock, state, pindexNew, view, false, fAlreadyChecked);
+        bool rv = ConnectBlock(*pblock, state, pindexNew, view, false, fAlreadyChecked, &coinsStatsTip);
         GetMainSignals().BlockChecked(*pblock, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -3639,6 +4261,7 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
     mempool.check(pcoinsTip);
     // Update chainActive & related variables.
     UpdateTip(pindexNew);
+    GetMainSignals().BlockConnected(*pblock, pindexNew);
     // Tell wallet about transactions that went from mempool
     // to conflicted:
     BOOST_FOREACH (const CTransaction& tx, txConflicted) {
@@ -4042,7 +4665,7 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
 
     //mark as PoS seen
     if (pindexNew->IsProofOfStake())
-        setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
+        setStakeSeen.insert(make_pair(pindexNew->pstake->prevoutStake, pindexNew->pstake->nStakeTime));
 
     pindexNew->phashBlock = &((*mi).first);
     BlockMap::iterator miPrev = mapBlockIndex.find(block.hashPrevBlock);
@@ -4065,7 +4688,7 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
         if (pindexNew->IsProofOfStake()) {
             if (!mapProofOfStake.count(hash))
                 LogPrintf("AddToBlockIndex() : hashProofOfStake not found in map \n");
-            pindexNew->hashProofOfStake = mapProofOfStake[hash];
+            pindexNew->pstake->hashProofOfStake = mapProofOfStake[hash];
         }
 
         // ppcoin: compute stake modifier
@@ -4173,6 +4796,8 @@ bool FindBlockPos(CValidationState& state, CDiskBlockPos& pos, unsigned int nAdd
         unsigned int nOldChunks = (pos.nPos + BLOCKFILE_CHUNK_SIZE - 1) / BLOCKFILE_CHUNK_SIZE;
         unsigned int nNewChunks = (vinfoBlockFile[nFile].nSize + BLOCKFILE_CHUNK_SIZE - 1) / BLOCKFILE_CHUNK_SIZE;
         if (nNewChunks > nOldChunks) {
+            if (fPruneMode)
+                fCheckForPruning = true;
             if (CheckDiskSpace(nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos)) {
                 FILE* file = OpenBlockFile(pos);
                 if (file) {
@@ -4193,6 +4818,9 @@ bool FindUndoPos(CValidationState& state, int nFile, CDiskBlockPos& pos, unsigne
 {
     pos.nFile = nFile;
 
+    // Undo data can still be added to the rev file of an older block file
+    blockFileMappings.Remove(nFile, "rev");
+
     LOCK(cs_LastBlockFile);
 
     unsigned int nNewSize;
@@ -4203,6 +4831,8 @@ bool FindUndoPos(CValidationState& state, int nFile, CDiskBlockPos& pos, unsigne
     unsigned int nOldChunks = (pos.nPos + UNDOFILE_CHUNK_SIZE - 1) / UNDOFILE_CHUNK_SIZE;
     unsigned int nNewChunks = (nNewSize + UNDOFILE_CHUNK_SIZE - 1) / UNDOFILE_CHUNK_SIZE;
     if (nNewChunks > nOldChunks) {
+        if (fPruneMode)
+            fCheckForPruning = true;
         if (CheckDiskSpace(nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos)) {
             FILE* file = OpenUndoFile(pos);
             if (file) {
@@ -4364,8 +4994,19 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
     // Check transactions
     bool fZerocoinActive = block.GetBlockTime() > Params().Zerocoin_StartTime();
     vector<CBigNum> vBlockSerials;
+    // Zerocoin spend proofs are by far the most expensive part of checking a block,
+    // collect them here and verify them on the script check threads below. Below
+    // the -assumevalid block they are collected and dropped without verifying.
+    bool fAssumeValid = false;
+    if (hashAssumeValid != 0) {
+        // ProcessNewBlock checks the block before it takes cs_main
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
+        fAssumeValid = mi != mapBlockIndex.end() && IsBlockAssumedValid(mi->second, block.GetHash());
+    }
+    std::vector<CZerocoinSpendCheck> vSpendChecks;
     for (const CTransaction& tx : block.vtx) {
-        if (!CheckTransaction(tx, fZerocoinActive, chainActive.Height() + 1 >= Params().Zerocoin_Block_EnforceSerialRange(), state))
+        if (!CheckTransaction(tx, fZerocoinActive, chainActive.Height() + 1 >= Params().Zerocoin_Block_EnforceSerialRange(), state, (nScriptCheckThreads || fAssumeValid) ? &vSpendChecks : NULL))
             return error("CheckBlock() : CheckTransaction failed");
 
         // double check that there are no double spent zDIVIT spends in this block
@@ -4382,6 +5023,17 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
         }
     }
 
+    // Nothing that takes cs_main may run while the queue is held here, as
+    // ConnectBlock acquires the queue while holding cs_main.
+    if (!vSpendChecks.empty() && !fAssumeValid) {
+        BatchZerocoinSpendChecks(vSpendChecks);
+        CCheckQueueControl<CValidationCheck> control(&scriptcheckqueue);
+        QueueChecks(control, vSpendChecks);
+        if (!control.Wait())
+            return state.DoS(100, error("CheckBlock() : zerocoin spend did not verify"),
+                REJECT_INVALID, "bad-zerocoinspend");
+    }
+
 
     unsigned int nSigOps = 0;
     BOOST_FOREACH (const CTransaction& tx, block.vtx) {
@@ -4998,11 +5650,6 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
     if (!pindexNew)
         throw runtime_error("LoadBlockIndex() : new CBlockIndex failed");
     mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
-
-    //mark as PoS seen
-    if (pindexNew->IsProofOfStake())
-        setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
-
     pindexNew->phashBlock = &((*mi).first);
 
     return pindexNew;
@@ -5026,7 +5673,8 @@ bool static LoadBlockIndexDB(string& strError)
     BOOST_FOREACH (const PAIRTYPE(int, CBlockIndex*) & item, vSortedByHeight) {
         CBlockIndex* pindex = item.second;
         pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
-        if (pindex->nStatus & BLOCK_HAVE_DATA) {
+        // Blocks below a UTXO snapshot have a transaction count but no data
+        if (pindex->nTx > 0) {
             if (pindex->pprev) {
                 if (pindex->pprev->nChainTx) {
                     pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
@@ -5091,9 +5739,15 @@ bool static LoadBlockIndexDB(string& strError)
     pblocktree->ReadReindexing(fReindexing);
     fReindex |= fReindexing;
 
-    // Check whether we have a transaction index
-    pblocktree->ReadFlag("txindex", fTxIndex);
-    LogPrintf("LoadBlockIndexDB(): transaction index %s\n", fTxIndex ? "enabled" : "disabled");
+    // Check whether some block files are missing
+    pblocktree->ReadFlag("prunedblockfiles", fHavePruned);
+    if (fHavePruned)
+        LogPrintf("LoadBlockIndexDB(): block files below the tip are missing\n");
+
+    // Check whether we have the address and spent indexes
+    pblocktree->ReadFlag("addressindex", fAddressIndex);
+    pblocktree->ReadFlag("spentindex", fSpentIndex);
+    LogPrintf("LoadBlockIndexDB(): address index %s, spent index %s\n", fAddressIndex ? "enabled" : "disabled", fSpentIndex ? "enabled" : "disabled");
 
     // If this is written true before the next client init, then we know the shutdown process failed
     pblocktree->WriteFlag("shutdown", false);
@@ -5106,6 +5760,15 @@ bool static LoadBlockIndexDB(string& strError)
 
     PruneBlockIndexCandidates();
 
+    // A transaction index of an older version, written along with the blocks, covers the chain tip
+    bool fTxIndexInline = false;
+    CBlockLocator locatorTxIndex;
+    if (pblocktree->ReadFlag("txindex", fTxIndexInline) && fTxIndexInline && !pblocktree->ReadTxIndexBestBlock(locatorTxIndex)) {
+        LogPrintf("LoadBlockIndexDB(): transaction index covers height %d\n", chainActive.Height());
+        if (!pblocktree->WriteTxIndexBestBlock(chainActive.GetLocator()) || !pblocktree->WriteFlag("txindex", false))
+            return error("LoadBlockIndexDB() : failed to write transaction index best block");
+    }
+
     LogPrintf("LoadBlockIndexDB(): hashBestChain=%s height=%d date=%s progress=%f\n",
         chainActive.Tip()->GetBlockHash().ToString(), chainActive.Height(),
         DateTimeStrFormat("%Y-%m-%d %H:%M:%S", chainActive.Tip()->GetBlockTime()),
@@ -5147,6 +5810,11 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
         uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
         if (pindex->nHeight < chainActive.Height() - nCheckDepth)
             break;
+        // Blocks loaded from a UTXO snapshot have no undo data, and the ones below them no data at all
+        if (fHavePruned && (pindex->nStatus & (BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO)) != (BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO)) {
+            LogPrintf("VerifyDB(): block data ends at height %d\n", pindex->nHeight);
+            break;
+        }
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex))
@@ -5164,7 +5832,7 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
             }
         }
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.GetCacheSize() + pcoinsTip->GetCacheSize()) <= nCoinCacheSize) {
+        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
             bool fClean = true;
             if (!DisconnectBlock(block, state, pindex, coins, &fClean))
                 return error("VerifyDB() : *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
@@ -5203,10 +5871,14 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
 
 void UnloadBlockIndex()
 {
+    WaitForAccumulatorValues(true);
     mapBlockIndex.clear();
     setBlockIndexCandidates.clear();
     chainActive.SetTip(NULL);
     pindexBestInvalid = NULL;
+    fHavePruned = false;
+    coinsStatsTip.SetNull();
+    mintCounts.Clear();
 }
 
 bool LoadBlockIndex(string& strError)
@@ -5225,9 +5897,12 @@ bool InitBlockIndex()
     if (chainActive.Genesis() != NULL)
         return true;
 
-    // Use the provided setting for -txindex in the new database
-    fTxIndex = GetBoolArg("-txindex", true);
-    pblocktree->WriteFlag("txindex", fTxIndex);
+    // Use the provided settings for the address and spent indexes in the new database
+    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    pblocktree->WriteFlag("addressindex", fAddressIndex);
+    fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    pblocktree->WriteFlag("spentindex", fSpentIndex);
+
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -5257,6 +5932,349 @@ bool InitBlockIndex()
     return true;
 }
 
+bool WriteSnapshotBlock(CBlock& block, CBlockIndex* pindex, CValidationState& state)
+{
+    AssertLockHeld(cs_main);
+
+    unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+    CDiskBlockPos blockPos;
+    if (!FindBlockPos(state, blockPos, nBlockSize + 8, pindex->nHeight, block.GetBlockTime()))
+        return error("WriteSnapshotBlock() : FindBlockPos failed");
+    if (!WriteBlockToDisk(block, blockPos))
+        return state.Abort("Failed to write block");
+
+    pindex->nFile = blockPos.nFile;
+    pindex->nDataPos = blockPos.nPos;
+    pindex->nStatus |= BLOCK_HAVE_DATA;
+    setDirtyBlockIndex.insert(pindex);
+    return true;
+}
+
+bool ActivateSnapshotChain(CBlockIndex* pindexBase, CValidationState& state)
+{
+    AssertLockHeld(cs_main);
+
+    std::vector<CBlockIndex*> vChain;
+    for (CBlockIndex* pindex = pindexBase; pindex->pprev; pindex = pindex->pprev)
+        vChain.push_back(pindex);
+
+    BOOST_REVERSE_FOREACH (CBlockIndex* pindex, vChain) {
+        pindex->nChainWork = pindex->pprev->nChainWork + GetBlockProof(*pindex);
+        pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
+        pindex->BuildSkip();
+        if (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex))
+            pindexBestHeader = pindex;
+    }
+
+    // Everything below the snapshot base is known without its block data
+    fHavePruned = true;
+    if (!pblocktree->WriteFlag("prunedblockfiles", true))
+        return state.Abort("Failed to write to block index");
+
+    chainActive.SetTip(pindexBase);
+    setBlockIndexCandidates.insert(pindexBase);
+    PruneBlockIndexCandidates();
+
+    LogPrintf("ActivateSnapshotChain(): new best=%s height=%d\n", pindexBase->GetBlockHash().ToString(), pindexBase->nHeight);
+    if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS))
+        return false;
+
+    // The unspent outputs were replaced as a whole, so the running statistics are recomputed
+    if (!pcoinsdbview->ComputeRunningStats(coinsStatsTip))
+        return state.Abort("Failed to compute UTXO set statistics");
+    if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS))
+        return false;
+
+    cvBlockChange.notify_all();
+    return true;
+}
+
+bool LoadCoinsRunningStats()
+{
+    LOCK(cs_main);
+
+    // Statistics that were not written along with the best block of the coin database are stale
+    uint256 hashBestBlock = pcoinsTip->GetBestBlock();
+    if (!pcoinsdbview->ReadRunningStats(coinsStatsTip) || coinsStatsTip.hashBlock != hashBestBlock) {
+        LogPrintf("Computing UTXO set statistics...\n");
+        int64_t nStart = GetTimeMillis();
+        if (!pcoinsdbview->ComputeRunningStats(coinsStatsTip) || coinsStatsTip.hashBlock != hashBestBlock)
+            return error("%s : failed to compute UTXO set statistics", __func__);
+        LogPrintf("Computed UTXO set statistics: %u outputs in %dms\n", coinsStatsTip.nTransactionOutputs, GetTimeMillis() - nStart);
+    }
+    pcoinsdbview->TrackRunningStats(&coinsStatsTip);
+    return true;
+}
+
+
+namespace
+{
+/** A block located in an external block file, on its way to validation */
+struct CImportBlock {
+    uint64_t nSequence;
+    unsigned int nGeneration;
+    //! Position to continue scanning from if the block can not be decoded
+    uint64_t nRewindPos;
+    uint64_t nBlockPos;
+    std::vector<char> vchBlock;
+    CBlock block;
+    uint256 hash;
+    bool fDecoded;
+
+    CImportBlock() : nSequence(0), nGeneration(0), nRewindPos(0), nBlockPos(0), fDecoded(false) {}
+};
+typedef std::shared_ptr<CImportBlock> CImportBlockRef;
+
+/**
+ * Reads the blocks of an external block file in a pipeline. A reader thread locates
+ * them in the file, a pool of workers deserializes and hashes them, and Next() hands
+ * them back in file order. The reader stays at most MAX_IMPORT_BLOCKS_IN_FLIGHT blocks
+ * and MAX_IMPORT_BYTES_IN_FLIGHT bytes ahead of the block last returned by Next(). The
+ * file buffer keeps that many bytes, so Rewind() can go back to a block that failed to
+ * decode and scan the file from there, the same way a sequential read would. Scanning
+ * over garbage can still carry the reader past the buffer, then it seeks in the file.
+ */
+class CBlockImportPipeline
+{
+private:
+    CBufferedFile& blkdat;
+
+    boost::mutex cs;
+    boost::condition_variable condReader;
+    boost::condition_variable condWorker;
+    boost::condition_variable condResult;
+
+    //! Blocks read from the file, waiting for a worker
+    std::deque<CImportBlockRef> queueRead;
+    //! Decoded blocks by sequence number, waiting for Next()
+    std::map<uint64_t, CImportBlockRef> mapDecoded;
+    //! Rewind positions of the blocks read but not yet returned by Next(), in file order
+    std::deque<uint64_t> dequeInFlight;
+    //! The front of dequeInFlight was returned by Next(), it stays until the next call
+    //! because the caller may still rewind to it
+    bool fReturnedFront;
+    uint64_t nNextRead;
+    uint64_t nNextResult;
+    //! Incremented by Rewind(), blocks of earlier generations are dropped
+    unsigned int nGeneration;
+    bool fRewind;
+    uint64_t nRewindTo;
+    bool fReaderDone;
+    bool fStop;
+    std::string strReaderError;
+
+    boost::thread_group threads;
+
+    void ThreadRead();
+    void ThreadDecode();
+
+public:
+    //! Bytes the file buffer must be able to rewind: the reader stops one block record
+    //! past MAX_IMPORT_BYTES_IN_FLIGHT, and the buffer reads up to one record ahead of it
+    static const uint64_t REWIND_SIZE = MAX_IMPORT_BYTES_IN_FLIGHT + 2 * (MAX_BLOCK_SIZE_CURRENT + 8);
+    static const uint64_t BUFFER_SIZE = REWIND_SIZE + MAX_BLOCK_SIZE_CURRENT + 8;
+
+    CBlockImportPipeline(CBufferedFile& blkdatIn, int nWorkers);
+    ~CBlockImportPipeline();
+
+    //! Wait for the next block in file order, returns false after the last one
+    bool Next(CImportBlockRef& pimport);
+    //! Drop the blocks after the last one returned and continue reading at nPos
+    void Rewind(uint64_t nPos);
+    std::string GetReaderError();
+};
+
+CBlockImportPipeline::CBlockImportPipeline(CBufferedFile& blkdatIn, int nWorkers) : blkdat(blkdatIn), fReturnedFront(false), nNextRead(0), nNextResult(0), nGeneration(0), fRewind(false), nRewindTo(0), fReaderDone(false), fStop(false)
+{
+    threads.create_thread(boost::bind(&CBlockImportPipeline::ThreadRead, this));
+    for (int i = 0; i < nWorkers; i++)
+        threads.create_thread(boost::bind(&CBlockImportPipeline::ThreadDecode, this));
+}
+
+CBlockImportPipeline::~CBlockImportPipeline()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = true;
+    }
+    condReader.notify_all();
+    condWorker.notify_all();
+    threads.join_all();
+}
+
+void CBlockImportPipeline::ThreadRead()
+{
+    RenameThread("Divitae-impread");
+    try {
+        uint64_t nRewind = blkdat.GetPos();
+        while (true) {
+            unsigned int nGenerationRead;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (!fStop && !fRewind && (dequeInFlight.size() >= MAX_IMPORT_BLOCKS_IN_FLIGHT ||
+                                                 (!dequeInFlight.empty() && nRewind > dequeInFlight.front() + MAX_IMPORT_BYTES_IN_FLIGHT)))
+                    condReader.wait(lock);
+                if (fStop)
+                    return;
+                if (fRewind) {
+                    nRewind = nRewindTo;
+                    fRewind = false;
+                }
+                nGenerationRead = nGeneration;
+            }
+
+            bool fEnd = false;
+            CImportBlockRef pimport;
+            if (!blkdat.SetPos(nRewind) && blkdat.GetPos() > nRewind) {
+                // Out of the buffer, read the file again from there
+                LogPrint("reindex", "%s : rewinding to %u outside the buffer, seeking in the file\n", __func__, nRewind);
+                if (!blkdat.Seek(nRewind))
+                    throw std::runtime_error(strprintf("can not seek to position %u in the block file", nRewind));
+            }
+            if (blkdat.eof()) {
+                fEnd = true;
+            } else {
+                nRewind++;         // start one byte further next time, in case of failure
+                blkdat.SetLimit(); // remove former limit
+                unsigned int nSize = 0;
+                try {
+                    // locate a header
+                    unsigned char buf[MESSAGE_START_SIZE];
+                    blkdat.FindByte(Params().MessageStart()[0]);
+                    nRewind = blkdat.GetPos() + 1;
+                    blkdat >> FLATDATA(buf);
+                    if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
+                        continue;
+                    // read size
+                    blkdat >> nSize;
+                    if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
+                        continue;
+                } catch (const std::exception&) {
+                    // no valid block header found; don't complain
+                    fEnd = true;
+                }
+                if (!fEnd) {
+                    try {
+                        // read the block, the workers deserialize it
+                        pimport.reset(new CImportBlock());
+                        pimport->nRewindPos = nRewind;
+                        pimport->nBlockPos = blkdat.GetPos();
+                        blkdat.SetLimit(pimport->nBlockPos + nSize);
+                        pimport->vchBlock.resize(nSize);
+                        blkdat.read(&pimport->vchBlock[0], nSize);
+                        nRewind = blkdat.GetPos();
+                    } catch (const std::exception& e) {
+                        LogPrintf("%s : Deserialize or I/O error - %s\n", __func__, e.what());
+                        continue;
+                    }
+                }
+            }
+
+            boost::unique_lock<boost::mutex> lock(cs);
+            if (nGenerationRead != nGeneration)
+                continue;
+            if (!fEnd) {
+                pimport->nSequence = nNextRead++;
+                pimport->nGeneration = nGeneration;
+                dequeInFlight.push_back(pimport->nRewindPos);
+                queueRead.push_back(pimport);
+                condWorker.notify_one();
+                continue;
+            }
+
+            // Wait at the end of the file in case a block fails to decode and the caller rewinds
+            fReaderDone = true;
+            condResult.notify_all();
+            while (!fStop && !fRewind)
+                condReader.wait(lock);
+            if (fStop)
+                return;
+        }
+    } catch (const std::exception& e) {
+        boost::unique_lock<boost::mutex> lock(cs);
+        strReaderError = e.what();
+        fReaderDone = true;
+        condResult.notify_all();
+    }
+}
+
+void CBlockImportPipeline::ThreadDecode()
+{
+    RenameThread("Divitae-impdec");
+    while (true) {
+        CImportBlockRef pimport;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            while (!fStop && queueRead.empty())
+                condWorker.wait(lock);
+            if (fStop)
+                return;
+            pimport = queueRead.front();
+            queueRead.pop_front();
+        }
+
+        try {
+            CDataStream ssBlock(pimport->vchBlock.data(), pimport->vchBlock.data() + pimport->vchBlock.size(), SER_DISK, CLIENT_VERSION);
+            ssBlock >> pimport->block;
+            pimport->hash = pimport->block.GetHash();
+            pimport->fDecoded = true;
+        } catch (const std::exception& e) {
+            LogPrintf("%s : Deserialize or I/O error - %s\n", __func__, e.what());
+        }
+        std::vector<char>().swap(pimport->vchBlock);
+
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pimport->nGeneration == nGeneration) {
+            mapDecoded[pimport->nSequence] = pimport;
+            condResult.notify_all();
+        }
+    }
+}
+
+bool CBlockImportPipeline::Next(CImportBlockRef& pimport)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (fReturnedFront) {
+        dequeInFlight.pop_front();
+        fReturnedFront = false;
+        condReader.notify_one();
+    }
+    while (true) {
+        std::map<uint64_t, CImportBlockRef>::iterator it = mapDecoded.find(nNextResult);
+        if (it != mapDecoded.end()) {
+            pimport = it->second;
+            mapDecoded.erase(it);
+            nNextResult++;
+            fReturnedFront = true;
+            return true;
+        }
+        if (fReaderDone && dequeInFlight.empty())
+            return false;
+        condResult.wait(lock);
+    }
+}
+
+void CBlockImportPipeline::Rewind(uint64_t nPos)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    nGeneration++;
+    queueRead.clear();
+    mapDecoded.clear();
+    dequeInFlight.clear();
+    fReturnedFront = false;
+    nNextResult = nNextRead;
+    fRewind = true;
+    nRewindTo = nPos;
+    fReaderDone = false;
+    condReader.notify_all();
+}
+
+std::string CBlockImportPipeline::GetReaderError()
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return strReaderError;
+}
+} // anon namespace
 
 bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
 {
@@ -5264,47 +6282,31 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
     static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
+    // Reading and decoding run ahead on their own threads, this thread only validates
+    const int nWorkers = std::max(1, std::min(MAX_IMPORT_THREADS, (int)boost::thread::hardware_concurrency() - 1));
+
     int nLoaded = 0;
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SIZE_CURRENT, MAX_BLOCK_SIZE_CURRENT + 8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        CBufferedFile blkdat(fileIn, CBlockImportPipeline::BUFFER_SIZE, CBlockImportPipeline::REWIND_SIZE, SER_DISK, CLIENT_VERSION);
+        CBlockImportPipeline pipeline(blkdat, nWorkers);
+        CImportBlockRef pimport;
+        while (pipeline.Next(pimport)) {
             boost::this_thread::interruption_point();
 
-            blkdat.SetPos(nRewind);
-            nRewind++;         // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[MESSAGE_START_SIZE];
-                blkdat.FindByte(Params().MessageStart()[0]);
-                nRewind = blkdat.GetPos() + 1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
+            if (!pimport->fDecoded) {
+                // scan again from just after the start of this block
+                pipeline.Rewind(pimport->nRewindPos);
+                continue;
             }
+
             try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
                 if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
+                    dbp->nPos = pimport->nBlockPos;
+                CBlock& block = pimport->block;
 
                 // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
+                uint256 hash = pimport->hash;
                 if (hash != Params().HashGenesisBlock() && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
                     LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
                         block.hashPrevBlock.ToString());
@@ -5350,6 +6352,9 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
                 LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
             }
         }
+        std::string strReaderError = pipeline.GetReaderError();
+        if (!strReaderError.empty())
+            throw std::runtime_error(strReaderError);
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
@@ -5394,6 +6399,7 @@ void static CheckBlockIndex()
     int nHeight = 0;
     CBlockIndex* pindexFirstInvalid = NULL;         // Oldest ancestor of pindex which is invalid.
     CBlockIndex* pindexFirstMissing = NULL;         // Oldest ancestor of pindex which does not have BLOCK_HAVE_DATA.
+    CBlockIndex* pindexFirstNeverProcessed = NULL;  // Oldest ancestor of pindex for which nTx == 0.
     CBlockIndex* pindexFirstNotTreeValid = NULL;    // Oldest ancestor of pindex which does not have BLOCK_VALID_TREE (regardless of being valid or not).
     CBlockIndex* pindexFirstNotChainValid = NULL;   // Oldest ancestor of pindex which does not have BLOCK_VALID_CHAIN (regardless of being valid or not).
     CBlockIndex* pindexFirstNotScriptsValid = NULL; // Oldest ancestor of pindex which does not have BLOCK_VALID_SCRIPTS (regardless of being valid or not).
@@ -5401,6 +6407,7 @@ void static CheckBlockIndex()
         nNodes++;
         if (pindexFirstInvalid == NULL && pindex->nStatus & BLOCK_FAILED_VALID) pindexFirstInvalid = pindex;
         if (pindexFirstMissing == NULL && !(pindex->nStatus & BLOCK_HAVE_DATA)) pindexFirstMissing = pindex;
+        if (pindexFirstNeverProcessed == NULL && pindex->nTx == 0) pindexFirstNeverProcessed = pindex;
         if (pindex->pprev != NULL && pindexFirstNotTreeValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TREE) pindexFirstNotTreeValid = pindex;
         if (pindex->pprev != NULL && pindexFirstNotChainValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN) pindexFirstNotChainValid = pindex;
         if (pindex->pprev != NULL && pindexFirstNotScriptsValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS) pindexFirstNotScriptsValid = pindex;
@@ -5411,12 +6418,18 @@ void static CheckBlockIndex()
             assert(pindex->GetBlockHash() == Params().HashGenesisBlock()); // Genesis block's hash must match.
             assert(pindex == chainActive.Genesis());                       // The current active chain's genesis block must be this block.
         }
-        // HAVE_DATA is equivalent to VALID_TRANSACTIONS and equivalent to nTx > 0 (we stored the number of transactions in the block)
-        assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
+        if (!fHavePruned) {
+            // HAVE_DATA is equivalent to VALID_TRANSACTIONS and equivalent to nTx > 0 (we stored the number of transactions in the block)
+            assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
+            assert(pindexFirstMissing == pindexFirstNeverProcessed);
+        } else {
+            // Blocks below a UTXO snapshot were never stored, but their transaction count is known
+            if (pindex->nStatus & BLOCK_HAVE_DATA) assert(pindex->nTx > 0);
+        }
         assert(((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TRANSACTIONS) == (pindex->nTx > 0));
         if (pindex->nChainTx == 0) assert(pindex->nSequenceId == 0); // nSequenceId can't be set for blocks that aren't linked
-        // All parents having data is equivalent to all parents being VALID_TRANSACTIONS, which is equivalent to nChainTx being set.
-        assert((pindexFirstMissing != NULL) == (pindex->nChainTx == 0));                                             // nChainTx == 0 is used to signal that all parent block's transaction data is available.
+        // All parents being VALID_TRANSACTIONS is equivalent to nChainTx being set.
+        assert((pindexFirstNeverProcessed != NULL) == (pindex->nChainTx == 0));                                      // nChainTx == 0 is used to signal that all parent block's transaction data is available.
         assert(pindex->nHeight == nHeight);                                                                          // nHeight must be consistent.
         assert(pindex->pprev == NULL || pindex->nChainWork >= pindex->pprev->nChainWork);                            // For every block except the genesis block, the chainwork must be larger than the parent's.
         assert(nHeight < 2 || (pindex->pskip && (pindex->pskip->nHeight < nHeight)));                                // The pskip pointer must point back for all but the first 2 blocks.
@@ -5428,8 +6441,10 @@ void static CheckBlockIndex()
             // Checks for not-invalid blocks.
             assert((pindex->nStatus & BLOCK_FAILED_MASK) == 0); // The failed mask cannot be set for blocks without invalid parents.
         }
-        if (!CBlockIndexWorkComparator()(pindex, chainActive.Tip()) && pindexFirstMissing == NULL) {
-            if (pindexFirstInvalid == NULL) { // If this block sorts at least as good as the current tip and is valid, it must be in setBlockIndexCandidates.
+        if (!CBlockIndexWorkComparator()(pindex, chainActive.Tip()) && pindexFirstNeverProcessed == NULL) {
+            // If this block sorts at least as good as the current tip and is valid, it must be in setBlockIndexCandidates.
+            // Missing parent data only excuses blocks other than the tip, see fHavePruned.
+            if (pindexFirstInvalid == NULL && (pindexFirstMissing == NULL || pindex == chainActive.Tip())) {
                 assert(setBlockIndexCandidates.count(pindex));
             }
         } else { // If this block sorts worse than the current tip, it cannot be in setBlockIndexCandidates.
@@ -5446,7 +6461,7 @@ void static CheckBlockIndex()
             }
             rangeUnlinked.first++;
         }
-        if (pindex->pprev && pindex->nStatus & BLOCK_HAVE_DATA && pindexFirstMissing != NULL) {
+        if (pindex->pprev && pindex->nStatus & BLOCK_HAVE_DATA && pindexFirstNeverProcessed != NULL) {
             if (pindexFirstInvalid == NULL) { // If this block has block data available, some parent doesn't, and has no invalid parents, it must be in mapBlocksUnlinked.
                 assert(foundInUnlinked);
             }
@@ -5471,6 +6486,7 @@ void static CheckBlockIndex()
             // If pindex was the first with a certain property, unset the corresponding variable.
             if (pindex == pindexFirstInvalid) pindexFirstInvalid = NULL;
             if (pindex == pindexFirstMissing) pindexFirstMissing = NULL;
+            if (pindex == pindexFirstNeverProcessed) pindexFirstNeverProcessed = NULL;
             if (pindex == pindexFirstNotTreeValid) pindexFirstNotTreeValid = NULL;
             if (pindex == pindexFirstNotChainValid) pindexFirstNotChainValid = NULL;
             if (pindex == pindexFirstNotScriptsValid) pindexFirstNotScriptsValid = NULL;
@@ -5565,8 +6581,10 @@ bool static AlreadyHave(const CInv& inv)
     case MSG_TX: {
         bool txInMap = false;
         txInMap = mempool.exists(inv.hash);
+        // Best effort: only try output 0 and 1
         return txInMap || mapOrphanTransactions.count(inv.hash) ||
-               pcoinsTip->HaveCoins(inv.hash);
+               pcoinsTip->HaveCoinInCache(COutPoint(inv.hash, 0)) ||
+               pcoinsTip->HaveCoinInCache(COutPoint(inv.hash, 1));
     }
     case MSG_DSTX:
         return mapObfuscationBroadcastTxes.count(inv.hash);
@@ -5667,14 +6685,18 @@ void static ProcessGetData(CNode* pfrom)
                 }
                 // Don't send not-validated blocks
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        pfrom->PushMessage("block", block);
-                    else // MSG_FILTERED_BLOCK)
+                    // Send block from disk, as stored, without deserializing it
+                    if (inv.type == MSG_BLOCK) {
+                        std::shared_ptr<const CDataStream> pdata;
+                        if (!ReadRawBlockFromDisk(pdata, (*mi).second))
+                            assert(!"cannot load block from disk");
+                        pfrom->PushMessage("block", *pdata);
+                    } else // MSG_FILTERED_BLOCK)
                     {
+                        std::shared_ptr<const CBlock> pblock;
+                        if (!ReadBlockFromDisk(pblock, (*mi).second))
+                            assert(!"cannot load block from disk");
+                        const CBlock& block = *pblock;
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter) {
                             CMerkleBlock merkleBlock(block, *pfrom->pfilter);
@@ -7135,18 +8157,31 @@ bool CBlockUndo::WriteToDisk(CDiskBlockPos& pos, const uint256& hashBlock)
 
 bool CBlockUndo::ReadFromDisk(const CDiskBlockPos& pos, const uint256& hashBlock)
 {
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("CBlockUndo::ReadFromDisk : OpenBlockFile failed");
-
-    // Read block
     uint256 hashChecksum;
-    try {
-        filein >> *this;
-        filein >> hashChecksum;
-    } catch (const std::exception& e) {
-        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    std::shared_ptr<const CMappedFile> pfile = MapFinalizedBlockFile(pos, "rev");
+    const char* pbegin;
+    const char* pend;
+    if (pfile && GetMappedRecord(*pfile, pos, sizeof(hashChecksum), pbegin, pend)) {
+        try {
+            CSpanReader reader(pbegin, pend, SER_DISK, CLIENT_VERSION);
+            reader >> *this;
+            reader >> hashChecksum;
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize error - %s", __func__, e.what());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("CBlockUndo::ReadFromDisk : OpenBlockFile failed");
+
+        // Read block
+        try {
+            filein >> *this;
+            filein >> hashChecksum;
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
     }
 
     // Verify checksum
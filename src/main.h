@@ -13,7 +13,9 @@
 #include "config/Divitae-config.h"
 #endif
 
+#include "addressindex.h"
 #include "amount.h"
+#include "blockcache.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "coins.h"
@@ -45,12 +47,16 @@
 #include <boost/unordered_map.hpp>
 
 class CBlockIndex;
+class CCoinsRunningStats;
+class CCoinsViewBackgroundFlush;
+class CCoinsViewDB;
 class CBlockTreeDB;
 class CZerocoinDB;
 class CSporkDB;
 class CBloomFilter;
 class CInv;
 class CScriptCheck;
+class CZerocoinSpendCheck;
 class CValidationInterface;
 class CValidationState;
 
@@ -83,12 +89,28 @@ static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
+/** Maximum number of finalized blk?????.dat and rev?????.dat files kept memory mapped */
+static const unsigned int MAX_MAPPED_BLOCK_FILES = 32;
+/** Number of blocks below the tip whose block and undo files are never pruned */
+static const unsigned int MIN_BLOCKS_TO_KEEP = 288;
+/** Minimum -prune target, enough for MIN_BLOCKS_TO_KEEP blocks and a partial block file */
+static const uint64_t MIN_DISK_SPACE_FOR_BLOCK_FILES = 550 * 1024 * 1024;
 /** Coinbase transaction outputs can only be spent after this number of new blocks (network rule) */
 static const int COINBASE_MATURITY = 100;
 /** Maximum number of script-checking threads allowed */
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** -zkpthreads default (number of threads computing zerocoin proof iterations, 0 = auto) */
+static const int DEFAULT_ZKP_THREADS = 0;
+/** Maximum number of threads deserializing and hashing blocks imported from block files */
+static const int MAX_IMPORT_THREADS = 8;
+/** Maximum number of imported blocks read ahead of validation */
+static const unsigned int MAX_IMPORT_BLOCKS_IN_FLIGHT = 1024;
+/** Maximum number of block file bytes read ahead of validation during an import */
+static const uint64_t MAX_IMPORT_BYTES_IN_FLIGHT = 32 * 1000 * 1000;
+/** Number of blocks whose supply changes are computed and written together by RecalculateSupply() */
+static const int RECALCULATE_SUPPLY_BATCH = 10000;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -126,6 +148,7 @@ struct BlockHasher {
 extern CScript COINBASE_FLAGS;
 extern CCriticalSection cs_main;
 extern CTxMemPool mempool;
+extern CBlockCache blockCache;
 typedef boost::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern BlockMap mapBlockIndex;
 extern uint64_t nLastBlockTx;
@@ -138,12 +161,22 @@ extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fAddressIndex;
+extern bool fSpentIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
-extern unsigned int nCoinCacheSize;
+extern size_t nCoinCacheUsage;
 extern CFeeRate minRelayTxFee;
 extern bool fAlerts;
 extern bool fVerifyingBlocks;
+//! True if the data of some blocks in the active chain is missing, e.g. pruned or below a loaded UTXO snapshot
+extern bool fHavePruned;
+//! True if block and undo files are deleted to stay below nPruneTarget (-prune)
+extern bool fPruneMode;
+//! Number of bytes of block and undo files to keep at most, in prune mode
+extern uint64_t nPruneTarget;
+//! Script and zerocoin proof checks are skipped for this block and its ancestors, 0 to verify all
+extern uint256 hashAssumeValid;
 
 extern bool fLargeWorkForkFound;
 extern bool fLargeWorkInvalidChainFound;
@@ -202,8 +235,18 @@ boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos& pos, const char
 bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp = NULL);
 /** Initialize a new block tree database + block data on disk */
 bool InitBlockIndex();
+/** Store a block of a UTXO snapshot on disk and record its position in pindex */
+bool WriteSnapshotBlock(CBlock& block, CBlockIndex* pindex, CValidationState& state);
+/** Make the block index chain ending in pindexBase, as loaded from a UTXO snapshot, the active chain */
+bool ActivateSnapshotChain(CBlockIndex* pindexBase, CValidationState& state);
 /** Load the block tree and coins database from disk */
 bool LoadBlockIndex(std::string& strError);
+/** Delete the block and undo files in setFilesToPrune, whose blocks are already marked as pruned */
+void UnlinkPrunedFiles(std::set<int>& setFilesToPrune);
+/** Total size of the block and undo files on disk */
+uint64_t CalculateCurrentUsage();
+/** Load the running UTXO set statistics, recomputing them if they do not match the coin database */
+bool LoadCoinsRunningStats();
 /** Unload database information */
 void UnloadBlockIndex();
 /** See whether the protocol update is enforced for connected nodes */
@@ -230,6 +273,12 @@ bool IsInitialBlockDownload();
 std::string GetWarnings(std::string strFor);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256& hash, CTransaction& tx, uint256& hashBlock, bool fAllowSlow = false);
+/** Look up the balance changes of an address in the address index, from nStart to nEnd inclusive when nEnd is not 0 */
+bool GetAddressIndex(const uint160& hashAddress, int nAddressType, std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries, int nStart = 0, int nEnd = 0);
+/** Look up the unspent outputs of an address in the address index */
+bool GetAddressUnspent(const uint160& hashAddress, int nAddressType, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vEntries);
+/** Look up the input that spent an output in the spent index */
+bool GetSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
 /** Find the best known block, and make it the tip of the block chain */
 
 bool DisconnectBlocksAndReprocess(int blocks);
@@ -353,18 +402,21 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CValidationState& state, CCoinsViewCache& inputs, CTxUndo& txundo, int nHeight);
 
-/** Context-independent validity checks */
-bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state);
+/** Context-independent validity checks. If pvChecks is not NULL, zerocoin spend proof
+ *  verification is deferred by appending the checks to it instead of running them. */
+bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvChecks = NULL);
 bool CheckZerocoinMint(const uint256& txHash, const CTxOut& txout, CValidationState& state, bool fCheckOnly = false);
-bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state);
+bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvChecks = NULL);
 bool ContextualCheckZerocoinSpend(const CTransaction& tx, const libzerocoin::CoinSpend& spend, CBlockIndex* pindex);
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx, CTransaction& tx);
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx);
 bool IsBlockHashInChain(const uint256& hashBlock);
 bool ValidOutPoint(const COutPoint out, int nHeight);
-void RecalculateZVITSpent();
-void RecalculateZVITMinted();
-bool RecalculateVITSupply(int nHeightStart);
+/**
+ * Recalculate the money supply from nHeightStart on and, if fZerocoin, the zerocoin mints and supply from the
+ * zerocoin start height on. The blocks are read and their changes computed in parallel, a range at a time.
+ */
+bool RecalculateSupply(int nHeightStart, bool fZerocoin);
 bool ReindexAccumulators(list<uint256>& listMissingCheckpoints, string& strError);
 
 
@@ -419,8 +471,8 @@ private:
 
 public:
     CScriptCheck() : ptxTo(0), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
-    CScriptCheck(const CCoins& txFromIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn) : scriptPubKey(txFromIn.vout[txToIn.vin[nInIn].prevout.n].scriptPubKey),
-                                                                                                                                ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
+    CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn) : scriptPubKey(outIn.scriptPubKey),
+                                                                                                                             ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
 
     bool operator()();
 
@@ -437,11 +489,88 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Closure representing the proof verification of zerocoin spend inputs:
+ * the accumulator, commitment and serial number proofs of CoinSpend::Verify.
+ * The accumulator value is looked up beforehand so that the check itself
+ * does not touch the database. Verified spends are added to the spend cache.
+ * Checks of spends against the same accumulator can be merged, so that they
+ * are verified together with CoinSpend::BatchVerify.
+ */
+class CZerocoinSpendCheck
+{
+private:
+    const libzerocoin::ZerocoinParams* params;
+    CBigNum bnAccumulatorValue;
+    std::vector<const CTransaction*> vTxTo;
+    std::vector<unsigned int> vIn;
+    std::vector<uint256> vHashSpend;
+
+public:
+    CZerocoinSpendCheck() : params(0), bnAccumulatorValue(0) {}
+    CZerocoinSpendCheck(const CTransaction& txToIn, unsigned int nInIn, const libzerocoin::ZerocoinParams* paramsIn, const CBigNum& bnAccumulatorValueIn, const uint256& hashSpendIn) : params(paramsIn), bnAccumulatorValue(bnAccumulatorValueIn),
+                                                                                                                                                                                       vTxTo(1, &txToIn), vIn(1, nInIn), vHashSpend(1, hashSpendIn) {}
+
+    bool operator()();
+
+    /** Number of spend inputs verified by this check */
+    unsigned int size() const { return vIn.size(); }
+
+    /** Returns true if the spends of check are verified against the same accumulator */
+    bool SameAccumulator(const CZerocoinSpendCheck& check) const;
+
+    /** Moves the inputs of check, which must verify against the same accumulator, into this one */
+    void Merge(CZerocoinSpendCheck& check);
+
+    void swap(CZerocoinSpendCheck& check)
+    {
+        std::swap(params, check.params);
+        std::swap(bnAccumulatorValue, check.bnAccumulatorValue);
+        vTxTo.swap(check.vTxTo);
+        vIn.swap(check.vIn);
+        vHashSpend.swap(check.vHashSpend);
+    }
+};
+
+/** Merges zerocoin spend checks made against the same accumulator, when there are enough of them to share the work */
+void BatchZerocoinSpendChecks(std::vector<CZerocoinSpendCheck>& vChecks);
+
+/**
+ * A deferred check run by the -par worker threads. Script checks and
+ * zerocoin spend checks share the same queue so that blocks full of
+ * zerocoin spends are verified on all cores as well.
+ */
+class CValidationCheck
+{
+private:
+    CScriptCheck scriptCheck;
+    CZerocoinSpendCheck zerocoinCheck;
+    bool fZerocoin;
+
+public:
+    CValidationCheck() : fZerocoin(false) {}
+    explicit CValidationCheck(CScriptCheck& check) : fZerocoin(false) { scriptCheck.swap(check); }
+    explicit CValidationCheck(CZerocoinSpendCheck& check) : fZerocoin(true) { zerocoinCheck.swap(check); }
+
+    bool operator()();
+
+    void swap(CValidationCheck& check)
+    {
+        scriptCheck.swap(check.scriptCheck);
+        zerocoinCheck.swap(check.zerocoinCheck);
+        std::swap(fZerocoin, check.fZerocoin);
+    }
+};
+
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(CBlock& block, CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
+/** Read a block through the block cache, sharing the cached copy */
+bool ReadBlockFromDisk(std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex);
+/** Read the serialized bytes of a block through the block cache, for relaying it unchanged */
+bool ReadRawBlockFromDisk(std::shared_ptr<const CDataStream>& pdata, const CBlockIndex* pindex);
 
 
 /** Functions for validating blocks and updating the block tree */
@@ -449,14 +578,16 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  In case pfClean is provided, operation will try to be tolerant about errors, and *pfClean
  *  will be true if no problems were found. Otherwise, the return value will be false in case
- *  of problems. Note that in any case, coins may be modified. */
-bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins, bool* pfClean = NULL);
+ *  of problems. Note that in any case, coins may be modified. If pstats describes the state of
+ *  coins, it is moved back to the previous block too. */
+bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins, bool* pfClean = NULL, CCoinsRunningStats* pstats = NULL);
 
 /** Reprocess a number of blocks to try and get on the correct chain again **/
 bool DisconnectBlocksAndReprocess(int blocks);
 
-/** Apply the effects of this block (with given index) on the UTXO set represented by coins */
-bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins, bool fJustCheck, bool fAlreadyChecked = false);
+/** Apply the effects of this block (with given index) on the UTXO set represented by coins,
+ *  and on pstats if it describes the state of coins */
+bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins, bool fJustCheck, bool fAlreadyChecked = false, CCoinsRunningStats* pstats = NULL);
 
 /** Context-independent validity checks */
 bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW = true);
@@ -627,9 +758,18 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex* pindex);
 /** The currently-connected chain of blocks. */
 extern CChain chainActive;
 
+/** Global variable that points to the coin database below pcoinsTip (protected by cs_main) */
+extern CCoinsViewDB* pcoinsdbview;
+
+/** Global variable that points to the view writing flushes of pcoinsTip to pcoinsdbview in the background */
+extern CCoinsViewBackgroundFlush* pcoinsflusher;
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache* pcoinsTip;
 
+/** Running statistics of the UTXO set at the best block of pcoinsTip (protected by cs_main) */
+extern CCoinsRunningStats coinsStatsTip;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB* pblocktree;
 
@@ -0,0 +1,92 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "muhash.h"
+
+#include "crypto/sha256.h"
+#include "crypto/sha512.h"
+
+#include <string.h>
+
+const size_t CMuHash3072::BYTE_SIZE;
+
+const CBigNum& CMuHash3072::Modulus()
+{
+    static const CBigNum bnModulus = (CBigNum(1) << (BYTE_SIZE * 8)) - CBigNum(1103717);
+    return bnModulus;
+}
+
+CBigNum CMuHash3072::FromBytes(const unsigned char* pch)
+{
+    // Little endian, with a zero byte appended so the value is never read as negative
+    std::vector<unsigned char> vch(pch, pch + BYTE_SIZE);
+    vch.push_back(0);
+    return CBigNum(vch);
+}
+
+void CMuHash3072::ToBytes(const CBigNum& bn, unsigned char* pch)
+{
+    std::vector<unsigned char> vch = bn.getvch();
+    assert(vch.size() <= BYTE_SIZE + 1);
+    memset(pch, 0, BYTE_SIZE);
+    memcpy(pch, vch.data(), std::min(vch.size(), BYTE_SIZE));
+}
+
+CBigNum CMuHash3072::ToNum3072(const std::vector<unsigned char>& vch)
+{
+    // Expand the SHA256 of the element to a 3072-bit number with SHA512 in counter mode
+    unsigned char key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(vch.data(), vch.size()).Finalize(key);
+
+    unsigned char pch[BYTE_SIZE];
+    for (unsigned char i = 0; i < BYTE_SIZE / CSHA512::OUTPUT_SIZE; i++)
+        CSHA512().Write(key, sizeof(key)).Write(&i, 1).Finalize(pch + i * CSHA512::OUTPUT_SIZE);
+
+    return FromBytes(pch) % Modulus();
+}
+
+CMuHash3072::CMuHash3072() : bnNumerator(1), bnDenominator(1)
+{
+}
+
+CBigNum CMuHash3072::GetValue() const
+{
+    if (bnDenominator == 1)
+        return bnNumerator;
+    return bnNumerator.mul_mod(bnDenominator.inverse(Modulus()), Modulus());
+}
+
+void CMuHash3072::Insert(const std::vector<unsigned char>& vch)
+{
+    bnNumerator = bnNumerator.mul_mod(ToNum3072(vch), Modulus());
+}
+
+void CMuHash3072::Remove(const std::vector<unsigned char>& vch)
+{
+    bnDenominator = bnDenominator.mul_mod(ToNum3072(vch), Modulus());
+}
+
+CMuHash3072& CMuHash3072::operator*=(const CMuHash3072& other)
+{
+    bnNumerator = bnNumerator.mul_mod(other.bnNumerator, Modulus());
+    bnDenominator = bnDenominator.mul_mod(other.bnDenominator, Modulus());
+    return *this;
+}
+
+CMuHash3072& CMuHash3072::operator/=(const CMuHash3072& other)
+{
+    bnNumerator = bnNumerator.mul_mod(other.bnDenominator, Modulus());
+    bnDenominator = bnDenominator.mul_mod(other.bnNumerator, Modulus());
+    return *this;
+}
+
+uint256 CMuHash3072::Finalize() const
+{
+    unsigned char pch[BYTE_SIZE];
+    ToBytes(GetValue(), pch);
+
+    uint256 hash;
+    CSHA256().Write(pch, BYTE_SIZE).Finalize(hash.begin());
+    return hash;
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DIVIT_MUHASH_H
+#define DIVIT_MUHASH_H
+
+#include "libzerocoin/bignum.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <vector>
+
+/**
+ * A hash of a multiset of byte strings that can be updated one element at a time (MuHash).
+ *
+ * Every element is mapped to a number modulo the prime 2^3072 - 1103717 and the set is
+ * represented by the product of those numbers, so the result does not depend on the order
+ * in which elements are added or removed. Removals are collected in a separate denominator
+ * and only divided out when the hash is finalized or serialized.
+ */
+class CMuHash3072
+{
+public:
+    //! Size of a group element, and of the serialized state
+    static const size_t BYTE_SIZE = 384;
+
+private:
+    CBigNum bnNumerator;
+    CBigNum bnDenominator;
+
+    static const CBigNum& Modulus();
+    static CBigNum ToNum3072(const std::vector<unsigned char>& vch);
+    static CBigNum FromBytes(const unsigned char* pch);
+    static void ToBytes(const CBigNum& bn, unsigned char* pch);
+
+    CBigNum GetValue() const;
+
+public:
+    //! The hash of the empty set
+    CMuHash3072();
+
+    //! Add an element to the set
+    void Insert(const std::vector<unsigned char>& vch);
+
+    //! Remove an element from the set
+    void Remove(const std::vector<unsigned char>& vch);
+
+    //! Add all elements of another set
+    CMuHash3072& operator*=(const CMuHash3072& other);
+
+    //! Remove all elements of another set
+    CMuHash3072& operator/=(const CMuHash3072& other);
+
+    //! The SHA256 of the set's group element
+    uint256 Finalize() const;
+
+    friend bool operator==(const CMuHash3072& a, const CMuHash3072& b) { return a.GetValue() == b.GetValue(); }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return BYTE_SIZE;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        unsigned char pch[BYTE_SIZE];
+        ToBytes(GetValue(), pch);
+        s.write((char*)pch, BYTE_SIZE);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        unsigned char pch[BYTE_SIZE];
+        s.read((char*)pch, BYTE_SIZE);
+        bnNumerator = FromBytes(pch);
+        bnDenominator = 1;
+    }
+};
+
+#endif // DIVIT_MUHASH_H
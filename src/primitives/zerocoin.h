@@ -246,4 +246,49 @@ public:
     int GetNeededSpends();
 };
 
+/**
+ * Witness of a mint, accumulated from the checkpoint before the mint's group of ten blocks up to,
+ * not including, the block at nHeight. Kept by the wallet so a spend only adds the blocks since.
+ */
+class CMintWitness
+{
+public:
+    libzerocoin::CoinDenomination denom;
+    int nHeightMint;
+    int nHeight;
+    //! The block at nHeight - 1, to tell whether the witness is still on the active chain
+    uint256 hashBlock;
+    int nMintsAdded;
+    CBigNum bnValue;
+
+    CMintWitness()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        denom = libzerocoin::ZQ_ERROR;
+        nHeightMint = 0;
+        nHeight = 0;
+        hashBlock = 0;
+        nMintsAdded = 0;
+        bnValue = 0;
+    }
+
+    bool IsNull() const { return bnValue == 0; }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(denom);
+        READWRITE(nHeightMint);
+        READWRITE(nHeight);
+        READWRITE(hashBlock);
+        READWRITE(nMintsAdded);
+        READWRITE(bnValue);
+    };
+};
+
 #endif //DIVIT_ZEROCOIN_H
@@ -11,12 +11,14 @@
 #include "clientversion.h"
 #include "main.h"
 #include "rpcserver.h"
+#include "snapshot.h"
 #include "sync.h"
 #include "txdb.h"
 #include "util.h"
 #include "utilmoneystr.h"
 #include "accumulatormap.h"
 #include "accumulators.h"
+#include "zvitspendcache.h"
 
 #include <stdint.h>
 #include <univalue.h>
@@ -121,7 +123,7 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
 
     UniValue zVitObj(UniValue::VOBJ);
     for (auto denom : libzerocoin::zerocoinDenomList) {
-        zVitObj.push_back(Pair(to_string(denom), ValueFromAmount(blockindex->mapZerocoinSupply.at(denom) * (denom*COIN))));
+        zVitObj.push_back(Pair(to_string(denom), ValueFromAmount(blockindex->GetZerocoinSupply(denom) * (denom*COIN))));
     }
     zVitObj.push_back(Pair("total", ValueFromAmount(blockindex->GetZerocoinSupply())));
     result.push_back(Pair("zDIVITsupply", zVitObj));
@@ -360,6 +362,9 @@ UniValue getblock(const UniValue& params, bool fHelp)
     CBlock block;
     CBlockIndex* pblockindex = mapBlockIndex[hash];
 
+    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+
     if (!ReadBlockFromDisk(block, pblockindex))
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
 
@@ -426,41 +431,138 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( full )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "The statistics are kept up to date as blocks are connected, unless full is set.\n"
+
+            "\nArguments:\n"
+            "1. full    (boolean, optional, default=false) Also scan the whole set for the transaction count and\n"
+            "           the serialized hash. Note this may take some time.\n"
 
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of transactions, only if full is set\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
             "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash, only if full is set\n"
+            "  \"muhash\": \"hash\",   (string) The order independent hash of the set (MuHash)\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
 
             "\nExamples:\n" +
-            HelpExampleCli("gettxoutsetinfo", "") + HelpExampleRpc("gettxoutsetinfo", ""));
+            HelpExampleCli("gettxoutsetinfo", "") + HelpExampleCli("gettxoutsetinfo", "true") + HelpExampleRpc("gettxoutsetinfo", ""));
+
+    bool fFull = params.size() > 0 && params[0].get_bool();
 
     LOCK(cs_main);
 
-    UniValue ret(UniValue::VOBJ);
+    // Only out of step if they could not be updated with the last block, recompute them then
+    if (coinsStatsTip.hashBlock != pcoinsTip->GetBestBlock()) {
+        FlushStateToDisk();
+        if (!pcoinsdbview->ComputeRunningStats(coinsStatsTip))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to compute UTXO set statistics");
+    }
 
-    CCoinsStats stats;
-    FlushStateToDisk();
-    if (pcoinsTip->GetStats(stats)) {
-        ret.push_back(Pair("height", (int64_t)stats.nHeight));
-        ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("height", (int64_t)mapBlockIndex.at(coinsStatsTip.hashBlock)->nHeight));
+    ret.push_back(Pair("bestblock", coinsStatsTip.hashBlock.GetHex()));
+    if (fFull) {
+        CCoinsStats stats;
+        FlushStateToDisk();
+        if (!pcoinsTip->GetStats(stats))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read UTXO set");
         ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
         ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
         ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
         ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
-        ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+    } else {
+        ret.push_back(Pair("txouts", (int64_t)coinsStatsTip.nTransactionOutputs));
+        ret.push_back(Pair("bytes_serialized", (int64_t)coinsStatsTip.nSerializedSize));
     }
+    ret.push_back(Pair("muhash", coinsStatsTip.muhash.Finalize().GetHex()));
+    ret.push_back(Pair("total_amount", ValueFromAmount(coinsStatsTip.nTotalAmount)));
+    return ret;
+}
+
+UniValue dumptxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the unspent transaction output set, the zerocoin database and the block index\n"
+            "of the active chain to a snapshot file that loadtxoutset can bootstrap a new node from.\n"
+            "Note this call may take some time.\n"
+
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The snapshot file to create, relative to the data directory\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"height\":n,              (numeric) The height of the snapshot base block\n"
+            "  \"bestblock\": \"hex\",      (string) The snapshot base block hash\n"
+            "  \"txouts\": n,             (numeric) The number of unspent outputs written\n"
+            "  \"zerocoin_entries\": n,   (numeric) The number of zerocoin database records written\n"
+            "  \"hash_contents\": \"hash\", (string) The hash to pin in the chain parameters for loadtxoutset\n"
+            "  \"path\": \"path\"           (string) The absolute path of the snapshot file\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("dumptxoutset", "\"utxo.dat\"") + HelpExampleRpc("dumptxoutset", "\"utxo.dat\""));
+
+    boost::filesystem::path path = boost::filesystem::absolute(params[0].get_str(), GetDataDir());
+    CSnapshotMetadata metadata;
+    std::string strError;
+    if (!DumpTxOutSet(path, metadata, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("height", metadata.nHeight));
+    ret.push_back(Pair("bestblock", metadata.hashBlock.GetHex()));
+    ret.push_back(Pair("txouts", (int64_t)metadata.nCoins));
+    ret.push_back(Pair("zerocoin_entries", (int64_t)metadata.nZerocoinEntries));
+    ret.push_back(Pair("hash_contents", metadata.hashContents.GetHex()));
+    ret.push_back(Pair("path", path.string()));
+    return ret;
+}
+
+UniValue loadtxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nMakes the chain state of a snapshot written by dumptxoutset the active chain.\n"
+            "Only snapshots pinned in this version are accepted, and only by a node without blocks.\n"
+            "Blocks below the snapshot are not downloaded; the node cannot reorganize below it.\n"
+
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The snapshot file, relative to the data directory\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"height\":n,              (numeric) The new block height\n"
+            "  \"bestblock\": \"hex\",      (string) The new best block hash\n"
+            "  \"txouts\": n,             (numeric) The number of unspent outputs loaded\n"
+            "  \"zerocoin_entries\": n    (numeric) The number of zerocoin database records loaded\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("loadtxoutset", "\"utxo.dat\"") + HelpExampleRpc("loadtxoutset", "\"utxo.dat\""));
+
+    boost::filesystem::path path = boost::filesystem::absolute(params[0].get_str(), GetDataDir());
+    CSnapshotMetadata metadata;
+    std::string strError;
+    if (!LoadTxOutSet(path, metadata, strError))
+        throw JSONRPCError(RPC_DATABASE_ERROR, strError);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("height", metadata.nHeight));
+    ret.push_back(Pair("bestblock", metadata.hashBlock.GetHex()));
+    ret.push_back(Pair("txouts", (int64_t)metadata.nCoins));
+    ret.push_back(Pair("zerocoin_entries", (int64_t)metadata.nZerocoinEntries));
     return ret;
 }
 
@@ -491,7 +593,6 @@ UniValue gettxout(const UniValue& params, bool fHelp)
             "        ,...\n"
             "     ]\n"
             "  },\n"
-            "  \"version\" : n,            (numeric) The version\n"
             "  \"coinbase\" : true|false   (boolean) Coinbase or not\n"
             "}\n"
 
@@ -514,33 +615,33 @@ UniValue gettxout(const UniValue& params, bool fHelp)
     if (params.size() > 2)
         fMempool = params[2].get_bool();
 
-    CCoins coins;
+    if (n < 0)
+        return NullUniValue;
+    COutPoint out(hash, n);
+
+    Coin coin;
     if (fMempool) {
         LOCK(mempool.cs);
         CCoinsViewMemPool view(pcoinsTip, mempool);
-        if (!view.GetCoins(hash, coins))
+        if (!view.GetCoin(out, coin) || mempool.isSpent(out))
             return NullUniValue;
-        mempool.pruneSpent(hash, coins); // TODO: this should be done by the CCoinsViewMemPool
     } else {
-        if (!pcoinsTip->GetCoins(hash, coins))
+        if (!pcoinsTip->GetCoin(out, coin))
             return NullUniValue;
     }
-    if (n < 0 || (unsigned int)n >= coins.vout.size() || coins.vout[n].IsNull())
-        return NullUniValue;
 
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     CBlockIndex* pindex = it->second;
     ret.push_back(Pair("bestblock", pindex->GetBlockHash().GetHex()));
-    if ((unsigned int)coins.nHeight == MEMPOOL_HEIGHT)
+    if ((unsigned int)coin.nHeight == MEMPOOL_HEIGHT)
         ret.push_back(Pair("confirmations", 0));
     else
-        ret.push_back(Pair("confirmations", pindex->nHeight - coins.nHeight + 1));
-    ret.push_back(Pair("value", ValueFromAmount(coins.vout[n].nValue)));
+        ret.push_back(Pair("confirmations", pindex->nHeight - coin.nHeight + 1));
+    ret.push_back(Pair("value", ValueFromAmount(coin.out.nValue)));
     UniValue o(UniValue::VOBJ);
-    ScriptPubKeyToJSON(coins.vout[n].scriptPubKey, o, true);
+    ScriptPubKeyToJSON(coin.out.scriptPubKey, o, true);
     ret.push_back(Pair("scriptPubKey", o));
-    ret.push_back(Pair("version", coins.nVersion));
-    ret.push_back(Pair("coinbase", coins.fCoinBase));
+    ret.push_back(Pair("coinbase", coin.fCoinBase));
 
     return ret;
 }
@@ -622,6 +723,8 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
             "  \"difficulty\": xxxxxx,     (numeric) the current difficulty\n"
             "  \"verificationprogress\": xxxx, (numeric) estimate of verification progress [0..1]\n"
             "  \"chainwork\": \"xxxx\"     (string) total amount of work in active chain, in hexadecimal\n"
+            "  \"pruned\": xx,             (boolean) if the blocks are subject to pruning\n"
+            "  \"pruneheight\": xxxxxx,    (numeric) lowest-height complete block stored, only present if blocks were pruned\n"
             "  \"softforks\": [            (array) status of softforks in progress\n"
             "     {\n"
             "        \"id\": \"xxxx\",        (string) name of softfork\n"
@@ -650,6 +753,14 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
     obj.push_back(Pair("difficulty", (double)GetDifficulty()));
     obj.push_back(Pair("verificationprogress", Checkpoints::GuessVerificationProgress(chainActive.Tip())));
     obj.push_back(Pair("chainwork", chainActive.Tip()->nChainWork.GetHex()));
+    obj.push_back(Pair("pruned", fPruneMode));
+    if (fHavePruned) {
+        CBlockIndex* block = chainActive.Tip();
+        while (block && block->pprev && (block->pprev->nStatus & BLOCK_HAVE_DATA))
+            block = block->pprev;
+
+        obj.push_back(Pair("pruneheight", block->nHeight));
+    }
     CBlockIndex* tip = chainActive.Tip();
     UniValue softforks(UniValue::VARR);
     softforks.push_back(SoftForkDesc("bip65", newBlockVersion, tip));
@@ -849,7 +960,13 @@ UniValue mempoolInfoToJSON()
     UniValue ret(UniValue::VOBJ);
     ret.push_back(Pair("size", (int64_t) mempool.size()));
     ret.push_back(Pair("bytes", (int64_t) mempool.GetTotalTxSize()));
-    //ret.push_back(Pair("usage", (int64_t) mempool.DynamicMemoryUsage()));
+    ret.push_back(Pair("usage", (int64_t) mempool.DynamicMemoryUsage()));
+
+    uint64_t nLookups, nHits;
+    GetZerocoinSpendCacheStats(nLookups, nHits);
+    ret.push_back(Pair("zerocoinspendcachelookups", nLookups));
+    ret.push_back(Pair("zerocoinspendcachehits", nHits));
+    ret.push_back(Pair("zerocoinspendcachehitrate", nLookups ? (double)nHits / nLookups : 0.0));
 
     return ret;
 }
@@ -865,6 +982,10 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
             "{\n"
             "  \"size\": xxxxx                (numeric) Current tx count\n"
             "  \"bytes\": xxxxx               (numeric) Sum of all tx sizes\n"
+            "  \"usage\": xxxxx               (numeric) Total memory usage for the mempool\n"
+            "  \"zerocoinspendcachelookups\": xxxxx  (numeric) Lookups in the verified zerocoin spend cache\n"
+            "  \"zerocoinspendcachehits\": xxxxx     (numeric) Spends whose proofs were found already verified\n"
+            "  \"zerocoinspendcachehitrate\": x.xxx  (numeric) Fraction of lookups that were hits\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -982,6 +1103,58 @@ UniValue findserial(const UniValue& params, bool fHelp)
     return ret;
 }
 
+static UniValue ZerocoinFilterStatsToJSON(const CZerocoinFilterStats& stats)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("loaded", stats.fLoaded));
+    obj.push_back(Pair("elements", (uint64_t)stats.nElements));
+    obj.push_back(Pair("capacity", (uint64_t)stats.nCapacity));
+    obj.push_back(Pair("bytes", (uint64_t)stats.nBytes));
+    obj.push_back(Pair("hashfuncs", (int)stats.nHashFuncs));
+    obj.push_back(Pair("lookups", (uint64_t)stats.nLookups));
+    obj.push_back(Pair("filtered", (uint64_t)stats.nFiltered));
+    obj.push_back(Pair("falsepositives", (uint64_t)stats.nFalsePositives));
+    uint64_t nNegatives = stats.nFiltered + stats.nFalsePositives;
+    obj.push_back(Pair("falsepositiverate", nNegatives ? (double)stats.nFalsePositives / nNegatives : 0.0));
+    return obj;
+}
+
+UniValue getzerocoinfilterinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getzerocoinfilterinfo\n"
+            "\nReturns the state of the in-memory filters that answer lookups of spent serials and minted pubcoins\n"
+            "missing from the zerocoin database without reading it.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"spends\": {             (object) the filter of spent serial hashes\n"
+            "    \"loaded\": true|false,     (boolean) whether lookups use the filter\n"
+            "    \"elements\": n,            (numeric) hashes inserted since the filter was built\n"
+            "    \"capacity\": n,            (numeric) hashes the filter is sized for before it is rebuilt\n"
+            "    \"bytes\": n,               (numeric) memory used by the filter\n"
+            "    \"hashfuncs\": n,           (numeric) bits set per hash\n"
+            "    \"lookups\": n,             (numeric) lookups since startup\n"
+            "    \"filtered\": n,            (numeric) lookups answered without reading the database\n"
+            "    \"falsepositives\": n,      (numeric) lookups passed to the database that were not found\n"
+            "    \"falsepositiverate\": x.x  (numeric) share of the lookups of missing hashes that read the database\n"
+            "  },\n"
+            "  \"mints\": {...}          (object) the filter of minted pubcoin hashes, the same fields\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getzerocoinfilterinfo", "") + HelpExampleRpc("getzerocoinfilterinfo", ""));
+
+    if (!zerocoinDB)
+        throw JSONRPCError(RPC_DATABASE_ERROR, "zerocoin database is not loaded");
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("spends", ZerocoinFilterStatsToJSON(zerocoinDB->GetSpendFilterStats())));
+    ret.push_back(Pair("mints", ZerocoinFilterStatsToJSON(zerocoinDB->GetMintFilterStats())));
+    return ret;
+}
+
 UniValue getaccumulatorvalues(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -90,8 +90,13 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"lockunspent", 1},
         {"importprivkey", 2},
         {"importaddress", 2},
+        {"gettxoutsetinfo", 0},
         {"verifychain", 0},
         {"verifychain", 1},
+        {"getaddressbalance", 0},
+        {"getaddresstxids", 0},
+        {"getaddressutxos", 0},
+        {"getspentinfo", 0},
         {"keypoolrefill", 0},
         {"getrawmempool", 0},
         {"estimatefee", 0},
@@ -10,13 +10,16 @@
 #include "clientversion.h"
 #include "init.h"
 #include "main.h"
+#include "memusage.h"
 #include "prosperitynode-sync.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpcserver.h"
+#include "script/sigcache.h"
 #include "spork.h"
 #include "mn-spork.h"
 #include "timedata.h"
+#include "txdb.h"
 #include "util.h"
 #ifdef ENABLE_WALLET
 #include "wallet.h"
@@ -126,7 +129,7 @@ UniValue getinfo(const UniValue& params, bool fHelp)
     obj.push_back(Pair("moneysupply",ValueFromAmount(chainActive.Tip()->nMoneySupply)));
     UniValue zVitObj(UniValue::VOBJ);
     for (auto denom : libzerocoin::zerocoinDenomList) {
-        zVitObj.push_back(Pair(to_string(denom), ValueFromAmount(chainActive.Tip()->mapZerocoinSupply.at(denom) * (denom*COIN))));
+        zVitObj.push_back(Pair(to_string(denom), ValueFromAmount(chainActive.Tip()->GetZerocoinSupply(denom) * (denom*COIN))));
     }
     zVitObj.push_back(Pair("total", ValueFromAmount(chainActive.Tip()->GetZerocoinSupply())));
     obj.push_back(Pair("zDIVITsupply", zVitObj));
@@ -604,6 +607,327 @@ UniValue setmocktime(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+UniValue getmemoryinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getmemoryinfo\n"
+            "\nReturns the heap memory used by the node's main in-memory data structures, in bytes.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"coinscache\": {                (json object) The in-memory UTXO cache\n"
+            "    \"usage\": xxxxx,              (numeric) Memory used by the cache of the chain tip\n"
+            "    \"entries\": xxxxx,            (numeric) Number of cached outputs\n"
+            "    \"flushing\": xxxxx,           (numeric) Memory held by the cache that is still being written to disk\n"
+            "    \"flushingentries\": xxxxx,    (numeric) Number of outputs that are still being written to disk\n"
+            "    \"budget\": xxxxx              (numeric) Memory the coins cache may use (-dbcache)\n"
+            "  },\n"
+            "  \"mempool\": {                   (json object) The transaction memory pool\n"
+            "    \"usage\": xxxxx,              (numeric) Memory used by the transactions and their indexes\n"
+            "    \"size\": xxxxx                (numeric) Number of transactions\n"
+            "  },\n"
+            "  \"blockindex\": {                (json object) The in-memory block index\n"
+            "    \"usage\": xxxxx,              (numeric) Memory used by the block index entries and map\n"
+            "    \"size\": xxxxx                (numeric) Number of block index entries\n"
+            "  },\n"
+            "  \"sigcache\": {                  (json object) The cache of verified signatures\n"
+            "    \"usage\": xxxxx,              (numeric) Memory used by the cached signatures\n"
+            "    \"size\": xxxxx                (numeric) Number of cached signatures\n"
+            "  },\n"
+            "  \"blockcache\": {                (json object) The cache of recently read blocks\n"
+            "    \"usage\": xxxxx,              (numeric) Memory used by the cached blocks\n"
+            "    \"size\": xxxxx,               (numeric) Number of cached blocks\n"
+            "    \"budget\": xxxxx,             (numeric) Memory the block cache may use (-blockcachesize)\n"
+            "    \"hits\": xxxxx,               (numeric) Reads served from the cache\n"
+            "    \"misses\": xxxxx              (numeric) Reads that went to disk\n"
+            "  },\n"
+            "  \"total\": xxxxx                 (numeric) Sum of the usages above\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getmemoryinfo", "") + HelpExampleRpc("getmemoryinfo", ""));
+
+    LOCK(cs_main);
+
+    UniValue coins(UniValue::VOBJ);
+    size_t nCoinsUsage = pcoinsTip->DynamicMemoryUsage();
+    size_t nFlushingUsage = pcoinsflusher->DynamicMemoryUsage();
+    coins.push_back(Pair("usage", (uint64_t)nCoinsUsage));
+    coins.push_back(Pair("entries", (uint64_t)pcoinsTip->GetCacheSize()));
+    coins.push_back(Pair("flushing", (uint64_t)nFlushingUsage));
+    coins.push_back(Pair("flushingentries", (uint64_t)pcoinsflusher->GetWritingSize()));
+    coins.push_back(Pair("budget", (uint64_t)nCoinCacheUsage));
+
+    UniValue pool(UniValue::VOBJ);
+    size_t nMempoolUsage = mempool.DynamicMemoryUsage();
+    pool.push_back(Pair("usage", (uint64_t)nMempoolUsage));
+    pool.push_back(Pair("size", (uint64_t)mempool.size()));
+
+    UniValue blockindex(UniValue::VOBJ);
+    size_t nBlockIndexUsage = memusage::DynamicUsage(mapBlockIndex) + mapBlockIndex.size() * memusage::MallocUsage(sizeof(CBlockIndex));
+    blockindex.push_back(Pair("usage", (uint64_t)nBlockIndexUsage));
+    blockindex.push_back(Pair("size", (uint64_t)mapBlockIndex.size()));
+
+    UniValue sigcache(UniValue::VOBJ);
+    size_t nSigCacheUsage = SignatureCacheDynamicMemoryUsage();
+    sigcache.push_back(Pair("usage", (uint64_t)nSigCacheUsage));
+    sigcache.push_back(Pair("size", (uint64_t)SignatureCacheSize()));
+
+    UniValue blockcache(UniValue::VOBJ);
+    size_t nBlockCacheUsage = blockCache.DynamicMemoryUsage();
+    uint64_t nHits, nMisses;
+    blockCache.GetStats(nHits, nMisses);
+    blockcache.push_back(Pair("usage", (uint64_t)nBlockCacheUsage));
+    blockcache.push_back(Pair("size", (uint64_t)blockCache.Size()));
+    blockcache.push_back(Pair("budget", (uint64_t)blockCache.GetMaxUsage()));
+    blockcache.push_back(Pair("hits", nHits));
+    blockcache.push_back(Pair("misses", nMisses));
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coinscache", coins));
+    ret.push_back(Pair("mempool", pool));
+    ret.push_back(Pair("blockindex", blockindex));
+    ret.push_back(Pair("sigcache", sigcache));
+    ret.push_back(Pair("blockcache", blockcache));
+    ret.push_back(Pair("total", (uint64_t)(nCoinsUsage + nFlushingUsage + nMempoolUsage + nBlockIndexUsage + nSigCacheUsage + nBlockCacheUsage)));
+    return ret;
+}
+
+static void ParseAddresses(const UniValue& param, std::vector<std::pair<uint160, int> >& vAddresses)
+{
+    std::vector<std::string> vStrings;
+    if (param.isStr()) {
+        vStrings.push_back(param.get_str());
+    } else if (param.isObject()) {
+        UniValue addresses = find_value(param.get_obj(), "addresses");
+        if (!addresses.isArray())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Addresses is expected to be an array");
+        for (unsigned int i = 0; i < addresses.size(); i++)
+            vStrings.push_back(addresses[i].get_str());
+    } else {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected an address or an object with an array of addresses");
+    }
+
+    for (const std::string& strAddress : vStrings) {
+        CBitcoinAddress address(strAddress);
+        CKeyID keyID;
+        if (address.GetKeyID(keyID))
+            vAddresses.push_back(std::make_pair(uint160(keyID), (int)ADDRESS_PUBKEYHASH));
+        else if (address.IsValid() && address.IsScript())
+            vAddresses.push_back(std::make_pair(uint160(boost::get<CScriptID>(address.Get())), (int)ADDRESS_SCRIPTHASH));
+        else
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + strAddress);
+    }
+}
+
+static std::string AddressToString(int nAddressType, const uint160& hashAddress)
+{
+    if (nAddressType == ADDRESS_SCRIPTHASH)
+        return CBitcoinAddress(CScriptID(hashAddress)).ToString();
+    return CBitcoinAddress(CKeyID(hashAddress)).ToString();
+}
+
+UniValue getaddressbalance(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressbalance {\"addresses\": [\"address\",...]}\n"
+            "\nReturns the balance of addresses. Requires -addressindex.\n"
+
+            "\nArguments:\n"
+            "{\n"
+            "  \"addresses\"  (array, required) The Divitae addresses, or a single address as string\n"
+            "}\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\": xxxxx,   (numeric) The current balance in satoshis\n"
+            "  \"received\": xxxxx   (numeric) The total number of satoshis received, change included\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'") +
+            HelpExampleRpc("getaddressbalance", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}"));
+
+    std::vector<std::pair<uint160, int> > vAddresses;
+    ParseAddresses(params[0], vAddresses);
+
+    CAmount nBalance = 0;
+    CAmount nReceived = 0;
+    for (const std::pair<uint160, int>& address : vAddresses) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vEntries;
+        if (!GetAddressIndex(address.first, address.second, vEntries))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        for (const std::pair<CAddressIndexKey, CAmount>& entry : vEntries) {
+            if (entry.second > 0)
+                nReceived += entry.second;
+            nBalance += entry.second;
+        }
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("balance", nBalance));
+    result.push_back(Pair("received", nReceived));
+    return result;
+}
+
+UniValue getaddresstxids(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddresstxids {\"addresses\": [\"address\",...], \"start\": n, \"end\": n}\n"
+            "\nReturns the txids of the transactions of addresses, in chain order. Requires -addressindex.\n"
+
+            "\nArguments:\n"
+            "{\n"
+            "  \"addresses\"  (array, required) The Divitae addresses, or a single address as string\n"
+            "  \"start\"      (numeric, optional) The first block height to include\n"
+            "  \"end\"        (numeric, optional) The last block height to include\n"
+            "}\n"
+
+            "\nResult:\n"
+            "[\n"
+            "  \"transactionid\"  (string) The transaction id\n"
+            "  ,...\n"
+            "]\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"start\": 1000, \"end\": 2000}'") +
+            HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"start\": 1000, \"end\": 2000}"));
+
+    std::vector<std::pair<uint160, int> > vAddresses;
+    ParseAddresses(params[0], vAddresses);
+
+    int nStart = 0;
+    int nEnd = 0;
+    if (params[0].isObject()) {
+        UniValue start = find_value(params[0].get_obj(), "start");
+        UniValue end = find_value(params[0].get_obj(), "end");
+        if (!start.isNull() || !end.isNull()) {
+            if (!start.isNum() || !end.isNum())
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Start and end are expected to be given together");
+            nStart = start.get_int();
+            nEnd = end.get_int();
+            if (nStart <= 0 || nEnd <= 0)
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Start and end are expected to be greater than zero");
+            if (nEnd < nStart)
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "End is expected to be at least start");
+        }
+    }
+
+    // Height and position in the block order the transactions of all addresses together
+    std::set<std::pair<std::pair<int, unsigned int>, uint256> > setTxids;
+    for (const std::pair<uint160, int>& address : vAddresses) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vEntries;
+        if (!GetAddressIndex(address.first, address.second, vEntries, nStart, nEnd))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        for (const std::pair<CAddressIndexKey, CAmount>& entry : vEntries)
+            setTxids.insert(std::make_pair(std::make_pair(entry.first.nHeight, entry.first.nTxIndex), entry.first.txhash));
+    }
+
+    UniValue result(UniValue::VARR);
+    for (const std::pair<std::pair<int, unsigned int>, uint256>& txid : setTxids)
+        result.push_back(txid.second.GetHex());
+    return result;
+}
+
+UniValue getaddressutxos(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressutxos {\"addresses\": [\"address\",...]}\n"
+            "\nReturns the unspent outputs paying to addresses. Requires -addressindex.\n"
+
+            "\nArguments:\n"
+            "{\n"
+            "  \"addresses\"  (array, required) The Divitae addresses, or a single address as string\n"
+            "}\n"
+
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\": \"address\",  (string) The address\n"
+            "    \"txid\": \"txid\",        (string) The id of the transaction of the output\n"
+            "    \"outputIndex\": n,      (numeric) The index of the output in the transaction\n"
+            "    \"script\": \"hex\",       (string) The script of the output, hex encoded\n"
+            "    \"satoshis\": n,         (numeric) The value of the output in satoshis\n"
+            "    \"height\": n            (numeric) The height of the block of the transaction\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'") +
+            HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}"));
+
+    std::vector<std::pair<uint160, int> > vAddresses;
+    ParseAddresses(params[0], vAddresses);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspent;
+    for (const std::pair<uint160, int>& address : vAddresses) {
+        if (!GetAddressUnspent(address.first, address.second, vUnspent))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    }
+    std::stable_sort(vUnspent.begin(), vUnspent.end(), [](const std::pair<CAddressUnspentKey, CAddressUnspentValue>& a, const std::pair<CAddressUnspentKey, CAddressUnspentValue>& b) {
+        return a.second.nHeight < b.second.nHeight;
+    });
+
+    UniValue result(UniValue::VARR);
+    for (const std::pair<CAddressUnspentKey, CAddressUnspentValue>& entry : vUnspent) {
+        UniValue output(UniValue::VOBJ);
+        output.push_back(Pair("address", AddressToString(entry.first.nAddressType, entry.first.hashAddress)));
+        output.push_back(Pair("txid", entry.first.txhash.GetHex()));
+        output.push_back(Pair("outputIndex", (int)entry.first.nIndex));
+        output.push_back(Pair("script", HexStr(entry.second.script.begin(), entry.second.script.end())));
+        output.push_back(Pair("satoshis", entry.second.nValue));
+        output.push_back(Pair("height", entry.second.nHeight));
+        result.push_back(output);
+    }
+    return result;
+}
+
+UniValue getspentinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1 || !params[0].isObject())
+        throw runtime_error(
+            "getspentinfo {\"txid\": \"txid\", \"index\": n}\n"
+            "\nReturns the input that spent an output. Requires -spentindex.\n"
+
+            "\nArguments:\n"
+            "{\n"
+            "  \"txid\"   (string, required) The id of the transaction of the output\n"
+            "  \"index\"  (numeric, required) The index of the output in the transaction\n"
+            "}\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"txid\": \"txid\",  (string) The id of the spending transaction\n"
+            "  \"index\": n,      (numeric) The index of the spending input\n"
+            "  \"height\": n      (numeric) The height of the block of the spending transaction\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getspentinfo", "'{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}'") +
+            HelpExampleRpc("getspentinfo", "{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}"));
+
+    UniValue txid = find_value(params[0].get_obj(), "txid");
+    UniValue index = find_value(params[0].get_obj(), "index");
+    if (!txid.isStr() || !index.isNum())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid txid or index");
+
+    CSpentIndexKey key(ParseHashV(txid, "txid"), index.get_int());
+    CSpentIndexValue value;
+    if (!GetSpentIndex(key, value) || value.IsNull())
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("txid", value.txid.GetHex()));
+    result.push_back(Pair("index", (int)value.nInputIndex));
+    result.push_back(Pair("height", value.nHeight));
+    return result;
+}
+
 #ifdef ENABLE_WALLET
 UniValue getstakingstatus(const UniValue& params, bool fHelp)
 {
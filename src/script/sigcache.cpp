@@ -5,6 +5,7 @@
 
 #include "sigcache.h"
 
+#include "memusage.h"
 #include "pubkey.h"
 #include "random.h"
 #include "uint256.h"
@@ -26,9 +27,13 @@ private:
      //! sigdata_type is (signature hash, signature, public key):
     typedef boost::tuple<uint256, std::vector<unsigned char>, CPubKey> sigdata_type;
     std::set< sigdata_type> setValid;
+    //! Heap memory of the signatures held by setValid
+    size_t nSignaturesUsage;
     boost::shared_mutex cs_sigcache;
 
 public:
+    CSignatureCache() : nSignaturesUsage(0) {}
+
     bool
     Get(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
     {
@@ -62,19 +67,50 @@ public:
             std::set<sigdata_type>::iterator it = setValid.lower_bound(sigdata_type(randomHash));
             if (it == setValid.end())
                 it = setValid.begin();
-            setValid.erase(*it);
+            nSignaturesUsage -= memusage::DynamicUsage(it->get<1>());
+            setValid.erase(it);
         }
 
         sigdata_type k(hash, vchSig, pubKey);
-        setValid.insert(k);
+        std::pair<std::set<sigdata_type>::iterator, bool> ret = setValid.insert(k);
+        if (ret.second)
+            nSignaturesUsage += memusage::DynamicUsage(ret.first->get<1>());
+    }
+
+    size_t Size()
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.size();
+    }
+
+    size_t DynamicMemoryUsage()
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return memusage::DynamicUsage(setValid) + nSignaturesUsage;
     }
 };
 
+CSignatureCache& GetSignatureCache()
+{
+    static CSignatureCache signatureCache;
+    return signatureCache;
+}
+
+}
+
+size_t SignatureCacheSize()
+{
+    return GetSignatureCache().Size();
+}
+
+size_t SignatureCacheDynamicMemoryUsage()
+{
+    return GetSignatureCache().DynamicMemoryUsage();
 }
 
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
-    static CSignatureCache signatureCache;
+    CSignatureCache& signatureCache = GetSignatureCache();
 
     if (signatureCache.Get(sighash, vchSig, pubkey))
         return true;
@@ -23,4 +23,10 @@ public:
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 };
 
+//! Number of entries in the signature cache
+size_t SignatureCacheSize();
+
+//! Heap memory used by the signature cache
+size_t SignatureCacheDynamicMemoryUsage();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -0,0 +1,422 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "snapshot.h"
+
+#include "accumulators.h"
+#include "chain.h"
+#include "coins.h"
+#include "hash.h"
+#include "main.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+
+namespace
+{
+/** Snapshot file that hashes everything read or written after the metadata */
+class CSnapshotFile
+{
+private:
+    CAutoFile file;
+    CHashWriter hasher;
+
+public:
+    CSnapshotFile(FILE* filenew) : file(filenew, SER_DISK, CLIENT_VERSION), hasher(SER_GETHASH, PROTOCOL_VERSION) {}
+
+    bool IsNull() const { return file.IsNull(); }
+    FILE* Get() const { return file.Get(); }
+    void fclose() { file.fclose(); }
+
+    //! Go back to the metadata at the start of the file and restart hashing
+    bool Rewind()
+    {
+        hasher = CHashWriter(SER_GETHASH, PROTOCOL_VERSION);
+        return fseek(file.Get(), 0, SEEK_SET) == 0;
+    }
+
+    void ReadMetadata(CSnapshotMetadata& metadata) { file >> metadata; }
+    void WriteMetadata(const CSnapshotMetadata& metadata) { file << metadata; }
+
+    template <typename T>
+    CSnapshotFile& operator<<(const T& obj)
+    {
+        file << obj;
+        hasher << obj;
+        return *this;
+    }
+
+    template <typename T>
+    CSnapshotFile& operator>>(T& obj)
+    {
+        file >> obj;
+        hasher << obj;
+        return *this;
+    }
+
+    uint256 GetHash() { return hasher.GetHash(); }
+};
+
+/** Block index entry as stored in a snapshot, without anything that only applies to the local block files */
+CDiskBlockIndex SnapshotIndexEntry(CBlockIndex* pindex)
+{
+    CDiskBlockIndex diskindex(pindex);
+    diskindex.nStatus = BLOCK_VALID_SCRIPTS;
+    diskindex.nFile = 0;
+    diskindex.nDataPos = 0;
+    diskindex.nUndoPos = 0;
+    diskindex.hashNext = 0;
+    return diskindex;
+}
+
+bool ReadZerocoinEntry(leveldb::Iterator* pcursor, CSnapshotZerocoinEntry& entry)
+{
+    leveldb::Slice slKey = pcursor->key();
+    CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+    leveldb::Slice slValue = pcursor->value();
+    CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+    ssKey >> entry.chType;
+    if (entry.chType == 'm' || entry.chType == 's') {
+        ssKey >> entry.hash;
+        ssValue >> entry.txHash;
+        return true;
+    }
+    if (entry.IsAccumulatorValue()) {
+        ssKey >> entry.nChecksum;
+        ssValue >> entry.bnValue;
+        return true;
+    }
+    if (entry.IsBlockPubcoins()) {
+        CBlockPubcoinsKey key;
+        CDataStream ssFullKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+        ssFullKey >> key;
+        entry.nDenomination = key.nDenomination;
+        entry.nHeight = key.nHeight;
+        ssValue >> entry.vPubcoins;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Read the contents of a snapshot after its metadata. Without fApply this
+ * only checks that they are well formed. With fApply they are written to the
+ * databases, which requires cs_main and a node without blocks.
+ */
+bool ReadSnapshotContents(CSnapshotFile& snapshot, const CSnapshotMetadata& metadata, bool fApply, std::string& strError)
+{
+    if (fApply)
+        AssertLockHeld(cs_main);
+
+    // Block index entries of the whole chain, only the last ones come with their block
+    std::vector<uint256> vRecentHashes;
+    uint256 hashPrev = 0;
+    for (int nHeight = 0; nHeight <= metadata.nHeight; nHeight++) {
+        CDiskBlockIndex diskindex;
+        snapshot >> diskindex;
+        const uint256 hash = diskindex.GetBlockHash();
+        if (diskindex.nHeight != nHeight || diskindex.hashPrev != hashPrev || diskindex.nTx == 0 ||
+            (nHeight == 0 && hash != Params().HashGenesisBlock())) {
+            strError = strprintf("Invalid block index entry at height %d", nHeight);
+            return false;
+        }
+        hashPrev = hash;
+        if (nHeight > metadata.nHeight - metadata.nRecentBlocks)
+            vRecentHashes.push_back(hash);
+        if (!fApply || nHeight == 0)
+            continue;
+
+        CBlockIndex* pindexNew = InsertBlockIndex(hash);
+        pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
+        pindexNew->nHeight = diskindex.nHeight;
+        pindexNew->nVersion = diskindex.nVersion;
+        pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+        pindexNew->nTime = diskindex.nTime;
+        pindexNew->nBits = diskindex.nBits;
+        pindexNew->nNonce = diskindex.nNonce;
+        pindexNew->nStatus = diskindex.nStatus;
+        pindexNew->nTx = diskindex.nTx;
+        pindexNew->nAccumulatorCheckpoint = diskindex.nAccumulatorCheckpoint;
+        std::copy(diskindex.nZerocoinSupply, diskindex.nZerocoinSupply + libzerocoin::zerocoinDenomCount, pindexNew->nZerocoinSupply);
+        std::copy(diskindex.nMintDenominationsInBlock, diskindex.nMintDenominationsInBlock + libzerocoin::zerocoinDenomCount, pindexNew->nMintDenominationsInBlock);
+        pindexNew->nMint = diskindex.nMint;
+        pindexNew->nMoneySupply = diskindex.nMoneySupply;
+        pindexNew->nFlags = diskindex.nFlags;
+        pindexNew->nStakeModifier = diskindex.nStakeModifier;
+        if (pindexNew->IsProofOfStake())
+            setStakeSeen.insert(std::make_pair(diskindex.prevoutStake, diskindex.nStakeTime));
+        // prevoutStake and nStakeTime are read back from here, see CBlockIndex::GetStake()
+        if (!pblocktree->WriteBlockIndex(diskindex)) {
+            strError = "Failed to write to block index";
+            return false;
+        }
+    }
+    if (hashPrev != metadata.hashBlock) {
+        strError = "Block index does not end in the snapshot base block";
+        return false;
+    }
+
+    for (const uint256& hash : vRecentHashes) {
+        CBlock block;
+        snapshot >> block;
+        if (block.GetHash() != hash) {
+            strError = strprintf("Unexpected block %s", block.GetHash().GetHex());
+            return false;
+        }
+        CValidationState state;
+        if (fApply && !WriteSnapshotBlock(block, mapBlockIndex[hash], state)) {
+            strError = "Failed to write block " + hash.GetHex();
+            return false;
+        }
+    }
+
+    uint64_t nCoins = 0;
+    while (nCoins < metadata.nCoins) {
+        for (unsigned int n = 0; n < SNAPSHOT_LOAD_BATCH && nCoins < metadata.nCoins; n++, nCoins++) {
+            COutPoint outpoint;
+            Coin coin;
+            snapshot >> outpoint >> coin;
+            if (coin.IsSpent() || coin.nHeight > metadata.nHeight) {
+                strError = "Invalid coin " + outpoint.ToString();
+                return false;
+            }
+            if (fApply)
+                pcoinsTip->AddCoin(outpoint, coin, false);
+        }
+        if (fApply && !pcoinsTip->Flush()) {
+            strError = "Failed to write to coin database";
+            return false;
+        }
+    }
+
+    uint64_t nZerocoinEntries = 0;
+    while (nZerocoinEntries < metadata.nZerocoinEntries) {
+        CLevelDBBatch batch;
+        for (unsigned int n = 0; n < SNAPSHOT_LOAD_BATCH && nZerocoinEntries < metadata.nZerocoinEntries; n++, nZerocoinEntries++) {
+            CSnapshotZerocoinEntry entry;
+            snapshot >> entry;
+            if (entry.IsAccumulatorValue())
+                batch.Write(std::make_pair(entry.chType, entry.nChecksum), entry.bnValue);
+            else if (entry.IsBlockPubcoins())
+                batch.Write(CBlockPubcoinsKey(libzerocoin::IntToZerocoinDenomination(entry.nDenomination), entry.nHeight), entry.vPubcoins);
+            else if (entry.chType == 'm' || entry.chType == 's')
+                batch.Write(std::make_pair(entry.chType, entry.hash), entry.txHash);
+            else {
+                strError = "Invalid zerocoin database entry";
+                return false;
+            }
+        }
+        if (fApply && !zerocoinDB->WriteBatch(batch)) {
+            strError = "Failed to write to zerocoin database";
+            return false;
+        }
+    }
+
+    if (snapshot.GetHash() != metadata.hashContents) {
+        strError = "Snapshot contents do not match their hash";
+        return false;
+    }
+    return true;
+}
+}
+
+bool DumpTxOutSet(const boost::filesystem::path& path, CSnapshotMetadata& metadata, std::string& strError)
+{
+    if (boost::filesystem::exists(path)) {
+        strError = path.string() + " already exists";
+        return false;
+    }
+
+    // The cursors see the databases as they are at the tip below, the node
+    // keeps running while they are written out. The recent blocks are read
+    // right away, before pruning can get to their files.
+    std::vector<CBlockIndex*> vChain;
+    std::vector<CBlock> vRecentBlocks;
+    boost::scoped_ptr<CCoinsViewDBCursor> pcoinsCursor;
+    boost::scoped_ptr<leveldb::Iterator> pzerocoinCursor;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        CBlockIndex* pindexBase = chainActive.Tip();
+        if (pindexBase == NULL || pindexBase->nHeight == 0) {
+            strError = "No blocks to write";
+            return false;
+        }
+        vChain.resize(pindexBase->nHeight + 1);
+        for (CBlockIndex* pindex = pindexBase; pindex; pindex = pindex->pprev)
+            vChain[pindex->nHeight] = pindex;
+        pcoinsCursor.reset(pcoinsdbview->Cursor());
+        pzerocoinCursor.reset(zerocoinDB->NewIterator());
+
+        metadata.SetNull();
+        memcpy(metadata.pchMessageStart, Params().MessageStart(), sizeof(metadata.pchMessageStart));
+        metadata.hashBlock = pindexBase->GetBlockHash();
+        metadata.nHeight = pindexBase->nHeight;
+        metadata.nRecentBlocks = std::min(SNAPSHOT_RECENT_BLOCKS, pindexBase->nHeight);
+
+        vRecentBlocks.resize(metadata.nRecentBlocks);
+        for (int i = 0; i < metadata.nRecentBlocks; i++) {
+            const int nHeight = metadata.nHeight - metadata.nRecentBlocks + 1 + i;
+            if (!ReadBlockFromDisk(vRecentBlocks[i], vChain[nHeight])) {
+                strError = strprintf("Failed to read block at height %d", nHeight);
+                return false;
+            }
+        }
+    }
+
+    boost::filesystem::path pathTmp = path.string() + ".incomplete";
+    CSnapshotFile snapshot(fopen(pathTmp.string().c_str(), "wb"));
+    if (snapshot.IsNull()) {
+        strError = "Failed to open " + pathTmp.string();
+        return false;
+    }
+
+    try {
+        // Written again once the counts and the hash are known
+        snapshot.WriteMetadata(metadata);
+
+        // The entries are copied under cs_main, as the node keeps updating the block index
+        for (size_t nStart = 0; nStart < vChain.size(); nStart += SNAPSHOT_INDEX_BATCH) {
+            std::vector<CDiskBlockIndex> vEntries;
+            {
+                LOCK(cs_main);
+                for (size_t i = nStart; i < vChain.size() && i < nStart + SNAPSHOT_INDEX_BATCH; i++)
+                    vEntries.push_back(SnapshotIndexEntry(vChain[i]));
+            }
+            for (const CDiskBlockIndex& entry : vEntries)
+                snapshot << entry;
+        }
+
+        for (const CBlock& block : vRecentBlocks)
+            snapshot << block;
+
+        for (; pcoinsCursor->Valid(); pcoinsCursor->Next()) {
+            boost::this_thread::interruption_point();
+            COutPoint outpoint;
+            Coin coin;
+            if (!pcoinsCursor->GetCoin(outpoint, coin)) {
+                strError = "Failed to read coin database";
+                return false;
+            }
+            snapshot << outpoint << coin;
+            metadata.nCoins++;
+        }
+
+        for (pzerocoinCursor->SeekToFirst(); pzerocoinCursor->Valid(); pzerocoinCursor->Next()) {
+            CSnapshotZerocoinEntry entry;
+            if (ReadZerocoinEntry(pzerocoinCursor.get(), entry)) {
+                snapshot << entry;
+                metadata.nZerocoinEntries++;
+            }
+        }
+
+        metadata.hashContents = snapshot.GetHash();
+        if (!snapshot.Rewind()) {
+            strError = "Failed to write " + pathTmp.string();
+            return false;
+        }
+        snapshot.WriteMetadata(metadata);
+        FileCommit(snapshot.Get());
+        snapshot.fclose();
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to write %s: %s", pathTmp.string(), e.what());
+        return false;
+    }
+
+    if (!RenameOver(pathTmp, path)) {
+        strError = "Failed to rename " + pathTmp.string();
+        return false;
+    }
+
+    LogPrintf("%s: wrote %u coins and %u zerocoin entries at block %s to %s\n", __func__,
+        metadata.nCoins, metadata.nZerocoinEntries, metadata.hashBlock.GetHex(), path.string());
+    return true;
+}
+
+bool LoadTxOutSet(const boost::filesystem::path& path, CSnapshotMetadata& metadata, std::string& strError)
+{
+    CSnapshotFile snapshot(fopen(path.string().c_str(), "rb"));
+    if (snapshot.IsNull()) {
+        strError = "Failed to open " + path.string();
+        return false;
+    }
+
+    try {
+        snapshot.ReadMetadata(metadata);
+        if (memcmp(metadata.pchMessageStart, Params().MessageStart(), sizeof(metadata.pchMessageStart)) != 0 ||
+            metadata.nVersion != SNAPSHOT_VERSION) {
+            strError = "Snapshot was written for another network or version";
+            return false;
+        }
+        if (metadata.nHeight < 1 || metadata.nRecentBlocks < 1 || metadata.nRecentBlocks > metadata.nHeight) {
+            strError = "Invalid snapshot metadata";
+            return false;
+        }
+        const std::map<uint256, uint256>& mapSnapshotHashes = Params().SnapshotHashes();
+        std::map<uint256, uint256>::const_iterator it = mapSnapshotHashes.find(metadata.hashBlock);
+        if (it == mapSnapshotHashes.end() || it->second != metadata.hashContents) {
+            strError = "Snapshot for block " + metadata.hashBlock.GetHex() + " is not known to this version";
+            return false;
+        }
+
+        // Check all contents against the pinned hash before anything is written
+        if (!ReadSnapshotContents(snapshot, metadata, false, strError))
+            return false;
+        if (!snapshot.Rewind()) {
+            strError = "Failed to read " + path.string();
+            return false;
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to read %s: %s", path.string(), e.what());
+        return false;
+    }
+
+    LOCK(cs_main);
+    if (chainActive.Height() != 0 || mapBlockIndex.size() != 1) {
+        strError = "Snapshots can only be loaded by a node without blocks, start it with -connect=0";
+        return false;
+    }
+
+    // A load that does not finish leaves the databases inconsistent, see AppInit2
+    if (!pblocktree->WriteFlag("snapshotloading", true)) {
+        strError = "Failed to write to block index";
+        return false;
+    }
+
+    try {
+        CSnapshotMetadata metadataApply;
+        snapshot.ReadMetadata(metadataApply);
+        if (!ReadSnapshotContents(snapshot, metadata, true, strError))
+            return false;
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to load %s: %s", path.string(), e.what());
+        return false;
+    }
+
+    // The spends and mints were written past the zerocoin filters, which would tell they are not there
+    if (!zerocoinDB->LoadFilters()) {
+        strError = "Failed to load zerocoin filters";
+        return false;
+    }
+
+    CValidationState state;
+    pcoinsTip->SetBestBlock(metadata.hashBlock);
+    CBlockIndex* pindexBase = mapBlockIndex[metadata.hashBlock];
+    if (!ActivateSnapshotChain(pindexBase, state)) {
+        strError = "Failed to activate snapshot chain: " + state.GetRejectReason();
+        return false;
+    }
+    if (pindexBase->nAccumulatorCheckpoint != 0 && !LoadAccumulatorValuesFromDB(pindexBase->nAccumulatorCheckpoint))
+        LogPrintf("%s: failed to load accumulator values for checkpoint %s\n", __func__, pindexBase->nAccumulatorCheckpoint.GetHex());
+    // The snapshot carries the pubcoins of every zerocoin block, the witnesses of older mints are computed from them
+    zerocoinDB->WriteFlag("blockpubcoins", true);
+    pblocktree->WriteFlag("snapshotloading", false);
+
+    LogPrintf("%s: loaded %u coins and %u zerocoin entries at block %s from %s\n", __func__,
+        metadata.nCoins, metadata.nZerocoinEntries, metadata.hashBlock.GetHex(), path.string());
+    return true;
+}
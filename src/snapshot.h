@@ -0,0 +1,131 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DIVIT_SNAPSHOT_H
+#define DIVIT_SNAPSHOT_H
+
+#include "chainparams.h"
+#include "libzerocoin/bignum.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+//! Version of the dumptxoutset file format
+static const int SNAPSHOT_VERSION = 1;
+//! Number of blocks at the tip of a snapshot that are stored in full, enough to compute the next accumulator checkpoints
+static const int SNAPSHOT_RECENT_BLOCKS = 100;
+//! Number of records written to the databases at once while loading a snapshot
+static const unsigned int SNAPSHOT_LOAD_BATCH = 100000;
+//! Number of block index entries copied at once under cs_main while writing a snapshot
+static const unsigned int SNAPSHOT_INDEX_BATCH = 10000;
+
+/**
+ * Header of a UTXO snapshot file, as written by dumptxoutset.
+ *
+ * It is followed by:
+ * - the block index entries of the active chain from the genesis block up to hashBlock
+ * - the last nRecentBlocks blocks of that chain in full
+ * - nCoins unspent outputs as COutPoint and Coin pairs
+ * - nZerocoinEntries records of the zerocoin database, see CSnapshotZerocoinEntry
+ *
+ * hashContents is computed over all of those. loadtxoutset only accepts a
+ * snapshot if its contents hash is pinned for hashBlock in the chain params.
+ */
+class CSnapshotMetadata
+{
+public:
+    MessageStartChars pchMessageStart;
+    int nVersion;
+    uint256 hashBlock;
+    int nHeight;
+    int nRecentBlocks;
+    uint64_t nCoins;
+    uint64_t nZerocoinEntries;
+    uint256 hashContents;
+
+    CSnapshotMetadata()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        memset(pchMessageStart, 0, sizeof(pchMessageStart));
+        nVersion = SNAPSHOT_VERSION;
+        hashBlock = 0;
+        nHeight = 0;
+        nRecentBlocks = 0;
+        nCoins = 0;
+        nZerocoinEntries = 0;
+        hashContents = 0;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(FLATDATA(pchMessageStart));
+        READWRITE(this->nVersion);
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+        READWRITE(nRecentBlocks);
+        READWRITE(nCoins);
+        READWRITE(nZerocoinEntries);
+        READWRITE(hashContents);
+    }
+};
+
+/** A zerocoin database record in a UTXO snapshot: a mint, a spend, an accumulator value or the pubcoins of a block */
+class CSnapshotZerocoinEntry
+{
+public:
+    char chType;
+    //! Pubcoin or serial hash and the transaction it appeared in, for mints and spends
+    uint256 hash;
+    uint256 txHash;
+    //! Accumulator checksum and value, for accumulator values
+    uint32_t nChecksum;
+    CBigNum bnValue;
+    //! Denomination, height and accumulated pubcoins, for block pubcoins
+    int nDenomination;
+    int nHeight;
+    std::vector<CBigNum> vPubcoins;
+
+    CSnapshotZerocoinEntry() : chType(0), hash(0), txHash(0), nChecksum(0), nDenomination(0), nHeight(0) {}
+
+    bool IsAccumulatorValue() const { return chType == '2'; }
+    bool IsBlockPubcoins() const { return chType == 'p'; }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(chType);
+        if (IsAccumulatorValue()) {
+            READWRITE(nChecksum);
+            READWRITE(bnValue);
+        } else if (IsBlockPubcoins()) {
+            READWRITE(nDenomination);
+            READWRITE(nHeight);
+            READWRITE(vPubcoins);
+        } else {
+            READWRITE(hash);
+            READWRITE(txHash);
+        }
+    }
+};
+
+/** Write the chainstate at the current tip to a snapshot file */
+bool DumpTxOutSet(const boost::filesystem::path& path, CSnapshotMetadata& metadata, std::string& strError);
+
+/** Make the chainstate of a snapshot file the active chain. Only possible on a node that has no blocks yet. */
+bool LoadTxOutSet(const boost::filesystem::path& path, CSnapshotMetadata& metadata, std::string& strError);
+
+#endif // DIVIT_SNAPSHOT_H
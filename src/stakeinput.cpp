@@ -4,6 +4,7 @@
 
 #include "accumulators.h"
 #include "chain.h"
+#include "coins.h"
 #include "primitives/deterministicmint.h"
 #include "main.h"
 #include "stakeinput.h"
@@ -167,33 +168,55 @@ bool CZVitStake::MarkSpent(CWallet *pwallet, const uint256& txid)
 //!DIVIT Stake
 bool CVitStake::SetInput(CTransaction txPrev, unsigned int n)
 {
+    if (n >= txPrev.vout.size())
+        return false;
+
     this->txFrom = txPrev;
+    this->hashFrom = txPrev.GetHash();
     this->nPosition = n;
+    this->txoutFrom = txPrev.vout[n];
+    return true;
+}
+
+bool CVitStake::SetInput(const COutPoint& prevout, const Coin& coin)
+{
+    if (coin.IsSpent())
+        return false;
+
+    this->txFrom = CTransaction();
+    this->hashFrom = prevout.hash;
+    this->nPosition = prevout.n;
+    this->txoutFrom = coin.out;
+    if ((int)coin.nHeight <= chainActive.Height())
+        this->pindexFrom = chainActive[coin.nHeight];
     return true;
 }
 
 bool CVitStake::GetTxFrom(CTransaction& tx)
 {
+    if (txFrom.IsNull())
+        return false;
+
     tx = txFrom;
     return true;
 }
 
 bool CVitStake::CreateTxIn(CWallet* pwallet, CTxIn& txIn, uint256 hashTxOut)
 {
-    txIn = CTxIn(txFrom.GetHash(), nPosition);
+    txIn = CTxIn(hashFrom, nPosition);
     return true;
 }
 
 CAmount CVitStake::GetValue()
 {
-    return txFrom.vout[nPosition].nValue;
+    return txoutFrom.nValue;
 }
 
 bool CVitStake::CreateTxOuts(CWallet* pwallet, vector<CTxOut>& vout, CAmount nTotal)
 {
     vector<valtype> vSolutions;
     txnouttype whichType;
-    CScript scriptPubKeyKernel = txFrom.vout[nPosition].scriptPubKey;
+    CScript scriptPubKeyKernel = txoutFrom.scriptPubKey;
     if (!Solver(scriptPubKeyKernel, whichType, vSolutions)) {
         LogPrintf("CreateCoinStake : failed to parse kernel\n");
         return false;
@@ -242,16 +265,20 @@ CDataStream CVitStake::GetUniqueness()
 {
     //The unique identifier for a PIV stake is the outpoint
     CDataStream ss(SER_NETWORK, 0);
-    ss << nPosition << txFrom.GetHash();
+    ss << nPosition << hashFrom;
     return ss;
 }
 
 //The block that the UTXO was added to the chain
 CBlockIndex* CVitStake::GetIndexFrom()
 {
+    // Set from the coin height already when only the UTXO is known
+    if (txFrom.IsNull())
+        return pindexFrom;
+
     uint256 hashBlock = 0;
     CTransaction tx;
-    if (GetTransaction(txFrom.GetHash(), tx, hashBlock, true)) {
+    if (GetTransaction(hashFrom, tx, hashBlock, true)) {
         // If the index is in the chain, then set it as the "index from"
         if (mapBlockIndex.count(hashBlock)) {
             CBlockIndex* pindex = mapBlockIndex.at(hashBlock);
@@ -259,7 +286,7 @@ CBlockIndex* CVitStake::GetIndexFrom()
                 pindexFrom = pindex;
         }
     } else {
-        LogPrintf("%s : failed to find tx %s\n", __func__, txFrom.GetHash().GetHex());
+        LogPrintf("%s : failed to find tx %s\n", __func__, hashFrom.GetHex());
     }
 
     return pindexFrom;
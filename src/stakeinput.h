@@ -6,6 +6,7 @@
 #define DIVIT_STAKEINPUT_H
 
 class CKeyStore;
+class Coin;
 class CWallet;
 class CWalletTx;
 
@@ -67,7 +68,9 @@ class CVitStake : public CStakeInput
 {
 private:
     CTransaction txFrom;
+    uint256 hashFrom;
     unsigned int nPosition;
+    CTxOut txoutFrom;
 public:
     CVitStake()
     {
@@ -75,6 +78,9 @@ public:
     }
 
     bool SetInput(CTransaction txPrev, unsigned int n);
+    //! Set the input from the UTXO set only, when the transaction itself is not available (e.g. below a UTXO snapshot)
+    bool SetInput(const COutPoint& prevout, const Coin& coin);
+    const CTxOut& GetTxOutFrom() const { return txoutFrom; }
 
     CBlockIndex* GetIndexFrom() override;
     bool GetTxFrom(CTransaction& tx) override;
@@ -0,0 +1,101 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addressindex.h"
+#include "coins.h"
+#include "primitives/transaction.h"
+#include "script/standard.h"
+#include "txdb.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+static CScript PayToKeyID(unsigned char n)
+{
+    return GetScriptForDestination(CKeyID(uint160(std::vector<unsigned char>(20, n))));
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_key_order)
+{
+    // Keys of an address sort by height, also across byte boundaries
+    const uint160 hash(std::vector<unsigned char>(20, 7));
+    CDataStream ssLow(SER_DISK, CLIENT_VERSION), ssHigh(SER_DISK, CLIENT_VERSION);
+    ssLow << CAddressIndexKey(ADDRESS_PUBKEYHASH, hash, 255, 3, uint256(0), 0, false);
+    ssHigh << CAddressIndexKey(ADDRESS_PUBKEYHASH, hash, 256, 0, uint256(0), 0, false);
+    BOOST_CHECK(ssLow.str() < ssHigh.str());
+
+    CAddressIndexKey key;
+    ssHigh >> key;
+    BOOST_CHECK_EQUAL(key.nHeight, 256);
+    BOOST_CHECK_EQUAL(key.nTxIndex, 0U);
+    BOOST_CHECK(key.hashAddress == hash);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_connect_disconnect)
+{
+    CBlockTreeDB db(1 << 20, true);
+    const uint160 hashA(std::vector<unsigned char>(20, 1));
+    const uint160 hashB(std::vector<unsigned char>(20, 2));
+
+    CMutableTransaction txFund;
+    txFund.vout.resize(1);
+    txFund.vout[0].nValue = 50;
+    txFund.vout[0].scriptPubKey = PayToKeyID(1);
+    const CTransaction fund(txFund);
+
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].prevout = COutPoint(fund.GetHash(), 0);
+    txSpend.vout.resize(1);
+    txSpend.vout[0].nValue = 40;
+    txSpend.vout[0].scriptPubKey = PayToKeyID(2);
+    const CTransaction spend(txSpend);
+    std::vector<Coin> vSpent(1, Coin(fund.vout[0], 10, false, false));
+
+    CAddressIndexUpdate connect1(true, true);
+    connect1.AddTransaction(fund, 0, 10, NULL, true);
+    BOOST_CHECK(db.WriteAddressIndexUpdate(connect1));
+    CAddressIndexUpdate connect2(true, true);
+    connect2.AddTransaction(spend, 1, 20, &vSpent, true);
+    BOOST_CHECK(db.WriteAddressIndexUpdate(connect2));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vEntries;
+    BOOST_CHECK(db.ReadAddressIndex(ADDRESS_PUBKEYHASH, hashA, vEntries));
+    BOOST_CHECK_EQUAL(vEntries.size(), 2U);
+    BOOST_CHECK_EQUAL(vEntries[0].second + vEntries[1].second, 0);
+    vEntries.clear();
+    BOOST_CHECK(db.ReadAddressIndex(ADDRESS_PUBKEYHASH, hashA, vEntries, 15, 30));
+    BOOST_CHECK_EQUAL(vEntries.size(), 1U);
+    BOOST_CHECK(vEntries[0].first.fSpending && vEntries[0].first.txhash == spend.GetHash());
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspent;
+    BOOST_CHECK(db.ReadAddressUnspentIndex(ADDRESS_PUBKEYHASH, hashA, vUnspent));
+    BOOST_CHECK(vUnspent.empty());
+    BOOST_CHECK(db.ReadAddressUnspentIndex(ADDRESS_PUBKEYHASH, hashB, vUnspent));
+    BOOST_CHECK_EQUAL(vUnspent.size(), 1U);
+
+    CSpentIndexValue value;
+    BOOST_CHECK(db.ReadSpentIndex(CSpentIndexKey(fund.GetHash(), 0), value));
+    BOOST_CHECK(value.txid == spend.GetHash() && value.nHeight == 20 && value.hashAddress == hashA);
+
+    // Disconnecting the spend restores the state before it
+    CAddressIndexUpdate disconnect(true, true);
+    disconnect.AddTransaction(spend, 1, 20, &vSpent, false);
+    BOOST_CHECK(db.WriteAddressIndexUpdate(disconnect));
+
+    vEntries.clear();
+    BOOST_CHECK(db.ReadAddressIndex(ADDRESS_PUBKEYHASH, hashA, vEntries));
+    BOOST_CHECK_EQUAL(vEntries.size(), 1U);
+    vUnspent.clear();
+    BOOST_CHECK(db.ReadAddressUnspentIndex(ADDRESS_PUBKEYHASH, hashA, vUnspent));
+    BOOST_CHECK_EQUAL(vUnspent.size(), 1U);
+    BOOST_CHECK_EQUAL(vUnspent[0].second.nHeight, 10);
+    vUnspent.clear();
+    BOOST_CHECK(db.ReadAddressUnspentIndex(ADDRESS_PUBKEYHASH, hashB, vUnspent));
+    BOOST_CHECK(vUnspent.empty());
+    BOOST_CHECK(!db.ReadSpentIndex(CSpentIndexKey(fund.GetHash(), 0), value));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
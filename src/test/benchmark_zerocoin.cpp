@@ -369,6 +369,127 @@ Testb_MintAndSpend()
 	return false;
 }
 
+bool
+Testb_BatchSpendVerify()
+{
+	const uint32_t nSpends = 4;
+
+	try {
+		if (ggCoins[0] == NULL)
+			return false;
+
+		// Spend the first coins against an accumulator of all of them, and the
+		// first one once more against the accumulator before the last coin
+		Accumulator acc(&gg_Params->accumulatorParams,CoinDenomination::ZQ_ONE);
+		vector<AccumulatorWitness> witnesses;
+		for (uint32_t i = 0; i < nSpends; i++) {
+			witnesses.push_back(AccumulatorWitness(gg_Params, acc, ggCoins[i]->getPublicCoin()));
+		}
+		for (uint32_t i = 0; i < TESTS_COINS_TO_ACCUMULATE - 1; i++) {
+			acc += ggCoins[i]->getPublicCoin();
+			for (uint32_t j = 0; j < nSpends; j++) {
+				witnesses[j] += ggCoins[i]->getPublicCoin();
+			}
+		}
+		CoinSpend oldSpend(gg_Params, gg_Params, *(ggCoins[0]), acc, 0, witnesses[0], 0, SpendType::SPEND);
+
+		acc += ggCoins[TESTS_COINS_TO_ACCUMULATE - 1]->getPublicCoin();
+		vector<CoinSpend> spends;
+		for (uint32_t i = 0; i < nSpends; i++) {
+			witnesses[i] += ggCoins[TESTS_COINS_TO_ACCUMULATE - 1]->getPublicCoin();
+			spends.push_back(CoinSpend(gg_Params, gg_Params, *(ggCoins[i]), acc, 0, witnesses[i], 0, SpendType::SPEND));
+		}
+
+		vector<const CoinSpend*> batch;
+		for (uint32_t i = 0; i < nSpends; i++) {
+			batch.push_back(&spends[i]);
+		}
+
+		timer.start();
+		bool fSingle = true;
+		for (uint32_t i = 0; i < nSpends; i++) {
+			fSingle &= spends[i].Verify(acc);
+		}
+		timer.stop();
+		int nSingle = timer.duration();
+
+		vector<bool> valid;
+		timer.start();
+		bool fBatch = CoinSpend::BatchVerify(batch, acc, valid);
+		timer.stop();
+
+		cout << "	" << nSpends << " SPENDS VERIFY ELAPSED TIME:\n\t\tone by one: " << nSingle << " ms\n\t\tbatch: " << timer.duration() << " ms" << endl;
+
+		if (!fSingle || !fBatch || valid != vector<bool>(nSpends, true)) {
+			cout << "Valid spends did not verify" << endl;
+			return false;
+		}
+
+		// The spend made against another accumulator must be singled out
+		batch[2] = &oldSpend;
+		vector<bool> expected(nSpends, true);
+		expected[2] = false;
+		if (CoinSpend::BatchVerify(batch, acc, valid) || valid != expected) {
+			cout << "Invalid spend was not detected in the batch" << endl;
+			return false;
+		}
+	} catch (const runtime_error &e) {
+		cout << e.what() << endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool
+Testb_FixedBaseExp()
+{
+	// Time g^e with a plain modular exponentiation against the precomputed
+	// tables, on the groups that dominate spend verification
+	const uint32_t nRounds = 100;
+	const IntegerGroupParams* groups[] = {&gg_Params->coinCommitmentGroup, &gg_Params->serialNumberSoKCommitmentGroup, &gg_Params->accumulatorParams.accumulatorPoKCommitmentGroup};
+	const char* names[] = {"COIN COMMITMENT", "SERIAL SOK", "ACCUMULATOR POK"};
+
+	try {
+		for (uint32_t n = 0; n < 3; n++) {
+			const IntegerGroupParams* group = groups[n];
+			vector<CBigNum> exps(nRounds), plain(nRounds), fixed(nRounds);
+			for (uint32_t i = 0; i < nRounds; i++) {
+				exps[i] = CBigNum::randBignum(group->modulus);
+			}
+
+			// Build the table outside of the timed loop
+			group->pow_g(exps[0]);
+
+			timer.start();
+			for (uint32_t i = 0; i < nRounds; i++) {
+				plain[i] = group->g.pow_mod(exps[i], group->modulus);
+			}
+			timer.stop();
+			int nPlain = timer.duration();
+
+			timer.start();
+			for (uint32_t i = 0; i < nRounds; i++) {
+				fixed[i] = group->pow_g(exps[i]);
+			}
+			timer.stop();
+			int nFixed = timer.duration();
+
+			if (plain != fixed || group->pow_g(-exps[0]) != group->g.pow_mod(-exps[0], group->modulus)) {
+				cout << "Fixed base exponentiation mismatch" << endl;
+				return false;
+			}
+
+			cout << "\t" << names[n] << " GROUP (" << group->modulus.bitSize() << " bits), " << nRounds << " EXPONENTIATIONS:\n\t\tpow_mod: " << nPlain << " ms\n\t\tfixed base: " << nFixed << " ms" << endl;
+		}
+	} catch (const runtime_error &e) {
+		cout << e.what() << endl;
+		return false;
+	}
+
+	return true;
+}
+
 void
 Testb_RunAllTests()
 {
@@ -387,7 +508,9 @@ Testb_RunAllTests()
 	gLogTestResult("parameter generation is correct", Testb_ParamGen);
 	gLogTestResult("coins can be minted", Testb_MintCoin);
 	gLogTestResult("the accumulator works", Testb_Accumulator);
+	gLogTestResult("fixed base exponentiation is correct", Testb_FixedBaseExp);
 	gLogTestResult("a minted coin can be spent", Testb_MintAndSpend);
+	gLogTestResult("spends can be verified in a batch", Testb_BatchSpendVerify);
 
 	// Summarize test results
 	if (ggSuccessfulTests < ggNumTests) {
@@ -406,7 +529,12 @@ BOOST_AUTO_TEST_SUITE(benchmark_zerocoin)
 
 BOOST_AUTO_TEST_CASE(benchmark_test)
 {
-	cout << "libzerocoin v" << ZEROCOIN_VERSION_STRING << " benchmark utility." << endl << endl;
+	cout << "libzerocoin v" << ZEROCOIN_VERSION_STRING << " benchmark utility." << endl;
+#if defined(USE_NUM_GMP)
+	cout << "bignum implementation: gmp" << endl << endl;
+#else
+	cout << "bignum implementation: openssl" << endl << endl;
+#endif
 
 	Testb_RunAllTests();
 }
@@ -0,0 +1,78 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+#include "clientversion.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockcache_tests)
+
+static std::shared_ptr<const CBlock> MakeBlock(unsigned int nNonce)
+{
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    pblock->nNonce = nNonce;
+    CMutableTransaction tx;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << std::vector<unsigned char>(1000, nNonce & 0xff);
+    pblock->vtx.push_back(tx);
+    return pblock;
+}
+
+BOOST_AUTO_TEST_CASE(blockcache_lru)
+{
+    CBlockCache cache(0);
+    std::shared_ptr<const CBlock> pblock1 = MakeBlock(1), pblock2 = MakeBlock(2), pblock3 = MakeBlock(3);
+    const uint256 hash1 = pblock1->GetHash(), hash2 = pblock2->GetHash(), hash3 = pblock3->GetHash();
+
+    // Room for two blocks, not three
+    cache.SetMaxUsage(1 << 20);
+    cache.Put(hash1, pblock1);
+    const size_t nBlockUsage = cache.DynamicMemoryUsage();
+    BOOST_CHECK(nBlockUsage > 1000);
+    cache.SetMaxUsage(nBlockUsage * 5 / 2);
+
+    cache.Put(hash2, pblock2);
+    BOOST_CHECK(cache.Get(hash1) == pblock1);
+    cache.Put(hash3, pblock3);
+    BOOST_CHECK_EQUAL(cache.Size(), 2U);
+    BOOST_CHECK(cache.Get(hash1) == pblock1);
+    BOOST_CHECK(!cache.Get(hash2));
+    BOOST_CHECK(cache.Get(hash3) == pblock3);
+
+    uint64_t nHits, nMisses;
+    cache.GetStats(nHits, nMisses);
+    BOOST_CHECK_EQUAL(nHits, 3U);
+    BOOST_CHECK_EQUAL(nMisses, 1U);
+
+    // Evicted blocks stay valid for whoever still holds them
+    std::shared_ptr<const CBlock> pblock = cache.Get(hash1);
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), 0U);
+    BOOST_CHECK(pblock->GetHash() == hash1);
+}
+
+BOOST_AUTO_TEST_CASE(blockcache_raw)
+{
+    CBlockCache cache(1 << 20);
+    std::shared_ptr<const CBlock> pblock = MakeBlock(1);
+    const uint256 hash = pblock->GetHash();
+
+    std::shared_ptr<CDataStream> pdata(new CDataStream(SER_NETWORK, CLIENT_VERSION));
+    *pdata << *pblock;
+    cache.PutRaw(hash, pdata);
+    BOOST_CHECK(!cache.Get(hash));
+    BOOST_CHECK(cache.GetRaw(hash) == pdata);
+
+    // Both forms of a block share one entry
+    const size_t nRawUsage = cache.DynamicMemoryUsage();
+    cache.Put(hash, pblock);
+    BOOST_CHECK_EQUAL(cache.Size(), 1U);
+    BOOST_CHECK(cache.DynamicMemoryUsage() > nRawUsage);
+    cache.Erase(hash);
+    BOOST_CHECK(!cache.GetRaw(hash));
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -23,6 +23,7 @@
 #include "libzerocoin/Coin.h"
 #include "libzerocoin/CoinSpend.h"
 #include "libzerocoin/Accumulator.h"
+#include "libzerocoin/Threading.h"
 
 using namespace std;
 using namespace libzerocoin;
@@ -444,6 +445,38 @@ Test_MintAndSpend()
 	return false;
 }
 
+bool
+Test_MintAndSpendThreaded()
+{
+	// Proofs computed with several threads must verify with one and vice versa
+	bool ret = true;
+	int nThreads = GetProofThreads();
+	try {
+		Accumulator acc(&g_Params->accumulatorParams,CoinDenomination::ZQ_ONE);
+		AccumulatorWitness wAcc(g_Params, acc, gCoins[0]->getPublicCoin());
+		for (uint32_t i = 0; i < TESTS_COINS_TO_ACCUMULATE; i++) {
+			acc += gCoins[i]->getPublicCoin();
+			wAcc +=gCoins[i]->getPublicCoin();
+		}
+
+		SetProofThreads(4);
+		CoinSpend spend(g_Params, g_Params, *gCoins[0], acc, 0, wAcc, 0, SpendType::SPEND);
+		ret &= spend.Verify(acc);
+
+		CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+		ss << spend;
+		CoinSpend newSpend(g_Params, g_Params, ss);
+		SetProofThreads(1);
+		ret &= newSpend.Verify(acc);
+	} catch (const runtime_error &e) {
+		cout << e.what() << endl;
+		ret = false;
+	}
+	SetProofThreads(nThreads);
+
+	return ret;
+}
+
 void
 Test_RunAllTests()
 {
@@ -465,6 +498,7 @@ Test_RunAllTests()
 	LogTestResult("the accumulator works", Test_Accumulator);
 	LogTestResult("the commitment equality PoK works", Test_EqualityPoK);
 	LogTestResult("a minted coin can be spent", Test_MintAndSpend);
+	LogTestResult("a minted coin can be spent with multithreaded proofs", Test_MintAndSpendThreaded);
 
 	cout << endl << "Average coin size is " << gCoinSize << " bytes." << endl;
 	cout << "Serial number size is " << gSerialNumberSize << " bytes." << endl;
@@ -5,8 +5,17 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "primitives/transaction.h"
+#include "accumulators.h"
+#include "chainparams.h"
 #include "main.h"
+#include "streams.h"
+#include "txdb.h"
+#include "txindex.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validationinterface.h"
 
+#include <boost/filesystem.hpp>
 #include <boost/test/unit_test.hpp>
 
 BOOST_AUTO_TEST_SUITE(main_tests)
@@ -49,4 +58,257 @@ return; // need to be fixed
     BOOST_CHECK(nSum == 4109975100000000ULL);
 }
 
+
+BOOST_AUTO_TEST_CASE(disconnect_block_pre_upgrade_undo)
+{
+    // Before the chainstate upgrade a zerocoin mint kept its transaction in the UTXO set, so
+    // spending the change output wrote an undo record without the coin's metadata
+    CMutableTransaction txMint;
+    txMint.vin.resize(1);
+    txMint.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    txMint.vout.resize(2);
+    txMint.vout[0].nValue = 10 * COIN;
+    txMint.vout[0].scriptPubKey = CScript() << OP_ZEROCOINMINT << std::vector<unsigned char>(32, 1);
+    txMint.vout[1].nValue = 5 * COIN;
+    txMint.vout[1].scriptPubKey = CScript() << OP_TRUE;
+    CBlock blockMint;
+    blockMint.vtx.push_back(txMint);
+
+    CMutableTransaction txCoinBase;
+    txCoinBase.vin.resize(1);
+    txCoinBase.vin[0].prevout.SetNull();
+    txCoinBase.vout.resize(1);
+    txCoinBase.vout[0].nValue = 1 * COIN;
+    txCoinBase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].prevout = COutPoint(blockMint.vtx[0].GetHash(), 1);
+    txSpend.vout.resize(1);
+    txSpend.vout[0].nValue = 4 * COIN;
+    txSpend.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    CBlock block;
+    block.vtx.push_back(txCoinBase);
+    block.vtx.push_back(txSpend);
+
+    // Files past any the node uses, so they are read through the file and not a mapping
+    CDiskBlockPos posMint(1000, 0);
+    BOOST_REQUIRE(WriteBlockToDisk(blockMint, posMint));
+    CDiskBlockPos pos(1000, 0);
+    BOOST_REQUIRE(WriteBlockToDisk(block, pos));
+
+    CBlockTreeDB db(1 << 20, true);
+    CTxIndex txindex(&db);
+    txindex.Start();
+    for (int i = 0; i < 1000; i++) {
+        {
+            LOCK(cs_main);
+            if (txindex.IsSynced())
+                break;
+        }
+        MilliSleep(10);
+    }
+
+    LOCK(cs_main);
+    const uint256 hashMint = blockMint.GetHash();
+    CBlockIndex indexMint(blockMint);
+    indexMint.phashBlock = &hashMint;
+    indexMint.pprev = chainActive.Tip();
+    indexMint.nHeight = chainActive.Height() + 1;
+    indexMint.nFile = posMint.nFile;
+    indexMint.nDataPos = posMint.nPos;
+    indexMint.nStatus = BLOCK_HAVE_DATA;
+    const uint256 hash = block.GetHash();
+    CBlockIndex index(block);
+    index.phashBlock = &hash;
+    index.pprev = &indexMint;
+    index.nHeight = indexMint.nHeight + 1;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+    index.nStatus = BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO;
+    mapBlockIndex[hashMint] = &indexMint;
+
+    CBlockUndo blockUndo;
+    blockUndo.vtxundo.resize(1);
+    blockUndo.vtxundo[0].vprevout.push_back(Coin(txMint.vout[1], 0, false, false));
+    CDiskBlockPos posUndo(1000, 0);
+    BOOST_REQUIRE(blockUndo.WriteToDisk(posUndo, indexMint.GetBlockHash()));
+    index.nUndoPos = posUndo.nPos;
+
+    // The mint's block is found through the transaction index
+    BOOST_REQUIRE(txindex.IsSynced());
+    RegisterValidationInterface(&txindex);
+    GetMainSignals().BlockConnected(blockMint, &indexMint);
+    ptxindex = &txindex;
+
+    CCoinsViewCache view(pcoinsTip);
+    view.AddCoin(COutPoint(block.vtx[0].GetHash(), 0), Coin(txCoinBase.vout[0], index.nHeight, true, false), false);
+    view.AddCoin(COutPoint(block.vtx[1].GetHash(), 0), Coin(txSpend.vout[0], index.nHeight, false, false), false);
+    view.SetBestBlock(hash);
+
+    CValidationState state;
+    bool fClean = false;
+    BOOST_CHECK(DisconnectBlock(block, state, &index, view, &fClean));
+    BOOST_CHECK(fClean);
+    const Coin& coin = view.AccessCoin(txSpend.vin[0].prevout);
+    BOOST_CHECK(!coin.IsSpent());
+    BOOST_CHECK_EQUAL(coin.nHeight, indexMint.nHeight);
+    BOOST_CHECK(!coin.fCoinBase && !coin.fCoinStake);
+    BOOST_CHECK(view.GetBestBlock() == indexMint.GetBlockHash());
+
+    ptxindex = NULL;
+    GetMainSignals().BlockDisconnected(blockMint, &indexMint);
+    UnregisterValidationInterface(&txindex);
+
+    // Without the transaction index, as in prune mode, the blocks with mints are read
+    indexMint.ClearMintDenominations();
+    indexMint.AddMintDenomination(libzerocoin::ZQ_TEN);
+    CCoinsViewCache viewNoIndex(pcoinsTip);
+    viewNoIndex.AddCoin(COutPoint(block.vtx[0].GetHash(), 0), Coin(txCoinBase.vout[0], index.nHeight, true, false), false);
+    viewNoIndex.AddCoin(COutPoint(block.vtx[1].GetHash(), 0), Coin(txSpend.vout[0], index.nHeight, false, false), false);
+    viewNoIndex.SetBestBlock(hash);
+    fClean = false;
+    BOOST_CHECK(DisconnectBlock(block, state, &index, viewNoIndex, &fClean));
+    BOOST_CHECK(fClean);
+    const Coin& coinNoIndex = viewNoIndex.AccessCoin(txSpend.vin[0].prevout);
+    BOOST_CHECK(!coinNoIndex.IsSpent());
+    BOOST_CHECK_EQUAL(coinNoIndex.nHeight, indexMint.nHeight);
+
+    // And without the mint's block the undo data can not be applied
+    indexMint.nStatus = 0;
+    CCoinsViewCache viewPruned(pcoinsTip);
+    viewPruned.AddCoin(COutPoint(block.vtx[0].GetHash(), 0), Coin(txCoinBase.vout[0], index.nHeight, true, false), false);
+    viewPruned.AddCoin(COutPoint(block.vtx[1].GetHash(), 0), Coin(txSpend.vout[0], index.nHeight, false, false), false);
+    viewPruned.SetBestBlock(hash);
+    BOOST_CHECK(!DisconnectBlock(block, state, &index, viewPruned, &fClean));
+    mapBlockIndex.erase(hashMint);
+}
+
+BOOST_AUTO_TEST_CASE(load_external_block_file_corrupt)
+{
+    // A node without any blocks, as when it imports a bootstrap file on its first start
+    {
+        LOCK(cs_main);
+        UnloadBlockIndex();
+        pindexBestHeader = NULL;
+        delete pcoinsTip;
+        delete pcoinsflusher;
+        delete pcoinsdbview;
+        delete pblocktree;
+        pblocktree = new CBlockTreeDB(1 << 20, true);
+        pcoinsdbview = new CCoinsViewDB(1 << 23, true);
+        pcoinsflusher = new CCoinsViewBackgroundFlush(pcoinsdbview);
+        pcoinsTip = new CCoinsViewCache(pcoinsflusher);
+    }
+
+    const CBlock& genesis = Params().GenesisBlock();
+    // A block whose parent is not in the file
+    CBlock blockOrphan;
+    blockOrphan.nVersion = 1;
+    blockOrphan.hashPrevBlock = GetRandHash();
+    blockOrphan.nTime = genesis.nTime + 60;
+    blockOrphan.nBits = genesis.nBits;
+    blockOrphan.vtx.push_back(genesis.vtx[0]);
+    blockOrphan.hashMerkleRoot = blockOrphan.BuildMerkleTree();
+    // A record that does not decode: an empty header and an impossible transaction count.
+    // Its size covers the genesis block, which is only found by scanning again after it.
+    std::vector<char> vchCorrupt(80, 0);
+    vchCorrupt.insert(vchCorrupt.end(), 9, (char)0xff);
+    unsigned int nGenesisSize = ::GetSerializeSize(genesis, SER_DISK, CLIENT_VERSION);
+    unsigned int nCorruptSize = vchCorrupt.size() + 8 + nGenesisSize;
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss.write("junk", 4);
+    ss << FLATDATA(Params().MessageStart()) << nCorruptSize;
+    ss.write(&vchCorrupt[0], vchCorrupt.size());
+    ss << FLATDATA(Params().MessageStart()) << nGenesisSize << genesis;
+    ss << FLATDATA(Params().MessageStart()) << (unsigned int)::GetSerializeSize(blockOrphan, SER_DISK, CLIENT_VERSION) << blockOrphan;
+
+    const boost::filesystem::path path = GetDataDir() / "bootstrap_corrupt.dat";
+    FILE* file = fopen(path.string().c_str(), "wb");
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fwrite(&ss[0], 1, ss.size(), file), ss.size());
+    fclose(file);
+    file = fopen(path.string().c_str(), "rb");
+    BOOST_REQUIRE(file);
+    BOOST_CHECK(LoadExternalBlockFile(file));
+
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(chainActive.Height(), 0);
+        BOOST_CHECK(chainActive.Tip() && chainActive.Tip()->GetBlockHash() == genesis.GetHash());
+        BOOST_CHECK(!mapBlockIndex.count(blockOrphan.GetHash()));
+    }
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(recalculate_supply_mint_counts)
+{
+    const int nZerocoinStartHeightPrev = Params().Zerocoin_StartHeight();
+    ModifiableParams()->setZerocoinStartHeight(1);
+
+    // Blocks with a mint of ZQ_ONE each, whose index entries wrongly record ZQ_FIVE
+    std::vector<CBlockIndex*> vIndex;
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindexGenesis = chainActive.Tip();
+        for (int nHeight = 1; nHeight <= 25; nHeight++) {
+            CMutableTransaction txCoinBase;
+            txCoinBase.vin.resize(1);
+            txCoinBase.vin[0].prevout.SetNull();
+            txCoinBase.vin[0].scriptSig = CScript() << nHeight << OP_0;
+            txCoinBase.vout.resize(1);
+            std::vector<unsigned char> vch(128, 0);
+            vch[0] = nHeight;
+            vch[127] = 1;
+            CBigNum bnPubcoin;
+            bnPubcoin.setvch(vch);
+            CMutableTransaction txMint;
+            txMint.vout.resize(1);
+            txMint.vout[0].nValue = 1 * COIN;
+            txMint.vout[0].scriptPubKey = CScript() << OP_ZEROCOINMINT << bnPubcoin.getvch().size() << bnPubcoin.getvch();
+            CBlock block;
+            block.nVersion = 1;
+            block.hashPrevBlock = chainActive.Tip()->GetBlockHash();
+            block.nTime = chainActive.Tip()->nTime + 60;
+            block.nBits = chainActive.Tip()->nBits;
+            block.vtx.push_back(txCoinBase);
+            block.vtx.push_back(txMint);
+            block.hashMerkleRoot = block.BuildMerkleTree();
+
+            // Files past any the node uses
+            CDiskBlockPos pos(1008, 0);
+            BOOST_REQUIRE(WriteBlockToDisk(block, pos));
+            CBlockIndex* pindex = new CBlockIndex(block);
+            BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(block.GetHash(), pindex)).first;
+            pindex->phashBlock = &mi->first;
+            pindex->pprev = chainActive.Tip();
+            pindex->nHeight = nHeight;
+            pindex->nTx = block.vtx.size();
+            pindex->nFile = pos.nFile;
+            pindex->nDataPos = pos.nPos;
+            pindex->nStatus = BLOCK_HAVE_DATA | BLOCK_VALID_SCRIPTS;
+            pindex->ClearMintDenominations();
+            pindex->AddMintDenomination(libzerocoin::ZQ_FIVE);
+            chainActive.SetTip(pindex);
+            vIndex.push_back(pindex);
+        }
+        BOOST_CHECK_EQUAL(mintCounts.GetCount(chainActive, 26, libzerocoin::ZQ_FIVE), 25U);
+
+        // The counts follow the denominations the recalculation rewrites
+        BOOST_CHECK(RecalculateSupply(1, true));
+        BOOST_CHECK_EQUAL(mintCounts.GetCount(chainActive, 26, libzerocoin::ZQ_FIVE), 0U);
+        BOOST_CHECK_EQUAL(mintCounts.GetCount(chainActive, 26, libzerocoin::ZQ_ONE), 25U);
+        BOOST_CHECK_EQUAL(mintCounts.GetCount(chainActive, 11, libzerocoin::ZQ_ONE), 10U);
+
+        chainActive.SetTip(pindexGenesis);
+        for (CBlockIndex* pindex : vIndex) {
+            mapBlockIndex.erase(pindex->GetBlockHash());
+            delete pindex;
+        }
+        mintCounts.Clear();
+    }
+
+    ModifiableParams()->setZerocoinStartHeight(nZerocoinStartHeightPrev);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,59 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "clientversion.h"
+#include "mappedfile.h"
+#include "random.h"
+#include "streams.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(mappedfile_tests)
+
+BOOST_AUTO_TEST_CASE(span_reader)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    std::vector<unsigned char> vch(300, 7);
+    ss << 12345 << vch;
+
+    CSpanReader reader(&ss[0], &ss[0] + ss.size(), SER_DISK, CLIENT_VERSION);
+    int n;
+    std::vector<unsigned char> vch2;
+    reader >> n >> vch2;
+    BOOST_CHECK_EQUAL(n, 12345);
+    BOOST_CHECK(vch2 == vch);
+    BOOST_CHECK(reader.empty());
+    BOOST_CHECK_THROW(reader >> n, std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(mapped_file)
+{
+    boost::filesystem::path path = GetTempPath() / strprintf("test_Divitae_mappedfile_%lu", (unsigned long)GetRand(100000000));
+    CAutoFile fileout(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    fileout << 42 << std::string("mapped");
+    fileout.fclose();
+
+    std::shared_ptr<const CMappedFile> pfile = CMappedFile::Open(path);
+#ifndef WIN32
+    BOOST_CHECK(pfile);
+    // The mapping outlives the file's directory entry
+    boost::filesystem::remove(path);
+    CSpanReader reader(pfile->data(), pfile->data() + pfile->size(), SER_DISK, CLIENT_VERSION);
+    int n;
+    std::string str;
+    reader >> n >> str;
+    BOOST_CHECK_EQUAL(n, 42);
+    BOOST_CHECK_EQUAL(str, "mapped");
+    BOOST_CHECK(reader.empty());
+#else
+    BOOST_CHECK(!pfile);
+    boost::filesystem::remove(path);
+#endif
+
+    BOOST_CHECK(!CMappedFile::Open(path));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
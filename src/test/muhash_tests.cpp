@@ -0,0 +1,99 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "clientversion.h"
+#include "muhash.h"
+#include "streams.h"
+#include "txdb.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(muhash_tests)
+
+static std::vector<unsigned char> Element(unsigned char c)
+{
+    return std::vector<unsigned char>(32, c);
+}
+
+BOOST_AUTO_TEST_CASE(muhash_set_operations)
+{
+    CMuHash3072 empty;
+    CMuHash3072 ab, ba;
+    ab.Insert(Element(1));
+    ab.Insert(Element(2));
+    ba.Insert(Element(2));
+    ba.Insert(Element(1));
+    BOOST_CHECK(ab.Finalize() == ba.Finalize());
+    BOOST_CHECK(ab.Finalize() != empty.Finalize());
+
+    // Removing an element that was never added and adding it later cancels out too
+    CMuHash3072 acc;
+    acc.Remove(Element(1));
+    acc.Insert(Element(2));
+    acc.Insert(Element(1));
+    acc.Remove(Element(2));
+    BOOST_CHECK(acc.Finalize() == empty.Finalize());
+
+    CMuHash3072 a, b;
+    a.Insert(Element(1));
+    b.Insert(Element(2));
+    CMuHash3072 c = a;
+    c *= b;
+    BOOST_CHECK(c.Finalize() == ab.Finalize());
+    c /= a;
+    BOOST_CHECK(c.Finalize() == b.Finalize());
+}
+
+BOOST_AUTO_TEST_CASE(muhash_serialization)
+{
+    CMuHash3072 muhash;
+    muhash.Insert(Element(1));
+    muhash.Insert(Element(2));
+    muhash.Remove(Element(3));
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << muhash;
+    BOOST_CHECK_EQUAL(ss.size(), CMuHash3072::BYTE_SIZE);
+
+    CMuHash3072 muhash2;
+    ss >> muhash2;
+    BOOST_CHECK(muhash2 == muhash);
+    BOOST_CHECK(muhash2.Finalize() == muhash.Finalize());
+
+    // The stored state keeps accepting updates
+    muhash.Insert(Element(3));
+    muhash2.Insert(Element(3));
+    BOOST_CHECK(muhash2.Finalize() == muhash.Finalize());
+}
+
+BOOST_AUTO_TEST_CASE(coins_running_stats)
+{
+    CCoinsRunningStats stats;
+    const uint256 hashEmpty = stats.muhash.Finalize();
+
+    COutPoint outpoint1(uint256(1), 0), outpoint2(uint256(1), 1);
+    Coin coin1(CTxOut(5 * COIN, CScript() << OP_TRUE), 10, false, false);
+    Coin coin2(CTxOut(7 * COIN, CScript() << OP_TRUE << OP_TRUE), 10, false, true);
+
+    stats.AddCoin(outpoint1, coin1);
+    stats.AddCoin(outpoint2, coin2);
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, 2U);
+    BOOST_CHECK_EQUAL(stats.nTotalAmount, 12 * COIN);
+    BOOST_CHECK(stats.nSerializedSize > 0);
+
+    // The same coin at a different height is a different element
+    CCoinsRunningStats stats2 = stats;
+    stats2.RemoveCoin(outpoint1, coin1);
+    stats2.AddCoin(outpoint1, Coin(coin1.out, 11, false, false));
+    BOOST_CHECK(stats2.muhash.Finalize() != stats.muhash.Finalize());
+
+    stats.RemoveCoin(outpoint1, coin1);
+    stats.RemoveCoin(outpoint2, coin2);
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, 0U);
+    BOOST_CHECK_EQUAL(stats.nSerializedSize, 0U);
+    BOOST_CHECK_EQUAL(stats.nTotalAmount, 0);
+    BOOST_CHECK(stats.muhash.Finalize() == hashEmpty);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,207 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "coins.h"
+#include "main.h"
+#include "snapshot.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(snapshot_tests)
+
+//! Replace the chainstate with that of a node that only has the genesis block
+static void ResetChainState()
+{
+    LOCK(cs_main);
+    UnloadBlockIndex();
+    pindexBestHeader = NULL;
+    delete pcoinsTip;
+    delete pcoinsflusher;
+    delete pcoinsdbview;
+    delete pblocktree;
+    pblocktree = new CBlockTreeDB(1 << 20, true);
+    pcoinsdbview = new CCoinsViewDB(1 << 23, true);
+    pcoinsflusher = new CCoinsViewBackgroundFlush(pcoinsdbview);
+    pcoinsTip = new CCoinsViewCache(pcoinsflusher);
+    BOOST_REQUIRE(InitBlockIndex());
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_metadata_size)
+{
+    // dumptxoutset rewrites the metadata in place once the counts are known
+    CSnapshotMetadata metadata;
+    const unsigned int nSize = ::GetSerializeSize(metadata, SER_DISK, CLIENT_VERSION);
+    metadata.nHeight = 1234567;
+    metadata.nCoins = 0xffffffffffULL;
+    metadata.nZerocoinEntries = 1;
+    metadata.hashContents = ~uint256(0);
+    BOOST_CHECK_EQUAL(::GetSerializeSize(metadata, SER_DISK, CLIENT_VERSION), nSize);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << metadata;
+    CSnapshotMetadata metadata2;
+    ss >> metadata2;
+    BOOST_CHECK_EQUAL(metadata2.nVersion, SNAPSHOT_VERSION);
+    BOOST_CHECK_EQUAL(metadata2.nHeight, 1234567);
+    BOOST_CHECK(metadata2.nCoins == metadata.nCoins);
+    BOOST_CHECK(metadata2.hashContents == metadata.hashContents);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_zerocoin_entry)
+{
+    CSnapshotZerocoinEntry mint;
+    mint.chType = 'm';
+    mint.hash = uint256(1);
+    mint.txHash = uint256(2);
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << mint;
+    BOOST_CHECK_EQUAL(ss.size(), 65U);
+
+    CSnapshotZerocoinEntry accumulator;
+    accumulator.chType = '2';
+    accumulator.nChecksum = 0xdeadbeef;
+    accumulator.bnValue = CBigNum(123456789);
+    ss << accumulator;
+
+    CSnapshotZerocoinEntry entry;
+    ss >> entry;
+    BOOST_CHECK(!entry.IsAccumulatorValue());
+    BOOST_CHECK(entry.hash == mint.hash && entry.txHash == mint.txHash);
+    ss >> entry;
+    BOOST_CHECK(entry.IsAccumulatorValue());
+    BOOST_CHECK_EQUAL(entry.nChecksum, 0xdeadbeef);
+    BOOST_CHECK(entry.bnValue == accumulator.bnValue);
+    BOOST_CHECK(ss.empty());
+
+    CSnapshotZerocoinEntry pubcoins;
+    pubcoins.chType = 'p';
+    pubcoins.nDenomination = libzerocoin::ZQ_FIFTY;
+    pubcoins.nHeight = 300000;
+    pubcoins.vPubcoins.push_back(CBigNum(7));
+    pubcoins.vPubcoins.push_back(CBigNum(11));
+    ss << pubcoins;
+    ss >> entry;
+    BOOST_CHECK(entry.IsBlockPubcoins());
+    BOOST_CHECK_EQUAL(entry.nDenomination, libzerocoin::ZQ_FIFTY);
+    BOOST_CHECK_EQUAL(entry.nHeight, 300000);
+    BOOST_CHECK(entry.vPubcoins == pubcoins.vPubcoins);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_dump_load)
+{
+    ResetChainState();
+    ModifiableParams()->setSkipProofOfWorkCheck(true);
+    CZerocoinDB* pzerocoinDBPrev = zerocoinDB;
+    zerocoinDB = new CZerocoinDB(1 << 20, true);
+
+    // A few blocks on top of the genesis block, each with a coinbase output
+    std::vector<COutPoint> vOutpoints;
+    {
+        LOCK(cs_main);
+        for (int nHeight = 1; nHeight <= 3; nHeight++) {
+            CMutableTransaction txCoinBase;
+            txCoinBase.vin.resize(1);
+            txCoinBase.vin[0].prevout.SetNull();
+            txCoinBase.vin[0].scriptSig = CScript() << nHeight << OP_0;
+            txCoinBase.vout.resize(1);
+            txCoinBase.vout[0].nValue = nHeight * COIN;
+            txCoinBase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+            CBlock block;
+            block.nVersion = 1;
+            block.hashPrevBlock = chainActive.Tip()->GetBlockHash();
+            block.nTime = chainActive.Tip()->nTime + 60;
+            block.nBits = chainActive.Tip()->nBits;
+            block.vtx.push_back(txCoinBase);
+            block.hashMerkleRoot = block.BuildMerkleTree();
+
+            // Files past any the node uses
+            CDiskBlockPos pos(1002, 0);
+            BOOST_REQUIRE(WriteBlockToDisk(block, pos));
+            CBlockIndex* pindex = new CBlockIndex(block);
+            BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(block.GetHash(), pindex)).first;
+            pindex->phashBlock = &mi->first;
+            pindex->pprev = chainActive.Tip();
+            pindex->nHeight = nHeight;
+            pindex->nTx = 1;
+            pindex->nFile = pos.nFile;
+            pindex->nDataPos = pos.nPos;
+            pindex->nStatus = BLOCK_HAVE_DATA | BLOCK_VALID_SCRIPTS;
+            chainActive.SetTip(pindex);
+
+            vOutpoints.push_back(COutPoint(block.vtx[0].GetHash(), 0));
+            pcoinsTip->AddCoin(vOutpoints.back(), Coin(txCoinBase.vout[0], nHeight, true, false), false);
+        }
+        pcoinsTip->SetBestBlock(chainActive.Tip()->GetBlockHash());
+    }
+    BOOST_CHECK(zerocoinDB->WriteAccumulatorValue(0xdeadbeef, CBigNum(123456789)));
+    std::vector<std::pair<libzerocoin::PublicCoin, uint256> > vMintInfo;
+    vMintInfo.push_back(std::make_pair(libzerocoin::PublicCoin(Params().Zerocoin_Params(false), CBigNum(12345), libzerocoin::ZQ_ONE), GetRandHash()));
+    BOOST_CHECK(zerocoinDB->WriteCoinMintBatch(vMintInfo));
+    const uint256 hashSerial = GetRandHash();
+    const uint256 txidSpend = GetRandHash();
+    CLevelDBBatch batch;
+    batch.Write(std::make_pair('s', hashSerial), txidSpend);
+    BOOST_CHECK(zerocoinDB->WriteBatch(batch));
+
+    const boost::filesystem::path path = GetDataDir() / "snapshot_dump_load.dat";
+    CSnapshotMetadata metadata;
+    std::string strError;
+    BOOST_REQUIRE_MESSAGE(DumpTxOutSet(path, metadata, strError), strError);
+    BOOST_CHECK_EQUAL(metadata.nHeight, 3);
+    BOOST_CHECK_EQUAL(metadata.nRecentBlocks, 3);
+    BOOST_CHECK_EQUAL(metadata.nCoins, 3U);
+    BOOST_CHECK_EQUAL(metadata.nZerocoinEntries, 3U);
+    const uint256 hashBase = metadata.hashBlock;
+
+    // The node that loads it has its zerocoin filters loaded, without the spends and mints
+    delete zerocoinDB;
+    zerocoinDB = new CZerocoinDB(1 << 20, true);
+    BOOST_REQUIRE(zerocoinDB->LoadFilters());
+
+    // Only snapshots pinned in the chain params are loaded
+    CSnapshotMetadata metadataLoaded;
+    ResetChainState();
+    BOOST_CHECK(!LoadTxOutSet(path, metadataLoaded, strError));
+    ModifiableParams()->setSnapshotHash(metadata.hashBlock, metadata.hashContents);
+    BOOST_REQUIRE_MESSAGE(LoadTxOutSet(path, metadataLoaded, strError), strError);
+    BOOST_CHECK(metadataLoaded.hashContents == metadata.hashContents);
+
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(chainActive.Height(), 3);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == hashBase);
+        for (int nHeight = 1; nHeight <= 3; nHeight++) {
+            const Coin& coin = pcoinsTip->AccessCoin(vOutpoints[nHeight - 1]);
+            BOOST_CHECK(!coin.IsSpent());
+            BOOST_CHECK_EQUAL(coin.nHeight, nHeight);
+            BOOST_CHECK(coin.fCoinBase);
+            BOOST_CHECK(coin.out.nValue == nHeight * COIN);
+
+            // The recent blocks are stored again, in the node's own block files
+            CBlock block;
+            BOOST_CHECK(ReadBlockFromDisk(block, chainActive[nHeight]));
+            BOOST_CHECK(block.vtx.size() == 1 && block.vtx[0].GetHash() == vOutpoints[nHeight - 1].hash);
+        }
+    }
+    CBigNum bnValue;
+    BOOST_CHECK(zerocoinDB->ReadAccumulatorValue(0xdeadbeef, bnValue));
+    BOOST_CHECK(bnValue == CBigNum(123456789));
+    uint256 txid;
+    BOOST_CHECK(zerocoinDB->ReadCoinMint(CBigNum(12345), txid) && txid == vMintInfo[0].second);
+    BOOST_CHECK(zerocoinDB->ReadCoinSpend(hashSerial, txid) && txid == txidSpend);
+
+    boost::filesystem::remove(path);
+    delete zerocoinDB;
+    zerocoinDB = pzerocoinDBPrev;
+    ModifiableParams()->setSkipProofOfWorkCheck(false);
+    ResetChainState();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
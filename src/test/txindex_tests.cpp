@@ -0,0 +1,86 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txdb.h"
+#include "txindex.h"
+#include "utiltime.h"
+#include "validationinterface.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(txindex_tests)
+
+static bool WaitForSync(const CTxIndex& txindex)
+{
+    for (int i = 0; i < 1000; i++) {
+        {
+            LOCK(cs_main);
+            if (txindex.IsSynced())
+                return true;
+        }
+        MilliSleep(10);
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE(txindex_connect_disconnect)
+{
+    CBlockTreeDB db(1 << 20, true);
+    CTxIndex txindex(&db);
+    txindex.Start();
+    BOOST_CHECK(WaitForSync(txindex));
+    RegisterValidationInterface(&txindex);
+
+    CBlock block;
+    for (unsigned int i = 0; i < 2; i++) {
+        CMutableTransaction tx;
+        tx.vout.resize(1);
+        tx.vout[0].nValue = i;
+        tx.vout[0].scriptPubKey = CScript() << std::vector<unsigned char>(100 * (i + 1), 1);
+        block.vtx.push_back(tx);
+    }
+    const uint256 hash = block.GetHash();
+    CBlockIndex index(block);
+    index.phashBlock = &hash;
+    index.nFile = 0;
+    index.nDataPos = 1000;
+    index.nStatus = BLOCK_HAVE_DATA;
+
+    int nHeightBefore;
+    {
+        LOCK(cs_main);
+        nHeightBefore = txindex.GetBestHeight();
+        index.pprev = chainActive.Tip();
+        index.nHeight = chainActive.Height() + 1;
+        GetMainSignals().BlockConnected(block, &index);
+        BOOST_CHECK_EQUAL(txindex.GetBestHeight(), index.nHeight);
+    }
+
+    // The positions are found while queued and once written
+    const unsigned int nOffset = 1 + ::GetSerializeSize(block.vtx[0], SER_DISK, CLIENT_VERSION);
+    CDiskTxPos pos;
+    BOOST_CHECK(txindex.FindTx(block.vtx[1].GetHash(), pos));
+    BOOST_CHECK_EQUAL(pos.nPos, 1000U);
+    BOOST_CHECK_EQUAL(pos.nTxOffset, nOffset);
+    BOOST_CHECK(txindex.WaitForWrite());
+    BOOST_CHECK(db.ReadTxIndex(block.vtx[0].GetHash(), pos));
+    BOOST_CHECK_EQUAL(pos.nTxOffset, 1U);
+    CBlockLocator locator;
+    BOOST_CHECK(db.ReadTxIndexBestBlock(locator));
+    BOOST_CHECK(!locator.IsNull() && locator.vHave[0] == hash);
+
+    // Disconnecting moves the best block back
+    {
+        LOCK(cs_main);
+        GetMainSignals().BlockDisconnected(block, &index);
+        BOOST_CHECK_EQUAL(txindex.GetBestHeight(), nHeightBefore);
+    }
+    BOOST_CHECK(txindex.WaitForWrite());
+    BOOST_CHECK(db.ReadTxIndexBestBlock(locator));
+    BOOST_CHECK(locator.IsNull() || locator.vHave[0] != hash);
+
+    UnregisterValidationInterface(&txindex);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
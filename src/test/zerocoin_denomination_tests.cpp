@@ -519,4 +519,47 @@ BOOST_AUTO_TEST_CASE(zerocoin_spend_test99)
     nValueTarget += OneCoinAmount;
 }
 
+BOOST_AUTO_TEST_CASE(block_index_denomination_serialization)
+{
+    cout << "Running block_index_denomination_serialization...\n";
+
+    // A proof-of-stake block index entry in the layout written with the
+    // std::map supply and std::vector mint denomination members
+    std::map<CoinDenomination, int64_t> mapSupply;
+    for (auto& denom : zerocoinDenomList)
+        mapSupply.insert(std::make_pair(denom, 0));
+    mapSupply.at(ZQ_ONE) = 12;
+    mapSupply.at(ZQ_FIVE_THOUSAND) = 3;
+    std::vector<CoinDenomination> vMints = {ZQ_ONE, ZQ_ONE, ZQ_FIFTY, ZQ_FIVE_THOUSAND};
+    COutPoint prevoutStake(GetRandHash(), 1);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << VARINT(CLIENT_VERSION) << VARINT(100) << VARINT(0) << VARINT(2);
+    ss << (int64_t)0 << (int64_t)0 << (unsigned int)CBlockIndex::BLOCK_PROOF_OF_STAKE << (uint64_t)0;
+    ss << prevoutStake << (unsigned int)1500000000;
+    ss << 4 << uint256() << uint256() << uint256() << (unsigned int)1500000000 << (unsigned int)0 << (unsigned int)0 << uint256();
+    ss << mapSupply << vMints;
+    std::string strOld = ss.str();
+
+    CDiskBlockIndex diskindex;
+    ss >> diskindex;
+    BOOST_CHECK(ss.empty());
+    BOOST_CHECK_EQUAL(diskindex.GetZerocoinSupply(ZQ_ONE), 12);
+    BOOST_CHECK_EQUAL(diskindex.GetZerocoinSupply(ZQ_FIVE), 0);
+    BOOST_CHECK_EQUAL(diskindex.GetZerocoinSupply(ZQ_FIVE_THOUSAND), 3);
+    BOOST_CHECK_EQUAL(diskindex.GetZerocoinSupply(), 12 * COIN + 3 * 5000 * COIN);
+    BOOST_CHECK_EQUAL(diskindex.GetMintDenominationCount(ZQ_ONE), 2U);
+    BOOST_CHECK_EQUAL(diskindex.GetMintDenominationCount(ZQ_TEN), 0U);
+    BOOST_CHECK(diskindex.MintedDenomination(ZQ_FIFTY));
+    BOOST_CHECK(!diskindex.MintedDenomination(ZQ_FIVE));
+    BOOST_CHECK(diskindex.GetMintDenominations() == vMints);
+    BOOST_CHECK(diskindex.prevoutStake == prevoutStake);
+    BOOST_CHECK_THROW(diskindex.GetZerocoinSupply(ZQ_ERROR), std::out_of_range);
+
+    // Writing the entry back gives the same record
+    CDataStream ss2(SER_DISK, CLIENT_VERSION);
+    ss2 << diskindex;
+    BOOST_CHECK(ss2.str() == strOld);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
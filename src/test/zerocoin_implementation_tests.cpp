@@ -516,4 +516,142 @@ BOOST_AUTO_TEST_CASE(deterministic_tests)
 }
 
 
+BOOST_AUTO_TEST_CASE(mint_counts_test)
+{
+    // A chain with a mint of ZQ_ONE in every third block and a mint of ZQ_FIVE at height 25
+    std::vector<CBlockIndex> vIndex(60);
+    CChain chain;
+    for (unsigned int i = 0; i < vIndex.size(); i++) {
+        vIndex[i].nHeight = i;
+        vIndex[i].pprev = i ? &vIndex[i - 1] : NULL;
+        vIndex[i].ClearMintDenominations();
+        if (i % 3 == 0)
+            vIndex[i].AddMintDenomination(libzerocoin::ZQ_ONE);
+        if (i == 25)
+            vIndex[i].AddMintDenomination(libzerocoin::ZQ_FIVE);
+    }
+    chain.SetTip(&vIndex[39]);
+
+    CMintCounts counts;
+    BOOST_CHECK_EQUAL(counts.GetCount(chain, 0, libzerocoin::ZQ_ONE), 0U);
+    BOOST_CHECK_EQUAL(counts.GetCount(chain, 1, libzerocoin::ZQ_ONE), 1U);
+    BOOST_CHECK_EQUAL(counts.GetCount(chain, 31, libzerocoin::ZQ_ONE), 11U);
+    BOOST_CHECK_EQUAL(counts.GetCount(chain, 40, libzerocoin::ZQ_ONE), 14U);
+    BOOST_CHECK_EQUAL(counts.GetCount(chain, 25, libzerocoin::ZQ_FIVE), 0U);
+    BOOST_CHECK_EQUAL(counts.GetCount(chain, 26, libzerocoin::ZQ_FIVE), 1U);
+
+    // The counts follow the chain as it grows
+    chain.SetTip(&vIndex[59]);
+    BOOST_CHECK_EQUAL(counts.GetCount(chain, 60, libzerocoin::ZQ_ONE), 20U);
+
+    // And when it switches to a fork without the mints from height 20 on
+    std::vector<CBlockIndex> vFork(30);
+    for (unsigned int i = 0; i < vFork.size(); i++) {
+        vFork[i].nHeight = 20 + i;
+        vFork[i].pprev = i ? &vFork[i - 1] : &vIndex[19];
+        vFork[i].ClearMintDenominations();
+    }
+    chain.SetTip(&vFork.back());
+    BOOST_CHECK_EQUAL(counts.GetCount(chain, 50, libzerocoin::ZQ_ONE), 7U);
+    BOOST_CHECK_EQUAL(counts.GetCount(chain, 50, libzerocoin::ZQ_FIVE), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(mint_witness_serialization)
+{
+    CMintWitness witness;
+    BOOST_CHECK(witness.IsNull());
+    witness.denom = libzerocoin::ZQ_FIFTY;
+    witness.nHeightMint = 1234;
+    witness.nHeight = 1300;
+    witness.hashBlock = uint256("0x1f");
+    witness.nMintsAdded = 17;
+    witness.bnValue = CBigNum(987654321);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << witness;
+    CMintWitness witnessRead;
+    ss >> witnessRead;
+    BOOST_CHECK(!witnessRead.IsNull());
+    BOOST_CHECK_EQUAL(witnessRead.denom, libzerocoin::ZQ_FIFTY);
+    BOOST_CHECK_EQUAL(witnessRead.nHeightMint, 1234);
+    BOOST_CHECK_EQUAL(witnessRead.nHeight, 1300);
+    BOOST_CHECK(witnessRead.hashBlock == witness.hashBlock);
+    BOOST_CHECK_EQUAL(witnessRead.nMintsAdded, 17);
+    BOOST_CHECK(witnessRead.bnValue == witness.bnValue);
+}
+
+BOOST_AUTO_TEST_CASE(mint_witness_advance)
+{
+    // A mint of ZQ_ONE in every block around the activation of zDIVIT v2, when the blocks
+    // 1050000 to 1050010 were accumulated twice
+    const int nHeightFirst = 1049990;
+    const int nHeightEnd = 1050030;
+    const int nHeightMint = 1049995;
+    CZerocoinDB* pzerocoinDBPrev = zerocoinDB;
+    zerocoinDB = new CZerocoinDB(1 << 20, true);
+    std::vector<CBlockIndex> vIndex(nHeightEnd - nHeightFirst);
+    std::vector<uint256> vHashes(vIndex.size());
+    std::vector<const CBlockIndex*> vBlocks;
+    for (unsigned int i = 0; i < vIndex.size(); i++) {
+        vHashes[i] = uint256(i + 1);
+        vIndex[i].phashBlock = &vHashes[i];
+        vIndex[i].nHeight = nHeightFirst + i;
+        vIndex[i].pprev = i ? &vIndex[i - 1] : NULL;
+        vIndex[i].ClearMintDenominations();
+        vIndex[i].AddMintDenomination(libzerocoin::ZQ_ONE);
+        std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> > mapPubcoins;
+        mapPubcoins[libzerocoin::ZQ_ONE].push_back(CBigNum(1000 + i));
+        BOOST_CHECK(zerocoinDB->WriteBlockPubcoins(vIndex[i].nHeight, mapPubcoins));
+        vBlocks.push_back(&vIndex[i]);
+    }
+    const uint256 hashPubcoin = GetPubCoinHash(CBigNum(1000 + nHeightMint - nHeightFirst));
+
+    // Every pubcoin except the mint's own, those of 1050000 to 1050010 twice
+    libzerocoin::Accumulator accumulatorExpected(Params().Zerocoin_Params(false), libzerocoin::ZQ_ONE);
+    int nMintsExpected = 0;
+    for (unsigned int i = 0; i < vIndex.size(); i++) {
+        if (vIndex[i].nHeight == nHeightMint)
+            continue;
+        for (int n = (vIndex[i].nHeight >= 1050000 && vIndex[i].nHeight <= 1050010) ? 2 : 1; n > 0; n--) {
+            accumulatorExpected.increment(CBigNum(1000 + i));
+            nMintsExpected++;
+        }
+    }
+
+    CMintWitness witnessStart;
+    witnessStart.denom = libzerocoin::ZQ_ONE;
+    witnessStart.nHeightMint = nHeightMint;
+    witnessStart.nHeight = nHeightFirst;
+    witnessStart.nMintsAdded = 0;
+    witnessStart.bnValue = libzerocoin::Accumulator(Params().Zerocoin_Params(false), libzerocoin::ZQ_ONE).getValue();
+
+    // From scratch
+    CMintWitness witness = witnessStart;
+    BOOST_REQUIRE(AdvanceMintWitness(hashPubcoin, vBlocks, nHeightFirst, nHeightEnd, witness));
+    BOOST_CHECK(witness.bnValue == accumulatorExpected.getValue());
+    BOOST_CHECK_EQUAL(witness.nMintsAdded, nMintsExpected);
+    BOOST_CHECK_EQUAL(witness.nHeight, nHeightEnd);
+    BOOST_CHECK(witness.hashBlock == vHashes.back());
+
+    // From a witness kept at any height before, within or after the blocks accumulated twice
+    for (int nHeightKept = nHeightFirst + 1; nHeightKept < nHeightEnd; nHeightKept++) {
+        CMintWitness witnessKept = witnessStart;
+        BOOST_REQUIRE(AdvanceMintWitness(hashPubcoin, vBlocks, nHeightFirst, nHeightKept, witnessKept));
+        BOOST_CHECK(witnessKept.hashBlock == vHashes[nHeightKept - 1 - nHeightFirst]);
+        BOOST_REQUIRE(AdvanceMintWitness(hashPubcoin, vBlocks, nHeightFirst, nHeightEnd, witnessKept));
+        BOOST_CHECK_MESSAGE(witnessKept.bnValue == witness.bnValue, "kept at " << nHeightKept);
+        BOOST_CHECK_EQUAL(witnessKept.nMintsAdded, witness.nMintsAdded);
+        BOOST_CHECK(witnessKept.hashBlock == witness.hashBlock);
+    }
+
+    // A witness kept within them can not go on without the blocks from 1050000
+    CMintWitness witnessKept = witnessStart;
+    BOOST_REQUIRE(AdvanceMintWitness(hashPubcoin, vBlocks, nHeightFirst, 1050005, witnessKept));
+    std::vector<const CBlockIndex*> vBlocksLate(vBlocks.begin() + (1050003 - nHeightFirst), vBlocks.end());
+    BOOST_CHECK(!AdvanceMintWitness(hashPubcoin, vBlocksLate, 1050003, nHeightEnd, witnessKept));
+
+    delete zerocoinDB;
+    zerocoinDB = pzerocoinDBPrev;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
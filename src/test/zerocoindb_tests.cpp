@@ -0,0 +1,234 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "invalid.h"
+#include "main.h"
+#include "streams.h"
+#include "txdb.h"
+#include "zvitchain.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(zerocoindb_tests)
+
+BOOST_AUTO_TEST_CASE(block_pubcoins_key_order)
+{
+    // The keys of a denomination sort by height, so the pubcoins can be read in chain order
+    CDataStream ssLow(SER_DISK, CLIENT_VERSION), ssHigh(SER_DISK, CLIENT_VERSION);
+    ssLow << CBlockPubcoinsKey(libzerocoin::ZQ_ONE, 255);
+    ssHigh << CBlockPubcoinsKey(libzerocoin::ZQ_ONE, 256);
+    BOOST_CHECK(ssLow.str() < ssHigh.str());
+
+    CBlockPubcoinsKey key;
+    ssHigh >> key;
+    BOOST_CHECK_EQUAL(key.chType, 'p');
+    BOOST_CHECK_EQUAL(key.nDenomination, libzerocoin::ZQ_ONE);
+    BOOST_CHECK_EQUAL(key.nHeight, 256);
+}
+
+BOOST_AUTO_TEST_CASE(block_pubcoins_cursor)
+{
+    CZerocoinDB db(1 << 20, true);
+    for (int nHeight = 100; nHeight <= 400; nHeight += 100) {
+        std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> > mapPubcoins;
+        mapPubcoins[libzerocoin::ZQ_ONE].push_back(CBigNum(nHeight));
+        if (nHeight == 300)
+            mapPubcoins[libzerocoin::ZQ_FIVE].push_back(CBigNum(nHeight + 1));
+        BOOST_CHECK(db.WriteBlockPubcoins(nHeight, mapPubcoins));
+    }
+
+    // The cursor stays within its denomination, in height order
+    boost::scoped_ptr<CPubcoinCursor> pcursor(db.PubcoinCursor(libzerocoin::ZQ_ONE, 150));
+    std::vector<int> vHeights;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        std::vector<CBigNum> vPubcoins;
+        BOOST_CHECK(pcursor->GetPubcoins(vPubcoins));
+        BOOST_CHECK(vPubcoins.size() == 1 && vPubcoins[0] == CBigNum(pcursor->GetHeight()));
+        vHeights.push_back(pcursor->GetHeight());
+    }
+    BOOST_CHECK_EQUAL(vHeights.size(), 3U);
+    BOOST_CHECK_EQUAL(vHeights.front(), 200);
+    BOOST_CHECK_EQUAL(vHeights.back(), 400);
+
+    pcursor->Seek(100);
+    BOOST_CHECK(pcursor->Valid() && pcursor->GetHeight() == 100);
+
+    pcursor.reset(db.PubcoinCursor(libzerocoin::ZQ_FIVE, 0));
+    BOOST_CHECK(pcursor->Valid() && pcursor->GetHeight() == 300);
+    pcursor->Next();
+    BOOST_CHECK(!pcursor->Valid());
+}
+
+BOOST_AUTO_TEST_CASE(reindex_zerocoin_db)
+{
+    const int nZerocoinStartHeightPrev = Params().Zerocoin_StartHeight();
+    ModifiableParams()->setZerocoinStartHeight(1);
+    CZerocoinDB* pzerocoinDBPrev = zerocoinDB;
+    zerocoinDB = new CZerocoinDB(1 << 20, true);
+
+    // An entry of an earlier index that is not in the chain
+    std::vector<std::pair<libzerocoin::PublicCoin, uint256> > vMintStale;
+    vMintStale.push_back(std::make_pair(libzerocoin::PublicCoin(Params().Zerocoin_Params(false), CBigNum(12345), libzerocoin::ZQ_ONE), GetRandHash()));
+    BOOST_CHECK(zerocoinDB->WriteCoinMintBatch(vMintStale));
+
+    // Blocks with a mint in every third one, past a few batches and the blocks in flight of the pipeline
+    std::vector<CBlockIndex*> vIndex;
+    std::vector<std::pair<CBigNum, uint256> > vMints;
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindexGenesis = chainActive.Tip();
+        for (int nHeight = 1; nHeight <= 650; nHeight++) {
+            CMutableTransaction txCoinBase;
+            txCoinBase.vin.resize(1);
+            txCoinBase.vin[0].prevout.SetNull();
+            txCoinBase.vin[0].scriptSig = CScript() << nHeight << OP_0;
+            txCoinBase.vout.resize(1);
+            CBlock block;
+            block.nVersion = 1;
+            block.hashPrevBlock = chainActive.Tip()->GetBlockHash();
+            block.nTime = chainActive.Tip()->nTime + 60;
+            block.nBits = chainActive.Tip()->nBits;
+            block.vtx.push_back(txCoinBase);
+            if (nHeight % 3 == 0) {
+                std::vector<unsigned char> vch(128, 0);
+                vch[0] = nHeight & 0xff;
+                vch[1] = nHeight >> 8;
+                vch[127] = 1;
+                CBigNum bnPubcoin;
+                bnPubcoin.setvch(vch);
+                CMutableTransaction txMint;
+                txMint.vin.resize(1);
+                txMint.vin[0].prevout = COutPoint(GetRandHash(), 0);
+                txMint.vout.resize(1);
+                txMint.vout[0].nValue = 1 * COIN;
+                txMint.vout[0].scriptPubKey = CScript() << OP_ZEROCOINMINT << bnPubcoin.getvch().size() << bnPubcoin.getvch();
+                block.vtx.push_back(txMint);
+                vMints.push_back(std::make_pair(bnPubcoin, txMint.GetHash()));
+            }
+            block.hashMerkleRoot = block.BuildMerkleTree();
+
+            // Files past any the node uses
+            CDiskBlockPos pos(1004, 0);
+            BOOST_REQUIRE(WriteBlockToDisk(block, pos));
+            CBlockIndex* pindex = new CBlockIndex(block);
+            BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(block.GetHash(), pindex)).first;
+            pindex->phashBlock = &mi->first;
+            pindex->pprev = chainActive.Tip();
+            pindex->nHeight = nHeight;
+            pindex->nTx = block.vtx.size();
+            pindex->nFile = pos.nFile;
+            pindex->nDataPos = pos.nPos;
+            pindex->nStatus = BLOCK_HAVE_DATA | BLOCK_VALID_SCRIPTS;
+            chainActive.SetTip(pindex);
+            vIndex.push_back(pindex);
+        }
+
+        BOOST_REQUIRE_EQUAL(ReindexZerocoinDB(), "");
+        bool fReindexZerocoin = true;
+        BOOST_CHECK(zerocoinDB->ReadFlag("reindexzerocoin", fReindexZerocoin) && !fReindexZerocoin);
+        for (const std::pair<CBigNum, uint256>& mint : vMints) {
+            uint256 txid;
+            BOOST_CHECK(zerocoinDB->ReadCoinMint(mint.first, txid) && txid == mint.second);
+        }
+        uint256 txid;
+        BOOST_CHECK(!zerocoinDB->ReadCoinMint(CBigNum(12345), txid));
+
+        // A block that can not be read stops the reindex, which stays marked to run again
+        const unsigned int nDataPos = vIndex[400]->nDataPos;
+        vIndex[400]->nDataPos = vIndex[401]->nDataPos;
+        BOOST_CHECK(ReindexZerocoinDB() != "");
+        BOOST_CHECK(zerocoinDB->ReadFlag("reindexzerocoin", fReindexZerocoin) && fReindexZerocoin);
+        vIndex[400]->nDataPos = nDataPos;
+
+        chainActive.SetTip(pindexGenesis);
+        for (CBlockIndex* pindex : vIndex) {
+            mapBlockIndex.erase(pindex->GetBlockHash());
+            delete pindex;
+        }
+    }
+
+    delete zerocoinDB;
+    zerocoinDB = pzerocoinDBPrev;
+    ModifiableParams()->setZerocoinStartHeight(nZerocoinStartHeightPrev);
+}
+
+BOOST_AUTO_TEST_CASE(index_block_pubcoins_invalid_outpoint)
+{
+    const int nZerocoinStartHeightPrev = Params().Zerocoin_StartHeight();
+    ModifiableParams()->setZerocoinStartHeight(1);
+    CZerocoinDB* pzerocoinDBPrev = zerocoinDB;
+    zerocoinDB = new CZerocoinDB(1 << 20, true);
+
+    // A block with a mint of a banned outpoint next to a valid one
+    const COutPoint outInvalid(GetRandHash(), 0);
+    invalid_out::setInvalidOutPoints.insert(outInvalid);
+    std::vector<CBigNum> vPubcoins;
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindexGenesis = chainActive.Tip();
+        CMutableTransaction txCoinBase;
+        txCoinBase.vin.resize(1);
+        txCoinBase.vin[0].prevout.SetNull();
+        txCoinBase.vin[0].scriptSig = CScript() << 1 << OP_0;
+        txCoinBase.vout.resize(1);
+        CBlock block;
+        block.nVersion = 1;
+        block.hashPrevBlock = pindexGenesis->GetBlockHash();
+        block.nTime = pindexGenesis->nTime + 60;
+        block.nBits = pindexGenesis->nBits;
+        block.vtx.push_back(txCoinBase);
+        for (unsigned int i = 0; i < 2; i++) {
+            std::vector<unsigned char> vch(128, 0);
+            vch[0] = i + 1;
+            vch[127] = 1;
+            CBigNum bnPubcoin;
+            bnPubcoin.setvch(vch);
+            CMutableTransaction txMint;
+            txMint.vin.resize(1);
+            txMint.vin[0].prevout = i == 0 ? outInvalid : COutPoint(GetRandHash(), 0);
+            txMint.vout.resize(1);
+            txMint.vout[0].nValue = 1 * COIN;
+            txMint.vout[0].scriptPubKey = CScript() << OP_ZEROCOINMINT << bnPubcoin.getvch().size() << bnPubcoin.getvch();
+            block.vtx.push_back(txMint);
+            vPubcoins.push_back(bnPubcoin);
+        }
+        block.hashMerkleRoot = block.BuildMerkleTree();
+
+        // A file past any the node uses
+        CDiskBlockPos pos(1006, 0);
+        BOOST_REQUIRE(WriteBlockToDisk(block, pos));
+        CBlockIndex* pindex = new CBlockIndex(block);
+        BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(block.GetHash(), pindex)).first;
+        pindex->phashBlock = &mi->first;
+        pindex->pprev = pindexGenesis;
+        pindex->nHeight = 1;
+        pindex->nTx = block.vtx.size();
+        pindex->nFile = pos.nFile;
+        pindex->nDataPos = pos.nPos;
+        pindex->nStatus = BLOCK_HAVE_DATA | BLOCK_VALID_SCRIPTS;
+        pindex->AddMintDenomination(libzerocoin::ZQ_ONE);
+        pindex->AddMintDenomination(libzerocoin::ZQ_ONE);
+        chainActive.SetTip(pindex);
+
+        // Only the valid mint is indexed
+        BOOST_REQUIRE_EQUAL(IndexBlockPubcoins(), "");
+        std::vector<CBigNum> vPubcoinsIndexed;
+        BOOST_CHECK(zerocoinDB->ReadBlockPubcoins(libzerocoin::ZQ_ONE, 1, vPubcoinsIndexed));
+        BOOST_CHECK(vPubcoinsIndexed.size() == 1 && vPubcoinsIndexed[0] == vPubcoins[1]);
+
+        chainActive.SetTip(pindexGenesis);
+        mapBlockIndex.erase(pindex->GetBlockHash());
+        delete pindex;
+    }
+    invalid_out::setInvalidOutPoints.erase(outInvalid);
+
+    delete zerocoinDB;
+    zerocoinDB = pzerocoinDBPrev;
+    ModifiableParams()->setZerocoinStartHeight(nZerocoinStartHeightPrev);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
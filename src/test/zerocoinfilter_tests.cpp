@@ -0,0 +1,71 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zerocoinfilter.h"
+#include "hash.h"
+#include "utilstrencodings.h"
+#include "uint256.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(zerocoinfilter_tests)
+
+static uint256 TestHash(uint32_t n)
+{
+    return Hash(BEGIN(n), END(n));
+}
+
+BOOST_AUTO_TEST_CASE(zerocoinfilter_lookups)
+{
+    CZerocoinFilter filter;
+    filter.Reset(50000);
+    for (uint32_t n = 0; n < 50000; n++)
+        filter.Insert(TestHash(n));
+
+    // Everything may be there until the filter is loaded
+    BOOST_CHECK(filter.MayContain(TestHash(1000000)));
+    BOOST_CHECK_EQUAL(filter.GetStats().nLookups, 0U);
+
+    filter.SetLoaded();
+    for (uint32_t n = 0; n < 50000; n++)
+        BOOST_CHECK(filter.MayContain(TestHash(n)));
+
+    // Hashes that were not inserted are mostly filtered out
+    unsigned int nPassed = 0;
+    for (uint32_t n = 1000000; n < 1100000; n++) {
+        if (filter.MayContain(TestHash(n))) {
+            filter.AddFalsePositive();
+            nPassed++;
+        }
+    }
+    BOOST_CHECK(nPassed < 100000 * ZEROCOIN_FILTER_FP_RATE * 3);
+
+    CZerocoinFilterStats stats = filter.GetStats();
+    BOOST_CHECK(stats.fLoaded);
+    BOOST_CHECK_EQUAL(stats.nLookups, 150000U);
+    BOOST_CHECK_EQUAL(stats.nFalsePositives, nPassed);
+    BOOST_CHECK_EQUAL(stats.nFiltered, 100000U - nPassed);
+    BOOST_CHECK(!filter.IsOverCapacity());
+}
+
+BOOST_AUTO_TEST_CASE(zerocoinfilter_capacity)
+{
+    CZerocoinFilter filter;
+    BOOST_CHECK_EQUAL(filter.GetStats().nCapacity, ZEROCOIN_FILTER_MIN_ELEMENTS);
+    for (uint32_t n = 0; n <= ZEROCOIN_FILTER_MIN_ELEMENTS; n++)
+        filter.Insert(TestHash(n));
+    BOOST_CHECK(filter.IsOverCapacity());
+
+    // A reset empties the filter and stops it answering lookups
+    filter.Reset(4 * ZEROCOIN_FILTER_MIN_ELEMENTS);
+    BOOST_CHECK(!filter.IsOverCapacity());
+    BOOST_CHECK(!filter.GetStats().fLoaded);
+    BOOST_CHECK_EQUAL(filter.GetStats().nElements, 0U);
+    BOOST_CHECK_EQUAL(filter.GetStats().nCapacity, 4 * ZEROCOIN_FILTER_MIN_ELEMENTS);
+    filter.Insert(TestHash(7));
+    filter.SetLoaded();
+    BOOST_CHECK(filter.MayContain(TestHash(7)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,70 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zvitspendcache.h"
+#include "random.h"
+#include "uint256.h"
+#include "util.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(zvitspendcache_tests)
+
+BOOST_AUTO_TEST_CASE(zvitspendcache_lookups)
+{
+    const uint256 hashSpend = GetRandHash();
+    uint64_t nLookups, nHits;
+    GetZerocoinSpendCacheStats(nLookups, nHits);
+
+    BOOST_CHECK(!IsZerocoinSpendVerified(hashSpend, 1));
+    SetZerocoinSpendVerified(hashSpend, 1);
+    BOOST_CHECK(IsZerocoinSpendVerified(hashSpend, 1));
+
+    // A spend verified against another accumulator must be verified again
+    BOOST_CHECK(!IsZerocoinSpendVerified(hashSpend, 2));
+    BOOST_CHECK(!IsZerocoinSpendVerified(GetRandHash(), 1));
+
+    uint64_t nLookupsAfter, nHitsAfter;
+    GetZerocoinSpendCacheStats(nLookupsAfter, nHitsAfter);
+    BOOST_CHECK_EQUAL(nLookupsAfter - nLookups, 4U);
+    BOOST_CHECK_EQUAL(nHitsAfter - nHits, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(zvitspendcache_eviction)
+{
+    // A cache of one entry holds only the last spend
+    mapArgs["-maxzerocoinspendcachesize"] = "1";
+    const uint256 hashFirst = GetRandHash();
+    const uint256 hashLast = GetRandHash();
+    SetZerocoinSpendVerified(hashFirst, 1);
+    SetZerocoinSpendVerified(hashLast, 1);
+    BOOST_CHECK(!IsZerocoinSpendVerified(hashFirst, 1));
+    BOOST_CHECK(IsZerocoinSpendVerified(hashLast, 1));
+
+    // Growing it keeps what is there, and a full cache evicts one entry per insert
+    mapArgs["-maxzerocoinspendcachesize"] = "3";
+    const uint256 hashA = GetRandHash();
+    const uint256 hashB = GetRandHash();
+    SetZerocoinSpendVerified(hashA, 1);
+    SetZerocoinSpendVerified(hashB, 1);
+    BOOST_CHECK(IsZerocoinSpendVerified(hashLast, 1));
+    BOOST_CHECK(IsZerocoinSpendVerified(hashA, 1));
+    BOOST_CHECK(IsZerocoinSpendVerified(hashB, 1));
+
+    const uint256 hashC = GetRandHash();
+    SetZerocoinSpendVerified(hashC, 1);
+    BOOST_CHECK(IsZerocoinSpendVerified(hashC, 1));
+    int nKept = IsZerocoinSpendVerified(hashLast, 1) + IsZerocoinSpendVerified(hashA, 1) + IsZerocoinSpendVerified(hashB, 1);
+    BOOST_CHECK_EQUAL(nKept, 2);
+
+    // A size of zero turns the cache off
+    mapArgs["-maxzerocoinspendcachesize"] = "0";
+    const uint256 hashOff = GetRandHash();
+    SetZerocoinSpendVerified(hashOff, 1);
+    BOOST_CHECK(!IsZerocoinSpendVerified(hashOff, 1));
+
+    mapArgs.erase("-maxzerocoinspendcachesize");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -8,11 +8,15 @@
 
 #include "txdb.h"
 
+#include "checkpoints.h"
+#include "init.h"
 #include "main.h"
 #include "pow.h"
+#include "ui_interface.h"
 #include "uint256.h"
 #include "accumulators.h"
 
+#include <atomic>
 #include <stdint.h>
 
 #include <boost/thread.hpp>
@@ -20,12 +24,94 @@
 using namespace std;
 using namespace libzerocoin;
 
-void static BatchWriteCoins(CLevelDBBatch& batch, const uint256& hash, const CCoins& coins)
+static const char DB_COIN = 'C';
+static const char DB_COINS = 'c';
+static const char DB_COINS_STATS = 'S';
+
+//! Number of writes queued before an intermediate batch is committed during Upgrade()
+static const size_t UPGRADE_BATCH_ENTRIES = 100000;
+
+//! Number of block index records decoded together by LoadBlockIndexGuts()
+static const size_t BLOCK_INDEX_LOAD_BATCH = 10000;
+
+namespace
 {
-    if (coins.IsPruned())
-        batch.Erase(make_pair('c', hash));
-    else
-        batch.Write(make_pair('c', hash), coins);
+struct CoinEntry {
+    COutPoint* outpoint;
+    char key;
+    CoinEntry(const COutPoint* ptr) : outpoint(const_cast<COutPoint*>(ptr)), key(DB_COIN) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(key);
+        READWRITE(outpoint->hash);
+        READWRITE(VARINT(outpoint->n));
+    }
+};
+
+/**
+ * Legacy per-transaction UTXO record, as stored under DB_COINS by versions
+ * before the per-outpoint chainstate. Only deserialization is supported; it
+ * is used to upgrade existing databases without a reindex.
+ *
+ * Serialized format:
+ * - VARINT(nVersion)
+ * - VARINT(nCode), where bit 1 is IsCoinBase(), bit 2 IsCoinStake(),
+ *   bits 4 and 8 the availability of vout[0] and vout[1], and the higher
+ *   bits the number of non-zero bytes in the following bitvector
+ * - unspentness bitvector, for vout[2] and further; least significant byte first
+ * - the non-spent CTxOuts (via CTxOutCompressor)
+ * - VARINT(nHeight)
+ */
+class CCoins
+{
+public:
+    bool fCoinBase;
+    bool fCoinStake;
+    std::vector<CTxOut> vout;
+    int nHeight;
+
+    CCoins() : fCoinBase(false), fCoinStake(false), vout(0), nHeight(0) {}
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        unsigned int nCode = 0;
+        // version
+        int nTxVersion = 0;
+        ::Unserialize(s, VARINT(nTxVersion), nType, nVersion);
+        // header code
+        ::Unserialize(s, VARINT(nCode), nType, nVersion);
+        fCoinBase = nCode & 1;
+        fCoinStake = (nCode & 2) != 0;
+        std::vector<bool> vAvail(2, false);
+        vAvail[0] = (nCode & 4) != 0;
+        vAvail[1] = (nCode & 8) != 0;
+        unsigned int nMaskCode = (nCode / 16) + ((nCode & 12) != 0 ? 0 : 1);
+        // spentness bitmask
+        while (nMaskCode > 0) {
+            unsigned char chAvail = 0;
+            ::Unserialize(s, chAvail, nType, nVersion);
+            for (unsigned int p = 0; p < 8; p++) {
+                bool f = (chAvail & (1 << p)) != 0;
+                vAvail.push_back(f);
+            }
+            if (chAvail != 0)
+                nMaskCode--;
+        }
+        // txouts themself
+        vout.assign(vAvail.size(), CTxOut());
+        for (unsigned int i = 0; i < vAvail.size(); i++) {
+            if (vAvail[i])
+                ::Unserialize(s, REF(CTxOutCompressor(vout[i])), nType, nVersion);
+        }
+        // coinbase height
+        ::Unserialize(s, VARINT(nHeight), nType, nVersion);
+    }
+};
 }
 
 void static BatchWriteHashBestChain(CLevelDBBatch& batch, const uint256& hash)
@@ -33,18 +119,18 @@ void static BatchWriteHashBestChain(CLevelDBBatch& batch, const uint256& hash)
     batch.Write('B', hash);
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe), pstatsTracked(NULL)
 {
 }
 
-bool CCoinsViewDB::GetCoins(const uint256& txid, CCoins& coins) const
+bool CCoinsViewDB::GetCoin(const COutPoint& outpoint, Coin& coin) const
 {
-    return db.Read(make_pair('c', txid), coins);
+    return db.Read(CoinEntry(&outpoint), coin);
 }
 
-bool CCoinsViewDB::HaveCoins(const uint256& txid) const
+bool CCoinsViewDB::HaveCoin(const COutPoint& outpoint) const
 {
-    return db.Exists(make_pair('c', txid));
+    return db.Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const
@@ -62,20 +148,289 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
     size_t changed = 0;
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            BatchWriteCoins(batch, it->first, it->second.coins);
+            CoinEntry entry(&it->first);
+            if (it->second.coin.IsSpent())
+                batch.Erase(entry);
+            else
+                batch.Write(entry, it->second.coin);
             changed++;
         }
         count++;
         CCoinsMap::iterator itOld = it++;
         mapCoins.erase(itOld);
     }
-    if (hashBlock != uint256(0))
+    if (hashBlock != uint256(0)) {
         BatchWriteHashBestChain(batch, hashBlock);
+        if (pstatsTracked && pstatsTracked->hashBlock == hashBlock)
+            batch.Write(DB_COINS_STATS, *pstatsTracked);
+    }
 
-    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    LogPrint("coindb", "Committing %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
     return db.WriteBatch(batch);
 }
 
+bool CCoinsViewDB::WriteCoins(const CCoinsMap& mapCoins, const uint256& hashBlock, const CCoinsRunningStats* pstats)
+{
+    CLevelDBBatch batch;
+    size_t changed = 0;
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            CoinEntry entry(&it->first);
+            if (it->second.coin.IsSpent())
+                batch.Erase(entry);
+            else
+                batch.Write(entry, it->second.coin);
+            changed++;
+        }
+    }
+    if (hashBlock != uint256(0)) {
+        BatchWriteHashBestChain(batch, hashBlock);
+        if (pstats)
+            batch.Write(DB_COINS_STATS, *pstats);
+    }
+
+    LogPrint("coindb", "Committing %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)mapCoins.size());
+    return db.WriteBatch(batch);
+}
+
+bool CCoinsViewDB::GetTrackedRunningStats(const uint256& hashBlock, CCoinsRunningStats& stats) const
+{
+    if (!pstatsTracked || pstatsTracked->hashBlock != hashBlock)
+        return false;
+    stats = *pstatsTracked;
+    return true;
+}
+
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsViewDB* pdbIn) : CCoinsViewBacked(pdbIn), pdb(pdbIn), hashBlockWriting(0), nCoinsUsageWriting(0), fStatsWriting(false), fWriteFailed(false), fStop(false)
+{
+    threadWrite = boost::thread(&CCoinsViewBackgroundFlush::ThreadWrite, this);
+}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = true;
+    }
+    condWrite.notify_all();
+    threadWrite.join();
+}
+
+void CCoinsViewBackgroundFlush::ThreadWrite()
+{
+    RenameThread("Divitae-flush");
+    while (true) {
+        std::shared_ptr<const CCoinsMap> pcoins;
+        uint256 hashBlock;
+        bool fStats;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            // A pending snapshot is written even when stopping
+            while (!pcoinsWriting && !fStop)
+                condWrite.wait(lock);
+            if (!pcoinsWriting)
+                return;
+            pcoins = pcoinsWriting;
+            hashBlock = hashBlockWriting;
+            fStats = fStatsWriting;
+        }
+
+        size_t nCoinsUsage = 0;
+        for (CCoinsMap::const_iterator it = pcoins->begin(); it != pcoins->end(); ++it)
+            nCoinsUsage += it->second.coin.DynamicMemoryUsage();
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            nCoinsUsageWriting = nCoinsUsage;
+        }
+
+        int64_t nStart = GetTimeMicros();
+        bool fOk = false;
+        try {
+            // statsWriting is only replaced once this snapshot is done
+            fOk = pdb->WriteCoins(*pcoins, hashBlock, fStats ? &statsWriting : NULL);
+        } catch (const std::exception& e) {
+            LogPrintf("%s : %s\n", __func__, e.what());
+        }
+        LogPrint("bench", "    - Background coins flush: %.2fms [%u entries]\n", (GetTimeMicros() - nStart) * 0.001, (unsigned int)pcoins->size());
+
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            pcoinsWriting.reset();
+            nCoinsUsageWriting = 0;
+            if (!fOk)
+                fWriteFailed = true;
+        }
+        condDone.notify_all();
+        if (!fOk)
+            AbortNode("Failed to write to coin database");
+    }
+}
+
+bool CCoinsViewBackgroundFlush::GetCoin(const COutPoint& outpoint, Coin& coin) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pcoinsWriting) {
+            CCoinsMap::const_iterator it = pcoinsWriting->find(outpoint);
+            if (it != pcoinsWriting->end()) {
+                if (it->second.coin.IsSpent())
+                    return false;
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoin(const COutPoint& outpoint) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pcoinsWriting) {
+            CCoinsMap::const_iterator it = pcoinsWriting->find(outpoint);
+            if (it != pcoinsWriting->end())
+                return !it->second.coin.IsSpent();
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pcoinsWriting && hashBlockWriting != uint256(0))
+            return hashBlockWriting;
+    }
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (pcoinsWriting)
+        condDone.wait(lock);
+    if (fWriteFailed)
+        return false;
+
+    // The caller holds cs_main, so the tracked statistics belong to this snapshot
+    fStatsWriting = hashBlock != uint256(0) && pdb->GetTrackedRunningStats(hashBlock, statsWriting);
+    std::shared_ptr<CCoinsMap> pcoins(new CCoinsMap());
+    pcoins->swap(mapCoins);
+    pcoinsWriting = pcoins;
+    hashBlockWriting = hashBlock;
+    nCoinsUsageWriting = 0;
+    condWrite.notify_one();
+    return true;
+}
+
+bool CCoinsViewBackgroundFlush::GetStats(CCoinsStats& stats) const
+{
+    // The statistics are computed from the database alone
+    if (!WaitForWrite())
+        return false;
+    return base->GetStats(stats);
+}
+
+bool CCoinsViewBackgroundFlush::WaitForWrite() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (pcoinsWriting)
+        condDone.wait(lock);
+    return !fWriteFailed;
+}
+
+size_t CCoinsViewBackgroundFlush::DynamicMemoryUsage() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (!pcoinsWriting)
+        return 0;
+    return memusage::DynamicUsage(*pcoinsWriting) + nCoinsUsageWriting;
+}
+
+size_t CCoinsViewBackgroundFlush::GetWritingSize() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return pcoinsWriting ? pcoinsWriting->size() : 0;
+}
+
+bool CCoinsViewDB::Upgrade()
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(db.NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair(DB_COINS, uint256(0));
+    pcursor->Seek(ssKeySet.str());
+    if (!pcursor->Valid())
+        return true;
+
+    int64_t nCount = 0;
+    LogPrintf("Upgrading utxo-set database...\n");
+    uiInterface.ShowProgress(_("Upgrading UTXO database..."), 0);
+    size_t nBatchEntries = 0;
+    CLevelDBBatch batch;
+    int nReportDone = 0;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            break;
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            uint256 txhash;
+            ssKey >> chType;
+            if (chType != DB_COINS)
+                break;
+            ssKey >> txhash;
+
+            if (nCount++ % 256 == 0) {
+                uint32_t nHigh = 0x100 * *txhash.begin() + *(txhash.begin() + 1);
+                int nPercentageDone = (int)(nHigh * 100.0 / 65536.0 + 0.5);
+                uiInterface.ShowProgress(_("Upgrading UTXO database..."), nPercentageDone);
+                if (nReportDone < nPercentageDone / 10) {
+                    // report max. every 10% step
+                    LogPrintf("[%d%%]...", nPercentageDone);
+                    nReportDone = nPercentageDone / 10;
+                }
+            }
+
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CCoins old_coins;
+            ssValue >> old_coins;
+
+            COutPoint outpoint(txhash, 0);
+            for (size_t i = 0; i < old_coins.vout.size(); ++i) {
+                const CTxOut& out = old_coins.vout[i];
+                if (!out.IsNull() && IsUTXOSetOutput(out)) {
+                    Coin newcoin(out, old_coins.nHeight, old_coins.fCoinBase, old_coins.fCoinStake);
+                    outpoint.n = i;
+                    batch.Write(CoinEntry(&outpoint), newcoin);
+                    nBatchEntries++;
+                }
+            }
+            batch.Erase(make_pair(DB_COINS, txhash));
+            nBatchEntries++;
+            if (nBatchEntries > UPGRADE_BATCH_ENTRIES) {
+                if (!db.WriteBatch(batch))
+                    return error("%s : failed to write to coin database", __func__);
+                batch = CLevelDBBatch();
+                nBatchEntries = 0;
+            }
+            pcursor->Next();
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    if (!db.WriteBatch(batch))
+        return error("%s : failed to write to coin database", __func__);
+    uiInterface.ShowProgress("", 100);
+    LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
+    return !ShutdownRequested();
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe)
 {
 }
@@ -85,6 +440,19 @@ bool CBlockTreeDB::WriteBlockIndex(const CDiskBlockIndex& blockindex)
     return Write(make_pair('b', blockindex.GetBlockHash()), blockindex);
 }
 
+bool CBlockTreeDB::WriteBlockIndexBatch(const std::vector<CBlockIndex*>& vIndex)
+{
+    CLevelDBBatch batch;
+    for (CBlockIndex* pindex : vIndex)
+        batch.Write(make_pair('b', pindex->GetBlockHash()), CDiskBlockIndex(pindex));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadBlockIndex(const uint256& hash, CDiskBlockIndex& blockindex)
+{
+    return Read(make_pair('b', hash), blockindex);
+}
+
 bool CBlockTreeDB::WriteBlockFileInfo(int nFile, const CBlockFileInfo& info)
 {
     return Write(make_pair('f', nFile), info);
@@ -119,6 +487,23 @@ bool CBlockTreeDB::ReadLastBlockFile(int& nFile)
     return Read('l', nFile);
 }
 
+static void ApplyStats(CCoinsStats& stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    assert(!outputs.empty());
+    ss << hash;
+    const Coin& first = outputs.begin()->second;
+    ss << VARINT(first.nHeight);
+    ss << (first.fCoinBase ? 'c' : 'n');
+    stats.nTransactions++;
+    for (std::map<uint32_t, Coin>::const_iterator it = outputs.begin(); it != outputs.end(); ++it) {
+        ss << VARINT(it->first + 1);
+        ss << it->second.out;
+        stats.nTransactionOutputs++;
+        stats.nTotalAmount += it->second.out.nValue;
+    }
+    ss << VARINT(0);
+}
+
 bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
 {
     /* It seems that there are no "const iterators" for LevelDB.  Since we
@@ -130,7 +515,8 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     stats.hashBlock = GetBestBlock();
     ss << stats.hashBlock;
-    CAmount nTotalAmount = 0;
+    uint256 prevkey;
+    std::map<uint32_t, Coin> outputs;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         try {
@@ -138,38 +524,111 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
             CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
             char chType;
             ssKey >> chType;
-            if (chType == 'c') {
+            if (chType == DB_COIN) {
+                COutPoint key;
+                ssKey >> key.hash;
+                ssKey >> VARINT(key.n);
                 leveldb::Slice slValue = pcursor->value();
                 CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CCoins coins;
-                ssValue >> coins;
-                uint256 txhash;
-                ssKey >> txhash;
-                ss << txhash;
-                ss << VARINT(coins.nVersion);
-                ss << (coins.fCoinBase ? 'c' : 'n');
-                ss << VARINT(coins.nHeight);
-                stats.nTransactions++;
-                for (unsigned int i = 0; i < coins.vout.size(); i++) {
-                    const CTxOut& out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i + 1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
+                Coin coin;
+                ssValue >> coin;
+                if (!outputs.empty() && key.hash != prevkey) {
+                    ApplyStats(stats, ss, prevkey, outputs);
+                    outputs.clear();
                 }
-                stats.nSerializedSize += 32 + slValue.size();
-                ss << VARINT(0);
+                prevkey = key.hash;
+                outputs[key.n] = coin;
+                stats.nSerializedSize += slKey.size() + slValue.size();
             }
             pcursor->Next();
         } catch (const std::exception& e) {
             return error("%s : Deserialize or I/O error - %s", __func__, e.what());
         }
     }
+    if (!outputs.empty())
+        ApplyStats(stats, ss, prevkey, outputs);
     stats.nHeight = mapBlockIndex.find(GetBestBlock())->second->nHeight;
     stats.hashSerialized = ss.GetHash();
-    stats.nTotalAmount = nTotalAmount;
+    return true;
+}
+
+static std::vector<unsigned char> RunningStatsElement(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << outpoint << coin;
+    return std::vector<unsigned char>(ss.begin(), ss.end());
+}
+
+void CCoinsRunningStats::AddCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    nTransactionOutputs++;
+    nSerializedSize += ::GetSerializeSize(CoinEntry(&outpoint), SER_DISK, CLIENT_VERSION) + ::GetSerializeSize(coin, SER_DISK, CLIENT_VERSION);
+    nTotalAmount += coin.out.nValue;
+    muhash.Insert(RunningStatsElement(outpoint, coin));
+}
+
+void CCoinsRunningStats::RemoveCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    nTransactionOutputs--;
+    nSerializedSize -= ::GetSerializeSize(CoinEntry(&outpoint), SER_DISK, CLIENT_VERSION) + ::GetSerializeSize(coin, SER_DISK, CLIENT_VERSION);
+    nTotalAmount -= coin.out.nValue;
+    muhash.Remove(RunningStatsElement(outpoint, coin));
+}
+
+bool CCoinsViewDB::ReadRunningStats(CCoinsRunningStats& stats) const
+{
+    return db.Read(DB_COINS_STATS, stats);
+}
+
+bool CCoinsViewDB::ComputeRunningStats(CCoinsRunningStats& stats) const
+{
+    stats.SetNull();
+    stats.hashBlock = GetBestBlock();
+    boost::scoped_ptr<CCoinsViewDBCursor> pcursor(Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        COutPoint outpoint;
+        Coin coin;
+        if (!pcursor->GetCoin(outpoint, coin))
+            return error("%s : unable to read coin", __func__);
+        stats.AddCoin(outpoint, coin);
+    }
+    return true;
+}
+
+CCoinsViewDBCursor* CCoinsViewDB::Cursor() const
+{
+    CCoinsViewDBCursor* pcursor = new CCoinsViewDBCursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << DB_COIN;
+    pcursor->pcursor->Seek(ssKeySet.str());
+    return pcursor;
+}
+
+bool CCoinsViewDBCursor::Valid() const
+{
+    // All outputs are stored under keys starting with DB_COIN
+    return pcursor->Valid() && pcursor->key().size() > 0 && pcursor->key().data()[0] == DB_COIN;
+}
+
+void CCoinsViewDBCursor::Next()
+{
+    pcursor->Next();
+}
+
+bool CCoinsViewDBCursor::GetCoin(COutPoint& outpoint, Coin& coin) const
+{
+    try {
+        leveldb::Slice slKey = pcursor->key();
+        CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+        CoinEntry entry(&outpoint);
+        ssKey >> entry;
+        leveldb::Slice slValue = pcursor->value();
+        CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue >> coin;
+    } catch (const std::exception& e) {
+        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
     return true;
 }
 
@@ -178,14 +637,115 @@ bool CBlockTreeDB::ReadTxIndex(const uint256& txid, CDiskTxPos& pos)
     return Read(make_pair('t', txid), pos);
 }
 
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& vect)
+bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& vect, const CBlockLocator& locator)
 {
     CLevelDBBatch batch;
     for (std::vector<std::pair<uint256, CDiskTxPos> >::const_iterator it = vect.begin(); it != vect.end(); it++)
         batch.Write(make_pair('t', it->first), it->second);
+    batch.Write('T', locator);
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadTxIndexBestBlock(CBlockLocator& locator)
+{
+    return Read('T', locator);
+}
+
+bool CBlockTreeDB::WriteTxIndexBestBlock(const CBlockLocator& locator)
+{
+    return Write('T', locator);
+}
+
+bool CBlockTreeDB::WriteAddressIndexUpdate(const CAddressIndexUpdate& update)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = update.vAddressWrite.begin(); it != update.vAddressWrite.end(); it++)
+        batch.Write(it->first, it->second);
+    for (std::vector<CAddressIndexKey>::const_iterator it = update.vAddressErase.begin(); it != update.vAddressErase.end(); it++)
+        batch.Erase(*it);
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it = update.vUnspent.begin(); it != update.vUnspent.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(it->first);
+        else
+            batch.Write(it->first, it->second);
+    }
+    for (std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >::const_iterator it = update.vSpent.begin(); it != update.vSpent.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(it->first);
+        else
+            batch.Write(it->first, it->second);
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressIndex(int nAddressType, const uint160& hashAddress, std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries, int nStart, int nEnd)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << CAddressIndexKey(nAddressType, hashAddress, nStart, 0, uint256(0), 0, false);
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            CAddressIndexKey key;
+            ssKey >> key;
+            if (key.chType != 'a' || key.nAddressType != nAddressType || key.hashAddress != hashAddress)
+                break;
+            if (nEnd > 0 && key.nHeight > nEnd)
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAmount nValue;
+            ssValue >> nValue;
+            vEntries.push_back(std::make_pair(key, nValue));
+            pcursor->Next();
+        } catch (const std::exception& e) {
+            // Keys of other records need not deserialize as address index keys
+            break;
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressUnspentIndex(int nAddressType, const uint160& hashAddress, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vEntries)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << CAddressUnspentKey(nAddressType, hashAddress, uint256(0), 0);
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            CAddressUnspentKey key;
+            ssKey >> key;
+            if (key.chType != 'u' || key.nAddressType != nAddressType || key.hashAddress != hashAddress)
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAddressUnspentValue value;
+            ssValue >> value;
+            vEntries.push_back(std::make_pair(key, value));
+            pcursor->Next();
+        } catch (const std::exception& e) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    return Read(key, value);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
 {
     return Write(std::make_pair('F', name), fValue ? '1' : '0');
@@ -210,6 +770,53 @@ bool CBlockTreeDB::ReadInt(const std::string& name, int& nValue)
     return Read(std::make_pair('I', name), nValue);
 }
 
+namespace
+{
+/** A block index record on its way from the database into mapBlockIndex */
+struct BlockIndexRecord {
+    std::string strValue;
+    CDiskBlockIndex diskindex;
+    uint256 hash;
+    std::string strError;
+};
+
+/**
+ * Deserializes the records, hashes their headers and checks the proof of work
+ * where needed, spread over nThreads threads. Failures are left in strError.
+ */
+void DecodeBlockIndexRecords(std::vector<BlockIndexRecord>& vRecords, int nThreads, int nTrustedHeight)
+{
+    std::atomic<size_t> nNext(0);
+    auto worker = [&]() {
+        for (size_t i = nNext++; i < vRecords.size(); i = nNext++) {
+            BlockIndexRecord& record = vRecords[i];
+            try {
+                CDataStream ssValue(record.strValue.data(), record.strValue.data() + record.strValue.size(), SER_DISK, CLIENT_VERSION);
+                ssValue >> record.diskindex;
+                record.hash = record.diskindex.GetBlockHash();
+
+                // Entries accepted below the last checkpoint had their proof of work checked then
+                const CDiskBlockIndex& diskindex = record.diskindex;
+                bool fTrusted = diskindex.nHeight <= nTrustedHeight && diskindex.IsValid(BLOCK_VALID_TREE);
+                if (diskindex.nHeight <= Params().LAST_POW_BLOCK() && !fTrusted) {
+                    if (!CheckProofOfWork(record.hash, diskindex.nBits))
+                        record.strError = strprintf("LoadBlockIndex() : CheckProofOfWork failed: %s", diskindex.ToString());
+                }
+            } catch (const std::exception& e) {
+                record.strError = strprintf("LoadBlockIndexGuts : Deserialize or I/O error - %s", e.what());
+            }
+            std::string().swap(record.strValue);
+        }
+    };
+
+    boost::thread_group threads;
+    for (int i = 1; i < nThreads; i++)
+        threads.create_thread(worker);
+    worker();
+    threads.join_all();
+}
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts()
 {
     boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
@@ -218,77 +825,96 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
     ssKeySet << make_pair('b', uint256(0));
     pcursor->Seek(ssKeySet.str());
 
+    // The script check threads are idle this early, use as many for decoding
+    const int nThreads = std::max(nScriptCheckThreads, 1);
+    const int nTrustedHeight = Checkpoints::GetTotalBlocksEstimate();
+
     // Load mapBlockIndex
     uint256 nPreviousCheckpoint;
-    while (pcursor->Valid()) {
+    std::vector<uint256> vAccumulatorCheckpoints;
+    std::vector<BlockIndexRecord> vRecords;
+    bool fDone = false;
+    while (!fDone) {
         boost::this_thread::interruption_point();
-        try {
-            leveldb::Slice slKey = pcursor->key();
-            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
-            char chType;
-            ssKey >> chType;
-            if (chType == 'b') {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CDiskBlockIndex diskindex;
-                ssValue >> diskindex;
-
-                // Construct block index object
-                CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
-                pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
-                pindexNew->nHeight = diskindex.nHeight;
-                pindexNew->nFile = diskindex.nFile;
-                pindexNew->nDataPos = diskindex.nDataPos;
-                pindexNew->nUndoPos = diskindex.nUndoPos;
-                pindexNew->nVersion = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime = diskindex.nTime;
-                pindexNew->nBits = diskindex.nBits;
-                pindexNew->nNonce = diskindex.nNonce;
-                pindexNew->nStatus = diskindex.nStatus;
-                pindexNew->nTx = diskindex.nTx;
-
-                //zerocoin
-                pindexNew->nAccumulatorCheckpoint = diskindex.nAccumulatorCheckpoint;
-                pindexNew->mapZerocoinSupply = diskindex.mapZerocoinSupply;
-                pindexNew->vMintDenominationsInBlock = diskindex.vMintDenominationsInBlock;
-
-                //Proof Of Stake
-                pindexNew->nMint = diskindex.nMint;
-                pindexNew->nMoneySupply = diskindex.nMoneySupply;
-                pindexNew->nFlags = diskindex.nFlags;
-                pindexNew->nStakeModifier = diskindex.nStakeModifier;
-                pindexNew->prevoutStake = diskindex.prevoutStake;
-                pindexNew->nStakeTime = diskindex.nStakeTime;
-                pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
-
-                if (pindexNew->nHeight <= Params().LAST_POW_BLOCK()) {
-                    if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits))
-                        return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
+
+        // Walking the cursor can't be shared, so collect a batch of raw records first
+        vRecords.clear();
+        while (vRecords.size() < BLOCK_INDEX_LOAD_BATCH) {
+            if (!pcursor->Valid()) {
+                fDone = true;
+                break;
+            }
+            try {
+                leveldb::Slice slKey = pcursor->key();
+                CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+                char chType;
+                ssKey >> chType;
+                if (chType != 'b') {
+                    fDone = true;
+                    break; // finished loading block index
                 }
-                // ppcoin: build setStakeSeen
-                if (pindexNew->IsProofOfStake())
-                    setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
+            } catch (const std::exception& e) {
+                return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+            }
+            leveldb::Slice slValue = pcursor->value();
+            vRecords.push_back(BlockIndexRecord());
+            vRecords.back().strValue.assign(slValue.data(), slValue.size());
+            pcursor->Next();
+        }
 
-                //populate accumulator checksum map in memory
-                if(pindexNew->nAccumulatorCheckpoint != 0 && pindexNew->nAccumulatorCheckpoint != nPreviousCheckpoint) {
-                    //Don't load any checkpoints that exist before v2 zvit. The accumulator is invalid for v1 and not used.
-                    if (pindexNew->nHeight >= Params().Zerocoin_Block_V2_Start())
-                        LoadAccumulatorValuesFromDB(pindexNew->nAccumulatorCheckpoint);
+        DecodeBlockIndexRecords(vRecords, nThreads, nTrustedHeight);
 
-                    nPreviousCheckpoint = pindexNew->nAccumulatorCheckpoint;
-                }
+        for (const BlockIndexRecord& record : vRecords) {
+            if (!record.strError.empty())
+                return error("%s", record.strError);
+            const CDiskBlockIndex& diskindex = record.diskindex;
 
-                pcursor->Next();
-            } else {
-                break; // if shutdown requested or finished loading block index
+            // Construct block index object
+            CBlockIndex* pindexNew = InsertBlockIndex(record.hash);
+            pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
+            pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
+            pindexNew->nHeight = diskindex.nHeight;
+            pindexNew->nFile = diskindex.nFile;
+            pindexNew->nDataPos = diskindex.nDataPos;
+            pindexNew->nUndoPos = diskindex.nUndoPos;
+            pindexNew->nVersion = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime = diskindex.nTime;
+            pindexNew->nBits = diskindex.nBits;
+            pindexNew->nNonce = diskindex.nNonce;
+            pindexNew->nStatus = diskindex.nStatus;
+            pindexNew->nTx = diskindex.nTx;
+
+            //zerocoin
+            pindexNew->nAccumulatorCheckpoint = diskindex.nAccumulatorCheckpoint;
+            std::copy(diskindex.nZerocoinSupply, diskindex.nZerocoinSupply + libzerocoin::zerocoinDenomCount, pindexNew->nZerocoinSupply);
+            std::copy(diskindex.nMintDenominationsInBlock, diskindex.nMintDenominationsInBlock + libzerocoin::zerocoinDenomCount, pindexNew->nMintDenominationsInBlock);
+
+            //Proof Of Stake
+            pindexNew->nMint = diskindex.nMint;
+            pindexNew->nMoneySupply = diskindex.nMoneySupply;
+            pindexNew->nFlags = diskindex.nFlags;
+            pindexNew->nStakeModifier = diskindex.nStakeModifier;
+            // prevoutStake and nStakeTime stay on disk, see CBlockIndex::GetStake()
+
+            // ppcoin: build setStakeSeen
+            if (pindexNew->IsProofOfStake())
+                setStakeSeen.insert(make_pair(diskindex.prevoutStake, diskindex.nStakeTime));
+
+            //collect the accumulator checkpoints to load into memory
+            if(pindexNew->nAccumulatorCheckpoint != 0 && pindexNew->nAccumulatorCheckpoint != nPreviousCheckpoint) {
+                //Don't load any checkpoints that exist before v2 zvit. The accumulator is invalid for v1 and not used.
+                if (pindexNew->nHeight >= Params().Zerocoin_Block_V2_Start())
+                    vAccumulatorCheckpoints.push_back(pindexNew->nAccumulatorCheckpoint);
+
+                nPreviousCheckpoint = pindexNew->nAccumulatorCheckpoint;
             }
-        } catch (const std::exception& e) {
-            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
         }
     }
 
+    // The accumulator values are only a cache of the zerocoin database, startup doesn't need to wait for them
+    LoadAccumulatorValuesInBackground(vAccumulatorCheckpoints);
+
     return true;
 }
 
@@ -308,7 +934,15 @@ bool CZerocoinDB::WriteCoinMintBatch(const std::vector<std::pair<libzerocoin::Pu
     }
 
     LogPrint("zero", "Writing %u coin mints to db.\n", (unsigned int)count);
-    return WriteBatch(batch, true);
+    if (!WriteBatch(batch, true))
+        return false;
+
+    // Into the filter once in the database, a rebuild that starts meanwhile finds them there
+    for (std::vector<std::pair<libzerocoin::PublicCoin, uint256> >::const_iterator it=mintInfo.begin(); it != mintInfo.end(); it++)
+        filterMints.Insert(GetPubCoinHash(it->first.getValue()));
+    if (filterMints.IsOverCapacity())
+        return RebuildFilter('m', filterMints);
+    return true;
 }
 
 bool CZerocoinDB::ReadCoinMint(const CBigNum& bnPubcoin, uint256& hashTx)
@@ -318,7 +952,12 @@ bool CZerocoinDB::ReadCoinMint(const CBigNum& bnPubcoin, uint256& hashTx)
 
 bool CZerocoinDB::ReadCoinMint(const uint256& hashPubcoin, uint256& hashTx)
 {
-    return Read(make_pair('m', hashPubcoin), hashTx);
+    if (!filterMints.MayContain(hashPubcoin))
+        return false;
+    if (Read(make_pair('m', hashPubcoin), hashTx))
+        return true;
+    filterMints.AddFalsePositive();
+    return false;
 }
 
 bool CZerocoinDB::EraseCoinMint(const CBigNum& bnPubcoin)
@@ -331,17 +970,28 @@ bool CZerocoinDB::WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::C
 {
     CLevelDBBatch batch;
     size_t count = 0;
+    std::vector<uint256> vHashes;
+    vHashes.reserve(spendInfo.size());
     for (std::vector<std::pair<libzerocoin::CoinSpend, uint256> >::const_iterator it=spendInfo.begin(); it != spendInfo.end(); it++) {
         CBigNum bnSerial = it->first.getCoinSerialNumber();
         CDataStream ss(SER_GETHASH, 0);
         ss << bnSerial;
         uint256 hash = Hash(ss.begin(), ss.end());
         batch.Write(make_pair('s', hash), it->second);
+        vHashes.push_back(hash);
         ++count;
     }
 
     LogPrint("zero", "Writing %u coin spends to db.\n", (unsigned int)count);
-    return WriteBatch(batch, true);
+    if (!WriteBatch(batch, true))
+        return false;
+
+    // Into the filter once in the database, a rebuild that starts meanwhile finds them there
+    for (const uint256& hash : vHashes)
+        filterSpends.Insert(hash);
+    if (filterSpends.IsOverCapacity())
+        return RebuildFilter('s', filterSpends);
+    return true;
 }
 
 bool CZerocoinDB::ReadCoinSpend(const CBigNum& bnSerial, uint256& txHash)
@@ -350,12 +1000,17 @@ bool CZerocoinDB::ReadCoinSpend(const CBigNum& bnSerial, uint256& txHash)
     ss << bnSerial;
     uint256 hash = Hash(ss.begin(), ss.end());
 
-    return Read(make_pair('s', hash), txHash);
+    return ReadCoinSpend(hash, txHash);
 }
 
 bool CZerocoinDB::ReadCoinSpend(const uint256& hashSerial, uint256 &txHash)
 {
-    return Read(make_pair('s', hashSerial), txHash);
+    if (!filterSpends.MayContain(hashSerial))
+        return false;
+    if (Read(make_pair('s', hashSerial), txHash))
+        return true;
+    filterSpends.AddFalsePositive();
+    return false;
 }
 
 bool CZerocoinDB::EraseCoinSpend(const CBigNum& bnSerial)
@@ -407,9 +1062,51 @@ bool CZerocoinDB::WipeCoins(std::string strType)
             LogPrintf("%s: error failed to delete %s\n", __func__, hash.GetHex());
     }
 
+    return RebuildFilter(type, type == 's' ? filterSpends : filterMints);
+}
+
+bool CZerocoinDB::RebuildFilter(char chType, CZerocoinFilter& filter)
+{
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair(chType, uint256(0));
+
+    // Count the records first, so the filter can be sized for them and some growth
+    uint64_t nRecords = 0;
+    {
+        boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+        for (pcursor->Seek(ssKeySet.str()); pcursor->Valid() && pcursor->key().size() > 0 && pcursor->key()[0] == chType; pcursor->Next())
+            nRecords++;
+    }
+
+    // Hashes written from here on are inserted by the writes themselves
+    filter.Reset(2 * nRecords);
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    for (pcursor->Seek(ssKeySet.str()); pcursor->Valid(); pcursor->Next()) {
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chTypeKey;
+            uint256 hash;
+            ssKey >> chTypeKey;
+            if (chTypeKey != chType)
+                break;
+            ssKey >> hash;
+            filter.Insert(hash);
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    filter.SetLoaded();
+
+    LogPrint("zero", "%s: %c filter holds %u hashes\n", __func__, chType, (unsigned int)filter.GetStats().nElements);
     return true;
 }
 
+bool CZerocoinDB::LoadFilters()
+{
+    return RebuildFilter('s', filterSpends) && RebuildFilter('m', filterMints);
+}
+
 bool CZerocoinDB::WriteAccumulatorValue(const uint32_t& nChecksum, const CBigNum& bnValue)
 {
     LogPrint("zero","%s : checksum:%d val:%s\n", __func__, nChecksum, bnValue.GetHex());
@@ -426,3 +1123,92 @@ bool CZerocoinDB::EraseAccumulatorValue(const uint32_t& nChecksum)
     LogPrint("zero", "%s : checksum:%d\n", __func__, nChecksum);
     return Erase(make_pair('2', nChecksum));
 }
+
+bool CZerocoinDB::WriteBlockPubcoins(int nHeight, const std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> >& mapPubcoins)
+{
+    CLevelDBBatch batch;
+    for (std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> >::const_iterator it = mapPubcoins.begin(); it != mapPubcoins.end(); it++)
+        batch.Write(CBlockPubcoinsKey(it->first, nHeight), it->second);
+
+    LogPrint("zero", "Writing pubcoins of %u denominations at height %d to db.\n", (unsigned int)mapPubcoins.size(), nHeight);
+    return WriteBatch(batch);
+}
+
+bool CZerocoinDB::ReadBlockPubcoins(libzerocoin::CoinDenomination denom, int nHeight, std::vector<CBigNum>& vPubcoins)
+{
+    return Read(CBlockPubcoinsKey(denom, nHeight), vPubcoins);
+}
+
+bool CZerocoinDB::EraseBlockPubcoins(int nHeight)
+{
+    CLevelDBBatch batch;
+    for (libzerocoin::CoinDenomination denom : libzerocoin::zerocoinDenomList)
+        batch.Erase(CBlockPubcoinsKey(denom, nHeight));
+    return WriteBatch(batch);
+}
+
+CPubcoinCursor* CZerocoinDB::PubcoinCursor(libzerocoin::CoinDenomination denom, int nHeight) const
+{
+    CPubcoinCursor* pcursor = new CPubcoinCursor(const_cast<CZerocoinDB*>(this)->NewIterator(), denom);
+    pcursor->Seek(nHeight);
+    return pcursor;
+}
+
+void CPubcoinCursor::ReadKey()
+{
+    fValid = false;
+    if (!pcursor->Valid())
+        return;
+    try {
+        leveldb::Slice slKey = pcursor->key();
+        CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+        CBlockPubcoinsKey key;
+        ssKey >> key;
+        if (key.chType != 'p' || key.nDenomination != denom)
+            return;
+        nHeight = key.nHeight;
+        fValid = true;
+    } catch (const std::exception& e) {
+        // Keys of other records need not deserialize as pubcoin keys
+    }
+}
+
+void CPubcoinCursor::Next()
+{
+    pcursor->Next();
+    ReadKey();
+}
+
+void CPubcoinCursor::Seek(int nHeightIn)
+{
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << CBlockPubcoinsKey(denom, nHeightIn);
+    pcursor->Seek(ssKeySet.str());
+    ReadKey();
+}
+
+bool CPubcoinCursor::GetPubcoins(std::vector<CBigNum>& vPubcoins) const
+{
+    try {
+        leveldb::Slice slValue = pcursor->value();
+        CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue >> vPubcoins;
+    } catch (const std::exception& e) {
+        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+    return true;
+}
+
+bool CZerocoinDB::WriteFlag(const std::string& name, bool fValue)
+{
+    return Write(std::make_pair('F', name), fValue ? '1' : '0');
+}
+
+bool CZerocoinDB::ReadFlag(const std::string& name, bool& fValue)
+{
+    char ch;
+    if (!Read(std::make_pair('F', name), ch))
+        return false;
+    fValue = ch == '1';
+    return true;
+}
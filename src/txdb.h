@@ -9,16 +9,22 @@
 #ifndef BITCOIN_TXDB_H
 #define BITCOIN_TXDB_H
 
+#include "addressindex.h"
 #include "leveldbwrapper.h"
 #include "main.h"
+#include "muhash.h"
 #include "primitives/zerocoin.h"
+#include "zerocoinfilter.h"
 
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
-class CCoins;
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
 class uint256;
 
 //! -dbcache default (MiB)
@@ -28,20 +34,152 @@ static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 4096 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
 
+class CCoinsViewDBCursor;
+
+/**
+ * Statistics of the unspent output set that are kept up to date block by block, so they
+ * are available without scanning the coin database. muhash commits to the set itself.
+ */
+class CCoinsRunningStats
+{
+public:
+    uint256 hashBlock;
+    uint64_t nTransactionOutputs;
+    uint64_t nSerializedSize;
+    CAmount nTotalAmount;
+    CMuHash3072 muhash;
+
+    CCoinsRunningStats()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        hashBlock = 0;
+        nTransactionOutputs = 0;
+        nSerializedSize = 0;
+        nTotalAmount = 0;
+        muhash = CMuHash3072();
+    }
+
+    void AddCoin(const COutPoint& outpoint, const Coin& coin);
+    void RemoveCoin(const COutPoint& outpoint, const Coin& coin);
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(hashBlock);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nSerializedSize);
+        READWRITE(nTotalAmount);
+        READWRITE(muhash);
+    }
+};
+
 /** CCoinsView backed by the LevelDB coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
     CLevelDBWrapper db;
+    const CCoinsRunningStats* pstatsTracked;
 
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
-    bool GetCoins(const uint256& txid, CCoins& coins) const;
-    bool HaveCoins(const uint256& txid) const;
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const;
+    bool HaveCoin(const COutPoint& outpoint) const;
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
     bool GetStats(CCoinsStats& stats) const;
+
+    //! Write the changed coins of mapCoins and the best block in one batch, without taking them from mapCoins. pstats is written along if set.
+    bool WriteCoins(const CCoinsMap& mapCoins, const uint256& hashBlock, const CCoinsRunningStats* pstats);
+
+    //! Write these statistics along with every batch that moves the best block to their hashBlock
+    void TrackRunningStats(const CCoinsRunningStats* pstats) { pstatsTracked = pstats; }
+    //! Copy the tracked statistics if they belong to hashBlock
+    bool GetTrackedRunningStats(const uint256& hashBlock, CCoinsRunningStats& stats) const;
+    //! Read the running statistics written with the best block. Their hashBlock may differ after an unclean shutdown.
+    bool ReadRunningStats(CCoinsRunningStats& stats) const;
+    //! Recompute the running statistics with a scan of the whole database
+    bool ComputeRunningStats(CCoinsRunningStats& stats) const;
+
+    //! Convert a per-transaction chainstate into the per-outpoint format. Returns false on error or interruption.
+    bool Upgrade();
+
+    //! Iterate over the unspent outputs. The caller owns the returned cursor.
+    CCoinsViewDBCursor* Cursor() const;
+};
+
+/**
+ * CCoinsView between the coins tip and the coin database that writes flushes on a background thread.
+ *
+ * BatchWrite() takes over the coins and the best block as an immutable snapshot and returns without
+ * waiting for the database, so validation continues into the emptied tip cache. Until the snapshot is
+ * written, reads look at it before the database. It is written as one batch together with its best
+ * block, so the database stays at a block boundary whenever the write stops. At most one snapshot is
+ * pending: a BatchWrite() while the previous one is still being written waits for it first.
+ */
+class CCoinsViewBackgroundFlush : public CCoinsViewBacked
+{
+private:
+    CCoinsViewDB* pdb;
+
+    mutable boost::mutex cs;
+    boost::condition_variable condWrite;
+    mutable boost::condition_variable condDone;
+    //! The snapshot being written, null when the database is up to date
+    std::shared_ptr<const CCoinsMap> pcoinsWriting;
+    uint256 hashBlockWriting;
+    //! Heap memory of the snapshot's scripts, filled in by the write thread
+    size_t nCoinsUsageWriting;
+    bool fStatsWriting;
+    CCoinsRunningStats statsWriting;
+    bool fWriteFailed;
+    bool fStop;
+
+    boost::thread threadWrite;
+
+    void ThreadWrite();
+
+public:
+    CCoinsViewBackgroundFlush(CCoinsViewDB* pdbIn);
+    ~CCoinsViewBackgroundFlush();
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const;
+    bool HaveCoin(const COutPoint& outpoint) const;
+    uint256 GetBestBlock() const;
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
+    bool GetStats(CCoinsStats& stats) const;
+
+    //! Wait until the pending snapshot is in the database. Returns false if a write failed.
+    bool WaitForWrite() const;
+
+    //! Heap memory held by the snapshot that is still being written
+    size_t DynamicMemoryUsage() const;
+
+    //! Number of entries in the snapshot that is still being written
+    size_t GetWritingSize() const;
+};
+
+/** Cursor over the unspent outputs of a CCoinsViewDB, as they were when it was created */
+class CCoinsViewDBCursor
+{
+public:
+    bool Valid() const;
+    void Next();
+    //! Returns false if the current entry cannot be deserialized
+    bool GetCoin(COutPoint& outpoint, Coin& coin) const;
+
+private:
+    CCoinsViewDBCursor(leveldb::Iterator* pcursorIn) : pcursor(pcursorIn) {}
+
+    boost::scoped_ptr<leveldb::Iterator> pcursor;
+
+    friend class CCoinsViewDB;
 };
 
 /** Access to the block database (blocks/index/) */
@@ -56,6 +194,9 @@ private:
 
 public:
     bool WriteBlockIndex(const CDiskBlockIndex& blockindex);
+    //! Write the entries of several blocks in one batch
+    bool WriteBlockIndexBatch(const std::vector<CBlockIndex*>& vIndex);
+    bool ReadBlockIndex(const uint256& hash, CDiskBlockIndex& blockindex);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo& fileinfo);
     bool WriteBlockFileInfo(int nFile, const CBlockFileInfo& fileinfo);
     bool ReadLastBlockFile(int& nFile);
@@ -63,7 +204,15 @@ public:
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool& fReindex);
     bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
-    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& list);
+    //! Write transaction positions together with the block the index has reached
+    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& list, const CBlockLocator& locator);
+    bool ReadTxIndexBestBlock(CBlockLocator& locator);
+    bool WriteTxIndexBestBlock(const CBlockLocator& locator);
+    bool WriteAddressIndexUpdate(const CAddressIndexUpdate& update);
+    //! Read the balance changes of an address, from nStart to nEnd inclusive when nEnd is not 0
+    bool ReadAddressIndex(int nAddressType, const uint160& hashAddress, std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries, int nStart = 0, int nEnd = 0);
+    bool ReadAddressUnspentIndex(int nAddressType, const uint160& hashAddress, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vEntries);
+    bool ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
     bool WriteInt(const std::string& name, int nValue);
@@ -71,6 +220,40 @@ public:
     bool LoadBlockIndexGuts();
 };
 
+/**
+ * Key of the pubcoins of one denomination that a block adds to the accumulators.
+ * The height is big endian, so the records of a denomination are ordered by height.
+ */
+class CBlockPubcoinsKey
+{
+public:
+    char chType;
+    int nDenomination;
+    int nHeight;
+
+    CBlockPubcoinsKey() : chType('p'), nDenomination(0), nHeight(0) {}
+    CBlockPubcoinsKey(libzerocoin::CoinDenomination denom, int nHeightIn) : chType('p'), nDenomination(denom), nHeight(nHeightIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(chType);
+        READWRITE(nDenomination);
+        unsigned char pchHeight[4];
+        if (!ser_action.ForRead()) {
+            for (int i = 0; i < 4; i++)
+                pchHeight[i] = (nHeight >> (24 - 8 * i)) & 0xff;
+        }
+        READWRITE(FLATDATA(pchHeight));
+        if (ser_action.ForRead())
+            nHeight = (pchHeight[0] << 24) | (pchHeight[1] << 16) | (pchHeight[2] << 8) | pchHeight[3];
+    }
+};
+
+class CPubcoinCursor;
+
 /** Zerocoin database (zerocoin/) */
 class CZerocoinDB : public CLevelDBWrapper
 {
@@ -96,6 +279,53 @@ public:
     bool WriteAccumulatorValue(const uint32_t& nChecksum, const CBigNum& bnValue);
     bool ReadAccumulatorValue(const uint32_t& nChecksum, CBigNum& bnValue);
     bool EraseAccumulatorValue(const uint32_t& nChecksum);
+    /** The pubcoins a block adds to the accumulators, for every denomination it minted, so witnesses can be generated without the block */
+    bool WriteBlockPubcoins(int nHeight, const std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> >& mapPubcoins);
+    bool ReadBlockPubcoins(libzerocoin::CoinDenomination denom, int nHeight, std::vector<CBigNum>& vPubcoins);
+    bool EraseBlockPubcoins(int nHeight);
+    //! Cursor over the block pubcoins of a denomination, from the first block at or after nHeight
+    CPubcoinCursor* PubcoinCursor(libzerocoin::CoinDenomination denom, int nHeight) const;
+    bool WriteFlag(const std::string& name, bool fValue);
+    bool ReadFlag(const std::string& name, bool& fValue);
+
+    //! Fill the filters of spent serials and minted pubcoins from the database, lookups use them from then on
+    bool LoadFilters();
+    CZerocoinFilterStats GetSpendFilterStats() const { return filterSpends.GetStats(); }
+    CZerocoinFilterStats GetMintFilterStats() const { return filterMints.GetStats(); }
+
+private:
+    CZerocoinFilter filterSpends;
+    CZerocoinFilter filterMints;
+
+    //! Resize the filter of the 's' or 'm' records to the number of them and insert their hashes
+    bool RebuildFilter(char chType, CZerocoinFilter& filter);
+};
+
+/** Cursor over the block pubcoins of one denomination, in height order */
+class CPubcoinCursor
+{
+public:
+    bool Valid() const { return fValid; }
+    void Next();
+    //! Move to the first block at or after nHeight
+    void Seek(int nHeight);
+    //! Height of the current block
+    int GetHeight() const { return nHeight; }
+    //! Returns false if the pubcoins of the current block cannot be deserialized
+    bool GetPubcoins(std::vector<CBigNum>& vPubcoins) const;
+
+private:
+    CPubcoinCursor(leveldb::Iterator* pcursorIn, libzerocoin::CoinDenomination denomIn) : pcursor(pcursorIn), denom(denomIn), fValid(false), nHeight(0) {}
+
+    //! Decode the key under the iterator, which may be past the records of the denomination
+    void ReadKey();
+
+    boost::scoped_ptr<leveldb::Iterator> pcursor;
+    libzerocoin::CoinDenomination denom;
+    bool fValid;
+    int nHeight;
+
+    friend class CZerocoinDB;
 };
 
 #endif // BITCOIN_TXDB_H
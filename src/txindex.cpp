@@ -0,0 +1,237 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txindex.h"
+
+#include "txdb.h"
+#include "util.h"
+
+CTxIndex* ptxindex = NULL;
+
+static bool SameTxPos(const CDiskTxPos& a, const CDiskTxPos& b)
+{
+    return a.nFile == b.nFile && a.nPos == b.nPos && a.nTxOffset == b.nTxOffset;
+}
+
+CTxIndex::CTxIndex(CBlockTreeDB* pdbIn) : pdb(pdbIn), fWriteFailed(false), fStop(false), pindexBest(NULL), fSynced(false)
+{
+}
+
+CTxIndex::~CTxIndex()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = true;
+    }
+    condQueue.notify_all();
+    if (threadIndex.joinable())
+        threadIndex.join();
+}
+
+void CTxIndex::Start()
+{
+    {
+        LOCK(cs_main);
+        CBlockLocator locator;
+        if (pdb->ReadTxIndexBestBlock(locator) && !locator.IsNull())
+            pindexBest = FindForkInGlobalIndex(chainActive, locator);
+        LogPrintf("%s: transaction index at height %d, active chain at height %d\n", __func__, GetBestHeight(), chainActive.Height());
+    }
+    threadIndex = boost::thread(&CTxIndex::ThreadIndex, this);
+}
+
+void CTxIndex::GetTxPositions(const CBlock& block, const CDiskBlockPos& pos, std::vector<std::pair<uint256, CDiskTxPos> >& vPos)
+{
+    CDiskTxPos posTx(pos, GetSizeOfCompactSize(block.vtx.size()));
+    vPos.reserve(vPos.size() + block.vtx.size());
+    for (const CTransaction& tx : block.vtx) {
+        vPos.push_back(std::make_pair(tx.GetHash(), posTx));
+        posTx.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
+    }
+}
+
+bool CTxIndex::IsStopping() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return fStop;
+}
+
+bool CTxIndex::SyncNextBlock(bool& fCaughtUp)
+{
+    const CBlockIndex* pindexNext;
+    CDiskBlockPos pos;
+    CBlockLocator locator;
+    {
+        LOCK(cs_main);
+        // Pick up again where the active chain forked away from the index
+        if (pindexBest && !chainActive.Contains(pindexBest))
+            pindexBest = chainActive.FindFork(pindexBest);
+        pindexNext = pindexBest ? chainActive.Next(pindexBest) : chainActive.Genesis();
+        if (!pindexNext) {
+            // Connected blocks are queued from here on
+            fSynced = true;
+            fCaughtUp = true;
+            LogPrintf("%s: transaction index is synced at height %d\n", __func__, GetBestHeight());
+            return true;
+        }
+        // Transactions of pruned blocks can not be indexed
+        if (!(pindexNext->nStatus & BLOCK_HAVE_DATA)) {
+            pindexBest = pindexNext;
+            return true;
+        }
+        pos = pindexNext->GetBlockPos();
+        locator = chainActive.GetLocator(pindexNext);
+    }
+
+    // Old blocks are read past the block cache, which is meant for blocks in use
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pos) || block.GetHash() != pindexNext->GetBlockHash())
+        return error("%s : failed to read block %s", __func__, pindexNext->GetBlockHash().ToString());
+    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
+    GetTxPositions(block, pos, vPos);
+    if (!pdb->WriteTxIndex(vPos, locator))
+        return error("%s : failed to write block %s", __func__, pindexNext->GetBlockHash().ToString());
+
+    LOCK(cs_main);
+    pindexBest = pindexNext;
+    if (pindexBest->nHeight % 10000 == 0)
+        LogPrintf("%s: transaction index at height %d\n", __func__, pindexBest->nHeight);
+    return true;
+}
+
+void CTxIndex::ThreadIndex()
+{
+    RenameThread("Divitae-txindex");
+
+    bool fCaughtUp = false;
+    while (!fCaughtUp) {
+        if (IsStopping())
+            return;
+        if (!SyncNextBlock(fCaughtUp)) {
+            AbortNode("Failed to write transaction index");
+            return;
+        }
+    }
+
+    while (true) {
+        std::vector<std::pair<uint256, CDiskTxPos> > vPos;
+        CBlockLocator locator;
+        size_t nBlocks;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            // Queued blocks are written even when stopping
+            while (queue.empty() && !fStop)
+                condQueue.wait(lock);
+            if (queue.empty())
+                return;
+            nBlocks = queue.size();
+            for (std::deque<CQueuedBlock>::const_iterator it = queue.begin(); it != queue.end(); ++it)
+                vPos.insert(vPos.end(), it->vPos.begin(), it->vPos.end());
+            locator = queue.back().locator;
+        }
+
+        // Everything queued goes into one batch, the last locator covers it all
+        bool fOk = false;
+        try {
+            fOk = pdb->WriteTxIndex(vPos, locator);
+        } catch (const std::exception& e) {
+            LogPrintf("%s : %s\n", __func__, e.what());
+        }
+
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            queue.erase(queue.begin(), queue.begin() + nBlocks);
+            for (std::vector<std::pair<uint256, CDiskTxPos> >::const_iterator it = vPos.begin(); it != vPos.end(); ++it) {
+                // A later block may have queued the transaction again
+                std::map<uint256, CDiskTxPos>::iterator mi = mapQueued.find(it->first);
+                if (mi != mapQueued.end() && SameTxPos(mi->second, it->second))
+                    mapQueued.erase(mi);
+            }
+            if (!fOk)
+                fWriteFailed = true;
+        }
+        condDone.notify_all();
+        if (!fOk) {
+            AbortNode("Failed to write transaction index");
+            return;
+        }
+    }
+}
+
+void CTxIndex::BlockConnected(const CBlock& block, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    // While catching up the thread finds the block itself
+    if (!fSynced)
+        return;
+
+    const CBlockLocator locator = chainActive.GetLocator(pindex);
+    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
+    GetTxPositions(block, pindex->GetBlockPos(), vPos);
+    pindexBest = pindex;
+
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (queue.size() >= MAX_TXINDEX_QUEUED_BLOCKS && !fWriteFailed)
+        condDone.wait(lock);
+    if (fWriteFailed)
+        return;
+    for (std::vector<std::pair<uint256, CDiskTxPos> >::const_iterator it = vPos.begin(); it != vPos.end(); ++it)
+        mapQueued[it->first] = it->second;
+    queue.push_back(CQueuedBlock());
+    queue.back().locator = locator;
+    queue.back().vPos.swap(vPos);
+    condQueue.notify_one();
+}
+
+void CTxIndex::BlockDisconnected(const CBlock& block, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (!fSynced)
+        return;
+
+    // Only the best block moves back, like the entries left in the database
+    pindexBest = pindex->pprev;
+    CQueuedBlock queued;
+    if (pindexBest)
+        queued.locator = chainActive.GetLocator(pindexBest);
+
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (fWriteFailed)
+        return;
+    queue.push_back(queued);
+    condQueue.notify_one();
+}
+
+bool CTxIndex::FindTx(const uint256& txid, CDiskTxPos& pos) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        std::map<uint256, CDiskTxPos>::const_iterator it = mapQueued.find(txid);
+        if (it != mapQueued.end()) {
+            pos = it->second;
+            return true;
+        }
+    }
+    return pdb->ReadTxIndex(txid, pos);
+}
+
+bool CTxIndex::IsSynced() const
+{
+    AssertLockHeld(cs_main);
+    return fSynced;
+}
+
+int CTxIndex::GetBestHeight() const
+{
+    AssertLockHeld(cs_main);
+    return pindexBest ? pindexBest->nHeight : -1;
+}
+
+bool CTxIndex::WaitForWrite() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (!queue.empty() && !fWriteFailed)
+        condDone.wait(lock);
+    return !fWriteFailed;
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DIVIT_TXINDEX_H
+#define DIVIT_TXINDEX_H
+
+#include "main.h"
+#include "validationinterface.h"
+
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+class CBlockTreeDB;
+
+//! Blocks that may be queued for the index thread before block connection waits for it
+static const unsigned int MAX_TXINDEX_QUEUED_BLOCKS = 1000;
+
+/**
+ * Transaction index, built and kept up to date by a thread of its own.
+ *
+ * When the index is behind the active chain, because it was just enabled or was disabled for a
+ * while, the thread catches up by reading the missing blocks from disk. From then on, blocks
+ * connected to the tip are queued by the validation interface and written by the thread, so
+ * block connection does not wait for the database. Queued transactions can be found right away.
+ * Every write carries a locator of the last block it covers, the index's own best block, which is
+ * where catching up resumes after a restart or a reorg. Entries of disconnected blocks are left in
+ * place and overwritten when their transactions are connected again.
+ */
+class CTxIndex : public CValidationInterface
+{
+private:
+    struct CQueuedBlock {
+        CBlockLocator locator;
+        std::vector<std::pair<uint256, CDiskTxPos> > vPos;
+    };
+
+    CBlockTreeDB* pdb;
+
+    mutable boost::mutex cs;
+    boost::condition_variable condQueue;
+    mutable boost::condition_variable condDone;
+    //! Blocks announced after the index caught up that are not written yet, oldest first
+    std::deque<CQueuedBlock> queue;
+    //! Positions of the transactions in queue
+    std::map<uint256, CDiskTxPos> mapQueued;
+    bool fWriteFailed;
+    bool fStop;
+
+    //! Last block of the active chain the index covers, queued blocks included. Protected by cs_main.
+    const CBlockIndex* pindexBest;
+    //! Whether blocks are queued as they are connected. Protected by cs_main.
+    bool fSynced;
+
+    boost::thread threadIndex;
+
+    void ThreadIndex();
+    //! Index the block that follows pindexBest in the active chain, or note that there is none
+    bool SyncNextBlock(bool& fCaughtUp);
+    bool IsStopping() const;
+
+protected:
+    void BlockConnected(const CBlock& block, const CBlockIndex* pindex);
+    void BlockDisconnected(const CBlock& block, const CBlockIndex* pindex);
+
+public:
+    explicit CTxIndex(CBlockTreeDB* pdbIn);
+    //! Write the queued blocks and stop the thread
+    ~CTxIndex();
+
+    //! Load the best block of the index and start the thread
+    void Start();
+
+    //! Look a transaction up among the queued blocks and in the database
+    bool FindTx(const uint256& txid, CDiskTxPos& pos) const;
+
+    //! Whether the index covers the whole active chain, so a missing transaction is not in it. Requires cs_main.
+    bool IsSynced() const;
+    //! Height of the last indexed block, -1 when there is none. Requires cs_main.
+    int GetBestHeight() const;
+
+    //! Wait until the queued blocks are in the database. Returns false if a write failed.
+    bool WaitForWrite() const;
+
+    //! Compute the position of each transaction of a block written at pos
+    static void GetTxPositions(const CBlock& block, const CDiskBlockPos& pos, std::vector<std::pair<uint256, CDiskTxPos> >& vPos);
+};
+
+//! The transaction index, null when -txindex is off
+extern CTxIndex* ptxindex;
+
+#endif // DIVIT_TXINDEX_H
@@ -360,6 +360,8 @@ public:
     uint256& SetCompact(uint32_t nCompact, bool* pfNegative = NULL, bool* pfOverflow = NULL);
     uint32_t GetCompact(bool fNegative = false) const;
     uint64_t GetHash(const uint256& salt) const;
+    //! salted hash that also mixes in a 32-bit value (e.g. an output index)
+    uint64_t GetHash(const uint256& salt, uint32_t nExtra) const;
 };
 
 /* uint256 from const char *.
@@ -1423,6 +1423,59 @@ std::list<CDeterministicMint> CWalletDB::ListDeterministicMints()
     return listMints;
 }
 
+bool CWalletDB::WriteMintWitness(const uint256& hashPubcoin, const CMintWitness& witness)
+{
+    return Write(make_pair(string("zwitness"), hashPubcoin), witness, true);
+}
+
+bool CWalletDB::EraseMintWitness(const uint256& hashPubcoin)
+{
+    return Erase(make_pair(string("zwitness"), hashPubcoin));
+}
+
+std::map<uint256, CMintWitness> CWalletDB::ListMintWitnesses()
+{
+    std::map<uint256, CMintWitness> mapWitnesses;
+    Dbc* pcursor = GetCursor();
+    if (!pcursor)
+        throw runtime_error(std::string(__func__)+" : cannot create DB cursor");
+    unsigned int fFlags = DB_SET_RANGE;
+    for (;;)
+    {
+        // Read next record
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        if (fFlags == DB_SET_RANGE)
+            ssKey << make_pair(string("zwitness"), uint256(0));
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        int ret = ReadAtCursor(pcursor, ssKey, ssValue, fFlags);
+        fFlags = DB_NEXT;
+        if (ret == DB_NOTFOUND)
+            break;
+        else if (ret != 0)
+        {
+            pcursor->close();
+            throw runtime_error(std::string(__func__)+" : error scanning DB");
+        }
+
+        // Unserialize
+        string strType;
+        ssKey >> strType;
+        if (strType != "zwitness")
+            break;
+
+        uint256 hashPubcoin;
+        ssKey >> hashPubcoin;
+
+        CMintWitness witness;
+        ssValue >> witness;
+
+        mapWitnesses.insert(make_pair(hashPubcoin, witness));
+    }
+
+    pcursor->close();
+    return mapWitnesses;
+}
+
 std::list<CZerocoinMint> CWalletDB::ListMintedCoins()
 {
     std::list<CZerocoinMint> listPubCoin;
@@ -32,6 +32,7 @@ class CScript;
 class CWallet;
 class CWalletTx;
 class CDeterministicMint;
+class CMintWitness;
 class CZerocoinMint;
 class CZerocoinSpend;
 class uint160;
@@ -171,6 +172,9 @@ public:
     std::list<CBigNum> ListSpentCoinsSerial();
     std::list<CZerocoinMint> ListArchivedZerocoins();
     std::list<CDeterministicMint> ListArchivedDeterministicMints();
+    bool WriteMintWitness(const uint256& hashPubcoin, const CMintWitness& witness);
+    bool EraseMintWitness(const uint256& hashPubcoin);
+    std::map<uint256, CMintWitness> ListMintWitnesses();
     bool WriteZerocoinSpendSerialEntry(const CZerocoinSpend& zerocoinSpend);
     bool EraseZerocoinSpendSerialEntry(const CBigNum& serialEntry);
     bool ReadZerocoinSpendSerialEntry(const CBigNum& bnSerial);
@@ -0,0 +1,106 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zerocoinfilter.h"
+
+#include "random.h"
+#include "uint256.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string.h>
+
+CZerocoinFilter::CZerocoinFilter() : nBits(0), nHashFuncs(0), nSalt(0), nCapacity(0), nElements(0), fLoaded(false), nLookups(0), nFiltered(0), nFalsePositives(0)
+{
+    Reset(ZEROCOIN_FILTER_MIN_ELEMENTS);
+}
+
+void CZerocoinFilter::Reset(uint64_t nCapacityIn)
+{
+    LOCK(cs);
+    nCapacity = std::max(nCapacityIn, ZEROCOIN_FILTER_MIN_ELEMENTS);
+    const double LN2 = 0.6931471805599453;
+    nBits = (uint64_t)(-1 / (LN2 * LN2) * nCapacity * log(ZEROCOIN_FILTER_FP_RATE));
+    nBits = (nBits + 63) & ~(uint64_t)63;
+    nHashFuncs = std::max(1, (int)(nBits / (double)nCapacity * LN2 + 0.5));
+    std::vector<uint64_t>(nBits / 64, 0).swap(vBits);
+    // A different salt on every node keeps crafted hashes from colliding everywhere
+    nSalt = GetRand(std::numeric_limits<uint64_t>::max());
+    nElements = 0;
+    fLoaded = false;
+}
+
+void CZerocoinFilter::SetLoaded()
+{
+    LOCK(cs);
+    fLoaded = true;
+}
+
+//! Two 64 bit words of the hash, combined into the positions of the hash functions
+static void GetFilterWords(const uint256& hash, uint64_t nSalt, uint64_t& h1, uint64_t& h2)
+{
+    memcpy(&h1, hash.begin(), sizeof(h1));
+    memcpy(&h2, hash.begin() + sizeof(h1), sizeof(h2));
+    h1 ^= nSalt;
+    h2 |= 1;
+}
+
+void CZerocoinFilter::Insert(const uint256& hash)
+{
+    LOCK(cs);
+    uint64_t h1, h2;
+    GetFilterWords(hash, nSalt, h1, h2);
+    for (unsigned int i = 0; i < nHashFuncs; i++) {
+        uint64_t nBit = (h1 + i * h2) % nBits;
+        vBits[nBit >> 6] |= (uint64_t)1 << (nBit & 63);
+    }
+    nElements++;
+}
+
+bool CZerocoinFilter::MayContain(const uint256& hash) const
+{
+    LOCK(cs);
+    if (!fLoaded)
+        return true;
+    nLookups++;
+    uint64_t h1, h2;
+    GetFilterWords(hash, nSalt, h1, h2);
+    for (unsigned int i = 0; i < nHashFuncs; i++) {
+        uint64_t nBit = (h1 + i * h2) % nBits;
+        if (!(vBits[nBit >> 6] & ((uint64_t)1 << (nBit & 63)))) {
+            nFiltered++;
+            return false;
+        }
+    }
+    return true;
+}
+
+void CZerocoinFilter::AddFalsePositive() const
+{
+    LOCK(cs);
+    if (fLoaded)
+        nFalsePositives++;
+}
+
+bool CZerocoinFilter::IsOverCapacity() const
+{
+    LOCK(cs);
+    return nElements > nCapacity;
+}
+
+CZerocoinFilterStats CZerocoinFilter::GetStats() const
+{
+    LOCK(cs);
+    CZerocoinFilterStats stats;
+    stats.fLoaded = fLoaded;
+    stats.nElements = nElements;
+    stats.nCapacity = nCapacity;
+    stats.nBytes = vBits.size() * sizeof(uint64_t);
+    stats.nHashFuncs = nHashFuncs;
+    stats.nLookups = nLookups;
+    stats.nFiltered = nFiltered;
+    stats.nFalsePositives = nFalsePositives;
+    return stats;
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DIVIT_ZEROCOINFILTER_H
+#define DIVIT_ZEROCOINFILTER_H
+
+#include "sync.h"
+
+#include <stdint.h>
+#include <vector>
+
+class uint256;
+
+//! False positive rate the zerocoin filters are sized for
+static const double ZEROCOIN_FILTER_FP_RATE = 0.001;
+//! Fewest elements a zerocoin filter is sized for
+static const uint64_t ZEROCOIN_FILTER_MIN_ELEMENTS = 100000;
+
+/** State and lookup counts of a zerocoin filter */
+struct CZerocoinFilterStats {
+    bool fLoaded;
+    uint64_t nElements;
+    uint64_t nCapacity;
+    uint64_t nBytes;
+    unsigned int nHashFuncs;
+    uint64_t nLookups;
+    //! Lookups answered without reading the database
+    uint64_t nFiltered;
+    //! Lookups passed on to the database that did not find the hash
+    uint64_t nFalsePositives;
+};
+
+/**
+ * Bloom filter over the hashes of the spent serials or of the minted pubcoins in the zerocoin
+ * database, so the lookups of coins that are not there, which are most of them, do not read
+ * the database. The hashes are SHA-256 based, so their bits serve as the hash functions.
+ * Erasing a hash from the database leaves it in the filter, which only costs a read, until
+ * the filter is rebuilt.
+ */
+class CZerocoinFilter
+{
+private:
+    mutable CCriticalSection cs;
+    std::vector<uint64_t> vBits;
+    uint64_t nBits;
+    unsigned int nHashFuncs;
+    uint64_t nSalt;
+    uint64_t nCapacity;
+    uint64_t nElements;
+    bool fLoaded;
+    mutable uint64_t nLookups;
+    mutable uint64_t nFiltered;
+    mutable uint64_t nFalsePositives;
+
+public:
+    CZerocoinFilter();
+
+    //! Empty the filter and size it for nCapacityIn hashes. It answers lookups again after SetLoaded().
+    void Reset(uint64_t nCapacityIn);
+    //! The filter holds every hash in the database from here on
+    void SetLoaded();
+    void Insert(const uint256& hash);
+    //! Whether the hash may be in the database, always true while the filter is not loaded
+    bool MayContain(const uint256& hash) const;
+    //! Count a hash the filter passed on that the database did not have
+    void AddFalsePositive() const;
+    //! Whether more hashes were inserted than the filter is sized for
+    bool IsOverCapacity() const;
+    CZerocoinFilterStats GetStats() const;
+};
+
+#endif // DIVIT_ZEROCOINFILTER_H
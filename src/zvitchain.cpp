@@ -3,11 +3,17 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "zvitchain.h"
+#include "init.h"
 #include "invalid.h"
 #include "main.h"
 #include "txdb.h"
 #include "ui_interface.h"
 
+#include <deque>
+#include <memory>
+
+#include <boost/thread.hpp>
+
 // 6 comes from OPCODE (1) + vch.size() (1) + BIGNUM size (4)
 #define SCRIPT_OFFSET 6
 // For Script size (BIGNUM/Uint256 size)
@@ -79,6 +85,22 @@ bool BlockToPubcoinList(const CBlock& block, std::list<libzerocoin::PublicCoin>&
     return true;
 }
 
+bool BlockToAccumulatedPubcoins(const CBlock& block, const CBlockIndex* pindex, std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> >& mapPubcoins)
+{
+    // Every minted denomination gets an entry, even if all of its mints are filtered out
+    for (const libzerocoin::CoinDenomination denom : pindex->GetMintDenominations())
+        mapPubcoins[denom];
+
+    std::list<libzerocoin::PublicCoin> listPubcoins;
+    if (!BlockToPubcoinList(block, listPubcoins, true))
+        return false;
+
+    for (const libzerocoin::PublicCoin& pubcoin : listPubcoins)
+        mapPubcoins[pubcoin.getDenomination()].push_back(pubcoin.getValue());
+
+    return true;
+}
+
 //return a list of zerocoin mints contained in a specific block
 bool BlockToZerocoinMintList(const CBlock& block, std::list<CZerocoinMint>& vMints, bool fFilterInvalid)
 {
@@ -253,80 +275,276 @@ bool IsSerialInBlockchain(const uint256& hashSerial, int& nHeightTx, uint256& tx
     return IsTransactionInChain(txidSpend, nHeightTx, tx);
 }
 
-std::string ReindexZerocoinDB()
+namespace
 {
-    if (!zerocoinDB->WipeCoins("spends") || !zerocoinDB->WipeCoins("mints")) {
-        return _("Failed to wipe zerocoinDB");
+/** A block being reindexed, with the zerocoin spends and mints found in it */
+struct CZerocoinReindexBlock {
+    uint64_t nSequence;
+    int nHeight;
+    CBlock block;
+    bool fParsed;
+    std::vector<std::pair<libzerocoin::CoinSpend, uint256> > vSpendInfo;
+    std::vector<std::pair<libzerocoin::PublicCoin, uint256> > vMintInfo;
+
+    CZerocoinReindexBlock() : nSequence(0), nHeight(0), fParsed(false) {}
+};
+typedef std::shared_ptr<CZerocoinReindexBlock> CZerocoinReindexBlockRef;
+
+/**
+ * Reads the blocks of a zerocoin reindex in a pipeline. A reader thread reads them from disk
+ * in height order, a pool of workers parses their spends and mints, and Next() hands them
+ * back in height order. The reader stays at most MAX_ZEROCOIN_REINDEX_BLOCKS_IN_FLIGHT blocks
+ * ahead of the caller.
+ */
+class CZerocoinReindexPipeline
+{
+private:
+    const std::vector<const CBlockIndex*>& vBlocks;
+
+    boost::mutex cs;
+    boost::condition_variable condReader;
+    boost::condition_variable condWorker;
+    boost::condition_variable condResult;
+
+    //! Blocks read from disk, waiting for a worker
+    std::deque<CZerocoinReindexBlockRef> queueRead;
+    //! Parsed blocks by sequence number, waiting for Next()
+    std::map<uint64_t, CZerocoinReindexBlockRef> mapParsed;
+    uint64_t nNextRead;
+    uint64_t nNextResult;
+    bool fStop;
+
+    boost::thread_group threads;
+
+    void ThreadRead();
+    void ThreadParse();
+
+public:
+    CZerocoinReindexPipeline(const std::vector<const CBlockIndex*>& vBlocksIn, int nWorkers);
+    ~CZerocoinReindexPipeline();
+
+    //! Wait for the next block in height order, returns false after the last one
+    bool Next(CZerocoinReindexBlockRef& pblock);
+};
+
+CZerocoinReindexPipeline::CZerocoinReindexPipeline(const std::vector<const CBlockIndex*>& vBlocksIn, int nWorkers) : vBlocks(vBlocksIn), nNextRead(0), nNextResult(0), fStop(false)
+{
+    threads.create_thread(boost::bind(&CZerocoinReindexPipeline::ThreadRead, this));
+    for (int i = 0; i < nWorkers; i++)
+        threads.create_thread(boost::bind(&CZerocoinReindexPipeline::ThreadParse, this));
+}
+
+CZerocoinReindexPipeline::~CZerocoinReindexPipeline()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = true;
     }
+    condReader.notify_all();
+    condWorker.notify_all();
+    threads.join_all();
+}
 
-    uiInterface.ShowProgress(_("Reindexing zerocoin database..."), 0);
+void CZerocoinReindexPipeline::ThreadRead()
+{
+    RenameThread("Divitae-zcread");
+    for (uint64_t nSequence = 0; nSequence < vBlocks.size(); nSequence++) {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            while (!fStop && nNextRead - nNextResult >= MAX_ZEROCOIN_REINDEX_BLOCKS_IN_FLIGHT)
+                condReader.wait(lock);
+            if (fStop)
+                return;
+        }
 
-    CBlockIndex* pindex = chainActive[Params().Zerocoin_StartHeight()];
-    std::vector<std::pair<libzerocoin::CoinSpend, uint256> > vSpendInfo;
-    std::vector<std::pair<libzerocoin::PublicCoin, uint256> > vMintInfo;
-    while (pindex) {
-        uiInterface.ShowProgress(_("Reindexing zerocoin database..."), std::max(1, std::min(99, (int)((double)(pindex->nHeight - Params().Zerocoin_StartHeight()) / (double)(chainActive.Height() - Params().Zerocoin_StartHeight()) * 100))));
+        // A block that can not be read goes on unparsed, the caller stops at it. Old blocks are
+        // read past the block cache, which is meant for blocks in use.
+        const CBlockIndex* pindex = vBlocks[nSequence];
+        CZerocoinReindexBlockRef pblock(new CZerocoinReindexBlock());
+        pblock->nSequence = nSequence;
+        pblock->nHeight = pindex->nHeight;
+        if (!ReadBlockFromDisk(pblock->block, pindex->GetBlockPos()) || pblock->block.GetHash() != pindex->GetBlockHash()) {
+            LogPrintf("%s : failed to read block %d\n", __func__, pblock->nHeight);
+            pblock->block.SetNull();
+        }
 
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("Reindexing zerocoin : block %d...\n", pindex->nHeight);
+        boost::unique_lock<boost::mutex> lock(cs);
+        nNextRead++;
+        queueRead.push_back(pblock);
+        condWorker.notify_one();
+    }
+}
 
-        CBlock block;
-        if (!ReadBlockFromDisk(block, pindex)) {
-            return _("Reindexing zerocoin failed");
+void CZerocoinReindexPipeline::ThreadParse()
+{
+    RenameThread("Divitae-zcparse");
+    while (true) {
+        CZerocoinReindexBlockRef pblock;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            while (!fStop && queueRead.empty())
+                condWorker.wait(lock);
+            if (fStop)
+                return;
+            pblock = queueRead.front();
+            queueRead.pop_front();
         }
 
-        for (const CTransaction& tx : block.vtx) {
-            for (unsigned int i = 0; i < tx.vin.size(); i++) {
-                if (tx.IsCoinBase())
-                    break;
+        try {
+            const bool fV1Params = pblock->nHeight < Params().Zerocoin_Block_V2_Start();
+            for (const CTransaction& tx : pblock->block.vtx) {
+                if (tx.IsCoinBase() || !tx.ContainsZerocoins())
+                    continue;
+
+                uint256 txid = tx.GetHash();
+                //Record Serials
+                if (tx.IsZerocoinSpend()) {
+                    for (auto& in : tx.vin) {
+                        if (!in.scriptSig.IsZerocoinSpend())
+                            continue;
 
-                if (tx.ContainsZerocoins()) {
-                    uint256 txid = tx.GetHash();
-                    //Record Serials
-                    if (tx.IsZerocoinSpend()) {
-                        for (auto& in : tx.vin) {
-                            if (!in.scriptSig.IsZerocoinSpend())
-                                continue;
-
-                            libzerocoin::CoinSpend spend = TxInToZerocoinSpend(in);
-                            vSpendInfo.push_back(make_pair(spend, txid));
-                        }
+                        libzerocoin::CoinSpend spend = TxInToZerocoinSpend(in);
+                        pblock->vSpendInfo.push_back(make_pair(spend, txid));
                     }
+                }
+
+                //Record mints
+                if (tx.IsZerocoinMint()) {
+                    for (auto& out : tx.vout) {
+                        if (!out.IsZerocoinMint())
+                            continue;
 
-                    //Record mints
-                    if (tx.IsZerocoinMint()) {
-                        for (auto& out : tx.vout) {
-                            if (!out.IsZerocoinMint())
-                                continue;
-
-                            CValidationState state;
-                            libzerocoin::PublicCoin coin(Params().Zerocoin_Params(pindex->nHeight < Params().Zerocoin_Block_V2_Start()));
-                            TxOutToPublicCoin(out, coin, state);
-                            vMintInfo.push_back(make_pair(coin, txid));
-                        }
+                        CValidationState state;
+                        libzerocoin::PublicCoin coin(Params().Zerocoin_Params(fV1Params));
+                        TxOutToPublicCoin(out, coin, state);
+                        pblock->vMintInfo.push_back(make_pair(coin, txid));
                     }
                 }
             }
+            pblock->fParsed = !pblock->block.IsNull();
+        } catch (const std::exception& e) {
+            LogPrintf("%s : failed to parse block %d - %s\n", __func__, pblock->nHeight, e.what());
         }
+        // Only the spends and mints are kept until the block is written
+        pblock->block.SetNull();
+
+        boost::unique_lock<boost::mutex> lock(cs);
+        mapParsed[pblock->nSequence] = pblock;
+        condResult.notify_all();
+    }
+}
+
+bool CZerocoinReindexPipeline::Next(CZerocoinReindexBlockRef& pblock)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (nNextResult == vBlocks.size())
+        return false;
+    std::map<uint64_t, CZerocoinReindexBlockRef>::iterator it;
+    while ((it = mapParsed.find(nNextResult)) == mapParsed.end())
+        condResult.wait(lock);
+    pblock = it->second;
+    mapParsed.erase(it);
+    nNextResult++;
+    condReader.notify_one();
+    return true;
+}
+} // anon namespace
+
+std::string ReindexZerocoinDB()
+{
+    // Marked until the spends and mints of the last block are written, so an interrupted reindex is run again
+    if (!zerocoinDB->WriteFlag("reindexzerocoin", true) || !zerocoinDB->WipeCoins("spends") || !zerocoinDB->WipeCoins("mints")) {
+        return _("Failed to wipe zerocoinDB");
+    }
+
+    uiInterface.ShowProgress(_("Reindexing zerocoin database..."), 0);
+
+    std::vector<const CBlockIndex*> vBlocks;
+    {
+        LOCK(cs_main);
+        for (CBlockIndex* pindex = chainActive[Params().Zerocoin_StartHeight()]; pindex; pindex = chainActive.Next(pindex))
+            vBlocks.push_back(pindex);
+    }
+
+    // Reading and parsing run ahead on their own threads, this thread only writes
+    const int nWorkers = std::max(1, std::min(MAX_ZEROCOIN_REINDEX_THREADS, (int)boost::thread::hardware_concurrency() - 1));
+    CZerocoinReindexPipeline pipeline(vBlocks, nWorkers);
+
+    std::vector<std::pair<libzerocoin::CoinSpend, uint256> > vSpendInfo;
+    std::vector<std::pair<libzerocoin::PublicCoin, uint256> > vMintInfo;
+    int nProgress = 0;
+    CZerocoinReindexBlockRef pblock;
+    while (pipeline.Next(pblock)) {
+        if (ShutdownRequested()) {
+            LogPrintf("Reindexing zerocoin interrupted at block %d, it continues at the next start\n", pblock->nHeight);
+            return "";
+        }
+
+        int nProgressBlock = std::max(1, std::min(99, (int)((double)(pblock->nSequence + 1) / (double)vBlocks.size() * 100)));
+        if (nProgressBlock != nProgress) {
+            nProgress = nProgressBlock;
+            uiInterface.ShowProgress(_("Reindexing zerocoin database..."), nProgress);
+        }
+
+        if (pblock->nHeight % 1000 == 0)
+            LogPrintf("Reindexing zerocoin : block %d...\n", pblock->nHeight);
+
+        if (!pblock->fParsed)
+            return _("Reindexing zerocoin failed");
+
+        vSpendInfo.insert(vSpendInfo.end(), pblock->vSpendInfo.begin(), pblock->vSpendInfo.end());
+        vMintInfo.insert(vMintInfo.end(), pblock->vMintInfo.begin(), pblock->vMintInfo.end());
 
         // Flush the zerocoinDB to disk every 100 blocks
-        if (pindex->nHeight % 100 == 0) {
+        if (pblock->nHeight % 100 == 0) {
             if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
                 return _("Error writing zerocoinDB to disk");
             vSpendInfo.clear();
             vMintInfo.clear();
         }
-
-        pindex = chainActive.Next(pindex);
     }
-    uiInterface.ShowProgress("", 100);
 
     // Final flush to disk in case any remaining information exists
     if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
         return _("Error writing zerocoinDB to disk");
 
+    if (!zerocoinDB->WriteFlag("reindexzerocoin", false))
+        return _("Error writing zerocoinDB to disk");
+
+    uiInterface.ShowProgress("", 100);
+
+    return "";
+}
+
+std::string IndexBlockPubcoins()
+{
+    uiInterface.ShowProgress(_("Indexing zerocoin mints..."), 0);
+
+    int nHeightStart = Params().Zerocoin_StartHeight();
+    CBlockIndex* pindex = chainActive[nHeightStart];
+    while (pindex) {
+        uiInterface.ShowProgress(_("Indexing zerocoin mints..."), std::max(1, std::min(99, (int)((double)(pindex->nHeight - nHeightStart) / (double)(chainActive.Height() - nHeightStart + 1) * 100))));
+
+        if (pindex->nHeight % 1000 == 0)
+            LogPrintf("Indexing zerocoin mints : block %d...\n", pindex->nHeight);
+
+        if (!pindex->GetMintDenominations().empty()) {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex))
+                return _("Zerocoin mints of pruned blocks can not be indexed, you need to rebuild the database using -reindex");
+
+            std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> > mapPubcoins;
+            if (!BlockToAccumulatedPubcoins(block, pindex, mapPubcoins) || !zerocoinDB->WriteBlockPubcoins(pindex->nHeight, mapPubcoins))
+                return _("Error writing zerocoinDB to disk");
+        }
+
+        pindex = chainActive.Next(pindex);
+    }
     uiInterface.ShowProgress("", 100);
 
+    if (!zerocoinDB->WriteFlag("blockpubcoins", true))
+        return _("Error writing zerocoinDB to disk");
+
     return "";
 }
 
@@ -9,9 +9,12 @@
 #include "libzerocoin/Denominations.h"
 #include "libzerocoin/CoinSpend.h"
 #include <list>
+#include <map>
+#include <stdint.h>
 #include <string>
 
 class CBlock;
+class CBlockIndex;
 class CBigNum;
 struct CMintMeta;
 class CTransaction;
@@ -21,6 +24,12 @@ class CValidationState;
 class CZerocoinMint;
 class uint256;
 
+//! Most threads parsing blocks during -reindexzerocoin
+static const int MAX_ZEROCOIN_REINDEX_THREADS = 8;
+//! Blocks that may be read ahead of writing them to the zerocoin database during -reindexzerocoin
+static const uint64_t MAX_ZEROCOIN_REINDEX_BLOCKS_IN_FLIGHT = 500;
+
+bool BlockToAccumulatedPubcoins(const CBlock& block, const CBlockIndex* pindex, std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> >& mapPubcoins);
 bool BlockToMintValueVector(const CBlock& block, const libzerocoin::CoinDenomination denom, std::vector<CBigNum>& vValues);
 bool BlockToPubcoinList(const CBlock& block, std::list<libzerocoin::PublicCoin>& listPubcoins, bool fFilterInvalid);
 bool BlockToZerocoinMintList(const CBlock& block, std::list<CZerocoinMint>& vMints, bool fFilterInvalid);
@@ -33,6 +42,7 @@ bool IsSerialInBlockchain(const CBigNum& bnSerial, int& nHeightTx);
 bool IsSerialInBlockchain(const uint256& hashSerial, int& nHeightTx, uint256& txidSpend);
 bool IsSerialInBlockchain(const uint256& hashSerial, int& nHeightTx, uint256& txidSpend, CTransaction& tx);
 bool RemoveSerialFromDB(const CBigNum& bnSerial);
+std::string IndexBlockPubcoins();
 std::string ReindexZerocoinDB();
 libzerocoin::CoinSpend TxInToZerocoinSpend(const CTxIn& txin);
 bool TxOutToPublicCoin(const CTxOut& txout, libzerocoin::PublicCoin& pubCoin, CValidationState& state);
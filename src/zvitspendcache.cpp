@@ -0,0 +1,94 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zvitspendcache.h"
+
+#include "hash.h"
+#include "primitives/transaction.h"
+#include "random.h"
+#include "uint256.h"
+#include "util.h"
+
+#include <atomic>
+#include <set>
+#include <utility>
+
+#include <boost/thread.hpp>
+
+namespace {
+
+class CZerocoinSpendCache
+{
+private:
+    //! spenddata_type is (spend hash, accumulator checksum)
+    typedef std::pair<uint256, uint32_t> spenddata_type;
+    std::set<spenddata_type> setValid;
+    boost::shared_mutex cs_spendcache;
+
+    std::atomic<uint64_t> nLookups;
+    std::atomic<uint64_t> nHits;
+
+public:
+    CZerocoinSpendCache() : nLookups(0), nHits(0) {}
+
+    bool Get(const uint256& hashSpend, uint32_t nAccumulatorChecksum)
+    {
+        ++nLookups;
+
+        boost::shared_lock<boost::shared_mutex> lock(cs_spendcache);
+        if (!setValid.count(spenddata_type(hashSpend, nAccumulatorChecksum)))
+            return false;
+
+        ++nHits;
+        return true;
+    }
+
+    void Set(const uint256& hashSpend, uint32_t nAccumulatorChecksum)
+    {
+        int64_t nMaxCacheSize = GetArg("-maxzerocoinspendcachesize", DEFAULT_MAX_ZEROCOIN_SPEND_CACHE_SIZE);
+        if (nMaxCacheSize <= 0) return;
+
+        boost::unique_lock<boost::shared_mutex> lock(cs_spendcache);
+
+        while (static_cast<int64_t>(setValid.size()) >= nMaxCacheSize) {
+            // Evict a random entry, same as the signature cache does.
+            std::set<spenddata_type>::iterator it = setValid.lower_bound(spenddata_type(GetRandHash(), 0));
+            if (it == setValid.end())
+                it = setValid.begin();
+            setValid.erase(it);
+        }
+
+        setValid.insert(spenddata_type(hashSpend, nAccumulatorChecksum));
+    }
+
+    void GetStats(uint64_t& nLookupsOut, uint64_t& nHitsOut) const
+    {
+        nLookupsOut = nLookups;
+        nHitsOut = nHits;
+    }
+};
+
+CZerocoinSpendCache spendCache;
+
+}
+
+uint256 GetZerocoinSpendCacheHash(const CTxIn& txin)
+{
+    return Hash(txin.scriptSig.begin(), txin.scriptSig.end());
+}
+
+bool IsZerocoinSpendVerified(const uint256& hashSpend, uint32_t nAccumulatorChecksum)
+{
+    return spendCache.Get(hashSpend, nAccumulatorChecksum);
+}
+
+void SetZerocoinSpendVerified(const uint256& hashSpend, uint32_t nAccumulatorChecksum)
+{
+    spendCache.Set(hashSpend, nAccumulatorChecksum);
+}
+
+void GetZerocoinSpendCacheStats(uint64_t& nLookups, uint64_t& nHits)
+{
+    spendCache.GetStats(nLookups, nHits);
+}
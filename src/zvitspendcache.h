@@ -0,0 +1,31 @@
+// Copyright (c) 2018 The DIVIT developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DIVIT_ZVITSPENDCACHE_H
+#define DIVIT_ZVITSPENDCACHE_H
+
+#include <stdint.h>
+
+class CTxIn;
+class uint256;
+
+/** Default for -maxzerocoinspendcachesize, the number of verified zerocoin spends to remember */
+static const unsigned int DEFAULT_MAX_ZEROCOIN_SPEND_CACHE_SIZE = 10000;
+
+/** Hash identifying a zerocoin spend for the verified spend cache */
+uint256 GetZerocoinSpendCacheHash(const CTxIn& txin);
+
+/**
+ * Valid zerocoin spend cache, to avoid verifying the expensive spend proofs
+ * twice for every spend (once when accepted into memory pool, and again
+ * when accepted into the block chain). Entries are keyed by the spend hash
+ * and the checksum of the accumulator the spend was verified against.
+ */
+bool IsZerocoinSpendVerified(const uint256& hashSpend, uint32_t nAccumulatorChecksum);
+void SetZerocoinSpendVerified(const uint256& hashSpend, uint32_t nAccumulatorChecksum);
+
+/** Number of lookups and hits of the verified spend cache since startup */
+void GetZerocoinSpendCacheStats(uint64_t& nLookups, uint64_t& nHits);
+
+#endif // DIVIT_ZVITSPENDCACHE_H
@@ -5,6 +5,8 @@
 #include "main.h"
 #include "txdb.h"
 #include "walletdb.h"
+#include "init.h"
+#include "wallet.h"
 #include "accumulators.h"
 
 using namespace std;
@@ -15,10 +17,13 @@ CzDIVITTracker::CzDIVITTracker(std::string strWalletFile)
     mapSerialHashes.clear();
     mapPendingSpends.clear();
     fInitialized = false;
+    fWitnessUpdate = false;
+    fStopWitness = false;
 }
 
 CzDIVITTracker::~CzDIVITTracker()
 {
+    StopWitnessThread();
     mapSerialHashes.clear();
     mapPendingSpends.clear();
 }
@@ -28,6 +33,7 @@ void CzDIVITTracker::Init()
     //Load all CZerocoinMints and CDeterministicMints from the database
     if (!fInitialized) {
         ListMints(false, false, true);
+        mapWitnesses = CWalletDB(strWalletFile).ListMintWitnesses();
         fInitialized = true;
     }
 }
@@ -488,3 +494,197 @@ void CzDIVITTracker::Clear()
 {
     mapSerialHashes.clear();
 }
+
+bool CzDIVITTracker::GetWitness(const uint256& hashPubcoin, CMintWitness& witness) const
+{
+    auto it = mapWitnesses.find(hashPubcoin);
+    if (it == mapWitnesses.end())
+        return false;
+    witness = it->second;
+    return true;
+}
+
+void CzDIVITTracker::StartWitnessThread()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(csWitness);
+        fWitnessUpdate = true;
+        fStopWitness = false;
+    }
+    threadWitness = boost::thread(&CzDIVITTracker::ThreadWitness, this);
+}
+
+void CzDIVITTracker::StopWitnessThread()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(csWitness);
+        fStopWitness = true;
+    }
+    condWitness.notify_all();
+    if (threadWitness.joinable())
+        threadWitness.join();
+}
+
+bool CzDIVITTracker::IsWitnessStopping()
+{
+    boost::unique_lock<boost::mutex> lock(csWitness);
+    return fStopWitness;
+}
+
+void CzDIVITTracker::BlockConnected(const CBlock& block, const CBlockIndex* pindex)
+{
+    // Witnesses move a checkpoint at a time
+    if (pindex->nHeight % 10 != 0)
+        return;
+    {
+        boost::unique_lock<boost::mutex> lock(csWitness);
+        fWitnessUpdate = true;
+    }
+    condWitness.notify_one();
+}
+
+void CzDIVITTracker::BlockDisconnected(const CBlock& block, const CBlockIndex* pindex)
+{
+    // Witnesses of the disconnected blocks are rebuilt, coins can not be taken out of an accumulator
+    {
+        boost::unique_lock<boost::mutex> lock(csWitness);
+        fWitnessUpdate = true;
+    }
+    condWitness.notify_one();
+}
+
+void CzDIVITTracker::ThreadWitness()
+{
+    RenameThread("Divitae-zwitness");
+
+    while (true) {
+        {
+            boost::unique_lock<boost::mutex> lock(csWitness);
+            while (!fWitnessUpdate && !fStopWitness)
+                condWitness.wait(lock);
+            if (fStopWitness)
+                return;
+            fWitnessUpdate = false;
+        }
+
+        bool fMore = true;
+        while (fMore && !IsWitnessStopping()) {
+            try {
+                fMore = UpdateWitnesses();
+            } catch (const std::exception& e) {
+                LogPrintf("%s : %s\n", __func__, e.what());
+                fMore = false;
+            }
+        }
+    }
+}
+
+bool CzDIVITTracker::UpdateWitnesses()
+{
+    // Pick the witnesses to advance and the blocks they need while the chain can not change
+    std::vector<std::pair<uint256, CMintWitness> > vJobs;
+    std::vector<const CBlockIndex*> vBlocks;
+    int nHeightFirst = 0;
+    int nHeightTarget;
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        int nHeightTip = chainActive.Height();
+        // Spends use checkpoints at least two deep, the same blocks GenerateAccumulatorWitness stops at
+        nHeightTarget = nHeightTip - nHeightTip % 10 - 20;
+        if (nHeightTarget <= 0)
+            return false;
+
+        std::set<uint256> setUnspent;
+        for (const CMintMeta& meta : GetMints(true)) {
+            setUnspent.insert(meta.hashPubcoin);
+            if (meta.nHeight <= 0 || meta.nHeight >= nHeightTarget)
+                continue;
+
+            CMintWitness witness;
+            auto it = mapWitnesses.find(meta.hashPubcoin);
+            if (it != mapWitnesses.end())
+                witness = it->second;
+
+            // A witness that went off the active chain starts over
+            if (!witness.IsNull() && (witness.denom != meta.denom || witness.nHeightMint != meta.nHeight ||
+                witness.nHeight < 1 || witness.nHeight > nHeightTip + 1 ||
+                chainActive[witness.nHeight - 1]->GetBlockHash() != witness.hashBlock))
+                witness.SetNull();
+
+            if (witness.IsNull()) {
+                // Only start from the height the mint is recorded at
+                std::vector<CBigNum> vPubcoins;
+                if (!zerocoinDB->ReadBlockPubcoins(meta.denom, meta.nHeight, vPubcoins))
+                    continue;
+                bool fFound = false;
+                for (const CBigNum& bnPubcoin : vPubcoins)
+                    fFound |= GetPubCoinHash(bnPubcoin) == meta.hashPubcoin;
+                if (!fFound || !InitMintWitness(meta.denom, meta.nHeight, witness))
+                    continue;
+            }
+
+            if (witness.nHeight >= nHeightTarget)
+                continue;
+            vJobs.emplace_back(meta.hashPubcoin, witness);
+        }
+
+        // Spent and archived mints need no witness anymore
+        CWalletDB walletdb(strWalletFile);
+        for (auto it = mapWitnesses.begin(); it != mapWitnesses.end();) {
+            if (setUnspent.count(it->first)) {
+                ++it;
+                continue;
+            }
+            walletdb.EraseMintWitness(it->first);
+            mapWitnesses.erase(it++);
+        }
+
+        if (vJobs.empty())
+            return false;
+
+        nHeightFirst = nHeightTarget;
+        int nHeightLast = 0;
+        for (const auto& job : vJobs) {
+            nHeightFirst = std::min(nHeightFirst, job.second.nHeight);
+            nHeightLast = std::max(nHeightLast, std::min(nHeightTarget, job.second.nHeight + MAX_WITNESS_UPDATE_BLOCKS));
+            // The blocks accumulated twice are walked again from 1050000
+            if (job.second.nHeight > 1050000 && job.second.nHeight <= 1050010)
+                nHeightFirst = std::min(nHeightFirst, 1050000);
+        }
+        vBlocks.reserve(nHeightLast - nHeightFirst);
+        for (int nHeight = nHeightFirst; nHeight < nHeightLast; nHeight++)
+            vBlocks.push_back(chainActive[nHeight]);
+    }
+
+    // Accumulate without holding the locks, a bounded number of blocks per witness
+    bool fMore = false;
+    std::vector<std::pair<uint256, CMintWitness> > vDone;
+    for (auto& job : vJobs) {
+        if (IsWitnessStopping())
+            break;
+        int nHeightEnd = std::min(nHeightTarget, job.second.nHeight + MAX_WITNESS_UPDATE_BLOCKS);
+        nHeightEnd -= nHeightEnd % 10;
+        if (nHeightEnd <= job.second.nHeight)
+            continue;
+        if (!AdvanceMintWitness(job.first, vBlocks, nHeightFirst, nHeightEnd, job.second)) {
+            LogPrintf("%s: failed to advance the witness of mint %s\n", __func__, job.first.GetHex());
+            continue;
+        }
+        fMore |= nHeightEnd < nHeightTarget;
+        vDone.push_back(job);
+    }
+
+    LOCK(pwalletMain->cs_wallet);
+    CWalletDB walletdb(strWalletFile);
+    for (const auto& done : vDone) {
+        // The mint may have been spent meanwhile
+        if (!HasPubcoinHash(done.first))
+            continue;
+        mapWitnesses[done.first] = done.second;
+        walletdb.WriteMintWitness(done.first, done.second);
+    }
+    if (!vDone.empty())
+        LogPrint("zero", "%s: %d witnesses at height %d or before\n", __func__, vDone.size(), nHeightTarget);
+
+    return fMore;
+}
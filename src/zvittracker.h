@@ -2,11 +2,17 @@
 #define DIVIT_ZPIVTRACKER_H
 
 #include "primitives/zerocoin.h"
+#include "validationinterface.h"
 #include <list>
 
+#include <boost/thread.hpp>
+
 class CDeterministicMint;
 
-class CzDIVITTracker
+//! Most blocks a witness is advanced by before the next witness gets its turn
+static const int MAX_WITNESS_UPDATE_BLOCKS = 1000;
+
+class CzDIVITTracker : public CValidationInterface
 {
 private:
     bool fInitialized;
@@ -14,6 +20,24 @@ private:
     std::map<uint256, CMintMeta> mapSerialHashes;
     std::map<uint256, uint256> mapPendingSpends; //serialhash, txid of spend
     bool UpdateStatusInternal(const std::set<uint256>& setMempool, CMintMeta& mint);
+
+    //! Witnesses of the unspent mints by pubcoin hash, kept two checkpoints behind the tip. Protected by cs_wallet.
+    std::map<uint256, CMintWitness> mapWitnesses;
+    boost::mutex csWitness;
+    boost::condition_variable condWitness;
+    bool fWitnessUpdate;
+    bool fStopWitness;
+    boost::thread threadWitness;
+
+    void ThreadWitness();
+    bool IsWitnessStopping();
+    //! Advance the witnesses a step towards the last checkpoint but one, returns whether there is more to do
+    bool UpdateWitnesses();
+
+protected:
+    void BlockConnected(const CBlock& block, const CBlockIndex* pindex);
+    void BlockDisconnected(const CBlock& block, const CBlockIndex* pindex);
+
 public:
     CzDIVITTracker(std::string strWalletFile);
     ~CzDIVITTracker();
@@ -42,6 +66,12 @@ public:
     bool UpdateZerocoinMint(const CZerocoinMint& mint);
     bool UpdateState(const CMintMeta& meta);
     void Clear();
+
+    //! The kept witness of a mint, it may be behind or off the active chain. Requires cs_wallet.
+    bool GetWitness(const uint256& hashPubcoin, CMintWitness& witness) const;
+    //! Start keeping the witnesses of the wallet's mints up to date in the background
+    void StartWitnessThread();
+    void StopWitnessThread();
 };
 
 #endif //DIVIT_ZPIVTRACKER_H